@@ -40,11 +40,25 @@
 #include "xia_common.h"
 
 #include "handeldef.h"
+#include "handel_mapping.h"
 
 #define XIA_RUN_HARDWARE 0x01
 #define XIA_RUN_HANDEL 0x02
 #define XIA_RUN_CT 0x04
 
+/*
+ * An independent detector system. See xiaContextCreate().
+ */
+typedef struct HandelContext HandelContext;
+
+/*
+ * A special run or gain operation running in the background. See
+ * xiaDoSpecialRunAsync(). The callback runs on the library thread; its
+ * request argument is NULL if no handle was returned to the caller.
+ */
+typedef struct XiaRequest XiaRequest;
+typedef void (*XiaRequestCallback)(XiaRequest* request, int status, void* arg);
+
 /* If this is compiled by a C++ compiler, make it clear that these are C routines */
 #ifdef __cplusplus
 extern "C" {
@@ -97,11 +111,15 @@ HANDEL_IMPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
 HANDEL_IMPORT int HANDEL_API xiaGetAcquisitionValues(int detChan, char* name,
                                                      void* value);
 HANDEL_IMPORT int HANDEL_API xiaRemoveAcquisitionValues(int detChan, char* name);
+HANDEL_IMPORT int HANDEL_API xiaBeginAcquisitionBatch(int detChan);
+HANDEL_IMPORT int HANDEL_API xiaCommitAcquisitionBatch(int detChan);
 HANDEL_IMPORT int HANDEL_API xiaUpdateUserParams(int detChan);
 HANDEL_IMPORT int HANDEL_API xiaGainOperation(int detChan, char* name, void* value);
 HANDEL_IMPORT int HANDEL_API xiaGainCalibrate(int detChan, double deltaGain);
 HANDEL_IMPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume);
 HANDEL_IMPORT int HANDEL_API xiaStopRun(int detChan);
+HANDEL_IMPORT int HANDEL_API xiaWaitRunComplete(int detChan, double timeout);
+HANDEL_IMPORT int HANDEL_API xiaCancel(int detChan);
 HANDEL_IMPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value);
 HANDEL_IMPORT int HANDEL_API xiaDoSpecialRun(int detChan, char* name, void* info);
 HANDEL_IMPORT int HANDEL_API xiaGetSpecialRunData(int detChan, char* name, void* value);
@@ -123,6 +141,100 @@ HANDEL_IMPORT int HANDEL_API xiaCommandOperation(int detChan, byte_t cmd,
 
 HANDEL_IMPORT int HANDEL_API xiaExit(void);
 
+HANDEL_IMPORT int HANDEL_API xiaContextCreate(HandelContext** ctx);
+HANDEL_IMPORT int HANDEL_API xiaContextDestroy(HandelContext* ctx);
+HANDEL_IMPORT int HANDEL_API xiaContextSelect(HandelContext* ctx);
+HANDEL_IMPORT int HANDEL_API xiaInitCtx(HandelContext* ctx, char* iniFile);
+HANDEL_IMPORT int HANDEL_API xiaStartSystemCtx(HandelContext* ctx);
+HANDEL_IMPORT int HANDEL_API xiaExitCtx(HandelContext* ctx);
+
+HANDEL_IMPORT int HANDEL_API xiaDoSpecialRunAsync(int detChan, char* name, void* info,
+                                                  XiaRequestCallback callback, void* arg,
+                                                  XiaRequest** request);
+HANDEL_IMPORT int HANDEL_API xiaGainOperationAsync(int detChan, char* name, void* value,
+                                                   XiaRequestCallback callback,
+                                                   void* arg, XiaRequest** request);
+HANDEL_IMPORT int HANDEL_API xiaWaitRunCompleteAsync(int detChan, double timeout,
+                                                     XiaRequestCallback callback,
+                                                     void* arg, XiaRequest** request);
+HANDEL_IMPORT int HANDEL_API xiaWaitRequest(XiaRequest* request, unsigned int timeout,
+                                            int* status);
+HANDEL_IMPORT int HANDEL_API xiaSetPoolConfig(unsigned int threads, int cpu);
+HANDEL_IMPORT int HANDEL_API xiaGetPoolSize(unsigned int* threads);
+HANDEL_IMPORT int HANDEL_API xiaGetPoolStats(unsigned int worker, unsigned long* stats);
+
+HANDEL_IMPORT int HANDEL_API xiaDecodeMCABuffer(const unsigned long* buffer,
+                                                unsigned long len,
+                                                XiaMCAPixels* pixels);
+HANDEL_IMPORT int HANDEL_API xiaFreeMCAPixels(XiaMCAPixels* pixels);
+HANDEL_IMPORT int HANDEL_API xiaDecodeSCABuffer(const unsigned long* buffer,
+                                                unsigned long len, int flags,
+                                                XiaSCAPixels* pixels);
+HANDEL_IMPORT int HANDEL_API xiaFreeSCAPixels(XiaSCAPixels* pixels);
+HANDEL_IMPORT int HANDEL_API xiaDecodeListBuffer(XiaListDecoder* decoder,
+                                                 const unsigned long* words,
+                                                 unsigned long len,
+                                                 XiaListEvents* events);
+HANDEL_IMPORT int HANDEL_API xiaResetListDecoder(XiaListDecoder* decoder);
+HANDEL_IMPORT int HANDEL_API xiaFreeListEvents(XiaListEvents* events);
+HANDEL_IMPORT int HANDEL_API xiaCreateListMerger(unsigned int nStreams, size_t capacity,
+                                                 XiaListMerger** merger);
+HANDEL_IMPORT int HANDEL_API xiaDestroyListMerger(XiaListMerger* merger);
+HANDEL_IMPORT int HANDEL_API xiaSetListMergerOffset(XiaListMerger* merger,
+                                                    unsigned int stream,
+                                                    int64_t offset);
+HANDEL_IMPORT int HANDEL_API xiaPushListEvents(XiaListMerger* merger,
+                                               unsigned int stream,
+                                               const XiaListEvents* events);
+HANDEL_IMPORT int HANDEL_API xiaFinishListStream(XiaListMerger* merger,
+                                                 unsigned int stream);
+HANDEL_IMPORT int HANDEL_API xiaPopListEvents(XiaListMerger* merger, size_t max,
+                                              XiaListEvents* events,
+                                              unsigned int* streams);
+HANDEL_IMPORT int HANDEL_API xiaCreateArchive(const char* filename, unsigned int nStreams,
+                                              const int* detChans, size_t chunkSize,
+                                              XiaArchiveWriter** writer);
+HANDEL_IMPORT int HANDEL_API xiaWriteArchiveBuffer(XiaArchiveWriter* writer,
+                                                   unsigned int stream,
+                                                   const unsigned long* buffer,
+                                                   unsigned long len);
+HANDEL_IMPORT int HANDEL_API xiaWriteArchivePixel(XiaArchiveWriter* writer,
+                                                  unsigned int stream,
+                                                  unsigned long pixel,
+                                                  const void* data, size_t size);
+HANDEL_IMPORT int HANDEL_API xiaFinishArchive(XiaArchiveWriter* writer);
+HANDEL_IMPORT int HANDEL_API xiaOpenArchive(const char* filename, XiaArchive** archive);
+HANDEL_IMPORT int HANDEL_API xiaGetArchivePixel(XiaArchive* archive, unsigned int stream,
+                                                unsigned long pixel, const void** data,
+                                                size_t* size);
+HANDEL_IMPORT int HANDEL_API xiaGetArchiveValue(XiaArchive* archive, unsigned int stream,
+                                                const char* name, double* value);
+HANDEL_IMPORT int HANDEL_API xiaCloseArchive(XiaArchive* archive);
+HANDEL_IMPORT int HANDEL_API xiaCreateCube(const char* filename, unsigned long width,
+                                           unsigned long height, unsigned int nChannels,
+                                           unsigned int nBins, XiaCube** cube);
+HANDEL_IMPORT int HANDEL_API xiaOpenCube(const char* filename, XiaCube** cube);
+HANDEL_IMPORT int HANDEL_API xiaWriteCubeBuffer(XiaCube* cube,
+                                                unsigned int firstChannel,
+                                                const unsigned long* buffer,
+                                                unsigned long len);
+HANDEL_IMPORT int HANDEL_API xiaGetCubeSpectrum(XiaCube* cube, unsigned long x,
+                                                unsigned long y, unsigned int channel,
+                                                unsigned int* spectrum);
+HANDEL_IMPORT int HANDEL_API xiaGetCubeImage(XiaCube* cube, unsigned int channel,
+                                             unsigned int firstBin, unsigned int nBins,
+                                             uint64_t* image);
+HANDEL_IMPORT int HANDEL_API xiaIndexCube(XiaCube* cube, unsigned int tile);
+HANDEL_IMPORT int HANDEL_API xiaGetCubeRegion(XiaCube* cube, unsigned int channel,
+                                              unsigned long x, unsigned long y,
+                                              unsigned long width, unsigned long height,
+                                              uint64_t* spectrum,
+                                              XiaRegionStats* stats);
+HANDEL_IMPORT int HANDEL_API xiaCloseCube(XiaCube* cube);
+HANDEL_IMPORT int HANDEL_API xiaSetMapTune(int detChan, unsigned int nBuffers,
+                                           double headroom, unsigned int flags);
+HANDEL_IMPORT int HANDEL_API xiaGetMapTune(int detChan, XiaMapTune* result);
+
 HANDEL_IMPORT int HANDEL_API xiaEnableLogOutput(void);
 HANDEL_IMPORT int HANDEL_API xiaSuppressLogOutput(void);
 HANDEL_IMPORT int HANDEL_API xiaSetLogLevel(int level);
@@ -130,6 +242,14 @@ HANDEL_IMPORT int HANDEL_API xiaSetLogOutput(char* fileName);
 HANDEL_IMPORT int HANDEL_API xiaCloseLog(void);
 
 HANDEL_IMPORT int HANDEL_API xiaSetIOPriority(int pri);
+HANDEL_IMPORT int HANDEL_API xiaSetIOScheduling(int policy, int priority, int cpu,
+                                              int flags);
+HANDEL_IMPORT int HANDEL_API xiaSetDSPCache(int mode);
+HANDEL_IMPORT int HANDEL_API xiaSetWaitProfile(int type, double spin, double interval,
+                                               double maxInterval);
+HANDEL_IMPORT int HANDEL_API xiaGetWaitStats(int type, unsigned long* histogram);
+HANDEL_IMPORT int HANDEL_API xiaSetRunDispatch(int mode);
+HANDEL_IMPORT int HANDEL_API xiaGetRunStartSkew(double* skew);
 
 HANDEL_IMPORT void HANDEL_API xiaGetVersionInfo(int* rel, int* min, int* maj,
                                                 char* pretty);
@@ -175,11 +295,15 @@ HANDEL_IMPORT int HANDEL_API xiaDownloadFirmware();
 HANDEL_IMPORT int HANDEL_API xiaSetAcquisitionValues();
 HANDEL_IMPORT int HANDEL_API xiaGetAcquisitionValues();
 HANDEL_IMPORT int HANDEL_API xiaRemoveAcquisitionValues();
+HANDEL_IMPORT int HANDEL_API xiaBeginAcquisitionBatch();
+HANDEL_IMPORT int HANDEL_API xiaCommitAcquisitionBatch();
 HANDEL_IMPORT int HANDEL_API xiaUpdateUserParams();
 HANDEL_IMPORT int HANDEL_API xiaGainOperation();
 HANDEL_IMPORT int HANDEL_API xiaGainCalibrate();
 HANDEL_IMPORT int HANDEL_API xiaStartRun();
 HANDEL_IMPORT int HANDEL_API xiaStopRun();
+HANDEL_IMPORT int HANDEL_API xiaWaitRunComplete();
+HANDEL_IMPORT int HANDEL_API xiaCancel();
 HANDEL_IMPORT int HANDEL_API xiaGetRunData();
 HANDEL_IMPORT int HANDEL_API xiaDoSpecialRun();
 HANDEL_IMPORT int HANDEL_API xiaGetSpecialRunData();
@@ -195,6 +319,53 @@ HANDEL_IMPORT int HANDEL_API xiaMemoryOperation();
 HANDEL_IMPORT int HANDEL_API xiaCommandOperation();
 HANDEL_IMPORT int HANDEL_API xiaExit();
 
+HANDEL_IMPORT int HANDEL_API xiaContextCreate();
+HANDEL_IMPORT int HANDEL_API xiaContextDestroy();
+HANDEL_IMPORT int HANDEL_API xiaContextSelect();
+HANDEL_IMPORT int HANDEL_API xiaInitCtx();
+HANDEL_IMPORT int HANDEL_API xiaStartSystemCtx();
+HANDEL_IMPORT int HANDEL_API xiaExitCtx();
+
+HANDEL_IMPORT int HANDEL_API xiaDoSpecialRunAsync();
+HANDEL_IMPORT int HANDEL_API xiaGainOperationAsync();
+HANDEL_IMPORT int HANDEL_API xiaWaitRunCompleteAsync();
+HANDEL_IMPORT int HANDEL_API xiaWaitRequest();
+HANDEL_IMPORT int HANDEL_API xiaSetPoolConfig();
+HANDEL_IMPORT int HANDEL_API xiaGetPoolSize();
+HANDEL_IMPORT int HANDEL_API xiaGetPoolStats();
+
+HANDEL_IMPORT int HANDEL_API xiaDecodeMCABuffer();
+HANDEL_IMPORT int HANDEL_API xiaFreeMCAPixels();
+HANDEL_IMPORT int HANDEL_API xiaDecodeSCABuffer();
+HANDEL_IMPORT int HANDEL_API xiaFreeSCAPixels();
+HANDEL_IMPORT int HANDEL_API xiaDecodeListBuffer();
+HANDEL_IMPORT int HANDEL_API xiaResetListDecoder();
+HANDEL_IMPORT int HANDEL_API xiaFreeListEvents();
+HANDEL_IMPORT int HANDEL_API xiaCreateListMerger();
+HANDEL_IMPORT int HANDEL_API xiaDestroyListMerger();
+HANDEL_IMPORT int HANDEL_API xiaSetListMergerOffset();
+HANDEL_IMPORT int HANDEL_API xiaPushListEvents();
+HANDEL_IMPORT int HANDEL_API xiaFinishListStream();
+HANDEL_IMPORT int HANDEL_API xiaPopListEvents();
+HANDEL_IMPORT int HANDEL_API xiaCreateArchive();
+HANDEL_IMPORT int HANDEL_API xiaWriteArchiveBuffer();
+HANDEL_IMPORT int HANDEL_API xiaWriteArchivePixel();
+HANDEL_IMPORT int HANDEL_API xiaFinishArchive();
+HANDEL_IMPORT int HANDEL_API xiaOpenArchive();
+HANDEL_IMPORT int HANDEL_API xiaGetArchivePixel();
+HANDEL_IMPORT int HANDEL_API xiaGetArchiveValue();
+HANDEL_IMPORT int HANDEL_API xiaCloseArchive();
+HANDEL_IMPORT int HANDEL_API xiaCreateCube();
+HANDEL_IMPORT int HANDEL_API xiaOpenCube();
+HANDEL_IMPORT int HANDEL_API xiaWriteCubeBuffer();
+HANDEL_IMPORT int HANDEL_API xiaGetCubeSpectrum();
+HANDEL_IMPORT int HANDEL_API xiaGetCubeImage();
+HANDEL_IMPORT int HANDEL_API xiaIndexCube();
+HANDEL_IMPORT int HANDEL_API xiaGetCubeRegion();
+HANDEL_IMPORT int HANDEL_API xiaCloseCube();
+HANDEL_IMPORT int HANDEL_API xiaSetMapTune();
+HANDEL_IMPORT int HANDEL_API xiaGetMapTune();
+
 HANDEL_IMPORT int HANDEL_API xiaEnableLogOutput();
 HANDEL_IMPORT int HANDEL_API xiaSuppressLogOutput();
 HANDEL_IMPORT int HANDEL_API xiaSetLogLevel();
@@ -202,6 +373,12 @@ HANDEL_IMPORT int HANDEL_API xiaSetLogOutput();
 HANDEL_IMPORT int HANDEL_API xiaCloseLog();
 
 HANDEL_IMPORT int HANDEL_API xiaSetIOPriority();
+HANDEL_IMPORT int HANDEL_API xiaSetIOScheduling();
+HANDEL_IMPORT int HANDEL_API xiaSetDSPCache();
+HANDEL_IMPORT int HANDEL_API xiaSetWaitProfile();
+HANDEL_IMPORT int HANDEL_API xiaGetWaitStats();
+HANDEL_IMPORT int HANDEL_API xiaSetRunDispatch();
+HANDEL_IMPORT int HANDEL_API xiaGetRunStartSkew();
 
 HANDEL_IMPORT void HANDEL_API xiaGetVersionInfo();
 HANDEL_IMPORT char* HANDEL_API xiaGetErrorText();
@@ -72,6 +72,44 @@
 #define XIA_XERXES_TEST_MASK 0x20
 #define XIA_HANDEL_SYSTEM_TEST_MASK 0x40
 
+/* DSP cache modes for xiaSetDSPCache() */
+#define XIA_DSP_CACHE_OFF 0
+#define XIA_DSP_CACHE_MEMORY 1
+#define XIA_DSP_CACHE_DISK 2
+
+/* Run dispatch modes for xiaSetRunDispatch() */
+#define XIA_RUN_DISPATCH_SERIAL 0
+#define XIA_RUN_DISPATCH_PARALLEL 1
+
+/* Polling operation types for xiaSetWaitProfile() and xiaGetWaitStats() */
+#define XIA_WAIT_BUSY 0
+#define XIA_WAIT_ACTIVE 1
+#define XIA_WAIT_RUN_ENABLE 2
+#define XIA_WAIT_RUN_END 3
+#define XIA_WAIT_HISTOGRAM_BINS 16
+
+/* I/O thread scheduling policies and flags for xiaSetIOScheduling() */
+#define XIA_IO_SCHED_OTHER 0
+#define XIA_IO_SCHED_FIFO 1
+#define XIA_IO_SCHED_RR 2
+#define XIA_IO_SCHED_LOCK_MEMORY 0x1
+
+/* Flags for xiaDecodeSCABuffer() */
+#define XIA_SCA_DEADTIME_CORRECT 0x1
+
+/* Flags for xiaSetMapTune() */
+#define XIA_MAP_TUNE_APPLY 0x1
+
+/* Flags set by xiaDecodeListBuffer() in XiaListEvents.flags */
+#define XIA_LIST_EVENT_ROLLOVER 0x100
+
+/* Worker pool statistics returned by xiaGetPoolStats() */
+#define XIA_POOL_STAT_SUBMITTED 0
+#define XIA_POOL_STAT_EXECUTED 1
+#define XIA_POOL_STAT_STOLEN 2
+#define XIA_POOL_STAT_MAX_DEPTH 3
+#define XIA_POOL_STATS_LEN 4
+
 /* List mode variant */
 #define XIA_LIST_MODE_SLOW_PIXEL 0.0
 #define XIA_LIST_MODE_FAST_PIXEL 1.0
@@ -151,6 +151,8 @@
 #define XIA_UNIMPLEMENTED 510 /* The routine is unimplemented in this version */
 #define XIA_PARAM_DEBUG_MISMATCH                                                       \
     511 /* A parameter mismatch was found with XIA_PARAM_DEBUG enabled. */
+#define XIA_STREAM_FULL 512 /* A list mode merger stream has no room for the events */
+#define XIA_CANCELLED 513 /* The operation was cancelled by xiaCancel() */
 
 /* PSL errors 601-700 */
 #define XIA_NOSUPPORT_FIRM                                                             \
@@ -260,6 +262,7 @@
 #define XIA_PARAMETER_OOR 686 /* The parameter passed in is out of range. */
 #define XIA_PASSTHROUGH 687 /* UART passthrough command error */
 #define XIA_UNSUPPORTED 688 /* Feature unsupported by current hardware */
+#define XIA_MALFORMED_BUFFER 689 /* Mapping buffer contents are malformed */
 
 /* handel-sitoro errors 690-700 */
 #define XIA_DAC_GAIN_OOR 690 /* SiToro DAC gain is out of range. */
@@ -42,33 +42,76 @@
 #include "handeldef.h"
 #include "xia_common.h"
 
+/*
+ * One line of a START/END block in an .ini section, tokenized in place into
+ * a name-value pair when the file is read.
+ */
+typedef struct {
+    /* Status of xiaGetLineData() for this line */
+    int status;
+    /* The original line (for error reporting) */
+    char* line;
+    char* name;
+    char* value;
+} IniEntry;
+
+/*
+ * A START/END block. The entries are a contiguous run of the file's index.
+ */
+typedef struct {
+    IniEntry* entries;
+    size_t count;
+} IniBlock;
+
+/*
+ * A section of the .ini file. Blocks are indexed in file order, so a
+ * section's blocks are contiguous.
+ */
+typedef struct {
+    /* The part in brackets, or NULL if the heading is malformed */
+    char* heading;
+    size_t firstBlock;
+    size_t numBlocks;
+} IniSection;
+
+/*
+ * The tokenized contents of an .ini file. All of the strings point into data.
+ */
+typedef struct {
+    char* data;
+    IniEntry* entries;
+    size_t numEntries;
+    IniBlock* blocks;
+    size_t numBlocks;
+    IniSection* sections;
+    size_t numSections;
+} IniIndex;
+
 /*
  * This structure exists so that we can re-use the section of the code that parses
  * in the sections of the ini files
  */
 typedef struct {
     /* Pointer to the proper xiaLoadRoutine */
-    int (*function_ptr)(FILE*, fpos_t*, fpos_t*);
+    int (*function_ptr)(const IniBlock*);
     /* Section heading name: the part in brackets */
     char* section;
 } SectionInfo;
 
 static int HANDEL_API xiaWriteIniFile(char* filename);
 
-static int HANDEL_API xiaFindEntryLimits(FILE* fp, const char* section, fpos_t* start,
-                                         fpos_t* end);
-static int HANDEL_API xiaGetLine(FILE* fp, char* line);
-static int HANDEL_API xiaGetLineData(char* line, char* name, char* value);
-static int HANDEL_API xiaFileRA(FILE* fp, fpos_t* start, fpos_t* end, char* name,
-                                char* value);
-static int HANDEL_API xiaSetPosOnNext(FILE* fp, fpos_t* start, fpos_t* end, char* name,
-                                      fpos_t* newPos, boolean_t after);
+static int HANDEL_API xiaIndexIniFile(FILE* fp, char* inifile, IniIndex* index);
+static void HANDEL_API xiaFreeIniIndex(IniIndex* index);
+static IniSection* HANDEL_API xiaFindIniSection(IniIndex* index, const char* section);
+static int HANDEL_API xiaGetLineData(char* line, char** name, char** value);
+static boolean_t xiaIsIniEntry(const IniEntry* entry, const char* name);
+static int HANDEL_API xiaFileRA(const IniBlock* block, char* name, char* value);
 
-static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end);
-static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end);
-static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end);
-static int xiaLoadDefaults(FILE* fp, fpos_t* start, fpos_t* end);
+static int xiaLoadDetector(const IniBlock* block);
+static int xiaLoadModule(const IniBlock* block);
+static int xiaLoadFirmware(const IniBlock* block);
+static int xiaLoadDefaults(const IniBlock* block);
 
-static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* alias);
+static int HANDEL_API xiaReadPTRRs(const IniBlock* block, char* alias);
 
 #endif /* HANDEL_FILE_H */
@@ -0,0 +1,204 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_mapping.h
+ * @brief Decoded mapping buffers, see xiaDecodeMCABuffer(), xiaDecodeSCABuffer()
+ * and xiaDecodeListBuffer(), the list mode merger, see xiaPopListEvents(), the
+ * mapping archive, see xiaCreateArchive(), the spectrum cube, see
+ * xiaCreateCube(), and the buffer size tuner, see xiaSetMapTune().
+ */
+
+#ifndef HANDEL_MAPPING_H
+#define HANDEL_MAPPING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An MCA mapping buffer decoded by xiaDecodeMCABuffer(). Every array is
+ * pixel-major: pixel p, channel c, bin b of the spectra is
+ * spectra[(p * nChannels + c) * mcaLength + b], and the statistics of
+ * pixel p, channel c are at index p * nChannels + c. Realtime and
+ * livetime are in hardware clock ticks.
+ *
+ * Zero the structure before its first use. Decoding into the same
+ * structure again reuses its arrays; xiaFreeMCAPixels() releases them.
+ */
+typedef struct XiaMCAPixels {
+    unsigned int runNumber;
+    unsigned long bufferNumber;
+    unsigned int bufferId; /* 0 for buffer A, 1 for buffer B */
+    unsigned long startPixel;
+    unsigned int serialNumber;
+
+    unsigned int nPixels;
+    unsigned int nChannels;
+    unsigned int mcaLength;
+
+    unsigned long* pixel;
+    unsigned int* spectra;
+    unsigned long* realtime;
+    unsigned long* livetime;
+    unsigned long* triggers;
+    unsigned long* events;
+
+    /* Allocated lengths of the arrays, managed by the decoder. */
+    size_t pixelCapacity;
+    size_t statCapacity;
+    size_t spectraCapacity;
+} XiaMCAPixels;
+
+/*
+ * An SCA mapping buffer decoded by xiaDecodeSCABuffer(). The counter of
+ * SCA s of channel c of pixel p is sca[(p * nChannels + c) * nSCAs + s];
+ * channels with fewer than nSCAs regions are padded with zeros. The
+ * statistics are laid out as in XiaMCAPixels.
+ *
+ * With XIA_SCA_DEADTIME_CORRECT, corrected holds each counter scaled by
+ * (triggers / livetime) / (events / realtime) of its pixel and channel;
+ * otherwise it is not filled.
+ */
+typedef struct XiaSCAPixels {
+    unsigned int runNumber;
+    unsigned long bufferNumber;
+    unsigned int bufferId;
+    unsigned long startPixel;
+    unsigned int serialNumber;
+
+    unsigned int nPixels;
+    unsigned int nChannels;
+    unsigned int nSCAs;
+
+    unsigned long* pixel;
+    unsigned int* sca;
+    float* corrected;
+    unsigned long* realtime;
+    unsigned long* livetime;
+    unsigned long* triggers;
+    unsigned long* events;
+
+    size_t pixelCapacity;
+    size_t statCapacity;
+    size_t scaCapacity;
+    size_t correctedCapacity;
+} XiaSCAPixels;
+
+/*
+ * The events decoded by one call to xiaDecodeListBuffer(), one array per
+ * field. timestamp is the 32-bit event clock of the module unwrapped to
+ * 64 bits; flags holds the status bits of the event record in its low
+ * byte and XIA_LIST_EVENT_ROLLOVER on the first event after the clock
+ * wrapped. pixel is 0 in the clock variant.
+ *
+ * Zero the structure before its first use. Decoding into the same
+ * structure again reuses its arrays; xiaFreeListEvents() releases them.
+ */
+typedef struct XiaListEvents {
+    size_t nEvents;
+
+    uint64_t* timestamp;
+    unsigned short* energy;
+    unsigned char* channel;
+    unsigned short* flags;
+    unsigned long* pixel;
+
+    size_t capacity;
+} XiaListEvents;
+
+/*
+ * The state xiaDecodeListBuffer() carries from one call to the next: the
+ * position in the current buffer, the words of a header or event record
+ * cut off at the end of the last call and the clock unwrapping. Zero it,
+ * or call xiaResetListDecoder(), before decoding a new stream. runNumber
+ * and variant are those of the last buffer header read; the rest is
+ * private to the decoder.
+ */
+typedef struct XiaListDecoder {
+    unsigned int runNumber;
+    unsigned int variant;
+
+    unsigned long wordsPerEvent;
+    unsigned long eventsLeft;
+    unsigned long padLeft;
+
+    int haveTime;
+    uint32_t lastTime;
+    uint64_t epoch;
+
+    unsigned long nPending;
+    unsigned long pending[256]; /* room for a whole buffer header */
+} XiaListDecoder;
+
+/*
+ * Merges the decoded list mode events of several modules into one stream
+ * in time order, see xiaCreateListMerger().
+ */
+typedef struct XiaListMerger XiaListMerger;
+
+/*
+ * A chunked, pixel-indexed archive of mapping data being written, see
+ * xiaCreateArchive(), and one mapped for reading, see xiaOpenArchive().
+ */
+typedef struct XiaArchiveWriter XiaArchiveWriter;
+typedef struct XiaArchive XiaArchive;
+
+/*
+ * A file-backed cube of the spectra of every pixel of a map, tiled for
+ * both spectrum and image reads, see xiaCreateCube().
+ */
+typedef struct XiaCube XiaCube;
+
+/*
+ * The sums over a region of a cube, see xiaGetCubeRegion(). nPixels is
+ * the region's area; the statistics are summed from the pixel headers in
+ * hardware clock ticks and counts.
+ */
+typedef struct XiaRegionStats {
+    unsigned long nPixels;
+    uint64_t counts;
+    uint64_t realtime;
+    uint64_t livetime;
+    uint64_t triggers;
+    uint64_t events;
+} XiaRegionStats;
+
+/*
+ * The buffer measurement of a run, see xiaGetMapTune(). The times are the
+ * means per buffer in seconds and pixels the mean pixels per buffer.
+ * headroom is fillTime / (readTime + doneTime); recommended is the
+ * smallest num_map_pixels_per_buffer expected to reach target, or 0 if
+ * only the maximum might. applied is set once recommended was written to
+ * the module.
+ */
+typedef struct XiaMapTune {
+    unsigned int nBuffers;
+    int complete;
+
+    double pixels;
+    double fillTime;
+    double readTime;
+    double doneTime;
+    double pixelRate;
+
+    double headroom;
+    double target;
+    unsigned long recommended;
+    int applied;
+} XiaMapTune;
+
+#endif /* HANDEL_MAPPING_H */
@@ -61,6 +61,10 @@
 /* I/O Priority flags */
 enum { MD_IO_PRI_NORMAL = 0, MD_IO_PRI_HIGH };
 
+/* I/O thread scheduling policies and flags, see dxp_md_set_scheduling() */
+enum { MD_IO_SCHED_OTHER = 0, MD_IO_SCHED_FIFO, MD_IO_SCHED_RR };
+#define MD_IO_SCHED_LOCK_MEMORY 0x1
+
 /* The maximum # of modules of any one type allowed in Handel. This constant
  * is created from thin air and allows us to make constant arrays. Hopefully
  * it is large enough for real systems in the field. If not, feel free to
@@ -107,6 +107,8 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_get_maxblk(void);
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int*);
 XIA_MD_STATIC int XIA_MD_API dxp_md_puts(char*);
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_priority(int* priority);
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_scheduling(int policy, int priority, int cpu,
+                                                   int flags);
 XIA_MD_STATIC char* dxp_md_fgets(char* s, int length, FILE* stream);
 XIA_MD_STATIC char* dxp_md_tmp_path(void);
 XIA_MD_STATIC void dxp_md_clear_tmp(void);
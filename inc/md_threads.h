@@ -98,6 +98,34 @@ typedef struct {
     const char* name;
 } handel_md_Event;
 
+/*
+ * A view of a whole file, read-only or writable.
+ */
+typedef struct {
+    void* data;
+    size_t size;
+    handel_md_ThreadsHandle handle;
+} handel_md_FileMap;
+
+/*
+ * A cancellation token. Cancelling it bumps the epoch; work that was bound
+ * to the token at an earlier epoch sees that it has been cancelled.
+ */
+typedef struct {
+    volatile long epoch;
+} handel_md_Cancel;
+
+/*
+ * The token a thread is bound to, the epoch it was bound at and the binding
+ * it replaced. Saved by handel_md_cancel_enter() so that bindings can nest;
+ * cancelling any token in the chain cancels the thread.
+ */
+typedef struct handel_md_CancelScope {
+    handel_md_Cancel* token;
+    long epoch;
+    struct handel_md_CancelScope* outer;
+} handel_md_CancelScope;
+
 /*
  * Threading.
  */
@@ -106,6 +134,15 @@ XIA_SHARED int handel_md_thread_destroy(handel_md_Thread* thread);
 XIA_SHARED int handel_md_thread_self(handel_md_Thread* thread);
 XIA_SHARED void handel_md_thread_sleep(unsigned int msecs);
 XIA_SHARED int handel_md_thread_ready(handel_md_Thread* thread);
+XIA_SHARED int handel_md_thread_set_affinity(unsigned int cpu);
+XIA_SHARED unsigned int handel_md_cpu_count(void);
+
+/*
+ * Library threads. The library marks its own threads so that the layers
+ * below can tell them from the application's.
+ */
+XIA_SHARED void handel_md_thread_set_library(int library);
+XIA_SHARED int handel_md_thread_library(void);
 
 /*
  * Locks.
@@ -126,4 +163,31 @@ XIA_SHARED int handel_md_event_wait(handel_md_Event* event, unsigned int timeout
 XIA_SHARED int handel_md_event_signal(handel_md_Event* event);
 XIA_SHARED int handel_md_event_ready(handel_md_Event* event);
 
+/*
+ * Time. A monotonic clock in seconds, for measuring intervals.
+ */
+XIA_SHARED double handel_md_clock(void);
+
+/*
+ * File mapping. The view stays valid until handel_md_file_unmap().
+ * handel_md_file_map_write() opens or creates the file, extends it to at
+ * least size bytes without writing the new part, and maps it writable.
+ */
+XIA_SHARED int handel_md_file_map(const char* path, handel_md_FileMap* map);
+XIA_SHARED int handel_md_file_map_write(const char* path, size_t size,
+                                        handel_md_FileMap* map);
+XIA_SHARED int handel_md_file_unmap(handel_md_FileMap* map);
+
+/*
+ * Cancellation. A thread binds a token while it works on something that can
+ * be cancelled; the layers below poll handel_md_cancelled() between I/O steps.
+ */
+XIA_SHARED void handel_md_cancel_init(handel_md_Cancel* token);
+XIA_SHARED void handel_md_cancel_request(handel_md_Cancel* token);
+XIA_SHARED long handel_md_cancel_epoch(handel_md_Cancel* token);
+XIA_SHARED void handel_md_cancel_enter(handel_md_Cancel* token,
+                                       handel_md_CancelScope* saved);
+XIA_SHARED void handel_md_cancel_leave(handel_md_CancelScope* saved);
+XIA_SHARED int handel_md_cancelled(void);
+
 #endif /* MD_THREADS_H */
@@ -38,6 +38,7 @@
 
 #include "psldef.h"
 
+#include "xia_common.h"
 #include "xia_handel_structures.h"
 
 #include "xerxes.h"
@@ -52,7 +53,7 @@
 #define pslLogDebug(x, y)                                                              \
     utils->funcs->dxp_md_log(MD_DEBUG, (x), (y), 0, __FILE__, __LINE__)
 
-static char info_string[4096];
+static XIA_THREAD_LOCAL char info_string[4096];
 
 /* PSL function pointers and structs */
 
@@ -97,6 +97,11 @@ static unsigned long MERCURY_STATS_CHAN_OFFSET[] = {0x000000, 0x000040, 0x000080
 #define MERCURY_UPDATE_NEVER 0x1
 #define MERCURY_UPDATE_MAPPING 0x2
 #define MERCURY_UPDATE_MCA 0x4
+/*
+ * Only stored inside an acquisition value batch. pslCommitAcquisitionValues()
+ * recomputes the filter, gain and thresholds from them once.
+ */
+#define MERCURY_UPDATE_BATCH 0x8
 
 /* Masks for psl__IsMapping(). */
 #define MAPPING_MCA 0x1
@@ -87,6 +87,14 @@ typedef struct _Stj_SpecialRun {
 #define STJ_SCA_PIXEL_BLOCK_HEADER_SIZE 64
 #define STJ_32_EXT_MEMORY 0x3000000
 
+/* Mapping buffer apertures. The packed apertures carry two 16-bit words per
+ * transfer, low word first.
+ */
+#define STJ_BUFFER_A_MEMORY 0x4000000
+#define STJ_BUFFER_B_MEMORY 0x6000000
+#define STJ_BUFFER_A_PACKED_MEMORY 0x5000000
+#define STJ_BUFFER_B_PACKED_MEMORY 0x7000000
+
 /* size of statistics block in SRAM. */
 #define STJ_STATS_BLOCK_SIZE 0x400
 
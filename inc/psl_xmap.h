@@ -78,6 +78,14 @@
 #define XMAP_SCA_PIXEL_BLOCK_HEADER_SIZE 64
 #define XMAP_32_EXT_MEMORY 0x3000000
 
+/* Mapping buffer apertures. The packed apertures carry two 16-bit words per
+ * transfer, low word first.
+ */
+#define XMAP_BUFFER_A_MEMORY 0x4000000
+#define XMAP_BUFFER_B_MEMORY 0x6000000
+#define XMAP_BUFFER_A_PACKED_MEMORY 0x5000000
+#define XMAP_BUFFER_B_PACKED_MEMORY 0x7000000
+
 static unsigned long XMAP_STATS_CHAN_OFFSET[] = {0x000000, 0x000040, 0x000080,
                                                  0x0000C0};
 
@@ -103,6 +111,11 @@ static unsigned long XMAP_STATS_CHAN_OFFSET[] = {0x000000, 0x000040, 0x000080,
 #define XMAP_UPDATE_NEVER 0x1
 #define XMAP_UPDATE_MAPPING 0x2
 #define XMAP_UPDATE_MCA 0x4
+/*
+ * Only stored inside an acquisition value batch. pslCommitAcquisitionValues()
+ * recomputes the filter and gain from them once.
+ */
+#define XMAP_UPDATE_BATCH 0x8
 
 /* Masks for psl__IsMapping(). */
 #define MAPPING_MCA 0x1
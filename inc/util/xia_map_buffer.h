@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xia_map_buffer.h
+ * @brief Works out how much of a mapping buffer has been filled.
+ */
+
+#ifndef XIA_UTIL_MAP_BUFFER_H
+#define XIA_UTIL_MAP_BUFFER_H
+
+#include "xia_common.h"
+
+/**
+ * @brief Returns the number of completed pixels in a mapping buffer and rewrites the
+ * pixel count in its header (word 8) to match.
+ *
+ * A full buffer holds the pixels its header says it does. Otherwise the count is the
+ * current mapping point less the starting pixel in the header. A header without the
+ * 0x55AA 0xAA55 tag, or a stale one left over from an earlier buffer whose start pixel
+ * is out of range for the current mapping point, gives no pixels. The count never
+ * exceeds the pixels per buffer.
+ *
+ * @param header the buffer header as read from the module.
+ * @param full whether the module reports the buffer as full.
+ * @param current the current mapping point, sampled before the header was read.
+ * @param pixPerBuf the number of pixels per buffer.
+ */
+static unsigned long xia_map_buffer_pixels(unsigned long* header, boolean_t full,
+                                           unsigned long current,
+                                           unsigned long pixPerBuf) {
+    unsigned long start;
+    unsigned long nPixels = 0;
+
+    if (full) {
+        nPixels = header[8];
+    } else if (header[0] == 0x55AA && header[1] == 0xAA55) {
+        start = WORD_TO_LONG(header[9], header[10]);
+
+        if (current >= start && current - start <= pixPerBuf) {
+            nPixels = current - start;
+        }
+    }
+
+    if (nPixels > pixPerBuf) {
+        nPixels = pixPerBuf;
+    }
+
+    header[8] = nPixels;
+
+    return nPixels;
+}
+
+#endif /* XIA_UTIL_MAP_BUFFER_H */
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xia_map_tune.h
+ * @brief Sizes mapping buffers from measured fill and service times.
+ */
+
+#ifndef XIA_UTIL_MAP_TUNE_H
+#define XIA_UTIL_MAP_TUNE_H
+
+/* Sizes past this are not a buffer any module can hold. */
+#define XIA_MAP_TUNE_SIZE_LIMIT 4294967295.0
+
+/**
+ * @brief Returns the smallest number of pixels per buffer whose fill time is at least
+ * target times its service time, or 0 if no size is.
+ *
+ * The read time is taken to grow with the pixels in the buffer and the buffer_done time
+ * to be fixed. At the measured rate a buffer of n pixels fills in n * fill / pixels and
+ * is serviced in n * read / pixels + done, so
+ *
+ *   n >= target * done * pixels / (fill - target * read)
+ *
+ * when the denominator is positive. Otherwise the host cannot keep up at that headroom
+ * whatever the size.
+ *
+ * @param fill mean time to fill a buffer.
+ * @param read mean time to read a buffer.
+ * @param done mean time to mark a buffer done.
+ * @param pixels mean number of pixels in the measured buffers.
+ * @param target the headroom to reach.
+ */
+static unsigned long xia_map_tune_size(double fill, double read, double done,
+                                       double pixels, double target) {
+    double slack = fill - target * read;
+    double n;
+
+    unsigned long size;
+
+    if (pixels <= 0.0 || fill <= 0.0 || slack <= 0.0) {
+        return 0;
+    }
+
+    n = target * done * pixels / slack;
+
+    if (n >= XIA_MAP_TUNE_SIZE_LIMIT) {
+        return 0;
+    }
+
+    size = (unsigned long) n;
+
+    if ((double) size < n) {
+        size++;
+    }
+
+    return size < 1 ? 1 : size;
+}
+
+#endif /* XIA_UTIL_MAP_TUNE_H */
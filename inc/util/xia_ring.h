@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/** @file xia_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of preallocated buffer slots.
+ *
+ * The producer claims a slot with xia_ring_acquire, fills it in place and publishes it
+ * with xia_ring_commit. The consumer borrows the oldest published slot with
+ * xia_ring_peek and hands it back with xia_ring_release. Nothing is copied and no lock
+ * is taken; each index is written by one side only and read by the other with acquire
+ * and release ordering. At most one thread may produce and one thread may consume.
+ */
+
+#ifndef XIA_UTIL_RING_H
+#define XIA_UTIL_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define XIA_RING_LOAD(p) ((uint32_t) _InterlockedOr((volatile long*) (p), 0))
+#define XIA_RING_STORE(p, v) _InterlockedExchange((volatile long*) (p), (long) (v))
+#else
+#define XIA_RING_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define XIA_RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+/** Slots and the producer and consumer indices are aligned to this many bytes. */
+#define XIA_RING_CACHE_LINE 64
+
+/**
+ * @brief A ring of `capacity` slots of `slot_size` bytes each.
+ *
+ * The producer and consumer indices run freely and are masked into the slot array, so
+ * `head - tail` is always the number of published slots. Each index sits on its own
+ * cache line so the two sides do not contend.
+ */
+struct xia_ring {
+    unsigned char* memory;
+    unsigned char* slots;
+    size_t* lengths;
+    size_t slot_size;
+    uint32_t capacity;
+    uint32_t mask;
+    uint32_t high_water;
+    unsigned char pad0[XIA_RING_CACHE_LINE];
+    volatile uint32_t head;
+    unsigned char pad1[XIA_RING_CACHE_LINE - sizeof(uint32_t)];
+    volatile uint32_t tail;
+    unsigned char pad2[XIA_RING_CACHE_LINE - sizeof(uint32_t)];
+};
+
+/**
+ * @brief Allocates the slots of a ring.
+ * @param ring the ring to initialize.
+ * @param capacity the minimum number of slots, rounded up to a power of two.
+ * @param slot_size the bytes available in each slot, rounded up to a cache line.
+ * @returns false if the arguments are invalid or the allocation failed.
+ */
+static bool xia_ring_init(struct xia_ring* ring, uint32_t capacity, size_t slot_size) {
+    uint32_t n = 1;
+    uintptr_t base;
+
+    if (ring == NULL || capacity == 0 || capacity > 0x80000000u || slot_size == 0) {
+        return false;
+    }
+
+    while (n < capacity) {
+        n <<= 1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    ring->slot_size = (slot_size + XIA_RING_CACHE_LINE - 1) &
+                      ~((size_t) XIA_RING_CACHE_LINE - 1);
+    ring->capacity = n;
+    ring->mask = n - 1;
+
+    ring->memory = (unsigned char*) malloc(ring->slot_size * n + XIA_RING_CACHE_LINE);
+    ring->lengths = (size_t*) calloc(n, sizeof(size_t));
+
+    if (ring->memory == NULL || ring->lengths == NULL) {
+        free(ring->memory);
+        free(ring->lengths);
+        memset(ring, 0, sizeof(*ring));
+        return false;
+    }
+
+    base = ((uintptr_t) ring->memory + XIA_RING_CACHE_LINE - 1) &
+           ~((uintptr_t) XIA_RING_CACHE_LINE - 1);
+    ring->slots = (unsigned char*) base;
+
+    return true;
+}
+
+/**
+ * @brief Frees the slots of a ring. Neither side may be using it.
+ * @param ring the ring to free.
+ */
+static void xia_ring_free(struct xia_ring* ring) {
+    if (ring != NULL) {
+        free(ring->memory);
+        free(ring->lengths);
+        memset(ring, 0, sizeof(*ring));
+    }
+}
+
+/**
+ * @brief Producer: returns the next free slot to fill in place.
+ *
+ * Calling it again before xia_ring_commit returns the same slot.
+ *
+ * @param ring the ring to produce into.
+ * @returns the slot, or NULL if every slot is still held by the consumer.
+ */
+static void* xia_ring_acquire(struct xia_ring* ring) {
+    uint32_t head = ring->head;
+
+    if (head - XIA_RING_LOAD(&ring->tail) == ring->capacity) {
+        return NULL;
+    }
+
+    return ring->slots + (size_t) (head & ring->mask) * ring->slot_size;
+}
+
+/**
+ * @brief Producer: publishes the slot returned by xia_ring_acquire.
+ * @param ring the ring to produce into.
+ * @param len the number of bytes written to the slot, reported back to the consumer.
+ */
+static void xia_ring_commit(struct xia_ring* ring, size_t len) {
+    uint32_t head = ring->head;
+    uint32_t used = head + 1 - XIA_RING_LOAD(&ring->tail);
+
+    ring->lengths[head & ring->mask] = len;
+
+    if (used > ring->high_water) {
+        XIA_RING_STORE(&ring->high_water, used);
+    }
+
+    XIA_RING_STORE(&ring->head, head + 1);
+}
+
+/**
+ * @brief Consumer: borrows the oldest published slot without copying it.
+ *
+ * The slot stays valid until xia_ring_release.
+ *
+ * @param ring the ring to consume from.
+ * @param len if not NULL, receives the length passed to xia_ring_commit.
+ * @returns the slot, or NULL if the ring is empty.
+ */
+static const void* xia_ring_peek(struct xia_ring* ring, size_t* len) {
+    uint32_t tail = ring->tail;
+
+    if (XIA_RING_LOAD(&ring->head) == tail) {
+        return NULL;
+    }
+
+    if (len != NULL) {
+        *len = ring->lengths[tail & ring->mask];
+    }
+
+    return ring->slots + (size_t) (tail & ring->mask) * ring->slot_size;
+}
+
+/**
+ * @brief Consumer: returns the slot from xia_ring_peek to the producer.
+ * @param ring the ring to consume from.
+ */
+static void xia_ring_release(struct xia_ring* ring) {
+    XIA_RING_STORE(&ring->tail, ring->tail + 1);
+}
+
+/**
+ * @brief The number of published slots not yet released. Safe to call from any thread;
+ * the result is a snapshot.
+ * @param ring the ring to inspect.
+ */
+static uint32_t xia_ring_occupancy(struct xia_ring* ring) {
+    uint32_t tail = XIA_RING_LOAD(&ring->tail);
+    return XIA_RING_LOAD(&ring->head) - tail;
+}
+
+/**
+ * @brief The highest occupancy seen by xia_ring_commit since init or the last reset.
+ * @param ring the ring to inspect.
+ */
+static uint32_t xia_ring_high_water(struct xia_ring* ring) {
+    return XIA_RING_LOAD(&ring->high_water);
+}
+
+/**
+ * @brief Resets the high-water mark to the current occupancy. Producer side only.
+ * @param ring the ring to reset.
+ */
+static void xia_ring_reset_high_water(struct xia_ring* ring) {
+    XIA_RING_STORE(&ring->high_water, xia_ring_occupancy(ring));
+}
+
+#endif  //XIA_UTIL_RING_H
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xia_unpack.h
+ * @brief Unpacks 16-bit words that were read from the hardware two to an element.
+ */
+
+#ifndef XIA_UTIL_UNPACK_H
+#define XIA_UTIL_UNPACK_H
+
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XIA_UNPACK_SSE2
+#endif
+
+/**
+ * @brief Spreads packed 16-bit words out to one word per element, in place.
+ *
+ * The words sit two to an element, low word first, in the last (n + 1) / 2 elements
+ * of data. Working forward from the packed half keeps every element ahead of the one
+ * being written.
+ *
+ * @param data the buffer, with room for n elements.
+ * @param n the number of 16-bit words.
+ */
+static void xia_unpack_packed_words(unsigned long* data, size_t n) {
+    size_t i = 0;
+    size_t offset = n / 2;
+    size_t nPacked = n - offset;
+
+    const unsigned long* src = data + offset;
+
+#ifdef XIA_UNPACK_SSE2
+    if (sizeof(unsigned long) == 8) {
+        const __m128i mask = _mm_set1_epi64x(0xFFFF);
+
+        /* Two packed elements give four words; the stores stay behind the
+         * next loads while i + 2 <= offset.
+         */
+        for (; i + 2 <= offset && i + 2 <= nPacked; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+            __m128i lo = _mm_and_si128(x, mask);
+            __m128i hi = _mm_and_si128(_mm_srli_epi64(x, 16), mask);
+
+            _mm_storeu_si128((__m128i*) (data + 2 * i), _mm_unpacklo_epi64(lo, hi));
+            _mm_storeu_si128((__m128i*) (data + 2 * i + 2), _mm_unpackhi_epi64(lo, hi));
+        }
+    } else {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+
+        for (; i + 4 <= offset && i + 4 <= nPacked; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+            __m128i lo = _mm_and_si128(x, mask);
+            __m128i hi = _mm_srli_epi32(x, 16);
+
+            _mm_storeu_si128((__m128i*) (data + 2 * i), _mm_unpacklo_epi32(lo, hi));
+            _mm_storeu_si128((__m128i*) (data + 2 * i + 4), _mm_unpackhi_epi32(lo, hi));
+        }
+    }
+#endif
+
+    for (; i < nPacked; i++) {
+        unsigned long w = src[i];
+
+        data[2 * i] = w & 0xFFFF;
+
+        if (2 * i + 1 < n) {
+            data[2 * i + 1] = (w >> 16) & 0xFFFF;
+        }
+    }
+}
+
+#endif /* XIA_UTIL_UNPACK_H */
@@ -62,6 +62,9 @@ XERXES_IMPORT int XERXES_API dxp_init_ds(void);
 XERXES_IMPORT int XERXES_API dxp_init_boards_ds(void);
 XERXES_IMPORT int XERXES_API dxp_init_library(void);
 XERXES_IMPORT int XERXES_API dxp_install_utils(const char* utilname);
+XERXES_IMPORT int XERXES_API dxp_create_context(Xerxes_Context** ctx);
+XERXES_IMPORT int XERXES_API dxp_free_context(Xerxes_Context* ctx);
+XERXES_IMPORT void XERXES_API dxp_select_context(Xerxes_Context* ctx);
 XERXES_IMPORT int XERXES_API dxp_add_system_item(char* ltoken, char** values);
 XERXES_IMPORT int XERXES_API dxp_add_board_item(char* ltoken, char** values);
 XERXES_IMPORT int XERXES_API dxp_user_setup(void);
@@ -95,9 +98,13 @@ XERXES_IMPORT int XERXES_API dxp_replace_fpgaconfig(int* detChan, char* name,
                                                     char* filename);
 XERXES_IMPORT int XERXES_API dxp_replace_dspconfig(int*, char*);
 XERXES_IMPORT int XERXES_API dxp_upload_dspparams(int*);
+XERXES_IMPORT int XERXES_API dxp_flush_dspparams(int* detChan);
 XERXES_IMPORT int XERXES_API dxp_get_symbol_index(int* detChan, char* name,
                                                   unsigned short* symindex);
 XERXES_IMPORT int XERXES_API dxp_set_one_dspsymbol(int*, char*, unsigned short*);
+XERXES_IMPORT int XERXES_API dxp_write_dspsymbols(int* detChan, unsigned short* first,
+                                                   unsigned short* n,
+                                                   unsigned short* values);
 XERXES_IMPORT int XERXES_API dxp_get_one_dspsymbol(int*, char*, unsigned short*);
 XERXES_IMPORT int XERXES_API dxp_nspec(int*, unsigned int*);
 XERXES_IMPORT int XERXES_API dxp_nbase(int*, unsigned int*);
@@ -123,6 +130,10 @@ XERXES_IMPORT int XERXES_API dxp_cmd(int* detChan, byte_t* cmd, unsigned int* le
 XERXES_IMPORT int XERXES_API dxp_exit(int* detChan);
 
 XERXES_IMPORT int XERXES_API dxp_set_io_priority(int* priority);
+XERXES_IMPORT int XERXES_API dxp_set_io_scheduling(int* policy, int* params);
+XERXES_IMPORT int XERXES_API dxp_set_dsp_cache(int* mode);
+XERXES_IMPORT int XERXES_API dxp_set_wait_profile(int* type, double* profile);
+XERXES_IMPORT int XERXES_API dxp_get_wait_stats(int* type, unsigned long* histogram);
 
 #else /* Begin old style C prototypes */
 /*
@@ -138,6 +149,9 @@ XERXES_IMPORT int XERXES_API dxp_init_ds();
 XERXES_IMPORT int XERXES_API dxp_init_boards_ds();
 XERXES_IMPORT int XERXES_API dxp_init_library();
 XERXES_IMPORT int XERXES_API dxp_install_utils();
+XERXES_IMPORT int XERXES_API dxp_create_context();
+XERXES_IMPORT int XERXES_API dxp_free_context();
+XERXES_IMPORT void XERXES_API dxp_select_context();
 XERXES_IMPORT int XERXES_API dxp_add_system_item();
 XERXES_IMPORT int XERXES_API dxp_add_board_item();
 XERXES_IMPORT int XERXES_API dxp_user_setup();
@@ -159,8 +173,10 @@ XERXES_IMPORT int XERXES_API dxp_dspconfig();
 XERXES_IMPORT int XERXES_API dxp_replace_fpgaconfig();
 XERXES_IMPORT int XERXES_API dxp_replace_dspconfig();
 XERXES_IMPORT int XERXES_API dxp_upload_dspparams();
+XERXES_IMPORT int XERXES_API dxp_flush_dspparams();
 XERXES_IMPORT int XERXES_API dxp_get_symbol_index();
 XERXES_IMPORT int XERXES_API dxp_set_one_dspsymbol();
+XERXES_IMPORT int XERXES_API dxp_write_dspsymbols();
 XERXES_IMPORT int XERXES_API dxp_get_one_dspsymbol();
 XERXES_IMPORT int XERXES_API dxp_nspec();
 XERXES_IMPORT int XERXES_API dxp_nbase();
@@ -179,6 +195,12 @@ XERXES_IMPORT int XERXES_API dxp_cmd();
 
 XERXES_IMPORT int XERXES_API dxp_exit();
 
+XERXES_IMPORT int XERXES_API dxp_set_io_priority();
+XERXES_IMPORT int XERXES_API dxp_set_io_scheduling();
+XERXES_IMPORT int XERXES_API dxp_set_dsp_cache();
+XERXES_IMPORT int XERXES_API dxp_set_wait_profile();
+XERXES_IMPORT int XERXES_API dxp_get_wait_stats();
+
 #endif /*   end if _XERXES_PROTO_ */
 
 /* If this is compiled by a C++ compiler, make it clear that these are C routines */
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xerxes_dsp_cache.h
+ * @brief Cache of parsed DSP program words and symbol tables.
+ *
+ * Parsing the text DSP files is the slowest part of adding a new DSP to the
+ * system. The cache stores the result of a device's dxp_get_dspconfig() keyed
+ * by the board type and a hash of the file contents so that repeat loads,
+ * across xiaInit() calls or firmware switches, are a copy instead of a parse.
+ */
+
+#ifndef XERXES_DSP_CACHE_H
+#define XERXES_DSP_CACHE_H
+
+#include "xia_common.h"
+#include "xia_xerxes_structures.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int dxp_dsp_cache_init(void);
+int dxp_dsp_cache_load(Board_Info* board, Dsp_Info* dsp);
+int dxp_dsp_cache_set_mode(int mode);
+void dxp_dsp_cache_clear(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* XERXES_DSP_CACHE_H */
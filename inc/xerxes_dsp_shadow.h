@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xerxes_dsp_shadow.h
+ * @brief Host shadow of DSP parameter memory.
+ *
+ * Devices that reach parameter memory through an address/data register pair
+ * pay a full bus transaction for every parameter they write. The shadow keeps
+ * the last value written to each parameter of a channel so that unchanged
+ * writes can be dropped, changed ones deferred and coalesced into block
+ * writes, and host-written values read back without touching the hardware.
+ *
+ * Only the Saturn defers its parameter writes through the shadow. The xMAP
+ * and STJ also write parameter memory through the TAR/TDR pair, but their
+ * run and control task code exchanges handshake parameters with the DSP one
+ * write at a time, so they only use dxp_dsp_symbols_write() to write blocks
+ * of parameters in dxp_write_dspsymbols().
+ */
+
+#ifndef XERXES_DSP_SHADOW_H
+#define XERXES_DSP_SHADOW_H
+
+#include "xia_common.h"
+#include "xia_xerxes_structures.h"
+
+/* Writes len parameter words starting at the DSP parameter address addr. */
+typedef int (*DXP_WRITE_PARAM_BLOCK)(int* ioChan, int* modChan, unsigned int addr,
+                                     unsigned int len, unsigned short* data);
+
+/* Writes len words of DSP data memory starting at the address base. */
+typedef int (*DXP_WRITE_DATA_MEMORY)(int ioChan, unsigned long base, unsigned long len,
+                                     unsigned long* data);
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int dxp_dsp_shadow_write(Board* board, int modChan, unsigned short index,
+                         unsigned short value);
+boolean_t dxp_dsp_shadow_read(Board* board, int modChan, unsigned short index,
+                              unsigned short* value);
+int dxp_dsp_shadow_flush(Board* board, int* ioChan, int* modChan,
+                         DXP_WRITE_PARAM_BLOCK write);
+void dxp_dsp_shadow_invalidate(Board* board, int modChan);
+void dxp_dsp_shadow_free(Board* board);
+
+Parameter* dxp_dsp_symbol(Board* board, int modChan, unsigned short index,
+                          unsigned long* addr);
+int dxp_dsp_symbols_write(Board* board, int* ioChan, int* modChan, unsigned short first,
+                          unsigned short n, unsigned short* values,
+                          DXP_WRITE_DATA_MEMORY write);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* XERXES_DSP_SHADOW_H */
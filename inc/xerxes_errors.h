@@ -116,6 +116,8 @@
 #define DXP_NULL 4310 /* Parameter cannot be NULL */
 #define DXP_MALFORMED_FILE 4311 /* Malformed firmware file */
 #define DXP_UNKNOWN_CT 4312 /* Unknown control task */
+#define DXP_BAD_PARAM 4313 /* Parameter value is invalid */
+#define DXP_CANCELLED 4314 /* Operation was cancelled */
 
 /* Host machine error codes 4401-4500 */
 #define DXP_NOMEM 4401 /* Error allocating memory */
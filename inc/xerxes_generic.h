@@ -47,4 +47,23 @@
 #define MAXBOARDNAME_LEN 20
 #define MAX_DSP_PARAM_NAME_LEN 30
 
+/* DSP parse cache modes, see dxp_set_dsp_cache() */
+#define DXP_DSP_CACHE_OFF 0
+#define DXP_DSP_CACHE_MEMORY 1
+#define DXP_DSP_CACHE_DISK 2
+
+/* Polling operation types, see dxp_set_wait_profile() */
+#define DXP_WAIT_BUSY 0
+#define DXP_WAIT_ACTIVE 1
+#define DXP_WAIT_RUN_ENABLE 2
+#define DXP_WAIT_RUN_END 3
+#define DXP_WAIT_NUM_TYPES 4
+
+/*
+ * Completion time histogram bins. Bin 0 counts waits of up to 100 us and
+ * each following bin doubles the limit; the last bin counts the rest.
+ */
+#define DXP_WAIT_HISTOGRAM_BINS 16
+#define DXP_WAIT_HISTOGRAM_BASE 100.0e-6
+
 #endif /* Endif for XERXES_GENERIC_H */
@@ -81,6 +81,7 @@ typedef int (*DXP_MD_ENABLE_LOG)(void);
 typedef int (*DXP_MD_SET_LOG_LEVEL)(int);
 typedef void (*DXP_MD_LOG)(int, const char*, const char*, int, const char*, int);
 typedef int (*DXP_MD_SET_PRIORITY)(int*);
+typedef int (*DXP_MD_SET_SCHEDULING)(int, int, int, int);
 typedef char* (*DXP_MD_FGETS)(char* s, int size, FILE* stream);
 typedef char* (*DXP_MD_TMP_PATH)(void);
 typedef void (*DXP_MD_CLEAR_TMP)(void);
@@ -101,6 +102,7 @@ struct Xia_Util_Functions {
     DXP_MD_SET_LOG_LEVEL dxp_md_set_log_level;
     DXP_MD_LOG dxp_md_log;
     DXP_MD_SET_PRIORITY dxp_md_set_priority;
+    DXP_MD_SET_SCHEDULING dxp_md_set_scheduling;
     DXP_MD_FGETS dxp_md_fgets;
     DXP_MD_TMP_PATH dxp_md_tmp_path;
     DXP_MD_CLEAR_TMP dxp_md_clear_tmp;
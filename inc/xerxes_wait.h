@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xerxes_wait.h
+ * @brief Shared polling for device operations that signal completion.
+ *
+ * Devices wait for BUSY, the DSP active bit or run enable by reading the
+ * hardware in a loop. A fixed sleep between reads makes every short
+ * operation cost at least one interval and a long one read the bus far
+ * more often than it needs to. The wait engine polls back to back for a
+ * short spin time, then sleeps with an exponentially growing interval,
+ * and records how long each type of operation took to complete.
+ *
+ * Usage:
+ *
+ *     Dxp_Wait w;
+ *
+ *     dxp_wait_begin(&w, DXP_WAIT_BUSY, timeout);
+ *     do {
+ *         read the hardware, dxp_wait_end(&w) and return when done
+ *     } while (dxp_wait_next(&w));
+ *     cancelled if w.cancelled, otherwise timed out
+ */
+
+#ifndef XERXES_WAIT_H
+#define XERXES_WAIT_H
+
+#include "xia_common.h"
+#include "xerxes_generic.h"
+
+typedef struct {
+    int type;
+    double timeout;
+    double start;
+    double elapsed;
+    double interval;
+    int polls;
+    boolean_t cancelled;
+} Dxp_Wait;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int dxp_wait_init(void);
+void dxp_wait_begin(Dxp_Wait* w, int type, double timeout);
+boolean_t dxp_wait_next(Dxp_Wait* w);
+void dxp_wait_end(Dxp_Wait* w);
+int dxp_wait_set_profile(int type, double spin, double interval, double maxInterval);
+int dxp_wait_get_stats(int type, unsigned long* histogram);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* XERXES_WAIT_H */
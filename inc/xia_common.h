@@ -115,4 +115,25 @@ typedef unsigned long* PULONG;
 #define XIA_FILE __FILE__
 #endif /* _WIN32 */
 
+/*
+ * Storage class for the scratch buffers used to format log messages.
+ * Each thread gets its own copy so that modules driven from separate
+ * threads do not overwrite each other's messages.
+ */
+#ifdef _MSC_VER
+#define XIA_THREAD_LOCAL __declspec(thread)
+#else /* _MSC_VER */
+#define XIA_THREAD_LOCAL __thread
+#endif /* _MSC_VER */
+
+/*
+ * Reentrant strtok(), for parsers that may run in several threads at
+ * once. save is a char* that holds the position between calls.
+ */
+#ifdef _MSC_VER
+#define XIA_STRTOK(str, delim, save) strtok_s((str), (delim), (save))
+#else /* _MSC_VER */
+#define XIA_STRTOK(str, delim, save) strtok_r((str), (delim), (save))
+#endif /* _MSC_VER */
+
 #endif /* __XIA_COMMON_H__ */
@@ -44,6 +44,7 @@
 extern "C" {
 #endif /* __cplusplus */
 
+XIA_SHARED int xia_file_init(void);
 XIA_SHARED FILE* xia_fopen(const char* name, const char* mode, char* file, int line);
 XIA_SHARED int xia_fclose(FILE* fp);
 XIA_SHARED int xia_num_open_handles(void);
@@ -63,6 +63,7 @@ extern "C" {
  * Public API
  */
 
+XIA_EXPORT int xia_file_init(void);
 XIA_EXPORT FILE* xia_fopen(const char* name, const char* mode, char* file, int line);
 XIA_EXPORT int xia_fclose(FILE* fp);
 XIA_EXPORT int xia_num_open_handles(void);
@@ -52,6 +52,7 @@
 #include "md_generic.h"
 
 #include "handeldef.h"
+#include "handel_mapping.h"
 
 /* If this is compiled by a C++ compiler, make it clear that these are C routines */
 #ifdef __cplusplus
@@ -115,11 +116,15 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
 HANDEL_EXPORT int HANDEL_API xiaGetAcquisitionValues(int detChan, char* name,
                                                      void* value);
 HANDEL_EXPORT int HANDEL_API xiaRemoveAcquisitionValues(int detChan, char* name);
+HANDEL_EXPORT int HANDEL_API xiaBeginAcquisitionBatch(int detChan);
+HANDEL_EXPORT int HANDEL_API xiaCommitAcquisitionBatch(int detChan);
 HANDEL_EXPORT int HANDEL_API xiaUpdateUserParams(int detChan);
 HANDEL_EXPORT int HANDEL_API xiaGainOperation(int detChan, char* name, void* value);
 HANDEL_EXPORT int HANDEL_API xiaGainCalibrate(int detChan, double deltaGain);
 HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume);
 HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan);
+HANDEL_EXPORT int HANDEL_API xiaWaitRunComplete(int detChan, double timeout);
+HANDEL_EXPORT int HANDEL_API xiaCancel(int detChan);
 HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value);
 HANDEL_EXPORT int HANDEL_API xiaDoSpecialRun(int detChan, char* name, void* info);
 HANDEL_EXPORT int HANDEL_API xiaGetSpecialRunData(int detChan, char* name, void* value);
@@ -140,7 +145,109 @@ HANDEL_EXPORT int HANDEL_API xiaCommandOperation(int detChan, byte_t cmd,
                                                  unsigned int lenR, byte_t* recv);
 HANDEL_EXPORT int HANDEL_API xiaExit(void);
 
+HANDEL_EXPORT int HANDEL_API xiaContextCreate(HandelContext** ctx);
+HANDEL_EXPORT int HANDEL_API xiaContextDestroy(HandelContext* ctx);
+HANDEL_EXPORT int HANDEL_API xiaContextSelect(HandelContext* ctx);
+HANDEL_EXPORT int HANDEL_API xiaInitCtx(HandelContext* ctx, char* iniFile);
+HANDEL_EXPORT int HANDEL_API xiaStartSystemCtx(HandelContext* ctx);
+HANDEL_EXPORT int HANDEL_API xiaExitCtx(HandelContext* ctx);
+
+HANDEL_EXPORT int HANDEL_API xiaDoSpecialRunAsync(int detChan, char* name, void* info,
+                                                  XiaRequestCallback callback, void* arg,
+                                                  XiaRequest** request);
+HANDEL_EXPORT int HANDEL_API xiaGainOperationAsync(int detChan, char* name, void* value,
+                                                   XiaRequestCallback callback,
+                                                   void* arg, XiaRequest** request);
+HANDEL_EXPORT int HANDEL_API xiaWaitRunCompleteAsync(int detChan, double timeout,
+                                                     XiaRequestCallback callback,
+                                                     void* arg, XiaRequest** request);
+HANDEL_EXPORT int HANDEL_API xiaWaitRequest(XiaRequest* request, unsigned int timeout,
+                                            int* status);
+HANDEL_EXPORT int HANDEL_API xiaSetPoolConfig(unsigned int threads, int cpu);
+HANDEL_EXPORT int HANDEL_API xiaGetPoolSize(unsigned int* threads);
+HANDEL_EXPORT int HANDEL_API xiaGetPoolStats(unsigned int worker, unsigned long* stats);
+
+HANDEL_EXPORT int HANDEL_API xiaDecodeMCABuffer(const unsigned long* buffer,
+                                                unsigned long len,
+                                                XiaMCAPixels* pixels);
+HANDEL_EXPORT int HANDEL_API xiaFreeMCAPixels(XiaMCAPixels* pixels);
+HANDEL_EXPORT int HANDEL_API xiaDecodeSCABuffer(const unsigned long* buffer,
+                                                unsigned long len, int flags,
+                                                XiaSCAPixels* pixels);
+HANDEL_EXPORT int HANDEL_API xiaFreeSCAPixels(XiaSCAPixels* pixels);
+HANDEL_EXPORT int HANDEL_API xiaDecodeListBuffer(XiaListDecoder* decoder,
+                                                 const unsigned long* words,
+                                                 unsigned long len,
+                                                 XiaListEvents* events);
+HANDEL_EXPORT int HANDEL_API xiaResetListDecoder(XiaListDecoder* decoder);
+HANDEL_EXPORT int HANDEL_API xiaFreeListEvents(XiaListEvents* events);
+HANDEL_EXPORT int HANDEL_API xiaCreateListMerger(unsigned int nStreams, size_t capacity,
+                                                 XiaListMerger** merger);
+HANDEL_EXPORT int HANDEL_API xiaDestroyListMerger(XiaListMerger* merger);
+HANDEL_EXPORT int HANDEL_API xiaSetListMergerOffset(XiaListMerger* merger,
+                                                    unsigned int stream,
+                                                    int64_t offset);
+HANDEL_EXPORT int HANDEL_API xiaPushListEvents(XiaListMerger* merger,
+                                               unsigned int stream,
+                                               const XiaListEvents* events);
+HANDEL_EXPORT int HANDEL_API xiaFinishListStream(XiaListMerger* merger,
+                                                 unsigned int stream);
+HANDEL_EXPORT int HANDEL_API xiaPopListEvents(XiaListMerger* merger, size_t max,
+                                              XiaListEvents* events,
+                                              unsigned int* streams);
+HANDEL_EXPORT int HANDEL_API xiaCreateArchive(const char* filename, unsigned int nStreams,
+                                              const int* detChans, size_t chunkSize,
+                                              XiaArchiveWriter** writer);
+HANDEL_EXPORT int HANDEL_API xiaWriteArchiveBuffer(XiaArchiveWriter* writer,
+                                                   unsigned int stream,
+                                                   const unsigned long* buffer,
+                                                   unsigned long len);
+HANDEL_EXPORT int HANDEL_API xiaWriteArchivePixel(XiaArchiveWriter* writer,
+                                                  unsigned int stream,
+                                                  unsigned long pixel,
+                                                  const void* data, size_t size);
+HANDEL_EXPORT int HANDEL_API xiaFinishArchive(XiaArchiveWriter* writer);
+HANDEL_EXPORT int HANDEL_API xiaOpenArchive(const char* filename, XiaArchive** archive);
+HANDEL_EXPORT int HANDEL_API xiaGetArchivePixel(XiaArchive* archive, unsigned int stream,
+                                                unsigned long pixel, const void** data,
+                                                size_t* size);
+HANDEL_EXPORT int HANDEL_API xiaGetArchiveValue(XiaArchive* archive, unsigned int stream,
+                                                const char* name, double* value);
+HANDEL_EXPORT int HANDEL_API xiaCloseArchive(XiaArchive* archive);
+HANDEL_EXPORT int HANDEL_API xiaCreateCube(const char* filename, unsigned long width,
+                                           unsigned long height, unsigned int nChannels,
+                                           unsigned int nBins, XiaCube** cube);
+HANDEL_EXPORT int HANDEL_API xiaOpenCube(const char* filename, XiaCube** cube);
+HANDEL_EXPORT int HANDEL_API xiaWriteCubeBuffer(XiaCube* cube,
+                                                unsigned int firstChannel,
+                                                const unsigned long* buffer,
+                                                unsigned long len);
+HANDEL_EXPORT int HANDEL_API xiaGetCubeSpectrum(XiaCube* cube, unsigned long x,
+                                                unsigned long y, unsigned int channel,
+                                                unsigned int* spectrum);
+HANDEL_EXPORT int HANDEL_API xiaGetCubeImage(XiaCube* cube, unsigned int channel,
+                                             unsigned int firstBin, unsigned int nBins,
+                                             uint64_t* image);
+HANDEL_EXPORT int HANDEL_API xiaIndexCube(XiaCube* cube, unsigned int tile);
+HANDEL_EXPORT int HANDEL_API xiaGetCubeRegion(XiaCube* cube, unsigned int channel,
+                                              unsigned long x, unsigned long y,
+                                              unsigned long width, unsigned long height,
+                                              uint64_t* spectrum,
+                                              XiaRegionStats* stats);
+HANDEL_EXPORT int HANDEL_API xiaCloseCube(XiaCube* cube);
+HANDEL_EXPORT int HANDEL_API xiaSetMapTune(int detChan, unsigned int nBuffers,
+                                           double headroom, unsigned int flags);
+HANDEL_EXPORT int HANDEL_API xiaGetMapTune(int detChan, XiaMapTune* result);
+
 HANDEL_EXPORT int HANDEL_API xiaSetIOPriority(int pri);
+HANDEL_EXPORT int HANDEL_API xiaSetIOScheduling(int policy, int priority, int cpu,
+                                              int flags);
+HANDEL_EXPORT int HANDEL_API xiaSetDSPCache(int mode);
+HANDEL_EXPORT int HANDEL_API xiaSetWaitProfile(int type, double spin, double interval,
+                                               double maxInterval);
+HANDEL_EXPORT int HANDEL_API xiaGetWaitStats(int type, unsigned long* histogram);
+HANDEL_EXPORT int HANDEL_API xiaSetRunDispatch(int mode);
+HANDEL_EXPORT int HANDEL_API xiaGetRunStartSkew(double* skew);
 
 HANDEL_EXPORT void HANDEL_API xiaGetVersionInfo(int* rel, int* min, int* maj,
                                                 char* pretty);
@@ -200,11 +307,15 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware();
 HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues();
 HANDEL_EXPORT int HANDEL_API xiaGetAcquisitionValues();
 HANDEL_EXPORT int HANDEL_API xiaRemoveAcquisitionValues();
+HANDEL_EXPORT int HANDEL_API xiaBeginAcquisitionBatch();
+HANDEL_EXPORT int HANDEL_API xiaCommitAcquisitionBatch();
 HANDEL_EXPORT int HANDEL_API xiaUpdateUserParams();
 HANDEL_EXPORT int HANDEL_API xiaGainCalibrate();
 HANDEL_EXPORT int HANDEL_API xiaGainOperation();
 HANDEL_EXPORT int HANDEL_API xiaStartRun();
 HANDEL_EXPORT int HANDEL_API xiaStopRun();
+HANDEL_EXPORT int HANDEL_API xiaWaitRunComplete();
+HANDEL_EXPORT int HANDEL_API xiaCancel();
 HANDEL_EXPORT int HANDEL_API xiaGetRunData();
 HANDEL_EXPORT int HANDEL_API xiaDoSpecialRun();
 HANDEL_EXPORT int HANDEL_API xiaGetSpecialRunData();
@@ -220,7 +331,60 @@ HANDEL_EXPORT int HANDEL_API xiaMemoryOperation();
 HANDEL_EXPORT int HANDEL_API xiaCommandOperation();
 HANDEL_EXPORT int HANDEL_API xiaExit();
 
+HANDEL_EXPORT int HANDEL_API xiaContextCreate();
+HANDEL_EXPORT int HANDEL_API xiaContextDestroy();
+HANDEL_EXPORT int HANDEL_API xiaContextSelect();
+HANDEL_EXPORT int HANDEL_API xiaInitCtx();
+HANDEL_EXPORT int HANDEL_API xiaStartSystemCtx();
+HANDEL_EXPORT int HANDEL_API xiaExitCtx();
+
+HANDEL_EXPORT int HANDEL_API xiaDoSpecialRunAsync();
+HANDEL_EXPORT int HANDEL_API xiaGainOperationAsync();
+HANDEL_EXPORT int HANDEL_API xiaWaitRunCompleteAsync();
+HANDEL_EXPORT int HANDEL_API xiaWaitRequest();
+HANDEL_EXPORT int HANDEL_API xiaSetPoolConfig();
+HANDEL_EXPORT int HANDEL_API xiaGetPoolSize();
+HANDEL_EXPORT int HANDEL_API xiaGetPoolStats();
+
+HANDEL_EXPORT int HANDEL_API xiaDecodeMCABuffer();
+HANDEL_EXPORT int HANDEL_API xiaFreeMCAPixels();
+HANDEL_EXPORT int HANDEL_API xiaDecodeSCABuffer();
+HANDEL_EXPORT int HANDEL_API xiaFreeSCAPixels();
+HANDEL_EXPORT int HANDEL_API xiaDecodeListBuffer();
+HANDEL_EXPORT int HANDEL_API xiaResetListDecoder();
+HANDEL_EXPORT int HANDEL_API xiaFreeListEvents();
+HANDEL_EXPORT int HANDEL_API xiaCreateListMerger();
+HANDEL_EXPORT int HANDEL_API xiaDestroyListMerger();
+HANDEL_EXPORT int HANDEL_API xiaSetListMergerOffset();
+HANDEL_EXPORT int HANDEL_API xiaPushListEvents();
+HANDEL_EXPORT int HANDEL_API xiaFinishListStream();
+HANDEL_EXPORT int HANDEL_API xiaPopListEvents();
+HANDEL_EXPORT int HANDEL_API xiaCreateArchive();
+HANDEL_EXPORT int HANDEL_API xiaWriteArchiveBuffer();
+HANDEL_EXPORT int HANDEL_API xiaWriteArchivePixel();
+HANDEL_EXPORT int HANDEL_API xiaFinishArchive();
+HANDEL_EXPORT int HANDEL_API xiaOpenArchive();
+HANDEL_EXPORT int HANDEL_API xiaGetArchivePixel();
+HANDEL_EXPORT int HANDEL_API xiaGetArchiveValue();
+HANDEL_EXPORT int HANDEL_API xiaCloseArchive();
+HANDEL_EXPORT int HANDEL_API xiaCreateCube();
+HANDEL_EXPORT int HANDEL_API xiaOpenCube();
+HANDEL_EXPORT int HANDEL_API xiaWriteCubeBuffer();
+HANDEL_EXPORT int HANDEL_API xiaGetCubeSpectrum();
+HANDEL_EXPORT int HANDEL_API xiaGetCubeImage();
+HANDEL_EXPORT int HANDEL_API xiaIndexCube();
+HANDEL_EXPORT int HANDEL_API xiaGetCubeRegion();
+HANDEL_EXPORT int HANDEL_API xiaCloseCube();
+HANDEL_EXPORT int HANDEL_API xiaSetMapTune();
+HANDEL_EXPORT int HANDEL_API xiaGetMapTune();
+
 HANDEL_EXPORT int HANDEL_API xiaSetIOPriority();
+HANDEL_EXPORT int HANDEL_API xiaSetIOScheduling();
+HANDEL_EXPORT int HANDEL_API xiaSetDSPCache();
+HANDEL_EXPORT int HANDEL_API xiaSetWaitProfile();
+HANDEL_EXPORT int HANDEL_API xiaGetWaitStats();
+HANDEL_EXPORT int HANDEL_API xiaSetRunDispatch();
+HANDEL_EXPORT int HANDEL_API xiaGetRunStartSkew();
 
 HANDEL_EXPORT void HANDEL_API xiaGetVersionInfo();
 HANDEL_EXPORT const char* HANDEL_API xiaGetErrorText();
@@ -286,6 +450,7 @@ double HANDEL_API xiaGetValueFromDefaults(char* name, char* alias);
 int HANDEL_API xiaGetDSPNameFromFirmware(char* alias, double peakingTime,
                                          char* dspName);
 int HANDEL_API xiaUserSetup(void);
+int HANDEL_API xiaFlushDSPParams(int detChan);
 int HANDEL_API xiaGetFippiNameFromFirmware(char* alias, double peakingTime,
                                            char* fippiName);
 int HANDEL_API xiaGetValueFromFirmware(char* alias, double peakingTime, char* name,
@@ -294,6 +459,43 @@ int HANDEL_API xiaLoadPSL(char* boardType, PSLFuncs* funcs);
 XiaDefaults* HANDEL_API xiaGetDefaultsHead(void);
 int HANDEL_API xiaGetAbsoluteChannel(int detChan, Module* module, unsigned int* chan);
 int HANDEL_API xiaTagAllRunActive(Module* module, boolean_t state);
+int HANDEL_API xiaWriteSnapshot(char* filename, boolean_t withImages);
+int HANDEL_API xiaReadSnapshot(char* filename);
+void HANDEL_API xiaFreeDSPImage(DspImage* image);
+int HANDEL_API xiaRestoreDSPImage(int detChan, Module* module, unsigned int modChan,
+                                  PSLFuncs* localFuncs, XiaDefaults* defaults,
+                                  boolean_t* restored);
+int HANDEL_API xiaInitModuleLock(Module* module);
+void HANDEL_API xiaFreeModuleLock(Module* module);
+Module* HANDEL_API xiaLockModule(int detChan);
+void HANDEL_API xiaUnlockModule(Module* module);
+int HANDEL_API xiaCancelStatus(int status);
+int HANDEL_API xiaDispatchRunSet(int detChan, unsigned short resume, boolean_t start);
+int HANDEL_API xiaCountSetMembers(int detChan, unsigned int* n);
+void HANDEL_API xiaCollectSetMembers(int detChan, int* members, unsigned int* n);
+int HANDEL_API xiaInitPoolLock(void);
+int HANDEL_API xiaPoolSubmit(XiaTaskGroup* group, XiaTaskFn fn, void* arg);
+int HANDEL_API xiaTaskGroupInit(XiaTaskGroup* group);
+void HANDEL_API xiaTaskGroupWait(XiaTaskGroup* group);
+void HANDEL_API xiaTaskGroupDrain(XiaTaskGroup* group);
+int HANDEL_API xiaInitDefaultContext(void);
+int HANDEL_API xiaInitRequests(HandelContext* ctx);
+void HANDEL_API xiaDrainRequests(void);
+void HANDEL_API xiaFreeRequests(HandelContext* ctx);
+void HANDEL_API xiaUnpackWords(const unsigned long* src, unsigned int* dst, size_t n);
+void HANDEL_API xiaUnpackWords32(const unsigned long* src, unsigned int* dst, size_t n);
+void HANDEL_API xiaScaleCounts(const unsigned int* src, float* dst, size_t n,
+                               float factor);
+int HANDEL_API xiaReserveListEvents(XiaListEvents* events, size_t n);
+void* HANDEL_API xiaGrowBlock(void* block, size_t used, size_t size);
+void HANDEL_API xiaFreeMapTune(Module* module);
+void HANDEL_API xiaMapTuneStarted(Module* module);
+void HANDEL_API xiaMapTuneRunData(Module* module, const char* name, const void* value,
+                                  double started);
+void HANDEL_API xiaMapTuneBoardOperation(Module* module, const char* name,
+                                         const void* value, double started);
+boolean_t HANDEL_API xiaMapTuneStopped(Module* module, double* value);
+int HANDEL_API xiaApplyMapTune(Module* module, double value);
 
 #include "xerxes_structures.h"
 
@@ -320,29 +522,9 @@ DXP_MD_SET_LOG_LEVEL handel_md_set_log_level;
 extern boolean_t isHandelInit;
 
 /*
- *	Define the head of the Detector list
- */
-extern Detector* xiaDetectorHead;
-
-/*
- *	Define the head of the Firmware Sets LL
- */
-extern FirmwareSet* xiaFirmwareSetHead;
-
-/*
- *	Define the head of the XiaDefaults LL
- */
-extern XiaDefaults* xiaDefaultsHead;
-
-/*
- * This is the head of the DetectorChannel LL
- */
-extern DetChanElement* xiaDetChanHead;
-
-/*
- * This is the head of Module LL
+ * The context used by the calling thread. See handel_context.c.
  */
-extern Module* xiaModuleHead;
+extern XIA_THREAD_LOCAL HandelContext* xiaContext;
 
 /* MACROS for the Linked-Lists */
 #define isListEmpty(x) (((x) == NULL) ? TRUE_ : FALSE_)
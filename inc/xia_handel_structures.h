@@ -38,6 +38,7 @@
 #define XIA_HANDEL_STRUCTURES_H
 
 #include "handel_generic.h"
+#include "md_threads.h"
 #include "xia_common.h"
 
 /*
@@ -61,6 +62,14 @@ typedef struct _Channel {
     unsigned short n_sca;
     unsigned short* sca_lo;
     unsigned short* sca_hi;
+
+    /*
+     * Set between xiaBeginAcquisitionBatch() and
+     * xiaCommitAcquisitionBatch(). While set, PSLs that implement
+     * commitAcquisitionValues may postpone work shared by several
+     * acquisition values until the batch is committed.
+     */
+    boolean_t in_batch;
 } Channel_t;
 
 /*
@@ -277,6 +286,23 @@ struct CurrentFirmware {
 };
 typedef struct CurrentFirmware CurrentFirmware;
 
+/*
+ * An image of a channel's DSP parameters, loaded from a binary snapshot
+ * and restored in place of the user setup by the next xiaStartSystem().
+ */
+struct DspImage {
+    unsigned short numParams;
+
+    /* Parameter names in DSP symbol table order. */
+    char** names;
+
+    parameter_t* values;
+
+    /* The firmware that was running when the image was captured. */
+    CurrentFirmware currentFirmware;
+};
+typedef struct DspImage DspImage;
+
 /*
  * This structure holds information about the status
  * of multichannel operations.
@@ -373,6 +399,32 @@ struct Module {
      */
     boolean_t isSetup;
 
+    /*
+     * Array of DSP images mapping logical module channels to the
+     * parameters loaded from a binary snapshot. NULL if the module has
+     * no images.
+     */
+    DspImage* images;
+
+    /*
+     * Buffer size tuner state, see handel_map_tune.c. NULL unless
+     * xiaSetMapTune() enabled it.
+     */
+    struct MapTune* tune;
+
+    /*
+     * Serializes access to this module's hardware. See handel_lock.c.
+     */
+    handel_md_Mutex lock;
+
+    /*
+     * Cancelled by xiaCancel(). The thread that holds the lock is bound to
+     * it; cancelScope and lockDepth are protected by the lock.
+     */
+    handel_md_Cancel cancel;
+    handel_md_CancelScope cancelScope;
+    unsigned int lockDepth;
+
     struct Module* next;
 };
 typedef struct Module Module;
@@ -449,4 +501,62 @@ typedef struct Interface_Plx {
     byte_t slot;
 } Interface_Plx;
 
+/*
+ * A task for the library's worker pool, and a group of tasks that their
+ * submitter waits for together. See handel_pool.c.
+ */
+typedef void (*XiaTaskFn)(void* arg);
+
+typedef struct {
+    handel_md_Mutex lock;
+    handel_md_Event done;
+    unsigned int pending;
+} XiaTaskGroup;
+
+/*
+ * One independent detector system: the configuration Handel reads from
+ * the .ini file together with the matching Xerxes boards. See
+ * handel_context.c.
+ */
+struct HandelContext {
+    /* Head of the Detector list */
+    Detector* detectorHead;
+
+    /* Head of the Firmware Sets LL */
+    FirmwareSet* firmwareSetHead;
+
+    /* Head of the XiaDefaults LL */
+    XiaDefaults* defaultsHead;
+
+    /* Head of the DetectorChannel LL */
+    DetChanElement* detChanHead;
+
+    /* Head of the Module LL */
+    Module* moduleHead;
+
+    /* The Xerxes boards for this system. NULL for the default context. */
+    struct Xerxes_Context* xerxes;
+
+    /* How runs are started and stopped on detChan sets. See xiaSetRunDispatch(). */
+    int runDispatch;
+
+    /* Seconds between the first and last module start of the last parallel start */
+    double runStartSkew;
+
+    /* Bound by xiaStartSystem(). Cancelled along with any of the modules. */
+    handel_md_Cancel cancel;
+
+    /* The asynchronous requests queued in this context. xiaExit() waits for them. */
+    XiaTaskGroup requests;
+};
+typedef struct HandelContext HandelContext;
+
+/*
+ * A special run or gain operation running in the background. See
+ * xiaDoSpecialRunAsync(). The callback runs on the library thread; its
+ * request argument is NULL if no handle was returned to the caller.
+ */
+typedef struct XiaRequest XiaRequest;
+typedef void (*XiaRequestCallback)(XiaRequest* request, int status, void* arg);
+
 #endif /* XIA_HANDEL_STRUCTURES_H */
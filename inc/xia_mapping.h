@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xia_mapping.h
+ * @brief Layout of the xMAP, Mercury and STJ mapping buffers, shared by the
+ * buffer decoders and the mapping archive.
+ */
+
+#ifndef XIA_MAPPING_H
+#define XIA_MAPPING_H
+
+/* Buffer header layout, in words */
+#define MAP_BUFFER_HEADER_SIZE 256
+#define MAP_BUFFER_TAG0 0x55AA
+#define MAP_BUFFER_TAG1 0xAA55
+#define MAP_BH_HEADER_SIZE 2
+#define MAP_BH_MAPPING_MODE 3
+#define MAP_BH_RUN_NUMBER 4
+#define MAP_BH_BUFFER_NUMBER 5
+#define MAP_BH_BUFFER_ID 7
+#define MAP_BH_N_PIXELS 8
+#define MAP_BH_N_EVENTS 8
+#define MAP_BH_START_PIXEL 9
+#define MAP_BH_SERIAL_NUMBER 11
+#define MAP_BH_TOTAL_WORDS 25
+#define MAP_BH_LIST_VARIANT 64
+#define MAP_BH_WORDS_PER_EVENT 65
+
+/* Pixel header layout, in words */
+#define MAP_MCA_PIXEL_HEADER_SIZE 256
+#define MAP_SCA_PIXEL_HEADER_SIZE 64
+#define MAP_PIXEL_TAG0 0x33CC
+#define MAP_PIXEL_TAG1 0xCC33
+#define MAP_PH_HEADER_SIZE 2
+#define MAP_PH_MAPPING_MODE 3
+#define MAP_PH_PIXEL 4
+#define MAP_PH_BLOCK_SIZE 6
+#define MAP_PH_CHANNEL_SIZE 8
+#define MAP_PH_STATS 32
+#define MAP_PH_STATS_PER_CHANNEL 8
+
+/* Every mapping buffer has room for four channels. */
+#define MAP_MAX_CHANNELS 4
+
+#define MAP_MODE_MCA 1
+#define MAP_MODE_SCA 2
+#define MAP_MODE_LIST 3
+
+#define MAP_WORD(w) ((unsigned long) ((w) & 0xFFFF))
+#define MAP_WORD32(w) (MAP_WORD((w)[0]) | (MAP_WORD((w)[1]) << 16))
+
+#endif /* XIA_MAPPING_H */
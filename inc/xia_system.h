@@ -51,6 +51,12 @@ typedef int (*setAcquisitionValues_FP)(int, char*, void*, XiaDefaults*, Firmware
                                        CurrentFirmware*, char*, Detector*, int, Module*,
                                        int);
 typedef int (*getAcquisitionValues_FP)(int, char*, void*, XiaDefaults*);
+typedef int (*commitAcquisitionValues_FP)(int detChan, XiaDefaults* defaults,
+                                          FirmwareSet* firmwareSet,
+                                          CurrentFirmware* currentFirmware,
+                                          char* detectorType, Detector* detector,
+                                          int detector_chan, Module* module,
+                                          int modChan);
 typedef int (*gainOperation_FP)(int detChan, char* name, void* value, Detector* det,
                                 int modChan, Module* m, XiaDefaults* defs);
 typedef int (*gainCalibrate_FP)(int detChan, Detector* det, int modChan, Module* m,
@@ -89,6 +95,8 @@ struct PSLFuncs {
     downloadFirmware_FP downloadFirmware;
     setAcquisitionValues_FP setAcquisitionValues;
     getAcquisitionValues_FP getAcquisitionValues;
+    /* Optional, may be NULL. See xiaCommitAcquisitionBatch(). */
+    commitAcquisitionValues_FP commitAcquisitionValues;
     gainOperation_FP gainOperation;
     gainCalibrate_FP gainCalibrate;
     startRun_FP startRun;
@@ -87,6 +87,9 @@ static int XERXES_API dxp_read_dspsymbol(int*, int*, char*, Board*, double*);
 static int dxp_read_dspparams(int* ioChan, int* modChan, Board* b,
                               unsigned short* params);
 static int XERXES_API dxp_write_dspparams(int*, int*, Dsp_Info*, unsigned short*);
+static int dxp_write_dspsymbols(int* ioChan, int* modChan, Board* board,
+                                unsigned short first, unsigned short n,
+                                unsigned short* values);
 
 static int dxp_get_spectrum_length(int* ioChan, int* modChan, Board* board,
                                    unsigned int* len);
@@ -64,6 +64,9 @@ XERXES_EXPORT int XERXES_API dxp_init_ds(void);
 XERXES_EXPORT int XERXES_API dxp_init_boards_ds(void);
 XERXES_EXPORT int XERXES_API dxp_init_library(void);
 XERXES_EXPORT int XERXES_API dxp_install_utils(const char* utilname);
+XERXES_EXPORT int XERXES_API dxp_create_context(Xerxes_Context** ctx);
+XERXES_EXPORT int XERXES_API dxp_free_context(Xerxes_Context* ctx);
+XERXES_EXPORT void XERXES_API dxp_select_context(Xerxes_Context* ctx);
 XERXES_EXPORT int XERXES_API dxp_add_system_item(char* ltoken, char** values);
 XERXES_EXPORT int XERXES_API dxp_add_board_item(char* ltoken, char** values);
 XERXES_EXPORT int XERXES_API dxp_user_setup(void);
@@ -94,9 +97,13 @@ XERXES_EXPORT int XERXES_API dxp_replace_fpgaconfig(int* detChan, char* name,
                                                     char* filename);
 XERXES_EXPORT int XERXES_API dxp_replace_dspconfig(int* detChan, char* filename);
 XERXES_EXPORT int XERXES_API dxp_upload_dspparams(int*);
+XERXES_EXPORT int XERXES_API dxp_flush_dspparams(int* detChan);
 XERXES_EXPORT int XERXES_API dxp_get_symbol_index(int* detChan, char* name,
                                                   unsigned short* symindex);
 XERXES_EXPORT int XERXES_API dxp_set_one_dspsymbol(int*, char*, unsigned short*);
+XERXES_EXPORT int XERXES_API dxp_write_dspsymbols(int* detChan, unsigned short* first,
+                                                   unsigned short* n,
+                                                   unsigned short* values);
 XERXES_EXPORT int XERXES_API dxp_get_one_dspsymbol(int*, char*, unsigned short*);
 XERXES_EXPORT int XERXES_API dxp_nspec(int*, unsigned int*);
 XERXES_EXPORT int XERXES_API dxp_nbase(int*, unsigned int*);
@@ -124,6 +131,10 @@ XERXES_EXPORT int XERXES_API dxp_cmd(int* detChan, byte_t* cmd, unsigned int* le
 XERXES_EXPORT int XERXES_API dxp_exit(int* detChan);
 
 XERXES_EXPORT int XERXES_API dxp_set_io_priority(int* priority);
+XERXES_EXPORT int XERXES_API dxp_set_io_scheduling(int* policy, int* params);
+XERXES_EXPORT int XERXES_API dxp_set_dsp_cache(int* mode);
+XERXES_EXPORT int XERXES_API dxp_set_wait_profile(int* type, double* profile);
+XERXES_EXPORT int XERXES_API dxp_get_wait_stats(int* type, unsigned long* histogram);
 
 #ifndef EXCLUDE_SATURN
 XERXES_IMPORT int dxp_init_saturn(Functions* funcs);
@@ -156,6 +167,9 @@ XERXES_EXPORT int XERXES_API dxp_init_ds();
 XERXES_EXPORT int XERXES_API dxp_init_boards_ds();
 XERXES_EXPORT int XERXES_API dxp_init_library();
 XERXES_EXPORT int XERXES_API dxp_install_utils();
+XERXES_EXPORT int XERXES_API dxp_create_context();
+XERXES_EXPORT int XERXES_API dxp_free_context();
+XERXES_EXPORT void XERXES_API dxp_select_context();
 XERXES_EXPORT int XERXES_API dxp_add_system_item();
 XERXES_EXPORT int XERXES_API dxp_add_board_item();
 XERXES_EXPORT int XERXES_API dxp_user_setup();
@@ -177,8 +191,10 @@ XERXES_EXPORT int XERXES_API dxp_dspconfig();
 XERXES_EXPORT int XERXES_API dxp_replace_fpgaconfig();
 XERXES_EXPORT int XERXES_API dxp_replace_dspconfig();
 XERXES_EXPORT int XERXES_API dxp_upload_dspparams();
+XERXES_EXPORT int XERXES_API dxp_flush_dspparams();
 XERXES_EXPORT int XERXES_API dxp_get_symbol_index();
 XERXES_EXPORT int XERXES_API dxp_set_one_dspsymbol();
+XERXES_EXPORT int XERXES_API dxp_write_dspsymbols();
 XERXES_EXPORT int XERXES_API dxp_get_one_dspsymbol();
 XERXES_EXPORT int XERXES_API dxp_nspec();
 XERXES_EXPORT int XERXES_API dxp_nbase();
@@ -202,6 +218,10 @@ XERXES_EXPORT int XERXES_API dxp_unhook();
 XERXES_EXPORT int XERXES_API dxp_exit();
 
 XERXES_EXPORT int XERXES_API dxp_set_io_priority();
+XERXES_EXPORT int XERXES_API dxp_set_io_scheduling();
+XERXES_EXPORT int XERXES_API dxp_set_dsp_cache();
+XERXES_EXPORT int XERXES_API dxp_set_wait_profile();
+XERXES_EXPORT int XERXES_API dxp_get_wait_stats();
 
 #ifndef EXCLUDE_SATURN
 XERXES_IMPORT int dxp_init_saturn();
@@ -257,6 +277,7 @@ DXP_MD_FREE xerxes_md_free;
 DXP_MD_PUTS xerxes_md_puts;
 DXP_MD_WAIT xerxes_md_wait;
 DXP_MD_SET_PRIORITY xerxes_md_set_priority;
+DXP_MD_SET_SCHEDULING xerxes_md_set_scheduling;
 DXP_MD_FGETS xerxes_md_fgets;
 DXP_MD_TMP_PATH xerxes_md_tmp_path;
 DXP_MD_CLEAR_TMP xerxes_md_clear_tmp;
@@ -86,6 +86,9 @@ struct Dsp_Params {
     unsigned short n_per_chan_symbols;
 
     unsigned long* chan_offsets;
+
+    /* Number of entries in chan_offsets. Required for the DSP cache. */
+    unsigned short n_chan_offsets;
 };
 typedef struct Dsp_Params Dsp_Params;
 
@@ -151,6 +154,22 @@ struct Chan_State {
 };
 typedef struct Chan_State Chan_State;
 
+/*
+ *	Host shadow of a channel's DSP parameter memory, see xerxes_dsp_shadow.c
+ */
+struct Dsp_Shadow {
+    /* The DSP code that the shadow was built for */
+    struct Dsp_Info* dsp;
+    unsigned short nsymbol;
+    /* Last value written by the host, indexed like dsp->params->parameters */
+    unsigned short* values;
+    /* Valid/dirty bits for each parameter */
+    byte_t* state;
+    /* Number of parameters not yet written to the hardware */
+    unsigned short ndirty;
+};
+typedef struct Dsp_Shadow Dsp_Shadow;
+
 /*
  *	Define a system linked list for all boards in use
  */
@@ -184,6 +203,8 @@ struct Board {
     unsigned short** params;
     /* Pointer to the DSP Program file for each channel */
     struct Dsp_Info** dsp;
+    /* Shadow of the DSP parameter memory for each channel (optional) */
+    struct Dsp_Shadow* shadow;
     /* Pointer to the FiPPi Program file for each channel */
     struct Fippi_Info** fippi;
     /* Pointer to the System FiPPI. */
@@ -274,6 +295,10 @@ typedef int (*DXP_WRITE_MEM)(int*, int*, Board*, char*, unsigned long*, unsigned
 typedef int (*DXP_GET_SYMBOL_BY_INDEX)(int modChan, unsigned short index, Board* board,
                                        char* name);
 typedef int (*DXP_GET_NUM_PARAMS)(int modChan, Board* board, unsigned short* n_params);
+typedef int (*DXP_FLUSH_DSPPARAMS)(int* ioChan, int* modChan, Board* board);
+typedef int (*DXP_WRITE_DSPSYMBOLS)(int* ioChan, int* modChan, Board* board,
+                                    unsigned short first, unsigned short n,
+                                    unsigned short* values);
 
 struct Functions {
     DXP_INIT_DRIVER dxp_init_driver;
@@ -325,6 +350,12 @@ struct Functions {
 
     DXP_GET_SYMBOL_BY_INDEX dxp_get_symbol_by_index;
     DXP_GET_NUM_PARAMS dxp_get_num_params;
+
+    /* Optional, for devices that defer DSP parameter writes */
+    DXP_FLUSH_DSPPARAMS dxp_flush_dspparams;
+
+    /* Optional, for devices that can write consecutive DSP parameters at once */
+    DXP_WRITE_DSPSYMBOLS dxp_write_dspsymbols;
 };
 typedef struct Functions Functions;
 
@@ -340,4 +371,10 @@ struct Board_Info {
 };
 typedef struct Board_Info Board_Info;
 
+/*
+ * All of the Xerxes configuration for one system. The members are
+ * private to xerxes.c.
+ */
+typedef struct Xerxes_Context Xerxes_Context;
+
 #endif /* __XIA_XERXES_STRUCTURES_H__ */
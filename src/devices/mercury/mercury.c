@@ -44,10 +44,12 @@
 #include "xia_file.h"
 #include "xia_mercury.h"
 
+#include "xerxes_dsp_shadow.h"
 #include "xerxes_errors.h"
 #include "xerxes_generic.h"
+#include "xerxes_wait.h"
 
-static char info_string[INFO_LEN];
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 /* Basic I/O */
 static int dxp__write_word(int* ioChan, unsigned long addr, unsigned long val);
@@ -188,6 +190,8 @@ XERXES_EXPORT int dxp_init_mercury(Functions* funcs) {
     funcs->dxp_get_symbol_by_index = dxp_get_symbol_by_index;
     funcs->dxp_get_num_params = dxp_get_num_params;
 
+    funcs->dxp_write_dspsymbols = dxp_write_dspsymbols;
+
     return DXP_SUCCESS;
 }
 
@@ -613,6 +617,8 @@ static int dxp__load_symbols_from_file(char* file, Dsp_Params* params) {
                 return DXP_NOMEM;
             }
 
+            params->n_chan_offsets = 4;
+
             /*
              * Global DSP parameters are stored by their absolute address. Per
              * channel DSP parameters, since they have 4 unique addresses, are
@@ -728,6 +734,92 @@ static int dxp_modify_dspsymbol(int* ioChan, int* modChan, char* name,
     return DXP_SUCCESS;
 }
 
+/*
+ * Writes n consecutive DSP parameters, starting at index first. Parameters
+ * at consecutive addresses are written as one block.
+ */
+static int dxp_write_dspsymbols(int* ioChan, int* modChan, Board* board,
+                                unsigned short first, unsigned short n,
+                                unsigned short* values) {
+    int status;
+
+    unsigned short i;
+    unsigned short start;
+
+    unsigned long addr;
+    unsigned long next = 0;
+    unsigned long base = 0;
+
+    unsigned long* data;
+
+    ASSERT(ioChan != NULL);
+    ASSERT(modChan != NULL);
+    ASSERT(board != NULL);
+    ASSERT(values != NULL);
+
+    if (n == 0) {
+        return DXP_SUCCESS;
+    }
+
+    data = mercury_md_alloc(n * sizeof(unsigned long));
+
+    if (data == NULL) {
+        sprintf(info_string, "Unable to allocate %zu bytes for 'data'",
+                n * sizeof(unsigned long));
+        dxp_log_error("dxp_write_dspsymbols", info_string, DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    for (i = 0; i < n; i++) {
+        data[i] = (unsigned long) values[i];
+    }
+
+    for (start = 0, i = 0; i <= n; i++) {
+        if (i < n) {
+            if (dxp_dsp_symbol(board, *modChan, (unsigned short) (first + i), &addr) ==
+                NULL) {
+                mercury_md_free(data);
+                sprintf(info_string, "No DSP parameter at index %u",
+                        (unsigned int) (first + i));
+                dxp_log_error("dxp_write_dspsymbols", info_string, DXP_NOSYMBOL);
+                return DXP_NOSYMBOL;
+            }
+
+            addr += DXP_DSP_DATA_MEM_ADDR;
+
+            if (i == 0) {
+                base = addr;
+                next = addr + 1;
+                continue;
+            }
+
+            if (addr == next) {
+                next++;
+                continue;
+            }
+        }
+
+        status = dxp__write_block(ioChan, base, (unsigned long) (i - start),
+                                  data + start);
+
+        if (status != DXP_SUCCESS) {
+            mercury_md_free(data);
+            sprintf(info_string, "Error writing %hu DSP parameters to %#lx",
+                    (unsigned short) (i - start), base);
+            dxp_log_error("dxp_write_dspsymbols", info_string, status);
+            return status;
+        }
+
+        start = i;
+        base = addr;
+        next = addr + 1;
+    }
+
+    mercury_md_free(data);
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Read a single parameter from the hardware.
  *
@@ -2404,18 +2496,17 @@ static int dxp__boot_dsp(int ioChan, int modChan, Board* b) {
  */
 static int dxp__wait_for_active(int ioChan, int modChan, double timeout, Board* board) {
     int status;
-    int n_polls = 0;
-    int i;
 
-    float wait = .01f;
     unsigned long csr = 0;
 
+    Dxp_Wait w;
+
     UNUSED(modChan);
     UNUSED(board);
 
-    n_polls = (int) ROUND(timeout / wait);
+    dxp_wait_begin(&w, DXP_WAIT_ACTIVE, timeout);
 
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp__read_global_register(ioChan, DXP_SYS_REG_CSR, &csr);
 
         if (status != DXP_SUCCESS) {
@@ -2426,18 +2517,21 @@ static int dxp__wait_for_active(int ioChan, int modChan, double timeout, Board*
 
         /* Stop waiting if DSP is active. */
         if ((csr & (0x1 << DXP_CSR_DSP_ACT_BIT))) {
-            sprintf(info_string, "Polls for waiting for DSP Active = %d", i);
+            dxp_wait_end(&w);
+            sprintf(info_string, "Polls for waiting for DSP Active = %d", w.polls);
             dxp_log_info("dxp_wait_for_active", info_string);
             return DXP_SUCCESS;
         }
+    } while (dxp_wait_next(&w));
 
-        mercury_md_wait(&wait);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
     sprintf(info_string,
             "Timeout waiting for DSP Active to be set "
             "after %d pools",
-            n_polls);
+            w.polls);
     dxp_log_error("dxp_wait_for_active", info_string, DXP_TIMEOUT);
     return DXP_TIMEOUT;
 }
@@ -2451,37 +2545,38 @@ static int dxp__wait_for_active(int ioChan, int modChan, double timeout, Board*
 static int dxp__wait_for_busy(int ioChan, int modChan, parameter_t desired,
                               double timeout, Board* board) {
     int status;
-    int n_polls = 0;
-    int i;
-
-    float wait = .01f;
 
     double BUSY = 0;
     double RUNERROR = 0;
 
+    Dxp_Wait w;
+
     ASSERT(board != NULL);
 
-    n_polls = (int) ROUND(timeout / wait);
+    dxp_wait_begin(&w, DXP_WAIT_BUSY, timeout);
 
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp_read_dspsymbol(&ioChan, &modChan, "BUSY", board, &BUSY);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string,
                     "Error reading BUSY during poll iteration %d while "
                     "waiting for BUSY to go to %hu on ioChan = %d",
-                    i, desired, ioChan);
+                    w.polls, desired, ioChan);
             dxp_log_error("dxp_wait_for_busy", info_string, status);
             return status;
         }
 
         if (BUSY == (double) desired) {
-            sprintf(info_string, "Polls for waiting for DSP BUSY = %d", i);
+            dxp_wait_end(&w);
+            sprintf(info_string, "Polls for waiting for DSP BUSY = %d", w.polls);
             dxp_log_info("dxp__wait_for_busy", info_string);
             return DXP_SUCCESS;
         }
+    } while (dxp_wait_next(&w));
 
-        mercury_md_wait(&wait);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
     sprintf(info_string,
@@ -2753,8 +2848,6 @@ static int dxp__do_apply(int ioChan, int modChan, Board* board) {
     int status;
     int active;
     int id = 0;
-    int n_polls;
-    int i;
 
     unsigned short ignored = 0;
 
@@ -2769,7 +2862,7 @@ static int dxp__do_apply(int ioChan, int modChan, Board* board) {
     double errinfo = 0.0;
     double timeout = 1.0;
 
-    float poll_interval = 0.1f;
+    Dxp_Wait w;
 
     ASSERT(board != NULL);
 
@@ -2834,17 +2927,9 @@ static int dxp__do_apply(int ioChan, int modChan, Board* board) {
     sprintf(info_string, "Started run id = %d on ioChan = %d", id, ioChan);
     dxp_log_debug("dxp__do_apply", info_string);
 
-    /*
-     * We have an approximate timeout here since we don't include the
-     * time it takes to call dxp__run_enable_active() in the calculation.
-     */
-    n_polls = (int) ROUND(timeout / (double) poll_interval);
+    dxp_wait_begin(&w, DXP_WAIT_RUN_ENABLE, timeout);
 
-    sprintf(info_string, "n_polls = %d, timeout = %0.1f, poll_interval = %0.1f",
-            n_polls, timeout, poll_interval);
-    dxp_log_debug("dxp__do_apply", info_string);
-
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp__run_enable_active(ioChan, &active);
 
         if (status != DXP_SUCCESS) {
@@ -2855,13 +2940,16 @@ static int dxp__do_apply(int ioChan, int modChan, Board* board) {
 
         if (!active) {
             /* The apply is complete. */
+            dxp_wait_end(&w);
             break;
         }
+    } while (dxp_wait_next(&w));
 
-        mercury_md_wait(&poll_interval);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
-    if (i == n_polls) {
+    if (active) {
         status = dxp_end_run(&ioChan, &modChan, board);
         sprintf(info_string,
                 "Timeout waiting %0.1f second(s) for the apply run "
@@ -41,6 +41,7 @@
 #include "xia_handel.h"
 #include "xia_psl.h"
 #include "xia_system.h"
+#include <util/xia_map_buffer.h>
 
 #include "psl_common.h"
 
@@ -62,6 +63,12 @@
 
 PSL_EXPORT int PSL_API mercury_PSLInit(PSLFuncs* funcs);
 
+PSL_STATIC int pslCommitAcquisitionValues(int detChan, XiaDefaults* defaults,
+                                          FirmwareSet* firmwareSet,
+                                          CurrentFirmware* currentFirmware,
+                                          char* detectorType, Detector* detector,
+                                          int detector_chan, Module* m, int modChan);
+
 /* Helpers */
 PSL_STATIC double psl__GetClockTick(void);
 PSL_STATIC int psl__UpdateFilterParams(int detChan, int modChan, double pt,
@@ -121,6 +128,8 @@ PSL_STATIC int psl__ClearBuffer(int detChan, char buf, boolean_t waitForEmpty);
 PSL_STATIC int psl__GetBufferFull(int detChan, char buf, boolean_t* is_full);
 PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
                               XiaDefaults* defs, Module* m);
+PSL_STATIC int psl__GetPartialBuffer(int detChan, char buf, unsigned long* data,
+                                     XiaDefaults* defs, Module* m);
 
 /* DSP Parameter Data Types */
 PSL_STATIC int psl__GetParamValues(int detChan, void* value);
@@ -208,6 +217,10 @@ PSL_STATIC int psl__GetBufferLen(int detChan, void* value, XiaDefaults* defs,
                                  Module* m);
 PSL_STATIC int psl__GetBufferA(int detChan, void* value, XiaDefaults* defs, Module* m);
 PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Module* m);
+PSL_STATIC int psl__GetPartialBufferA(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m);
+PSL_STATIC int psl__GetPartialBufferB(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m);
 PSL_STATIC int psl__GetCurrentPixel(int detChan, void* value, XiaDefaults* defs,
                                     Module* m);
 PSL_STATIC int psl__GetBufferOverrun(int detChan, void* value, XiaDefaults* defs,
@@ -470,6 +483,8 @@ static RunData runData[] = {{"mca_length", psl__GetMCALength},
                             {"buffer_len", psl__GetBufferLen},
                             {"buffer_a", psl__GetBufferA},
                             {"buffer_b", psl__GetBufferB},
+                            {"buffer_partial_a", psl__GetPartialBufferA},
+                            {"buffer_partial_b", psl__GetPartialBufferB},
                             {"current_pixel", psl__GetCurrentPixel},
                             {"buffer_overrun", psl__GetBufferOverrun},
                             {"module_mca", psl__GetModuleMCA},
@@ -484,22 +499,22 @@ static RunData runData[] = {{"mca_length", psl__GetMCALength},
                             {"mca_events", psl__GetMCAEvents}};
 
 static AcquisitionValue_t ACQ_VALUES[] = {
-    {"peaking_time", TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 20.0, psl__SetPeakingTime,
+    {"peaking_time", TRUE_, FALSE_, MERCURY_UPDATE_BATCH, 20.0, psl__SetPeakingTime,
      psl__GetPeakingTime, NULL},
 
-    {"minimum_gap_time", TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 0.060, psl__SetMinGapTime,
+    {"minimum_gap_time", TRUE_, FALSE_, MERCURY_UPDATE_BATCH, 0.060, psl__SetMinGapTime,
      NULL, NULL},
 
     /* If you modify the default values for the calibration energy or the ADC
      * percent rule, be sure to update the dynamic range value as well.
      */
-    {"dynamic_range", TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 47200.0, psl__SetDynamicRng,
+    {"dynamic_range", TRUE_, FALSE_, MERCURY_UPDATE_BATCH, 47200.0, psl__SetDynamicRng,
      NULL, NULL},
 
-    {"calibration_energy", TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 5900.0, psl__SetCalibEV,
+    {"calibration_energy", TRUE_, FALSE_, MERCURY_UPDATE_BATCH, 5900.0, psl__SetCalibEV,
      NULL, NULL},
 
-    {"mca_bin_width", TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 10.0, psl__SetMCABinWidth,
+    {"mca_bin_width", TRUE_, FALSE_, MERCURY_UPDATE_BATCH, 10.0, psl__SetMCABinWidth,
      NULL, NULL},
 
     {"trigger_threshold", TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 1000.0, psl__SetTThresh,
@@ -674,6 +689,7 @@ PSL_EXPORT int PSL_API mercury_PSLInit(PSLFuncs* funcs) {
     funcs->downloadFirmware = pslDownloadFirmware;
     funcs->setAcquisitionValues = pslSetAcquisitionValues;
     funcs->getAcquisitionValues = pslGetAcquisitionValues;
+    funcs->commitAcquisitionValues = pslCommitAcquisitionValues;
     funcs->gainOperation = pslGainOperation;
     funcs->gainCalibrate = pslGainCalibrate;
     funcs->startRun = pslStartRun;
@@ -798,6 +814,14 @@ PSL_STATIC int pslSetAcquisitionValues(int detChan, char* name, void* value,
 
     for (i = 0; i < N_ELEMS(ACQ_VALUES); i++) {
         if (STRNEQ(name, ACQ_VALUES[i].name)) {
+            if ((ACQ_VALUES[i].update & MERCURY_UPDATE_BATCH) && m != NULL &&
+                m->ch[modChan].in_batch) {
+                status = pslSetDefault(name, value, defaults);
+                ASSERT(status == XIA_SUCCESS);
+
+                return XIA_SUCCESS;
+            }
+
             /* Cache the current value in case we need to rollback. */
             status = pslGetDefault(name, (void*) &original_value, defaults);
             ASSERT(status == XIA_SUCCESS);
@@ -860,6 +884,76 @@ PSL_STATIC int pslSetAcquisitionValues(int detChan, char* name, void* value,
     return XIA_UNKNOWN_VALUE;
 }
 
+/*
+ * Finishes an acquisition value batch.
+ *
+ * The MERCURY_UPDATE_BATCH values set while the batch was open were only
+ * stored. Setting the final peaking time switches the FiPPI if needed and
+ * recomputes the filter, and with it the gain, from the final defaults.
+ * The thresholds follow the new gain and everything is applied once.
+ */
+PSL_STATIC int pslCommitAcquisitionValues(int detChan, XiaDefaults* defaults,
+                                          FirmwareSet* firmwareSet,
+                                          CurrentFirmware* currentFirmware,
+                                          char* detectorType, Detector* detector,
+                                          int detector_chan, Module* m, int modChan) {
+    int status;
+
+    double pt = 0.0;
+
+    ASSERT(defaults != NULL);
+    ASSERT(m != NULL);
+
+    UNUSED(currentFirmware);
+    UNUSED(detector_chan);
+
+    status = pslGetDefault("peaking_time", (void*) &pt, defaults);
+    ASSERT(status == XIA_SUCCESS);
+
+    status = psl__SetPeakingTime(detChan, modChan, NULL, (void*) &pt, detectorType,
+                                 defaults, m, detector, firmwareSet);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error setting peaking time to %0.3f for detChan %d", pt,
+                detChan);
+        pslLogError("pslCommitAcquisitionValues", info_string, status);
+        return status;
+    }
+
+    status = pslSetDefault("peaking_time", (void*) &pt, defaults);
+    ASSERT(status == XIA_SUCCESS);
+
+    /* The filter update includes the gain, except on the Mercury-OEM. */
+    if (psl__IsMercuryOem(detChan)) {
+        status = psl__UpdateGain(detChan, modChan, defaults, m, detector);
+
+        if (status != XIA_SUCCESS) {
+            sprintf(info_string, "Error updating gain for detChan %d", detChan);
+            pslLogError("pslCommitAcquisitionValues", info_string, status);
+            return status;
+        }
+    }
+
+    status = psl__UpdateThresholds(detChan, modChan, defaults, m, detector);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error updating thresholds for detChan %d", detChan);
+        pslLogError("pslCommitAcquisitionValues", info_string, status);
+        return status;
+    }
+
+    status = psl__Apply(detChan, NULL, defaults, NULL);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error applying committed values for detChan %d",
+                detChan);
+        pslLogError("pslCommitAcquisitionValues", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
 /*
  * Updates the acquisition value list with the raw DSP parameter
  * specified in name.
@@ -7021,6 +7115,193 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
     return XIA_SUCCESS;
 }
 
+/*
+ * Read the completed pixels of mapping Buffer A without waiting for it
+ * to fill.
+ *
+ * Requires MCA or SCA mapping firmware.
+ */
+PSL_STATIC int psl__GetPartialBufferA(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetPartialBuffer(detChan, 'a', (unsigned long*) value, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading partial Buffer A for detChan %d", detChan);
+        pslLogError("psl__GetPartialBufferA", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read the completed pixels of mapping Buffer B without waiting for it
+ * to fill.
+ *
+ * Requires MCA or SCA mapping firmware.
+ */
+PSL_STATIC int psl__GetPartialBufferB(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetPartialBuffer(detChan, 'b', (unsigned long*) value, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading partial Buffer B for detChan %d", detChan);
+        pslLogError("psl__GetPartialBufferB", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Get the buffer header and the pixels completed so far from the
+ * requested buffer.
+ *
+ * The pixel count is derived from the current mapping point and the
+ * starting pixel in the buffer header, so only the completed pixel
+ * blocks are transferred. The number of pixels in the returned header
+ * (word 8) is rewritten to the number actually read so the data can be
+ * parsed like a full buffer.
+ *
+ * Requires MCA or SCA mapping firmware.
+ *
+ * Assumes that data is large enough for the full buffer ("buffer_len").
+ */
+PSL_STATIC int psl__GetPartialBuffer(int detChan, char buf, unsigned long* data,
+                                     XiaDefaults* defs, Module* m) {
+    int status;
+
+    unsigned long len = 0;
+    unsigned long base = 0;
+    unsigned long pixelBlockSize = 0;
+    unsigned long current = 0;
+    unsigned long nPixels = 0;
+
+    parameter_t PIXPERBUF = 0;
+
+    boolean_t isMapping = FALSE_;
+    boolean_t isFull = FALSE_;
+
+    char memoryStr[36];
+
+    ASSERT(data != NULL);
+    ASSERT(buf == 'a' || buf == 'b');
+
+    status = psl__IsMapping(detChan, MAPPING_MCA | MAPPING_SCA, &isMapping);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error checking firmware type for detChan %d", detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    if (!isMapping) {
+        sprintf(info_string, "MCA or SCA mapping firmware not running on detChan %d",
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, XIA_NO_MAPPING);
+        return XIA_NO_MAPPING;
+    }
+
+    status = psl__GetBufferLen(detChan, (void*) &len, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting length of buffer '%c' for detChan %d", buf,
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    status = pslGetParameter(detChan, "PIXPERBUF", &PIXPERBUF);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string,
+                "Error reading the number of pixel points in the "
+                "buffer for detChan %d",
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    if (PIXPERBUF > 0) {
+        pixelBlockSize = (len - MERCURY_BUFFER_BLOCK_SIZE) / PIXPERBUF;
+    }
+
+    switch (buf) {
+        case 'a':
+            base = 0x4000000;
+            break;
+        case 'b':
+            base = 0x6000000;
+            break;
+        default:
+            FAIL();
+            break;
+    }
+
+    /* Sample the mapping point before the buffer so that every pixel below
+     * it has been written out by the time the pixel blocks are read.
+     */
+    status = psl__GetCurrentPixel(detChan, (void*) &current, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting the current pixel for detChan %d", detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    status = psl__GetBufferFull(detChan, buf, &isFull);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting full status of buffer '%c' for detChan %d",
+                buf, detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    sprintf(memoryStr, "burst_map:%#lx:%d", base, MERCURY_BUFFER_BLOCK_SIZE);
+
+    status = dxp_read_memory(&detChan, memoryStr, data);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading header of buffer '%c' on detChan %d", buf,
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    nPixels = xia_map_buffer_pixels(data, isFull, current, (unsigned long) PIXPERBUF);
+
+    sprintf(info_string, "Reading %lu pixel(s) from buffer '%c' on detChan %d",
+            nPixels, buf, detChan);
+    pslLogDebug("psl__GetPartialBuffer", info_string);
+
+    if (nPixels > 0) {
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base + MERCURY_BUFFER_BLOCK_SIZE,
+                nPixels * pixelBlockSize);
+
+        status = dxp_read_memory(&detChan, memoryStr, data + MERCURY_BUFFER_BLOCK_SIZE);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading pixels from buffer '%c' on detChan %d",
+                    buf, detChan);
+            pslLogError("psl__GetPartialBuffer", info_string, status);
+            return status;
+        }
+    }
+
+    return XIA_SUCCESS;
+}
+
 /*
  * Gets the current mapping point.
  *
@@ -49,7 +49,9 @@
 #include "xia_saturn.h"
 #include "xia_xerxes_structures.h"
 
-static char info_string[INFO_LEN];
+#include "xerxes_dsp_shadow.h"
+
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 /* Starting memory location and length for DSP parameter memory */
 static unsigned short startp = START_PARAMS;
@@ -84,6 +86,11 @@ static int dxp_write_external_memory(int* ioChan, int* modChan, Board* board,
                                      unsigned long* data);
 static int dxp_wait_for_busy(int* ioChan, int* modChan, Board* board, int n_timeout,
                              double busy, float wait);
+static int dxp_read_param_word(int* ioChan, int* modChan, Board* board,
+                               unsigned short index, unsigned short* value);
+static int dxp_write_param_block(int* ioChan, int* modChan, unsigned int addr,
+                                 unsigned int len, unsigned short* data);
+static int dxp_flush_dspparams(int* ioChan, int* modChan, Board* board);
 
 typedef int (*memory_func_t)(int*, int*, Board*, unsigned long, unsigned long,
                              unsigned long*);
@@ -161,6 +168,8 @@ int dxp_init_saturn(Functions* funcs) {
     funcs->dxp_get_symbol_by_index = dxp_get_symbol_by_index;
     funcs->dxp_get_num_params = dxp_get_num_params;
 
+    funcs->dxp_flush_dspparams = dxp_flush_dspparams;
+
     return DXP_SUCCESS;
 }
 
@@ -1028,6 +1037,9 @@ static int dxp_download_dspconfig(int* ioChan, int* modChan, Board* board) {
         dxp_log_error("dxp_download_dspconfig", info_string, status);
     }
 
+    /* New DSP code starts from its own parameter values. */
+    dxp_dsp_shadow_invalidate(board, *modChan);
+
     /* Since the Saturn hardware is single-channel, we are always referencing
      * module channel 0.
      */
@@ -1525,6 +1537,14 @@ static int dxp_modify_dspsymbol(int* ioChan, int* modChan, char* name,
         }
     }
 
+    /*
+     * Record the value in the shadow. It is written along with any other
+     * changed parameters by dxp_flush_dspparams().
+     */
+    if (dxp_dsp_shadow_write(board, *modChan, addr, *value) == DXP_SUCCESS) {
+        return DXP_SUCCESS;
+    }
+
     /* Write the value of the symbol into DSP memory */
 
     if ((status = dxp_write_dsp_param_addr(ioChan, modChan,
@@ -1679,10 +1699,9 @@ static int dxp_read_dspsymbol(int* ioChan, int* modChan, char* name, Board* boar
         return status;
     }
 
-    /* Read the value of the symbol from DSP memory */
+    /* Read the value of the symbol from the shadow or DSP memory */
 
-    addr = (unsigned short) (dsp->params->parameters[addr].address + startp);
-    status = dxp_read_word(ioChan, modChan, &addr, &stemp);
+    status = dxp_read_param_word(ioChan, modChan, board, addr, &stemp);
     if (status != DXP_SUCCESS) {
         sprintf(info_string, "Error writing parameter %s", uname);
         dxp_log_error("dxp_read_dspsymbol", info_string, status);
@@ -1692,8 +1711,7 @@ static int dxp_read_dspsymbol(int* ioChan, int* modChan, char* name, Board* boar
 
     /* If there is a second word, read it in */
     if (nword > 1) {
-        addr = (unsigned short) (dsp->params->parameters[addr1].address + startp);
-        status = dxp_read_word(ioChan, modChan, &addr, &stemp);
+        status = dxp_read_param_word(ioChan, modChan, board, addr1, &stemp);
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Error writing parameter %s+1", uname);
             dxp_log_error("dxp_read_dspsymbol", info_string, status);
@@ -1709,8 +1727,7 @@ static int dxp_read_dspsymbol(int* ioChan, int* modChan, char* name, Board* boar
 
     /* Special case of 48 Bit numbers */
     if (nword == 3) {
-        addr = (unsigned short) (dsp->params->parameters[addr2].address + startp);
-        status = dxp_read_word(ioChan, modChan, &addr, &stemp);
+        status = dxp_read_param_word(ioChan, modChan, board, addr2, &stemp);
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Error writing parameter %s+2", uname);
             dxp_log_error("dxp_read_dspsymbol", info_string, status);
@@ -1723,6 +1740,54 @@ static int dxp_read_dspsymbol(int* ioChan, int* modChan, char* name, Board* boar
     return status;
 }
 
+/*
+ * Reads the parameter at symbol index from the shadow if the host wrote it
+ * since the last run, otherwise from DSP memory.
+ */
+static int dxp_read_param_word(int* ioChan, int* modChan, Board* board,
+                               unsigned short index, unsigned short* value) {
+    unsigned short addr;
+
+    if (dxp_dsp_shadow_read(board, *modChan, index, value)) {
+        return DXP_SUCCESS;
+    }
+
+    addr =
+        (unsigned short) (board->dsp[*modChan]->params->parameters[index].address +
+                          startp);
+
+    return dxp_read_word(ioChan, modChan, &addr, value);
+}
+
+/*
+ * Writes a block of parameters starting at addr, which is relative to the
+ * start of parameter memory. Used to flush the parameter shadow.
+ */
+static int dxp_write_param_block(int* ioChan, int* modChan, unsigned int addr,
+                                 unsigned int len, unsigned short* data) {
+    unsigned short saddr = (unsigned short) (addr + startp);
+
+    return dxp_write_block(ioChan, modChan, &saddr, &len, data);
+}
+
+/*
+ * Writes the DSP parameters changed since the last flush. Parameters at
+ * consecutive addresses go out in a single TSAR + block transfer.
+ */
+static int dxp_flush_dspparams(int* ioChan, int* modChan, Board* board) {
+    int status;
+
+    status = dxp_dsp_shadow_flush(board, ioChan, modChan, dxp_write_param_block);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error flushing DSP parameters for module %d", board->mod);
+        dxp_log_error("dxp_flush_dspparams", info_string, status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Routine to readout the parameter memory from a single DSP.
  *
@@ -1741,6 +1806,12 @@ static int dxp_read_dspparams(int* ioChan, int* modChan, Board* b,
 
     Dsp_Info* dsp = b->dsp[*modChan];
 
+    status = dxp_flush_dspparams(ioChan, modChan, b);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     /* Read out the parameters from the DSP memory, stored in Y memory */
     len = dsp->params->nsymbol;
 
@@ -2010,6 +2081,12 @@ static int dxp_read_history(int* ioChan, int* modChan, Board* board,
 
     unsigned int len;
 
+    status = dxp_flush_dspparams(ioChan, modChan, board);
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_read_history", "Error writing DSP parameters", status);
+        return status;
+    }
+
     status = dxp_loc("HSTSTART", board->dsp[*modChan], &addr);
     if (status != DXP_SUCCESS) {
         status = DXP_NOSYMBOL;
@@ -2080,11 +2157,21 @@ static int dxp_begin_run(int* ioChan, int* modChan, unsigned short* gate,
     unsigned short data;
 
     UNUSED(id);
-    UNUSED(modChan);
-    UNUSED(board);
 
     dxp_log_debug("dxp_begin_run", "Entering dxp_begin_run()");
 
+    /*
+     * The DSP acts on its parameters once the run starts and may also change
+     * them, so the shadow is only good up to this point.
+     */
+    status = dxp_flush_dspparams(ioChan, modChan, board);
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_begin_run", "Error writing DSP parameters", status);
+        return status;
+    }
+
+    dxp_dsp_shadow_invalidate(board, *modChan);
+
     /* Read-Modify-Write to CSR to start data run */
     status = dxp_read_csr(ioChan, &data);
     if (status != DXP_SUCCESS) {
@@ -2406,6 +2493,21 @@ static int dxp_begin_control_task(int* ioChan, int* modChan, short* type,
         }
     }
 
+    /*
+     * Baseline history skips the run start, so its RUNTASKS change still
+     * sits in the shadow. The DSP owns RUNTASKS until the task ends.
+     */
+    status = dxp_flush_dspparams(ioChan, modChan, board);
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string,
+                "Error writing control task parameters to module %d chan %d",
+                board->mod, *modChan);
+        dxp_log_error("dxp_begin_control_task", info_string, status);
+        return status;
+    }
+
+    dxp_dsp_shadow_invalidate(board, *modChan);
+
     return DXP_SUCCESS;
 }
 
@@ -2491,6 +2593,14 @@ static int dxp_end_control_task(int* ioChan, int* modChan, Board* board) {
         return status;
     }
 
+    status = dxp_flush_dspparams(ioChan, modChan, board);
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error writing RUNTASKS to module %d chan %d", board->mod,
+                *modChan);
+        dxp_log_error("dxp_end_control_task", info_string, status);
+        return status;
+    }
+
     return status;
 }
 
@@ -2960,6 +3070,12 @@ static int dxp_read_mem(int* ioChan, int* modChan, Board* board, char* name,
     ASSERT(offset != NULL);
     ASSERT(data != NULL);
 
+    status = dxp_flush_dspparams(ioChan, modChan, board);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     for (i = 0; i < NUM_MEM_READERS; i++) {
         if (STREQ(name, mem_readers[i].name)) {
             status = mem_readers[i].f(ioChan, modChan, board, *base, *offset, data);
@@ -2997,9 +3113,16 @@ static int dxp_write_mem(int* ioChan, int* modChan, Board* board, char* name,
     ASSERT(offset != NULL);
     ASSERT(data != NULL);
 
+    status = dxp_flush_dspparams(ioChan, modChan, board);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     for (i = 0; i < NUM_MEM_WRITERS; i++) {
         if (STREQ(name, mem_writers[i].name)) {
             status = mem_writers[i].f(ioChan, modChan, board, *base, *offset, data);
+            dxp_dsp_shadow_invalidate(board, *modChan);
 
             if (status != DXP_SUCCESS) {
                 sprintf(info_string, "Error writing '%s' memory", name);
@@ -3044,6 +3167,16 @@ static int dxp_read_reg(int* ioChan, int* modChan, char* name, unsigned long* da
  * Calls the interface close routine.
  */
 static int XERXES_API dxp_unhook(Board* board) {
+    int status;
+    int modChan = ALLCHAN;
+
+    /* Don't leave parameter writes behind when the connection goes away. */
+    status = dxp_flush_dspparams(&(board->ioChan), &modChan, board);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_warning("dxp_unhook", "Unable to write pending DSP parameters");
+    }
+
     board->iface->funcs->dxp_md_close(&(board->ioChan));
 
     /* Ignore the status due to some issues involving
@@ -340,6 +340,7 @@ PSL_EXPORT int PSL_API saturn_PSLInit(PSLFuncs* funcs) {
     funcs->downloadFirmware = pslDownloadFirmware;
     funcs->setAcquisitionValues = pslSetAcquisitionValues;
     funcs->getAcquisitionValues = pslGetAcquisitionValues;
+    funcs->commitAcquisitionValues = NULL;
     funcs->gainOperation = pslGainOperation;
     funcs->gainCalibrate = pslGainCalibrate;
     funcs->startRun = pslStartRun;
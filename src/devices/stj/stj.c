@@ -43,9 +43,11 @@
 #include "xia_stj.h"
 #include "xia_xerxes_structures.h"
 
+#include "xerxes_dsp_shadow.h"
 #include "xerxes_errors.h"
 #include "xerxes_generic.h"
 #include "xerxes_structures.h"
+#include "xerxes_wait.h"
 
 #include "stj.h"
 
@@ -75,7 +77,7 @@ static DXP_MD_PUTS stj_md_puts;
 static DXP_MD_WAIT stj_md_wait;
 static DXP_MD_FGETS stj_md_fgets;
 
-static char info_string[INFO_LEN];
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 static int dxp_is_symbol_global(char* name, Dsp_Info* dsp, boolean_t* is_global);
 static int dxp_get_global_addr(char* name, Dsp_Info* dsp, unsigned long* addr);
@@ -219,6 +221,8 @@ XERXES_EXPORT int dxp_init_stj(Functions* funcs) {
     funcs->dxp_get_symbol_by_index = dxp_get_symbol_by_index;
     funcs->dxp_get_num_params = dxp_get_num_params;
 
+    funcs->dxp_write_dspsymbols = dxp_write_dspsymbols;
+
     return DXP_SUCCESS;
 }
 
@@ -692,6 +696,8 @@ static int dxp_load_symbols_from_file(char* file, Dsp_Params* params) {
                 return DXP_NOMEM;
             }
 
+            params->n_chan_offsets = 32;
+
             /* Global DSP parameters are stored by their absolute address. Per
              * channel DSP parameters, since they have 32 unique addresses, are
              * stored as offsets relative to the appropriate channel offset.
@@ -805,6 +811,17 @@ static int dxp_modify_dspsymbol(int* ioChan, int* modChan, char* name,
     return DXP_SUCCESS;
 }
 
+/*
+ * Writes n consecutive DSP parameters, starting at index first, in runs of
+ * consecutive addresses. See dxp_dsp_symbols_write().
+ */
+static int dxp_write_dspsymbols(int* ioChan, int* modChan, Board* board,
+                                unsigned short first, unsigned short n,
+                                unsigned short* values) {
+    return dxp_dsp_symbols_write(board, ioChan, modChan, first, n, values,
+                                 dxp__write_data_memory);
+}
+
 /*
  * Read a single parameter of the DSP.
  *
@@ -2047,10 +2064,9 @@ static int dxp_reset_dsp(int ioChan) {
 static int dxp_boot_dsp(int ioChan, int modChan, Board* b) {
     int status;
 
-    unsigned long dsp_active;
+    unsigned long dsp_active = 0;
 
-    float wait = 0.001f;
-    float elapsed = 0.0;
+    Dxp_Wait w;
 
     ASSERT(b != NULL);
 
@@ -2066,12 +2082,11 @@ static int dxp_boot_dsp(int ioChan, int modChan, Board* b) {
         return status;
     }
 
+    dxp_wait_begin(&w, DXP_WAIT_ACTIVE, STJ_DSP_BOOT_ACTIVE_TIMEOUT);
+
     do {
         unsigned long csr;
 
-        stj_md_wait(&wait);
-        elapsed += wait;
-
         status = dxp_read_global_register(ioChan, STJ_REG_CSR, &csr);
 
         if (status != DXP_SUCCESS) {
@@ -2084,13 +2099,22 @@ static int dxp_boot_dsp(int ioChan, int modChan, Board* b) {
         }
 
         dsp_active = csr & (1 << STJ_CSR_DSP_ACT_BIT);
-    } while (!dsp_active && elapsed < STJ_DSP_BOOT_ACTIVE_TIMEOUT);
 
-    if (elapsed >= STJ_DSP_BOOT_ACTIVE_TIMEOUT) {
+        if (dsp_active) {
+            dxp_wait_end(&w);
+            break;
+        }
+    } while (dxp_wait_next(&w));
+
+    if (w.cancelled) {
+        return DXP_CANCELLED;
+    }
+
+    if (!dsp_active) {
         sprintf(info_string,
                 "Timeout (%0.1f s) waiting for DSP Active bit in "
                 "the CSR to be set for ioChan = %d.",
-                elapsed, ioChan);
+                w.elapsed, ioChan);
         dxp_log_error("dxp_boot_dsp", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
@@ -2256,37 +2280,35 @@ static int dxp_begin_adc_trace(int ioChan, int modChan, Board* board) {
 static int dxp_wait_for_busy(int ioChan, int modChan, parameter_t desired,
                              double timeout, Board* board) {
     int status;
-    int n_polls = 0;
-    int i;
-
-    float wait = .01f;
 
     double BUSY = 0;
 
-    ASSERT(board != NULL);
+    Dxp_Wait w;
 
-    n_polls = (int) ROUND(timeout / wait);
+    ASSERT(board != NULL);
 
-    sprintf(info_string, "Max. polls for waiting for BUSY = %d", n_polls);
-    dxp_log_debug("dxp_wait_for_busy", info_string);
+    dxp_wait_begin(&w, DXP_WAIT_BUSY, timeout);
 
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp_read_dspsymbol(&ioChan, &modChan, "BUSY", board, &BUSY);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string,
                     "Error reading BUSY during poll iteration %d while "
                     "waiting for BUSY to go to %hu on ioChan = %d",
-                    i, desired, ioChan);
+                    w.polls, desired, ioChan);
             dxp_log_error("dxp_wait_for_busy", info_string, status);
             return status;
         }
 
         if (BUSY == (double) desired) {
+            dxp_wait_end(&w);
             return DXP_SUCCESS;
         }
+    } while (dxp_wait_next(&w));
 
-        stj_md_wait(&wait);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
     sprintf(info_string,
@@ -2353,12 +2375,10 @@ static int dxp_get_adc_trace(int ioChan, int modChan, unsigned long* data,
 static int dxp_do_apply(int ioChan, int modChan, Board* board) {
     int status;
     int active;
-    int n_polls;
-    int i;
 
     double timeout = 1.0;
 
-    float poll_interval = 0.1f;
+    Dxp_Wait w;
 
     ASSERT(board != NULL);
 
@@ -2370,16 +2390,9 @@ static int dxp_do_apply(int ioChan, int modChan, Board* board) {
         return status;
     }
 
-    /* We have an approximate timeout here since we don't include the
-     * time it takes to call dxp__run_enable_active() in the calculation.
-     */
-    n_polls = (int) ROUND(timeout / (double) poll_interval);
+    dxp_wait_begin(&w, DXP_WAIT_RUN_ENABLE, timeout);
 
-    sprintf(info_string, "n_polls = %d, timeout = %0.1f, poll_interval = %0.1f",
-            n_polls, (double) timeout, (double) poll_interval);
-    dxp_log_debug("dxp_do_apply", info_string);
-
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp__run_enable_active(ioChan, &active);
 
         if (status != DXP_SUCCESS) {
@@ -2390,13 +2403,16 @@ static int dxp_do_apply(int ioChan, int modChan, Board* board) {
 
         if (!active) {
             /* The apply is complete. */
+            dxp_wait_end(&w);
             break;
         }
+    } while (dxp_wait_next(&w));
 
-        stj_md_wait(&poll_interval);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
-    if (i == n_polls) {
+    if (active) {
         status = dxp_end_run(&ioChan, &modChan, board);
         sprintf(info_string,
                 "Timeout waiting %0.1f second(s) for the apply run "
@@ -43,6 +43,8 @@
 #include "xia_handel.h"
 #include "xia_psl.h"
 #include "xia_system.h"
+#include <util/xia_unpack.h>
+#include <util/xia_map_buffer.h>
 
 #include "handel_constants.h"
 #include "handel_errors.h"
@@ -79,7 +81,9 @@ PSL_STATIC int psl__GetBufferFull(int detChan, char buf, boolean_t* is_full);
 PSL_STATIC int psl__IsMapping(int detChan, unsigned short allowed,
                               boolean_t* isMapping);
 PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
-                              XiaDefaults* defs, Module* m);
+                              XiaDefaults* defs, Module* m, boolean_t packed);
+PSL_STATIC int psl__GetPartialBuffer(int detChan, char buf, unsigned long* data,
+                                     XiaDefaults* defs, Module* m);
 PSL_STATIC int psl__SetRegisterBit(int detChan, char* reg, int bit,
                                    boolean_t overwrite);
 PSL_STATIC int psl__ClearRegisterBit(int detChan, char* reg, int bit);
@@ -176,6 +180,14 @@ PSL_STATIC int psl__GetBufferLen(int detChan, void* value, XiaDefaults* defs,
                                  Module* m);
 PSL_STATIC int psl__GetBufferA(int detChan, void* value, XiaDefaults* defs, Module* m);
 PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Module* m);
+PSL_STATIC int psl__GetPackedBufferA(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m);
+PSL_STATIC int psl__GetPackedBufferB(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m);
+PSL_STATIC int psl__GetPartialBufferA(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m);
+PSL_STATIC int psl__GetPartialBufferB(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m);
 PSL_STATIC int psl__GetCurrentPixel(int detChan, void* value, XiaDefaults* defs,
                                     Module* m);
 PSL_STATIC int psl__GetBufferOverrun(int detChan, void* value, XiaDefaults* defs,
@@ -422,6 +434,10 @@ static RunData runData[] = {{"mca_length", pslGetMCALength},
                             {"buffer_len", psl__GetBufferLen},
                             {"buffer_a", psl__GetBufferA},
                             {"buffer_b", psl__GetBufferB},
+                            {"buffer_packed_a", psl__GetPackedBufferA},
+                            {"buffer_packed_b", psl__GetPackedBufferB},
+                            {"buffer_partial_a", psl__GetPartialBufferA},
+                            {"buffer_partial_b", psl__GetPartialBufferB},
                             {"current_pixel", psl__GetCurrentPixel},
                             {"buffer_overrun", psl__GetBufferOverrun},
                             {"livetime", psl__GetELivetime},
@@ -583,6 +599,7 @@ PSL_EXPORT int PSL_API stj_PSLInit(PSLFuncs* funcs) {
     funcs->downloadFirmware = pslDownloadFirmware;
     funcs->setAcquisitionValues = pslSetAcquisitionValues;
     funcs->getAcquisitionValues = pslGetAcquisitionValues;
+    funcs->commitAcquisitionValues = NULL;
     funcs->gainOperation = pslGainOperation;
     funcs->gainCalibrate = pslGainCalibrate;
     funcs->startRun = pslStartRun;
@@ -4450,7 +4467,7 @@ PSL_STATIC int psl__GetBufferA(int detChan, void* value, XiaDefaults* defs, Modu
     ASSERT(m != NULL);
     ASSERT(defs != NULL);
 
-    status = psl__GetBuffer(detChan, 'a', (unsigned long*) value, defs, m);
+    status = psl__GetBuffer(detChan, 'a', (unsigned long*) value, defs, m, FALSE_);
 
     if (status != XIA_SUCCESS) {
         sprintf(info_string, "Error reading Buffer A for detChan =  %d", detChan);
@@ -4472,7 +4489,7 @@ PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Modu
     ASSERT(m != NULL);
     ASSERT(defs != NULL);
 
-    status = psl__GetBuffer(detChan, 'b', (unsigned long*) value, defs, m);
+    status = psl__GetBuffer(detChan, 'b', (unsigned long*) value, defs, m, FALSE_);
 
     if (status != XIA_SUCCESS) {
         sprintf(info_string, "Error reading Buffer B for detChan =  %d", detChan);
@@ -4488,10 +4505,14 @@ PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Modu
  *
  * Requires mapping firmware.
  *
+ * If packed is set, the buffer is read through the packed aperture, which
+ * carries two 16-bit words per transfer, and spread out to one word per
+ * element on the host.
+ *
  * Assumes that the proper amount of memory has been allocated for data.
  */
 PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
-                              XiaDefaults* defs, Module* m) {
+                              XiaDefaults* defs, Module* m, boolean_t packed) {
     int status;
 
     unsigned long len = 0;
@@ -4528,15 +4549,12 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
         return XIA_NO_MAPPING;
     }
 
-    /* Use "no word packing". Once packing support is included, we can update
-     * the memory base here.
-     */
     switch (buf) {
         case 'a':
-            base = 0x4000000;
+            base = packed ? STJ_BUFFER_A_PACKED_MEMORY : STJ_BUFFER_A_MEMORY;
             break;
         case 'b':
-            base = 0x6000000;
+            base = packed ? STJ_BUFFER_B_PACKED_MEMORY : STJ_BUFFER_B_MEMORY;
             break;
         default:
             FAIL();
@@ -4572,9 +4590,18 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
         FAIL();
     }
 
-    sprintf(memoryStr, "burst_map:%#lx:%lu", base, len);
+    if (packed) {
+        /* Read the packed words into the back half of data so they can be
+         * spread out in place.
+         */
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base, (len + 1) / 2);
 
-    status = dxp_read_memory(&detChan, memoryStr, data);
+        status = dxp_read_memory(&detChan, memoryStr, data + len / 2);
+    } else {
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base, len);
+
+        status = dxp_read_memory(&detChan, memoryStr, data);
+    }
 
     if (status != DXP_SUCCESS) {
         sprintf(info_string, "Error reading memory for buffer '%c' on detChan %d", buf,
@@ -4583,6 +4610,243 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
         return status;
     }
 
+    if (packed) {
+        xia_unpack_packed_words(data, (size_t) len);
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read mapping data from Buffer A through the packed aperture.
+ *
+ * Requires mapping firmware.
+ */
+PSL_STATIC int psl__GetPackedBufferA(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetBuffer(detChan, 'a', (unsigned long*) value, defs, m, TRUE_);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading packed Buffer A for detChan %d", detChan);
+        pslLogError("psl__GetPackedBufferA", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read mapping data from Buffer B through the packed aperture.
+ *
+ * Requires mapping firmware.
+ */
+PSL_STATIC int psl__GetPackedBufferB(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetBuffer(detChan, 'b', (unsigned long*) value, defs, m, TRUE_);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading packed Buffer B for detChan %d", detChan);
+        pslLogError("psl__GetPackedBufferB", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read the completed pixels of mapping Buffer A without waiting for it
+ * to fill.
+ *
+ * Requires MCA or SCA mapping firmware.
+ */
+PSL_STATIC int psl__GetPartialBufferA(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetPartialBuffer(detChan, 'a', (unsigned long*) value, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading partial Buffer A for detChan %d", detChan);
+        pslLogError("psl__GetPartialBufferA", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read the completed pixels of mapping Buffer B without waiting for it
+ * to fill.
+ *
+ * Requires MCA or SCA mapping firmware.
+ */
+PSL_STATIC int psl__GetPartialBufferB(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetPartialBuffer(detChan, 'b', (unsigned long*) value, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading partial Buffer B for detChan %d", detChan);
+        pslLogError("psl__GetPartialBufferB", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Get the buffer header and the pixels completed so far from the
+ * requested buffer.
+ *
+ * The pixel count is derived from the current mapping point and the
+ * starting pixel in the buffer header, so only the completed pixel
+ * blocks are transferred. The number of pixels in the returned header
+ * (word 8) is rewritten to the number actually read so the data can be
+ * parsed like a full buffer.
+ *
+ * Requires MCA or SCA mapping firmware.
+ *
+ * Assumes that data is large enough for the full buffer ("buffer_len").
+ */
+PSL_STATIC int psl__GetPartialBuffer(int detChan, char buf, unsigned long* data,
+                                     XiaDefaults* defs, Module* m) {
+    int status;
+
+    unsigned long len = 0;
+    unsigned long base = 0;
+    unsigned long pixelBlockSize = 0;
+    unsigned long current = 0;
+    unsigned long nPixels = 0;
+
+    parameter_t PIXPERBUF = 0;
+
+    boolean_t isMapping = FALSE_;
+    boolean_t isFull = FALSE_;
+
+    char memoryStr[36];
+
+    ASSERT(data != NULL);
+    ASSERT(buf == 'a' || buf == 'b');
+
+    status = psl__IsMapping(detChan, MAPPING_MCA | MAPPING_SCA, &isMapping);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error checking firmware type for detChan %d", detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    if (!isMapping) {
+        sprintf(info_string, "MCA or SCA mapping firmware not running on detChan %d",
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, XIA_NO_MAPPING);
+        return XIA_NO_MAPPING;
+    }
+
+    status = psl__GetBufferLen(detChan, (void*) &len, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting length of buffer '%c' for detChan %d", buf,
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    status = pslGetParameter(detChan, "PIXPERBUF", &PIXPERBUF);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string,
+                "Error reading the number of pixel points in the "
+                "buffer for detChan %d",
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    if (PIXPERBUF > 0) {
+        pixelBlockSize = (len - STJ_MEMORY_BLOCK_SIZE) / PIXPERBUF;
+    }
+
+    switch (buf) {
+        case 'a':
+            base = 0x4000000;
+            break;
+        case 'b':
+            base = 0x6000000;
+            break;
+        default:
+            FAIL();
+            break;
+    }
+
+    /* Sample the mapping point before the buffer so that every pixel below
+     * it has been written out by the time the pixel blocks are read.
+     */
+    status = psl__GetCurrentPixel(detChan, (void*) &current, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting the current pixel for detChan %d", detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    status = psl__GetBufferFull(detChan, buf, &isFull);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting full status of buffer '%c' for detChan %d",
+                buf, detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    sprintf(memoryStr, "burst_map:%#lx:%d", base, STJ_MEMORY_BLOCK_SIZE);
+
+    status = dxp_read_memory(&detChan, memoryStr, data);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading header of buffer '%c' on detChan %d", buf,
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    nPixels = xia_map_buffer_pixels(data, isFull, current, (unsigned long) PIXPERBUF);
+
+    sprintf(info_string, "Reading %lu pixel(s) from buffer '%c' on detChan %d",
+            nPixels, buf, detChan);
+    pslLogDebug("psl__GetPartialBuffer", info_string);
+
+    if (nPixels > 0) {
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base + STJ_MEMORY_BLOCK_SIZE,
+                nPixels * pixelBlockSize);
+
+        status = dxp_read_memory(&detChan, memoryStr, data + STJ_MEMORY_BLOCK_SIZE);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading pixels from buffer '%c' on detChan %d",
+                    buf, detChan);
+            pslLogError("psl__GetPartialBuffer", info_string, status);
+            return status;
+        }
+    }
+
     return XIA_SUCCESS;
 }
 
@@ -44,11 +44,13 @@
 #include "md_generic.h"
 #include "udxp.h"
 #include "udxp_common.h"
+#include "xerxes_dsp_shadow.h"
 #include "xerxes_errors.h"
 #include "xerxes_generic.h"
 #include "xerxes_io.h"
 #include "xerxes_structures.h"
 #include "xia_assert.h"
+#include "xia_common.h"
 #include "xia_udxp.h"
 #include "xia_xerxes_structures.h"
 
@@ -78,7 +80,7 @@ static DXP_MD_WAIT udxp_md_wait;
 
 static int dxp_init_dspparams(int ioChan, int modChan, Board* board);
 
-char info_string[INFO_LEN];
+XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 /*
  * Routine to create pointers to all the internal routines
@@ -135,6 +137,8 @@ XERXES_EXPORT int dxp_init_udxp(Functions* funcs) {
 
     funcs->dxp_do_cmd = dxp_do_cmd;
 
+    funcs->dxp_write_dspsymbols = dxp_write_dspsymbols;
+
     dxp_init_pic_version_cache();
 
     return DXP_SUCCESS;
@@ -511,6 +515,85 @@ static int dxp_modify_dspsymbol(int* ioChan, int* modChan, char* name,
     return DXP_SUCCESS;
 }
 
+/*
+ * Writes n consecutive DSP parameters, starting at index first. Parameters
+ * at consecutive addresses share a DSP data memory write of up to 32 words,
+ * the same transfer size dxp_read_dspparams() uses.
+ */
+static int dxp_write_dspsymbols(int* ioChan, int* modChan, Board* board,
+                                unsigned short first, unsigned short n,
+                                unsigned short* values) {
+    int status;
+
+    unsigned int lenS;
+    unsigned int lenR = 1 + RECV_BASE;
+    unsigned int maxWordsPerTransfer = 32;
+    unsigned int nWords;
+
+    unsigned short i;
+    unsigned short index;
+
+    unsigned long addr;
+    unsigned long next;
+
+    byte_t cmd = CMD_WRITE_DSP_DATA_MEM;
+
+    byte_t send[4 + 2 * 32];
+    byte_t receive[1 + RECV_BASE];
+
+    UNUSED(ioChan);
+
+    ASSERT(board != NULL);
+    ASSERT(values != NULL);
+
+    for (i = 0; i < n; i += (unsigned short) nWords) {
+        index = (unsigned short) (first + i);
+
+        if (dxp_dsp_symbol(board, 0, index, &addr) == NULL) {
+            sprintf(info_string, "No DSP parameter at index %hu", index);
+            dxp_log_error("dxp_write_dspsymbols", info_string, DXP_NOSYMBOL);
+            return DXP_NOSYMBOL;
+        }
+
+        send[2] = LO_BYTE(addr);
+        send[3] = HI_BYTE(addr);
+
+        for (nWords = 0, next = addr;
+             nWords < maxWordsPerTransfer && i + nWords < n &&
+             dxp_dsp_symbol(board, 0, (unsigned short) (index + nWords), &addr) !=
+                 NULL &&
+             addr == next;
+             nWords++, next++) {
+            send[4 + nWords * 2] = LO_BYTE(values[i + nWords]);
+            send[5 + nWords * 2] = HI_BYTE(values[i + nWords]);
+        }
+
+        send[0] = (byte_t) 0x01;
+        send[1] = (byte_t) nWords;
+        lenS = 4 + nWords * 2;
+
+        status = dxp_command(*modChan, board, cmd, lenS, send, lenR, receive);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error writing %u DSP parameters starting at %hu",
+                    nWords, index);
+            dxp_log_error("dxp_write_dspsymbols", info_string, status);
+            return status;
+        }
+
+        if (receive[4] != 0) {
+            status = DXP_DSP_ERROR;
+            sprintf(info_string,
+                    "Board reported an error writing %u DSP parameters starting at %hu",
+                    nWords, index);
+            dxp_log_error("dxp_write_dspsymbols", info_string, status);
+            return status;
+        }
+    }
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Read a single parameter of the DSP.  Pass the symbol name, module
  * pointer and channel number.  Returns the value read using the variable value.
@@ -37,6 +37,7 @@
 #include <stdio.h>
 
 #include "xia_assert.h"
+#include "xia_common.h"
 #include "xia_mddef.h"
 
 #include "md_generic.h"
@@ -101,7 +102,7 @@ static byte_t VERSION_CACHE[MAXMOD][VERSION_NUMBERS];
     udxpc_md_free((void*) (x));                                                        \
     (x) = NULL
 
-static char INFO_STRING[INFO_LEN];
+static XIA_THREAD_LOCAL char INFO_STRING[INFO_LEN];
 
 /*
  *Reset the state of all ioChans in the variant cache to "unread".
@@ -43,9 +43,11 @@
 #include "xia_xerxes_structures.h"
 #include "xia_xmap.h"
 
+#include "xerxes_dsp_shadow.h"
 #include "xerxes_errors.h"
 #include "xerxes_generic.h"
 #include "xerxes_structures.h"
+#include "xerxes_wait.h"
 
 #include "xmap.h"
 
@@ -73,7 +75,7 @@ static DXP_MD_PUTS xmap_md_puts;
 static DXP_MD_WAIT xmap_md_wait;
 static DXP_MD_FGETS xmap_md_fgets;
 
-static char info_string[INFO_LEN];
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 static int dxp_is_symbol_global(char* name, Dsp_Info* dsp, boolean_t* is_global);
 static int dxp_get_global_addr(char* name, Dsp_Info* dsp, unsigned long* addr);
@@ -236,6 +238,8 @@ XERXES_EXPORT int dxp_init_xmap(Functions* funcs) {
     funcs->dxp_get_symbol_by_index = dxp_get_symbol_by_index;
     funcs->dxp_get_num_params = dxp_get_num_params;
 
+    funcs->dxp_write_dspsymbols = dxp_write_dspsymbols;
+
     return DXP_SUCCESS;
 }
 
@@ -736,6 +740,8 @@ static int dxp_load_symbols_from_file(char* file, Dsp_Params* params) {
                 return DXP_NOMEM;
             }
 
+            params->n_chan_offsets = 4;
+
             /* Global DSP parameters are stored by their absolute address. Per
              * channel DSP parameters, since they have 4 unique addresses, are
              * stored as offsets relative to the appropriate channel offset.
@@ -847,6 +853,17 @@ static int dxp_modify_dspsymbol(int* ioChan, int* modChan, char* name,
     return DXP_SUCCESS;
 }
 
+/*
+ * Writes n consecutive DSP parameters, starting at index first, in runs of
+ * consecutive addresses. See dxp_dsp_symbols_write().
+ */
+static int dxp_write_dspsymbols(int* ioChan, int* modChan, Board* board,
+                                unsigned short first, unsigned short n,
+                                unsigned short* values) {
+    return dxp_dsp_symbols_write(board, ioChan, modChan, first, n, values,
+                                 dxp__write_data_memory);
+}
+
 /*
  * Read a single parameter of the DSP.
  *
@@ -2174,10 +2191,9 @@ static int dxp_reset_dsp(int ioChan) {
 static int dxp_boot_dsp(int ioChan, int modChan, Board* b) {
     int status;
 
-    unsigned long dsp_active;
+    unsigned long dsp_active = 0;
 
-    float wait = 0.001f;
-    float elapsed = 0.0;
+    Dxp_Wait w;
 
     ASSERT(b != NULL);
 
@@ -2193,12 +2209,11 @@ static int dxp_boot_dsp(int ioChan, int modChan, Board* b) {
         return status;
     }
 
+    dxp_wait_begin(&w, DXP_WAIT_ACTIVE, XMAP_DSP_BOOT_ACTIVE_TIMEOUT);
+
     do {
         unsigned long csr;
 
-        xmap_md_wait(&wait);
-        elapsed += wait;
-
         status = dxp_read_global_register(ioChan, XMAP_REG_CSR, &csr);
 
         if (status != DXP_SUCCESS) {
@@ -2211,13 +2226,22 @@ static int dxp_boot_dsp(int ioChan, int modChan, Board* b) {
         }
 
         dsp_active = csr & (1 << XMAP_CSR_DSP_ACT_BIT);
-    } while (!dsp_active && elapsed < XMAP_DSP_BOOT_ACTIVE_TIMEOUT);
 
-    if (elapsed >= XMAP_DSP_BOOT_ACTIVE_TIMEOUT) {
+        if (dsp_active) {
+            dxp_wait_end(&w);
+            break;
+        }
+    } while (dxp_wait_next(&w));
+
+    if (w.cancelled) {
+        return DXP_CANCELLED;
+    }
+
+    if (!dsp_active) {
         sprintf(info_string,
                 "Timeout (%0.1f s) waiting for DSP Active bit in "
                 "the CSR to be set for ioChan = %d.",
-                elapsed, ioChan);
+                w.elapsed, ioChan);
         dxp_log_error("dxp_boot_dsp", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
@@ -2383,37 +2407,35 @@ static int dxp_begin_adc_trace(int ioChan, int modChan, Board* board) {
 static int dxp_wait_for_busy(int ioChan, int modChan, parameter_t desired,
                              double timeout, Board* board) {
     int status;
-    int n_polls = 0;
-    int i;
-
-    float wait = .01f;
 
     double BUSY = 0;
 
-    ASSERT(board != NULL);
+    Dxp_Wait w;
 
-    n_polls = (int) ROUND(timeout / wait);
+    ASSERT(board != NULL);
 
-    sprintf(info_string, "Max. polls for waiting for BUSY = %d", n_polls);
-    dxp_log_debug("dxp_wait_for_busy", info_string);
+    dxp_wait_begin(&w, DXP_WAIT_BUSY, timeout);
 
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp_read_dspsymbol(&ioChan, &modChan, "BUSY", board, &BUSY);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string,
                     "Error reading BUSY during poll iteration %d while "
                     "waiting for BUSY to go to %hu on ioChan = %d",
-                    i, desired, ioChan);
+                    w.polls, desired, ioChan);
             dxp_log_error("dxp_wait_for_busy", info_string, status);
             return status;
         }
 
         if (BUSY == (double) desired) {
+            dxp_wait_end(&w);
             return DXP_SUCCESS;
         }
+    } while (dxp_wait_next(&w));
 
-        xmap_md_wait(&wait);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
     sprintf(info_string,
@@ -2493,8 +2515,6 @@ static int dxp_do_apply(int ioChan, int modChan, Board* board) {
     int status;
     int active;
     int id = 0;
-    int n_polls;
-    int i;
 
     unsigned short ignored = 0;
 
@@ -2509,7 +2529,7 @@ static int dxp_do_apply(int ioChan, int modChan, Board* board) {
     double errinfo = 0.0;
     double timeout = 1.0;
 
-    float poll_interval = 0.1f;
+    Dxp_Wait w;
 
     ASSERT(board != NULL);
 
@@ -2573,16 +2593,9 @@ static int dxp_do_apply(int ioChan, int modChan, Board* board) {
     sprintf(info_string, "Started run id = %d on ioChan = %d", id, ioChan);
     dxp_log_debug("dxp_do_apply", info_string);
 
-    /* We have an approximate timeout here since we don't include the
-     * time it takes to call dxp__run_enable_active() in the calculation.
-     */
-    n_polls = (int) ROUND(timeout / (double) poll_interval);
+    dxp_wait_begin(&w, DXP_WAIT_RUN_ENABLE, timeout);
 
-    sprintf(info_string, "n_polls = %d, timeout = %0.1f, poll_interval = %0.1f",
-            n_polls, (double) timeout, (double) poll_interval);
-    dxp_log_debug("dxp_do_apply", info_string);
-
-    for (i = 0; i < n_polls; i++) {
+    do {
         status = dxp__run_enable_active(ioChan, &active);
 
         if (status != DXP_SUCCESS) {
@@ -2593,13 +2606,16 @@ static int dxp_do_apply(int ioChan, int modChan, Board* board) {
 
         if (!active) {
             /* The apply is complete. */
+            dxp_wait_end(&w);
             break;
         }
+    } while (dxp_wait_next(&w));
 
-        xmap_md_wait(&poll_interval);
+    if (w.cancelled) {
+        return DXP_CANCELLED;
     }
 
-    if (i == n_polls) {
+    if (active) {
         status = dxp_end_run(&ioChan, &modChan, board);
         sprintf(info_string,
                 "Timeout waiting %0.1f second(s) for the apply run "
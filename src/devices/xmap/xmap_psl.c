@@ -43,6 +43,8 @@
 #include "xia_handel.h"
 #include "xia_psl.h"
 #include "xia_system.h"
+#include <util/xia_unpack.h>
+#include <util/xia_map_buffer.h>
 
 #include "handel_constants.h"
 #include "handel_errors.h"
@@ -58,6 +60,12 @@
 
 PSL_EXPORT int PSL_API xmap_PSLInit(PSLFuncs* funcs);
 
+PSL_STATIC int pslCommitAcquisitionValues(int detChan, XiaDefaults* defaults,
+                                          FirmwareSet* firmwareSet,
+                                          CurrentFirmware* currentFirmware,
+                                          char* detectorType, Detector* detector,
+                                          int detector_chan, Module* m, int modChan);
+
 PSL_STATIC int psl__UpdateRawParamAcqValue(int detChan, char* name, void* value,
                                            XiaDefaults* defs);
 PSL_STATIC int psl__GetEVPerADC(XiaDefaults* defs, double* eVPerADC);
@@ -81,7 +89,9 @@ PSL_STATIC int psl__GetBufferFull(int detChan, char buf, boolean_t* is_full);
 PSL_STATIC int psl__IsMapping(int detChan, unsigned short allowed,
                               boolean_t* isMapping);
 PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
-                              XiaDefaults* defs, Module* m);
+                              XiaDefaults* defs, Module* m, boolean_t packed);
+PSL_STATIC int psl__GetPartialBuffer(int detChan, char buf, unsigned long* data,
+                                     XiaDefaults* defs, Module* m);
 PSL_STATIC int psl__SetRegisterBit(int detChan, char* reg, int bit,
                                    boolean_t overwrite);
 PSL_STATIC int psl__ClearRegisterBit(int detChan, char* reg, int bit);
@@ -187,6 +197,14 @@ PSL_STATIC int psl__GetBufferLen(int detChan, void* value, XiaDefaults* defs,
                                  Module* m);
 PSL_STATIC int psl__GetBufferA(int detChan, void* value, XiaDefaults* defs, Module* m);
 PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Module* m);
+PSL_STATIC int psl__GetPackedBufferA(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m);
+PSL_STATIC int psl__GetPackedBufferB(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m);
+PSL_STATIC int psl__GetPartialBufferA(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m);
+PSL_STATIC int psl__GetPartialBufferB(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m);
 PSL_STATIC int psl__GetCurrentPixel(int detChan, void* value, XiaDefaults* defs,
                                     Module* m);
 PSL_STATIC int psl__GetBufferOverrun(int detChan, void* value, XiaDefaults* defs,
@@ -414,6 +432,10 @@ static RunData runData[] = {{"mca_length", pslGetMCALength},
                             {"buffer_len", psl__GetBufferLen},
                             {"buffer_a", psl__GetBufferA},
                             {"buffer_b", psl__GetBufferB},
+                            {"buffer_packed_a", psl__GetPackedBufferA},
+                            {"buffer_packed_b", psl__GetPackedBufferB},
+                            {"buffer_partial_a", psl__GetPartialBufferA},
+                            {"buffer_partial_b", psl__GetPartialBufferB},
                             {"current_pixel", psl__GetCurrentPixel},
                             {"buffer_overrun", psl__GetBufferOverrun},
                             {"livetime", psl__GetELivetime},
@@ -436,7 +458,7 @@ static GainOperation gainOps[] = {
 
 /* Acquisition values */
 static AcquisitionValue_t ACQ_VALUES[] = {
-    {"peaking_time", TRUE_, FALSE_, XMAP_UPDATE_NEVER, 20.0, psl__SetPeakingTime, NULL,
+    {"peaking_time", TRUE_, FALSE_, XMAP_UPDATE_BATCH, 20.0, psl__SetPeakingTime, NULL,
      NULL},
 
     /* If you modify the default values for the calibration energy or the ADC
@@ -460,7 +482,7 @@ static AcquisitionValue_t ACQ_VALUES[] = {
     {"adc_percent_rule", TRUE_, FALSE_, XMAP_UPDATE_NEVER, 5.0, psl__SetADCRule, NULL,
      NULL},
 
-    {"mca_bin_width", TRUE_, FALSE_, XMAP_UPDATE_NEVER, 10.0, psl__SetMCABinWidth, NULL,
+    {"mca_bin_width", TRUE_, FALSE_, XMAP_UPDATE_BATCH, 10.0, psl__SetMCABinWidth, NULL,
      NULL},
 
     {"preamp_gain", TRUE_, TRUE_, XMAP_UPDATE_NEVER, 5.0, psl__SetPreampGain, NULL,
@@ -540,7 +562,7 @@ static AcquisitionValue_t ACQ_VALUES[] = {
     {"peak_interval_offset", FALSE_, FALSE_, XMAP_UPDATE_NEVER, 0.0,
      psl__SetPeakIntervalOffset, NULL, NULL},
 
-    {"minimum_gap_time", TRUE_, FALSE_, XMAP_UPDATE_NEVER, 0.060, psl__SetMinGapTime,
+    {"minimum_gap_time", TRUE_, FALSE_, XMAP_UPDATE_BATCH, 0.060, psl__SetMinGapTime,
      NULL, NULL},
 
     {"synchronous_run", TRUE_, FALSE_, XMAP_UPDATE_MAPPING | XMAP_UPDATE_MCA, 0.0,
@@ -574,6 +596,7 @@ PSL_EXPORT int PSL_API xmap_PSLInit(PSLFuncs* funcs) {
     funcs->downloadFirmware = pslDownloadFirmware;
     funcs->setAcquisitionValues = pslSetAcquisitionValues;
     funcs->getAcquisitionValues = pslGetAcquisitionValues;
+    funcs->commitAcquisitionValues = pslCommitAcquisitionValues;
     funcs->gainOperation = pslGainOperation;
     funcs->gainCalibrate = pslGainCalibrate;
     funcs->startRun = pslStartRun;
@@ -697,6 +720,14 @@ PSL_STATIC int pslSetAcquisitionValues(int detChan, char* name, void* value,
 
     for (i = 0; i < N_ELEMS(ACQ_VALUES); i++) {
         if (STRNEQ(name, ACQ_VALUES[i].name)) {
+            if ((ACQ_VALUES[i].update & XMAP_UPDATE_BATCH) && m != NULL &&
+                m->ch[modChan].in_batch) {
+                status = pslSetDefault(name, value, defaults);
+                ASSERT(status == XIA_SUCCESS);
+
+                return XIA_SUCCESS;
+            }
+
             /* Cache the current value in case we need to rollback. */
             status = pslGetDefault(name, (void*) &original_value, defaults);
             ASSERT(status == XIA_SUCCESS);
@@ -758,6 +789,57 @@ PSL_STATIC int pslSetAcquisitionValues(int detChan, char* name, void* value,
     return XIA_UNKNOWN_VALUE;
 }
 
+/*
+ * Finishes an acquisition value batch.
+ *
+ * The XMAP_UPDATE_BATCH values set while the batch was open were only
+ * stored. Setting the final peaking time switches the FiPPI if needed and
+ * recomputes the filter, and with it the gain, from the final defaults.
+ * Everything is then applied once.
+ */
+PSL_STATIC int pslCommitAcquisitionValues(int detChan, XiaDefaults* defaults,
+                                          FirmwareSet* firmwareSet,
+                                          CurrentFirmware* currentFirmware,
+                                          char* detectorType, Detector* detector,
+                                          int detector_chan, Module* m, int modChan) {
+    int status;
+
+    double pt = 0.0;
+
+    ASSERT(defaults != NULL);
+    ASSERT(m != NULL);
+
+    UNUSED(currentFirmware);
+    UNUSED(detector_chan);
+
+    status = pslGetDefault("peaking_time", (void*) &pt, defaults);
+    ASSERT(status == XIA_SUCCESS);
+
+    status = psl__SetPeakingTime(detChan, modChan, NULL, (void*) &pt, detectorType,
+                                 defaults, m, detector, firmwareSet);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error setting peaking time to %0.3f for detChan %d", pt,
+                detChan);
+        pslLogError("pslCommitAcquisitionValues", info_string, status);
+        return status;
+    }
+
+    status = pslSetDefault("peaking_time", (void*) &pt, defaults);
+    ASSERT(status == XIA_SUCCESS);
+
+    status = pslApply(detChan, NULL, defaults, NULL);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error applying committed values for detChan %d",
+                detChan);
+        pslLogError("pslCommitAcquisitionValues", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
 /*
  * Gets the current value of the requested acquisition value.
  */
@@ -5160,7 +5242,7 @@ PSL_STATIC int psl__GetBufferA(int detChan, void* value, XiaDefaults* defs, Modu
     ASSERT(m != NULL);
     ASSERT(defs != NULL);
 
-    status = psl__GetBuffer(detChan, 'a', (unsigned long*) value, defs, m);
+    status = psl__GetBuffer(detChan, 'a', (unsigned long*) value, defs, m, FALSE_);
 
     if (status != XIA_SUCCESS) {
         sprintf(info_string, "Error reading Buffer A for detChan =  %d", detChan);
@@ -5182,7 +5264,7 @@ PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Modu
     ASSERT(m != NULL);
     ASSERT(defs != NULL);
 
-    status = psl__GetBuffer(detChan, 'b', (unsigned long*) value, defs, m);
+    status = psl__GetBuffer(detChan, 'b', (unsigned long*) value, defs, m, FALSE_);
 
     if (status != XIA_SUCCESS) {
         sprintf(info_string, "Error reading Buffer B for detChan =  %d", detChan);
@@ -5198,10 +5280,14 @@ PSL_STATIC int psl__GetBufferB(int detChan, void* value, XiaDefaults* defs, Modu
  *
  * Requires mapping firmware.
  *
+ * If packed is set, the buffer is read through the packed aperture, which
+ * carries two 16-bit words per transfer, and spread out to one word per
+ * element on the host.
+ *
  * Assumes that the proper amount of memory has been allocated for data.
  */
 PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
-                              XiaDefaults* defs, Module* m) {
+                              XiaDefaults* defs, Module* m, boolean_t packed) {
     int status;
 
     unsigned long len = 0;
@@ -5238,15 +5324,12 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
         return XIA_NO_MAPPING;
     }
 
-    /* Use "no word packing". Once packing support is included, we can update
-     * the memory base here.
-     */
     switch (buf) {
         case 'a':
-            base = 0x4000000;
+            base = packed ? XMAP_BUFFER_A_PACKED_MEMORY : XMAP_BUFFER_A_MEMORY;
             break;
         case 'b':
-            base = 0x6000000;
+            base = packed ? XMAP_BUFFER_B_PACKED_MEMORY : XMAP_BUFFER_B_MEMORY;
             break;
         default:
             FAIL();
@@ -5282,9 +5365,18 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
         FAIL();
     }
 
-    sprintf(memoryStr, "burst_map:%#lx:%lu", base, len);
+    if (packed) {
+        /* Read the packed words into the back half of data so they can be
+         * spread out in place.
+         */
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base, (len + 1) / 2);
 
-    status = dxp_read_memory(&detChan, memoryStr, data);
+        status = dxp_read_memory(&detChan, memoryStr, data + len / 2);
+    } else {
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base, len);
+
+        status = dxp_read_memory(&detChan, memoryStr, data);
+    }
 
     if (status != DXP_SUCCESS) {
         sprintf(info_string, "Error reading memory for buffer '%c' on detChan %d", buf,
@@ -5293,6 +5385,243 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long* data,
         return status;
     }
 
+    if (packed) {
+        xia_unpack_packed_words(data, (size_t) len);
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read mapping data from Buffer A through the packed aperture.
+ *
+ * Requires mapping firmware.
+ */
+PSL_STATIC int psl__GetPackedBufferA(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetBuffer(detChan, 'a', (unsigned long*) value, defs, m, TRUE_);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading packed Buffer A for detChan %d", detChan);
+        pslLogError("psl__GetPackedBufferA", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read mapping data from Buffer B through the packed aperture.
+ *
+ * Requires mapping firmware.
+ */
+PSL_STATIC int psl__GetPackedBufferB(int detChan, void* value, XiaDefaults* defs,
+                                     Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetBuffer(detChan, 'b', (unsigned long*) value, defs, m, TRUE_);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading packed Buffer B for detChan %d", detChan);
+        pslLogError("psl__GetPackedBufferB", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read the completed pixels of mapping Buffer A without waiting for it
+ * to fill.
+ *
+ * Requires MCA or SCA mapping firmware.
+ */
+PSL_STATIC int psl__GetPartialBufferA(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetPartialBuffer(detChan, 'a', (unsigned long*) value, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading partial Buffer A for detChan %d", detChan);
+        pslLogError("psl__GetPartialBufferA", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Read the completed pixels of mapping Buffer B without waiting for it
+ * to fill.
+ *
+ * Requires MCA or SCA mapping firmware.
+ */
+PSL_STATIC int psl__GetPartialBufferB(int detChan, void* value, XiaDefaults* defs,
+                                      Module* m) {
+    int status;
+
+    ASSERT(m != NULL);
+    ASSERT(defs != NULL);
+
+    status = psl__GetPartialBuffer(detChan, 'b', (unsigned long*) value, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error reading partial Buffer B for detChan %d", detChan);
+        pslLogError("psl__GetPartialBufferB", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Get the buffer header and the pixels completed so far from the
+ * requested buffer.
+ *
+ * The pixel count is derived from the current mapping point and the
+ * starting pixel in the buffer header, so only the completed pixel
+ * blocks are transferred. The number of pixels in the returned header
+ * (word 8) is rewritten to the number actually read so the data can be
+ * parsed like a full buffer.
+ *
+ * Requires MCA or SCA mapping firmware.
+ *
+ * Assumes that data is large enough for the full buffer ("buffer_len").
+ */
+PSL_STATIC int psl__GetPartialBuffer(int detChan, char buf, unsigned long* data,
+                                     XiaDefaults* defs, Module* m) {
+    int status;
+
+    unsigned long len = 0;
+    unsigned long base = 0;
+    unsigned long pixelBlockSize = 0;
+    unsigned long current = 0;
+    unsigned long nPixels = 0;
+
+    parameter_t PIXPERBUF = 0;
+
+    boolean_t isMapping = FALSE_;
+    boolean_t isFull = FALSE_;
+
+    char memoryStr[36];
+
+    ASSERT(data != NULL);
+    ASSERT(buf == 'a' || buf == 'b');
+
+    status = psl__IsMapping(detChan, MAPPING_MCA | MAPPING_SCA, &isMapping);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error checking firmware type for detChan %d", detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    if (!isMapping) {
+        sprintf(info_string, "MCA or SCA mapping firmware not running on detChan %d",
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, XIA_NO_MAPPING);
+        return XIA_NO_MAPPING;
+    }
+
+    status = psl__GetBufferLen(detChan, (void*) &len, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting length of buffer '%c' for detChan %d", buf,
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    status = pslGetParameter(detChan, "PIXPERBUF", &PIXPERBUF);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string,
+                "Error reading the number of pixel points in the "
+                "buffer for detChan %d",
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    if (PIXPERBUF > 0) {
+        pixelBlockSize = (len - XMAP_MEMORY_BLOCK_SIZE) / PIXPERBUF;
+    }
+
+    switch (buf) {
+        case 'a':
+            base = 0x4000000;
+            break;
+        case 'b':
+            base = 0x6000000;
+            break;
+        default:
+            FAIL();
+            break;
+    }
+
+    /* Sample the mapping point before the buffer so that every pixel below
+     * it has been written out by the time the pixel blocks are read.
+     */
+    status = psl__GetCurrentPixel(detChan, (void*) &current, defs, m);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting the current pixel for detChan %d", detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    status = psl__GetBufferFull(detChan, buf, &isFull);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting full status of buffer '%c' for detChan %d",
+                buf, detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    sprintf(memoryStr, "burst_map:%#lx:%d", base, XMAP_MEMORY_BLOCK_SIZE);
+
+    status = dxp_read_memory(&detChan, memoryStr, data);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading header of buffer '%c' on detChan %d", buf,
+                detChan);
+        pslLogError("psl__GetPartialBuffer", info_string, status);
+        return status;
+    }
+
+    nPixels = xia_map_buffer_pixels(data, isFull, current, (unsigned long) PIXPERBUF);
+
+    sprintf(info_string, "Reading %lu pixel(s) from buffer '%c' on detChan %d",
+            nPixels, buf, detChan);
+    pslLogDebug("psl__GetPartialBuffer", info_string);
+
+    if (nPixels > 0) {
+        sprintf(memoryStr, "burst_map:%#lx:%lu", base + XMAP_MEMORY_BLOCK_SIZE,
+                nPixels * pixelBlockSize);
+
+        status = dxp_read_memory(&detChan, memoryStr, data + XMAP_MEMORY_BLOCK_SIZE);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading pixels from buffer '%c' on detChan %d",
+                    buf, detChan);
+            pslLogError("psl__GetPartialBuffer", info_string, status);
+            return status;
+        }
+    }
+
     return XIA_SUCCESS;
 }
 
@@ -47,13 +47,32 @@
 #include "xia_assert.h"
 #include "xia_common.h"
 #include "xia_file.h"
+#include "md_threads.h"
 
 static void fdd__StringChomp(char* str);
+static int fdd__GetFirmware(const char* filename, char* path, const char* ftype,
+                            double pt, unsigned int nother, const char** others,
+                            const char* detectorType, char newfilename[],
+                            char rawFilename[]);
+static int fdd__GetNumFilter(const char* filename, double peakingTime,
+                             unsigned int nKey, const char** keywords,
+                             unsigned short* numFilter);
+static int fdd__GetFilterInfo(const char* filename, double peakingTime,
+                              unsigned int nKey, const char** keywords, double* ptMin,
+                              double* ptMax, parameter_t* filterInfo);
+static int fdd__GetAndCacheFirmware(FirmwareSet* fs, const char* ftype, double pt,
+                                    char* detType, char* file, char* rawFile);
 
 static char line[XIA_LINE_LEN], *token, *delim = " ,=\t\r\n";
 
 static char* section = "$$$NEW SECTION$$$\n";
 
+/*
+ * The parser keeps its line and token state in the statics above and in
+ * strtok(), so the FDD routines run one at a time across all contexts.
+ */
+static handel_md_Mutex fddLock = {NULL, "fdd"};
+
 /*
  * Global initialization routine.  Should be called before performing get and/or
  * put routines to the database.
@@ -75,6 +94,13 @@ FDD_EXPORT int FDD_API xiaFddInitialize(void) {
         return status;
     }
 
+    if (!handel_md_mutex_ready(&fddLock) &&
+        handel_md_mutex_create(&fddLock) != THREADING_NO_ERROR) {
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaFddInitialize",
+               "Error creating the FDD lock");
+        return XIA_THREAD_ERROR;
+    }
+
     return status;
 }
 
@@ -106,6 +132,71 @@ FDD_EXPORT int FDD_API xiaFddInitLibrary(void) {
     return status;
 }
 
+/*
+ * Creates the firmware file for the criteria; see fdd__GetFirmware().
+ */
+FDD_EXPORT int FDD_API xiaFddGetFirmware(const char* filename, char* path,
+                                         const char* ftype, double pt,
+                                         unsigned int nother, const char** others,
+                                         const char* detectorType, char newfilename[],
+                                         char rawFilename[]) {
+    int status;
+
+    handel_md_mutex_lock(&fddLock);
+    status = fdd__GetFirmware(filename, path, ftype, pt, nother, others, detectorType,
+                              newfilename, rawFilename);
+    handel_md_mutex_unlock(&fddLock);
+
+    return status;
+}
+
+/*
+ * Returns the number of filter parameters; see fdd__GetNumFilter().
+ */
+FDD_EXPORT int FDD_API xiaFddGetNumFilter(const char* filename, double peakingTime,
+                                          unsigned int nKey, const char** keywords,
+                                          unsigned short* numFilter) {
+    int status;
+
+    handel_md_mutex_lock(&fddLock);
+    status = fdd__GetNumFilter(filename, peakingTime, nKey, keywords, numFilter);
+    handel_md_mutex_unlock(&fddLock);
+
+    return status;
+}
+
+/*
+ * Returns the filter parameters; see fdd__GetFilterInfo().
+ */
+FDD_EXPORT int FDD_API xiaFddGetFilterInfo(const char* filename, double peakingTime,
+                                           unsigned int nKey, const char** keywords,
+                                           double* ptMin, double* ptMax,
+                                           parameter_t* filterInfo) {
+    int status;
+
+    handel_md_mutex_lock(&fddLock);
+    status = fdd__GetFilterInfo(filename, peakingTime, nKey, keywords, ptMin, ptMax,
+                                filterInfo);
+    handel_md_mutex_unlock(&fddLock);
+
+    return status;
+}
+
+/*
+ * Gets the firmware and caches it in fs; see fdd__GetAndCacheFirmware().
+ */
+FDD_EXPORT int FDD_API xiaFddGetAndCacheFirmware(FirmwareSet* fs, const char* ftype,
+                                                 double pt, char* detType, char* file,
+                                                 char* rawFile) {
+    int status;
+
+    handel_md_mutex_lock(&fddLock);
+    status = fdd__GetAndCacheFirmware(fs, ftype, pt, detType, file, rawFile);
+    handel_md_mutex_unlock(&fddLock);
+
+    return status;
+}
+
 /*
  * Routine to create a file(s) of firmware based on criteria specified by the
  * calling routine.
@@ -123,11 +214,10 @@ FDD_EXPORT int FDD_API xiaFddInitLibrary(void) {
  * char newfilename[MAXFILENAME_LEN] Output: filename of the temporary firmware file
  * char rawFilename[MACFILENAME_LEN]   Output: filename for the raw filename. For ID purposes in PSL
  */
-FDD_EXPORT int FDD_API xiaFddGetFirmware(const char* filename, char* path,
-                                         const char* ftype, double pt,
-                                         unsigned int nother, const char** others,
-                                         const char* detectorType, char newfilename[],
-                                         char rawFilename[]) {
+static int fdd__GetFirmware(const char* filename, char* path, const char* ftype,
+                            double pt, unsigned int nother, const char** others,
+                            const char* detectorType, char newfilename[],
+                            char rawFilename[]) {
     int status = XIA_SUCCESS;
     size_t len;
     size_t completePathLen = 0;
@@ -471,9 +561,9 @@ static boolean_t xiaFddFindFirmware(const char* filename, const char* ftype,
  * Returns the number of filter parameters that are present for a given
  * peaking time and keywords.
  */
-FDD_EXPORT int FDD_API xiaFddGetNumFilter(const char* filename, double peakingTime,
-                                          unsigned int nKey, const char** keywords,
-                                          unsigned short* numFilter) {
+static int fdd__GetNumFilter(const char* filename, double peakingTime,
+                             unsigned int nKey, const char** keywords,
+                             unsigned short* numFilter) {
     unsigned int numToMatch;
 
     unsigned short numKeys;
@@ -622,10 +712,9 @@ FDD_EXPORT int FDD_API xiaFddGetNumFilter(const char* filename, double peakingTi
  * right amount of memory for filterInfo, preferably using the size
  * returned from xiaFddGetNumFilter().
  */
-FDD_EXPORT int FDD_API xiaFddGetFilterInfo(const char* filename, double peakingTime,
-                                           unsigned int nKey, const char** keywords,
-                                           double* ptMin, double* ptMax,
-                                           parameter_t* filterInfo) {
+static int fdd__GetFilterInfo(const char* filename, double peakingTime,
+                              unsigned int nKey, const char** keywords, double* ptMin,
+                              double* ptMax, parameter_t* filterInfo) {
     unsigned int numToMatch;
 
     unsigned short numKeys;
@@ -811,9 +900,8 @@ static void fdd__StringChomp(char* str) {
  * Get the required firmware by calling xiaFddGetFirmware
  * Update FirmwareSet structure with the returned firmware information.
  */
-FDD_EXPORT int FDD_API xiaFddGetAndCacheFirmware(FirmwareSet* fs, const char* ftype,
-                                                 double pt, char* detType, char* file,
-                                                 char* rawFile) {
+static int fdd__GetAndCacheFirmware(FirmwareSet* fs, const char* ftype, double pt,
+                                    char* detType, char* file, char* rawFile) {
     int status;
     size_t len;
 
@@ -80,31 +80,6 @@ static int HANDEL_API xiaUnHook(void);
  */
 boolean_t isHandelInit = FALSE_;
 
-/*
- * Define the head of the Detector list
- */
-Detector* xiaDetectorHead = NULL;
-
-/*
- * Define the head of the Firmware Sets LL
- */
-FirmwareSet* xiaFirmwareSetHead = NULL;
-
-/*
- * Define the head of the XiaDefaults LL
- */
-XiaDefaults* xiaDefaultsHead = NULL;
-
-/*
- * Define the head of the Modules LL
- */
-Module* xiaModuleHead = NULL;
-
-/*
- * This is the head of the DetectorChannel LL
- */
-DetChanElement* xiaDetChanHead = NULL;
-
 HANDEL_EXPORT int HANDEL_API xiaInit(char* iniFile) {
     int status;
     int nFilesOpen;
@@ -190,6 +165,28 @@ HANDEL_EXPORT int HANDEL_API xiaInitHandel(void) {
             return status;
         }
 
+        if (xia_file_init() != 0) {
+            xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaInitHandel",
+                   "Error initializing the file handle lock");
+            return XIA_THREAD_ERROR;
+        }
+
+        status = xiaInitPoolLock();
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "xiaInitHandel",
+                   "Error initializing the worker pool lock");
+            return status;
+        }
+
+        status = xiaInitDefaultContext();
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "xiaInitHandel",
+                   "Error initializing the default context");
+            return status;
+        }
+
         isHandelInit = TRUE_;
     } else {
         /*
@@ -320,6 +317,9 @@ HANDEL_EXPORT int HANDEL_API xiaExit(void) {
     int status;
     xiaLog(XIA_LOG_INFO, "xiaExit", "Exiting...");
 
+    /* Let this context's queued requests finish before the system goes away. */
+    xiaDrainRequests();
+
     /*
      * Close down any communications that need to be shutdown.
      */
@@ -366,7 +366,7 @@ static int HANDEL_API xiaInitDetectorDS(void) {
     int status = XIA_SUCCESS;
 
     Detector* next = NULL;
-    Detector* current = xiaDetectorHead;
+    Detector* current = xiaContext->detectorHead;
 
     /* Search through the Detector LL and clear them out */
     while ((current != NULL) && (status == XIA_SUCCESS)) {
@@ -382,7 +382,7 @@ static int HANDEL_API xiaInitDetectorDS(void) {
         current = next;
     }
 
-    xiaDetectorHead = NULL;
+    xiaContext->detectorHead = NULL;
 
     return status;
 }
@@ -427,7 +427,7 @@ static int HANDEL_API xiaInitFirmwareSetDS(void) {
     int status = XIA_SUCCESS;
 
     FirmwareSet* next;
-    FirmwareSet* current = xiaFirmwareSetHead;
+    FirmwareSet* current = xiaContext->firmwareSetHead;
 
     /* Search through the FirmwareSet LL and clear them out */
     while ((current != NULL) && (status == XIA_SUCCESS)) {
@@ -443,7 +443,7 @@ static int HANDEL_API xiaInitFirmwareSetDS(void) {
         current = next;
     }
 
-    xiaFirmwareSetHead = NULL;
+    xiaContext->firmwareSetHead = NULL;
 
     return status;
 }
@@ -562,7 +562,7 @@ static int HANDEL_API xiaInitXiaDefaultsDS(void) {
     int status = XIA_SUCCESS;
 
     XiaDefaults* next;
-    XiaDefaults* current = xiaDefaultsHead;
+    XiaDefaults* current = xiaContext->defaultsHead;
 
     /* Search through the XiaDefaults LL and clear them out */
     while ((current != NULL) && (status == XIA_SUCCESS)) {
@@ -578,7 +578,7 @@ static int HANDEL_API xiaInitXiaDefaultsDS(void) {
         current = next;
     }
     /* And clear out the pointer to the head of the list(the memory is freed) */
-    xiaDefaultsHead = NULL;
+    xiaContext->defaultsHead = NULL;
 
     return status;
 }
@@ -766,6 +766,16 @@ int HANDEL_API xiaFreeModule(Module* module) {
     handel_md_free((void*) module->defaults);
     handel_md_free((void*) module->currentFirmware);
 
+    if (module->images != NULL) {
+        for (i = 0; i < module->number_of_channels; i++) {
+            xiaFreeDSPImage(&module->images[i]);
+        }
+
+        handel_md_free(module->images);
+    }
+
+    xiaFreeMapTune(module);
+
     /* Free up any multichannel info that was allocated */
     if (module->isMultiChannel) {
         handel_md_free(module->state->runActive);
@@ -804,6 +814,8 @@ int HANDEL_API xiaFreeModule(Module* module) {
         module->type = NULL;
     }
 
+    xiaFreeModuleLock(module);
+
     handel_md_free(module->alias);
     module->alias = NULL;
 
@@ -827,7 +839,7 @@ int HANDEL_API xiaFreeModule(Module* module) {
  */
 static int HANDEL_API xiaInitDetChanDS(void) {
     DetChanElement* current = NULL;
-    DetChanElement* head = xiaDetChanHead;
+    DetChanElement* head = xiaContext->detChanHead;
 
     current = head;
 
@@ -848,7 +860,7 @@ static int HANDEL_API xiaInitDetChanDS(void) {
         handel_md_free((void*) head);
     }
 
-    xiaDetChanHead = NULL;
+    xiaContext->detChanHead = NULL;
 
     return XIA_SUCCESS;
 }
@@ -860,7 +872,7 @@ static int HANDEL_API xiaInitModuleDS(void) {
     int status;
 
     Module* current = NULL;
-    Module* head = xiaModuleHead;
+    Module* head = xiaContext->moduleHead;
 
     current = head;
 
@@ -875,7 +887,7 @@ static int HANDEL_API xiaInitModuleDS(void) {
         }
     }
 
-    xiaModuleHead = NULL;
+    xiaContext->moduleHead = NULL;
 
     return XIA_SUCCESS;
 }
@@ -888,7 +900,7 @@ static int HANDEL_API xiaUnHook(void) {
 
     char boardType[MAXITEM_LEN];
 
-    DetChanElement* current = xiaDetChanHead;
+    DetChanElement* current = xiaContext->detChanHead;
 
     PSLFuncs localFuncs;
 
@@ -0,0 +1,1198 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_archive.c
+ * @brief A chunked, pixel-indexed file of mapping data, written by
+ * xiaCreateArchive() and read back by xiaOpenArchive().
+ *
+ * Each stream, normally one module, collects its pixel records in a chunk
+ * of its own, so the data of different modules never interleave inside a
+ * chunk. A stream has two chunk buffers: while the caller fills one, a
+ * writer thread appends the other to the file. The caller only waits when
+ * it fills a chunk before the previous one of the same stream is written.
+ *
+ * Everything is written in host byte order, aligned to 8 bytes:
+ *
+ *   header:  "XIAARCH\0", uint32 byte order mark, uint32 version,
+ *            uint32 streams, uint32 chunk size, then for each stream
+ *            int32 detChan, uint32 values, values...
+ *   value:   uint32 length, name without a terminator, double value
+ *   chunk:   uint32 stream, uint32 size, records...
+ *   index:   uint64 file offset of each chunk, then for each stream
+ *            uint64 entries, entries sorted by pixel
+ *   entry:   uint32 pixel, uint32 chunk, uint32 offset, uint32 size
+ *   trailer: uint64 index offset, uint32 chunks, uint32 byte order mark
+ *
+ * The values are the acquisition values of each stream's detChan when the
+ * archive was created. An entry's offset is from the start of the chunk's
+ * records. The reader maps the file and answers a lookup with a binary
+ * search of the stream's index and a pointer into the mapping.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xia_common.h"
+#include "xia_file.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+#include "xia_mapping.h"
+
+#include "handel_errors.h"
+#include "handel_generic.h"
+#include "handel_log.h"
+#include "handel_mapping.h"
+#include "md_threads.h"
+
+#define ARCH_MAGIC "XIAARCH"
+#define ARCH_BOM 0x01020304UL
+#define ARCH_VERSION 1
+#define ARCH_ALIGN 8
+#define ARCH_HEADER_SIZE 24
+#define ARCH_CHUNK_HEADER_SIZE 8
+#define ARCH_TRAILER_SIZE 16
+#define ARCH_DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+
+#define ARCH_PAD(n) (((n) + ARCH_ALIGN - 1) & ~((size_t) ARCH_ALIGN - 1))
+
+typedef struct {
+    uint32_t pixel;
+    uint32_t chunk;
+    uint32_t offset;
+    uint32_t size;
+} ArchiveEntry;
+
+typedef struct {
+    /* Owned by the caller, except a buffer the writer thread has busy. */
+    byte_t* data[2];
+    size_t capacity[2];
+    boolean_t busy[2];
+    int fill;
+    size_t used;
+
+    ArchiveEntry* entries;
+    size_t nEntries;
+    size_t entryCapacity;
+    size_t firstPending; /* first entry whose chunk is not numbered yet */
+
+    handel_md_Event freed;
+} ArchiveStream;
+
+typedef struct {
+    unsigned int stream;
+    int buf;
+    size_t size;
+    uint32_t chunk;
+} ArchiveJob;
+
+struct XiaArchiveWriter {
+    FILE* fp;
+    unsigned int nStreams;
+    size_t chunkSize;
+
+    ArchiveStream* streams;
+
+    /* A ring of chunks to write; each buffer has at most one job. */
+    ArchiveJob* jobs;
+    size_t nJobs;
+    size_t jobHead;
+    size_t jobTail;
+
+    uint32_t nChunks;
+    boolean_t closing;
+    boolean_t failed;
+
+    handel_md_Mutex lock;
+    handel_md_Event work;
+    handel_md_Event stopped;
+    handel_md_Thread thread;
+
+    /* Owned by the writer thread until it stops. */
+    uint64_t* chunkOffsets;
+    size_t chunkCapacity;
+    uint64_t position;
+};
+
+typedef struct {
+    int detChan;
+    uint32_t nValues;
+    const byte_t* values;
+
+    const ArchiveEntry* entries;
+    uint64_t nEntries;
+} ArchiveView;
+
+struct XiaArchive {
+    handel_md_FileMap map;
+
+    unsigned int nStreams;
+    uint32_t nChunks;
+    const uint64_t* chunkOffsets;
+
+    ArchiveView* streams;
+};
+
+static int xiaCheckArchiveStream(const char* fn, XiaArchiveWriter* writer,
+                                 unsigned int stream);
+static int xiaWriteArchiveHeader(XiaArchiveWriter* writer, const int* detChans);
+static int xiaWriteArchiveIndex(XiaArchiveWriter* writer);
+static int xiaArchiveReserve(XiaArchiveWriter* writer, unsigned int stream,
+                             unsigned long pixel, size_t size, byte_t** data);
+static int xiaFlushArchiveStream(XiaArchiveWriter* writer, unsigned int stream);
+static void xiaArchiveThread(void* arg);
+static void xiaFreeArchiveWriter(XiaArchiveWriter* writer);
+static int xiaCompareEntries(const void* a, const void* b);
+static int xiaReadArchiveLayout(XiaArchive* archive);
+
+/*
+ * Creates an archive in filename for nStreams streams and starts its
+ * writer thread. If detChans is not NULL, the acquisition values of
+ * detChans[i] are saved with stream i; a negative detChan saves none.
+ * chunkSize is the number of bytes a stream collects before its chunk is
+ * written, 0 for the default of 4 MB.
+ */
+HANDEL_EXPORT int HANDEL_API xiaCreateArchive(const char* filename,
+                                              unsigned int nStreams,
+                                              const int* detChans, size_t chunkSize,
+                                              XiaArchiveWriter** writer) {
+    int status;
+
+    unsigned int i;
+
+    XiaArchiveWriter* w;
+
+    if (filename == NULL || writer == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaCreateArchive",
+               "filename and writer may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (chunkSize == 0) {
+        chunkSize = ARCH_DEFAULT_CHUNK_SIZE;
+    }
+
+    if (nStreams == 0 || chunkSize > UINT32_MAX) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaCreateArchive",
+               "An archive needs at least one stream and chunks under 4 GB");
+        return XIA_BAD_VALUE;
+    }
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    w = (XiaArchiveWriter*) handel_md_alloc(sizeof(XiaArchiveWriter));
+
+    if (w == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCreateArchive",
+               "Unable to allocate the archive writer");
+        return XIA_NOMEM;
+    }
+
+    memset(w, 0, sizeof(XiaArchiveWriter));
+
+    w->nStreams = nStreams;
+    w->chunkSize = chunkSize;
+    w->nJobs = 2 * (size_t) nStreams;
+    w->streams = (ArchiveStream*) handel_md_alloc(nStreams * sizeof(ArchiveStream));
+    w->jobs = (ArchiveJob*) handel_md_alloc(w->nJobs * sizeof(ArchiveJob));
+
+    if (w->streams != NULL) {
+        memset(w->streams, 0, nStreams * sizeof(ArchiveStream));
+    }
+
+    if (w->streams == NULL || w->jobs == NULL) {
+        xiaFreeArchiveWriter(w);
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCreateArchive",
+               "Unable to allocate %u archive streams", nStreams);
+        return XIA_NOMEM;
+    }
+
+    w->lock.name = "archive";
+    w->work.name = "archive work";
+    w->stopped.name = "archive stopped";
+
+    if (handel_md_mutex_create(&w->lock) != THREADING_NO_ERROR ||
+        handel_md_event_create(&w->work) != THREADING_NO_ERROR ||
+        handel_md_event_create(&w->stopped) != THREADING_NO_ERROR) {
+        xiaFreeArchiveWriter(w);
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaCreateArchive",
+               "Error creating the archive locks");
+        return XIA_THREAD_ERROR;
+    }
+
+    for (i = 0; i < nStreams; i++) {
+        ArchiveStream* s = &w->streams[i];
+
+        s->freed.name = "archive stream";
+
+        if (handel_md_event_create(&s->freed) != THREADING_NO_ERROR) {
+            xiaFreeArchiveWriter(w);
+            xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaCreateArchive",
+                   "Error creating the event for stream %u", i);
+            return XIA_THREAD_ERROR;
+        }
+    }
+
+    w->fp = xia_file_open(filename, "wb");
+
+    if (w->fp == NULL) {
+        xiaFreeArchiveWriter(w);
+        xiaLog(XIA_LOG_ERROR, XIA_OPEN_FILE, "xiaCreateArchive", "Could not open %s",
+               filename);
+        return XIA_OPEN_FILE;
+    }
+
+    status = xiaWriteArchiveHeader(w, detChans);
+
+    if (status != XIA_SUCCESS) {
+        xiaFreeArchiveWriter(w);
+        xiaLog(XIA_LOG_ERROR, status, "xiaCreateArchive",
+               "Error writing the header of archive '%s'", filename);
+        return status;
+    }
+
+    w->thread.state = handel_md_ThreadsDetached;
+    w->thread.name = "archive";
+    w->thread.realtime = FALSE_;
+    w->thread.entryPoint = xiaArchiveThread;
+    w->thread.argument = w;
+
+    if (handel_md_thread_create(&w->thread) != THREADING_NO_ERROR) {
+        xiaFreeArchiveWriter(w);
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaCreateArchive",
+               "Error starting the archive writer thread");
+        return XIA_THREAD_ERROR;
+    }
+
+    *writer = w;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Archives every pixel of an MCA or SCA mapping buffer, as returned by
+ * xiaGetRunData("buffer_a"/"buffer_b"), to a stream. Each pixel block,
+ * pixel header included, is stored as 16-bit words under its pixel
+ * number; the buffer header is not kept.
+ */
+HANDEL_EXPORT int HANDEL_API xiaWriteArchiveBuffer(XiaArchiveWriter* writer,
+                                                   unsigned int stream,
+                                                   const unsigned long* buffer,
+                                                   unsigned long len) {
+    int status;
+
+    unsigned long i;
+    unsigned long k;
+    unsigned long mode;
+    unsigned long nPixels;
+    unsigned long pos = MAP_BUFFER_HEADER_SIZE;
+
+    status = xiaCheckArchiveStream("xiaWriteArchiveBuffer", writer, stream);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    if (buffer == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaWriteArchiveBuffer",
+               "buffer may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (len < MAP_BUFFER_HEADER_SIZE || MAP_WORD(buffer[0]) != MAP_BUFFER_TAG0 ||
+        MAP_WORD(buffer[1]) != MAP_BUFFER_TAG1) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteArchiveBuffer",
+               "Missing mapping buffer header");
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    mode = MAP_WORD(buffer[MAP_BH_MAPPING_MODE]);
+
+    if (mode != MAP_MODE_MCA && mode != MAP_MODE_SCA) {
+        xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN_MAPPING, "xiaWriteArchiveBuffer",
+               "Only MCA and SCA mapping buffers have pixels, not mode %lu", mode);
+        return XIA_UNKNOWN_MAPPING;
+    }
+
+    nPixels = MAP_WORD(buffer[MAP_BH_N_PIXELS]);
+
+    for (i = 0; i < nPixels; i++) {
+        const unsigned long* block = buffer + pos;
+
+        unsigned long blockSize;
+
+        unsigned short* words;
+
+        if (len - pos < MAP_PH_CHANNEL_SIZE || MAP_WORD(block[0]) != MAP_PIXEL_TAG0 ||
+            MAP_WORD(block[1]) != MAP_PIXEL_TAG1) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteArchiveBuffer",
+                   "Missing header for pixel %lu of %lu", i, nPixels);
+            return XIA_MALFORMED_BUFFER;
+        }
+
+        blockSize = MAP_WORD32(block + MAP_PH_BLOCK_SIZE);
+
+        if (blockSize < MAP_PH_CHANNEL_SIZE || blockSize > len - pos) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteArchiveBuffer",
+                   "Pixel %lu of %lu has a bad block size of %lu words", i, nPixels,
+                   blockSize);
+            return XIA_MALFORMED_BUFFER;
+        }
+
+        status = xiaArchiveReserve(writer, stream, MAP_WORD32(block + MAP_PH_PIXEL),
+                                   blockSize * sizeof(unsigned short),
+                                   (byte_t**) &words);
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "xiaWriteArchiveBuffer",
+                   "Error archiving pixel %lu of %lu", i, nPixels);
+            return status;
+        }
+
+        for (k = 0; k < blockSize; k++) {
+            words[k] = (unsigned short) block[k];
+        }
+
+        pos += blockSize;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Archives size bytes of any data for a pixel, such as its decoded
+ * spectra, to a stream.
+ */
+HANDEL_EXPORT int HANDEL_API xiaWriteArchivePixel(XiaArchiveWriter* writer,
+                                                  unsigned int stream,
+                                                  unsigned long pixel,
+                                                  const void* data, size_t size) {
+    int status;
+
+    byte_t* record;
+
+    status = xiaCheckArchiveStream("xiaWriteArchivePixel", writer, stream);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    if (data == NULL && size > 0) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaWriteArchivePixel",
+               "data may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    status = xiaArchiveReserve(writer, stream, pixel, size, &record);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaWriteArchivePixel",
+               "Error archiving pixel %lu", pixel);
+        return status;
+    }
+
+    if (size > 0) {
+        memcpy(record, data, size);
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes the chunks still being filled, waits for the writer thread, adds
+ * the index and closes the archive. The writer is released even if this
+ * fails.
+ */
+HANDEL_EXPORT int HANDEL_API xiaFinishArchive(XiaArchiveWriter* writer) {
+    int status = XIA_SUCCESS;
+
+    unsigned int i;
+
+    if (writer == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaFinishArchive",
+               "writer may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    for (i = 0; i < writer->nStreams; i++) {
+        if (writer->streams[i].used > 0 ||
+            writer->streams[i].firstPending < writer->streams[i].nEntries) {
+            int flushed = xiaFlushArchiveStream(writer, i);
+
+            if (status == XIA_SUCCESS) {
+                status = flushed;
+            }
+        }
+    }
+
+    handel_md_mutex_lock(&writer->lock);
+    writer->closing = TRUE_;
+    handel_md_mutex_unlock(&writer->lock);
+
+    handel_md_event_signal(&writer->work);
+    handel_md_event_wait(&writer->stopped, 0);
+
+    if (status == XIA_SUCCESS && writer->failed) {
+        status = XIA_BAD_FILE_WRITE;
+    }
+
+    if (status == XIA_SUCCESS) {
+        status = xiaWriteArchiveIndex(writer);
+    }
+
+    if (xia_file_close(writer->fp) != 0 && status == XIA_SUCCESS) {
+        status = XIA_BAD_FILE_WRITE;
+    }
+
+    writer->fp = NULL;
+
+    xiaFreeArchiveWriter(writer);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaFinishArchive", "Error writing the archive");
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Maps an archive written by xiaFinishArchive() for reading.
+ */
+HANDEL_EXPORT int HANDEL_API xiaOpenArchive(const char* filename,
+                                            XiaArchive** archive) {
+    int status;
+
+    XiaArchive* a;
+
+    if (filename == NULL || archive == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaOpenArchive",
+               "filename and archive may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    a = (XiaArchive*) handel_md_alloc(sizeof(XiaArchive));
+
+    if (a == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaOpenArchive",
+               "Unable to allocate the archive");
+        return XIA_NOMEM;
+    }
+
+    memset(a, 0, sizeof(XiaArchive));
+
+    if (handel_md_file_map(filename, &a->map) != 0) {
+        handel_md_free(a);
+        xiaLog(XIA_LOG_ERROR, XIA_OPEN_FILE, "xiaOpenArchive", "Could not map %s",
+               filename);
+        return XIA_OPEN_FILE;
+    }
+
+    status = xiaReadArchiveLayout(a);
+
+    if (status != XIA_SUCCESS) {
+        xiaCloseArchive(a);
+        xiaLog(XIA_LOG_ERROR, status, "xiaOpenArchive", "'%s' is not a valid archive",
+               filename);
+        return status;
+    }
+
+    *archive = a;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Finds the record of a pixel in a stream. data points into the mapped
+ * file, aligned to 8 bytes, and stays valid until xiaCloseArchive(). If a
+ * pixel was archived more than once, the first record is returned.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetArchivePixel(XiaArchive* archive,
+                                                unsigned int stream,
+                                                unsigned long pixel,
+                                                const void** data, size_t* size) {
+    const ArchiveView* v;
+    const ArchiveEntry* e;
+
+    uint64_t lo = 0;
+    uint64_t hi;
+    uint64_t start;
+
+    if (archive == NULL || data == NULL || size == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetArchivePixel",
+               "archive, data and size may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (stream >= archive->nStreams) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaGetArchivePixel",
+               "Stream %u is out of range for an archive of %u streams", stream,
+               archive->nStreams);
+        return XIA_BAD_VALUE;
+    }
+
+    v = &archive->streams[stream];
+    hi = v->nEntries;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (v->entries[mid].pixel < pixel) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == v->nEntries || v->entries[lo].pixel != pixel) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOT_FOUND, "xiaGetArchivePixel",
+               "Pixel %lu is not in stream %u", pixel, stream);
+        return XIA_NOT_FOUND;
+    }
+
+    e = &v->entries[lo];
+
+    if (e->chunk >= archive->nChunks) {
+        xiaLog(XIA_LOG_ERROR, XIA_FILE_TYPE, "xiaGetArchivePixel",
+               "Pixel %lu refers to chunk %u of %u", pixel, e->chunk,
+               archive->nChunks);
+        return XIA_FILE_TYPE;
+    }
+
+    start = archive->chunkOffsets[e->chunk] + ARCH_CHUNK_HEADER_SIZE + e->offset;
+
+    if (start > archive->map.size || e->size > archive->map.size - start) {
+        xiaLog(XIA_LOG_ERROR, XIA_FILE_TYPE, "xiaGetArchivePixel",
+               "The record of pixel %lu runs past the end of the archive", pixel);
+        return XIA_FILE_TYPE;
+    }
+
+    *data = (const byte_t*) archive->map.data + start;
+    *size = e->size;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Gets an acquisition value saved with a stream when the archive was
+ * created.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetArchiveValue(XiaArchive* archive,
+                                                unsigned int stream,
+                                                const char* name, double* value) {
+    uint32_t i;
+
+    const byte_t* p;
+
+    size_t nameLen;
+
+    if (archive == NULL || name == NULL || value == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetArchiveValue",
+               "archive, name and value may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (stream >= archive->nStreams) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaGetArchiveValue",
+               "Stream %u is out of range for an archive of %u streams", stream,
+               archive->nStreams);
+        return XIA_BAD_VALUE;
+    }
+
+    nameLen = strlen(name);
+    p = archive->streams[stream].values;
+
+    for (i = 0; i < archive->streams[stream].nValues; i++) {
+        uint32_t len;
+
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+
+        if (len == nameLen && memcmp(p, name, len) == 0) {
+            memcpy(value, p + len, sizeof(double));
+            return XIA_SUCCESS;
+        }
+
+        p += len + sizeof(double);
+    }
+
+    xiaLog(XIA_LOG_ERROR, XIA_NOT_FOUND, "xiaGetArchiveValue",
+           "No value '%s' was saved with stream %u", name, stream);
+    return XIA_NOT_FOUND;
+}
+
+/*
+ * Unmaps an archive opened by xiaOpenArchive().
+ */
+HANDEL_EXPORT int HANDEL_API xiaCloseArchive(XiaArchive* archive) {
+    if (archive == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaCloseArchive",
+               "archive may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    handel_md_file_unmap(&archive->map);
+
+    handel_md_free(archive->streams);
+    handel_md_free(archive);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Checks the writer and stream arguments of an archive routine.
+ */
+static int xiaCheckArchiveStream(const char* fn, XiaArchiveWriter* writer,
+                                 unsigned int stream) {
+    if (writer == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, fn, "writer may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (stream >= writer->nStreams) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, fn,
+               "Stream %u is out of range for an archive of %u streams", stream,
+               writer->nStreams);
+        return XIA_BAD_VALUE;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes the file header and the acquisition values of each stream.
+ */
+static int xiaWriteArchiveHeader(XiaArchiveWriter* writer, const int* detChans) {
+    unsigned int i;
+
+    uint32_t u32[4];
+
+    static const byte_t zeros[ARCH_ALIGN] = {0};
+
+    boolean_t isOk = TRUE_;
+
+    u32[0] = ARCH_BOM;
+    u32[1] = ARCH_VERSION;
+    u32[2] = writer->nStreams;
+    u32[3] = (uint32_t) writer->chunkSize;
+
+    isOk &= fwrite(ARCH_MAGIC, sizeof(ARCH_MAGIC), 1, writer->fp) == 1;
+    isOk &= fwrite(u32, sizeof(u32), 1, writer->fp) == 1;
+    writer->position = ARCH_HEADER_SIZE;
+
+    for (i = 0; i < writer->nStreams; i++) {
+        int32_t detChan = detChans != NULL ? detChans[i] : -1;
+
+        uint32_t nValues = 0;
+
+        XiaDefaults* defaults = NULL;
+        XiaDaqEntry* entry;
+
+        Module* module = NULL;
+
+        if (detChan >= 0) {
+            if (xiaGetElemType((unsigned int) detChan) != SINGLE) {
+                xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaWriteArchiveHeader",
+                       "detChan %d of stream %u is not a single channel",
+                       (int) detChan, i);
+                return XIA_INVALID_DETCHAN;
+            }
+
+            module = xiaLockModule(detChan);
+            defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
+        }
+
+        for (entry = defaults != NULL ? defaults->entry : NULL; entry != NULL;
+             entry = entry->next) {
+            nValues++;
+        }
+
+        isOk &= fwrite(&detChan, sizeof(detChan), 1, writer->fp) == 1;
+        isOk &= fwrite(&nValues, sizeof(nValues), 1, writer->fp) == 1;
+        writer->position += sizeof(detChan) + sizeof(nValues);
+
+        for (entry = defaults != NULL ? defaults->entry : NULL; entry != NULL;
+             entry = entry->next) {
+            uint32_t len = (uint32_t) strlen(entry->name);
+
+            isOk &= fwrite(&len, sizeof(len), 1, writer->fp) == 1;
+            isOk &= fwrite(entry->name, 1, len, writer->fp) == len;
+            isOk &= fwrite(&entry->data, sizeof(entry->data), 1, writer->fp) == 1;
+            writer->position += sizeof(len) + len + sizeof(entry->data);
+        }
+
+        if (module != NULL) {
+            xiaUnlockModule(module);
+        }
+    }
+
+    isOk &= fwrite(zeros, 1, ARCH_PAD(writer->position) - writer->position,
+                   writer->fp) == ARCH_PAD(writer->position) - writer->position;
+    writer->position = ARCH_PAD(writer->position);
+
+    return isOk ? XIA_SUCCESS : XIA_BAD_FILE_WRITE;
+}
+
+/*
+ * Writes the chunk offsets, the sorted index of each stream and the
+ * trailer after the last chunk.
+ */
+static int xiaWriteArchiveIndex(XiaArchiveWriter* writer) {
+    unsigned int i;
+
+    uint64_t indexOffset = writer->position;
+
+    uint32_t trailer[2];
+
+    boolean_t isOk = TRUE_;
+
+    isOk &= fwrite(writer->chunkOffsets, sizeof(uint64_t), writer->nChunks,
+                   writer->fp) == writer->nChunks;
+
+    for (i = 0; i < writer->nStreams; i++) {
+        ArchiveStream* s = &writer->streams[i];
+
+        uint64_t n = s->nEntries;
+
+        size_t k;
+
+        /* Pixels normally arrive in order; only sort when they did not. */
+        for (k = 1; k < s->nEntries; k++) {
+            if (s->entries[k].pixel < s->entries[k - 1].pixel) {
+                qsort(s->entries, s->nEntries, sizeof(ArchiveEntry),
+                      xiaCompareEntries);
+                break;
+            }
+        }
+
+        isOk &= fwrite(&n, sizeof(n), 1, writer->fp) == 1;
+        isOk &= fwrite(s->entries, sizeof(ArchiveEntry), s->nEntries, writer->fp) ==
+                s->nEntries;
+    }
+
+    trailer[0] = writer->nChunks;
+    trailer[1] = ARCH_BOM;
+
+    isOk &= fwrite(&indexOffset, sizeof(indexOffset), 1, writer->fp) == 1;
+    isOk &= fwrite(trailer, sizeof(trailer), 1, writer->fp) == 1;
+
+    return isOk ? XIA_SUCCESS : XIA_BAD_FILE_WRITE;
+}
+
+/*
+ * Makes room for a record of size bytes in the stream's chunk, handing the
+ * chunk to the writer thread first if the record does not fit, and adds
+ * the record to the index. data is set to where the record goes.
+ */
+static int xiaArchiveReserve(XiaArchiveWriter* writer, unsigned int stream,
+                             unsigned long pixel, size_t size, byte_t** data) {
+    int status;
+
+    ArchiveStream* s = &writer->streams[stream];
+
+    size_t start;
+
+    if (size > UINT32_MAX - ARCH_ALIGN) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaArchiveReserve",
+               "A record of %zu bytes is too large", size);
+        return XIA_BAD_VALUE;
+    }
+
+    if (s->used > 0 && ARCH_PAD(s->used) + size > writer->chunkSize) {
+        status = xiaFlushArchiveStream(writer, stream);
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    start = ARCH_PAD(s->used);
+
+    /* A record larger than a chunk gets a chunk of its own. */
+    if (start + size > s->capacity[s->fill]) {
+        size_t capacity = MAX(writer->chunkSize, start + size);
+
+        byte_t* grown = (byte_t*) xiaGrowBlock(s->data[s->fill], s->used, capacity);
+
+        if (grown == NULL) {
+            xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaArchiveReserve",
+                   "Unable to allocate a %zu byte chunk", capacity);
+            return XIA_NOMEM;
+        }
+
+        s->data[s->fill] = grown;
+        s->capacity[s->fill] = capacity;
+    }
+
+    if (s->nEntries == s->entryCapacity) {
+        size_t capacity = s->entryCapacity == 0 ? 1024 : 2 * s->entryCapacity;
+
+        ArchiveEntry* grown = (ArchiveEntry*) xiaGrowBlock(
+            s->entries, s->nEntries * sizeof(ArchiveEntry),
+            capacity * sizeof(ArchiveEntry));
+
+        if (grown == NULL) {
+            xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaArchiveReserve",
+                   "Unable to allocate %zu index entries", capacity);
+            return XIA_NOMEM;
+        }
+
+        s->entries = grown;
+        s->entryCapacity = capacity;
+    }
+
+    /* Zero the padding so the file contents do not depend on old data. */
+    memset(s->data[s->fill] + s->used, 0, start - s->used);
+
+    s->entries[s->nEntries].pixel = (uint32_t) pixel;
+    s->entries[s->nEntries].chunk = UINT32_MAX;
+    s->entries[s->nEntries].offset = (uint32_t) start;
+    s->entries[s->nEntries].size = (uint32_t) size;
+    s->nEntries++;
+
+    s->used = start + size;
+    *data = s->data[s->fill] + start;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Hands the chunk being filled to the writer thread, numbers its records
+ * and switches to the other buffer once the writer is done with it.
+ */
+static int xiaFlushArchiveStream(XiaArchiveWriter* writer, unsigned int stream) {
+    ArchiveStream* s = &writer->streams[stream];
+    ArchiveJob* job;
+
+    size_t i;
+
+    uint32_t chunk;
+
+    boolean_t busy;
+    boolean_t failed;
+
+    handel_md_mutex_lock(&writer->lock);
+
+    chunk = writer->nChunks++;
+    s->busy[s->fill] = TRUE_;
+
+    job = &writer->jobs[writer->jobTail++ % writer->nJobs];
+    job->stream = stream;
+    job->buf = s->fill;
+    job->size = s->used;
+    job->chunk = chunk;
+
+    handel_md_mutex_unlock(&writer->lock);
+
+    handel_md_event_signal(&writer->work);
+
+    for (i = s->firstPending; i < s->nEntries; i++) {
+        s->entries[i].chunk = chunk;
+    }
+
+    s->firstPending = s->nEntries;
+    s->fill ^= 1;
+    s->used = 0;
+
+    for (;;) {
+        handel_md_mutex_lock(&writer->lock);
+        busy = s->busy[s->fill];
+        failed = writer->failed;
+        handel_md_mutex_unlock(&writer->lock);
+
+        if (!busy) {
+            break;
+        }
+
+        handel_md_event_wait(&s->freed, 0);
+    }
+
+    if (failed) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_FILE_WRITE, "xiaFlushArchiveStream",
+               "The archive writer failed to write a chunk");
+        return XIA_BAD_FILE_WRITE;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes the chunks handed over by xiaFlushArchiveStream() in the order
+ * they were numbered, until the writer is closing and none are left.
+ */
+static void xiaArchiveThread(void* arg) {
+    XiaArchiveWriter* w = (XiaArchiveWriter*) arg;
+
+    static const byte_t zeros[ARCH_ALIGN] = {0};
+
+    for (;;) {
+        ArchiveJob job;
+        ArchiveStream* s;
+
+        uint32_t header[2];
+
+        size_t pad;
+
+        boolean_t isOk = TRUE_;
+
+        handel_md_mutex_lock(&w->lock);
+
+        if (w->jobHead == w->jobTail) {
+            boolean_t closing = w->closing;
+
+            handel_md_mutex_unlock(&w->lock);
+
+            if (closing) {
+                break;
+            }
+
+            handel_md_event_wait(&w->work, 0);
+            continue;
+        }
+
+        job = w->jobs[w->jobHead++ % w->nJobs];
+
+        handel_md_mutex_unlock(&w->lock);
+
+        s = &w->streams[job.stream];
+
+        header[0] = job.stream;
+        header[1] = (uint32_t) job.size;
+        pad = ARCH_PAD(job.size) - job.size;
+
+        if (job.chunk >= w->chunkCapacity) {
+            size_t capacity = w->chunkCapacity == 0 ? 256 : 2 * w->chunkCapacity;
+
+            uint64_t* grown = (uint64_t*) xiaGrowBlock(
+                w->chunkOffsets, w->chunkCapacity * sizeof(uint64_t),
+                capacity * sizeof(uint64_t));
+
+            if (grown == NULL) {
+                isOk = FALSE_;
+            } else {
+                w->chunkOffsets = grown;
+                w->chunkCapacity = capacity;
+            }
+        }
+
+        if (isOk) {
+            w->chunkOffsets[job.chunk] = w->position;
+        }
+
+        isOk = isOk && fwrite(header, sizeof(header), 1, w->fp) == 1;
+        isOk = isOk && fwrite(s->data[job.buf], 1, job.size, w->fp) == job.size;
+        isOk = isOk && fwrite(zeros, 1, pad, w->fp) == pad;
+
+        w->position += ARCH_CHUNK_HEADER_SIZE + job.size + pad;
+
+        handel_md_mutex_lock(&w->lock);
+
+        s->busy[job.buf] = FALSE_;
+
+        if (!isOk) {
+            w->failed = TRUE_;
+        }
+
+        handel_md_mutex_unlock(&w->lock);
+
+        handel_md_event_signal(&s->freed);
+    }
+
+    handel_md_event_signal(&w->stopped);
+}
+
+/*
+ * Frees a writer and whatever of its parts were created. The writer
+ * thread must not be running.
+ */
+static void xiaFreeArchiveWriter(XiaArchiveWriter* writer) {
+    unsigned int i;
+
+    if (writer->streams != NULL) {
+        for (i = 0; i < writer->nStreams; i++) {
+            ArchiveStream* s = &writer->streams[i];
+
+            handel_md_free(s->data[0]);
+            handel_md_free(s->data[1]);
+            handel_md_free(s->entries);
+
+            if (handel_md_event_ready(&s->freed)) {
+                handel_md_event_destroy(&s->freed);
+            }
+        }
+    }
+
+    if (writer->fp != NULL) {
+        xia_file_close(writer->fp);
+    }
+
+    if (handel_md_mutex_ready(&writer->lock)) {
+        handel_md_mutex_destroy(&writer->lock);
+    }
+
+    if (handel_md_event_ready(&writer->work)) {
+        handel_md_event_destroy(&writer->work);
+    }
+
+    if (handel_md_event_ready(&writer->stopped)) {
+        handel_md_event_destroy(&writer->stopped);
+    }
+
+    handel_md_free(writer->streams);
+    handel_md_free(writer->jobs);
+    handel_md_free(writer->chunkOffsets);
+    handel_md_free(writer);
+}
+
+/*
+ * Orders index entries by pixel, then by where they were written.
+ */
+static int xiaCompareEntries(const void* a, const void* b) {
+    const ArchiveEntry* x = (const ArchiveEntry*) a;
+    const ArchiveEntry* y = (const ArchiveEntry*) b;
+
+    if (x->pixel != y->pixel) {
+        return x->pixel < y->pixel ? -1 : 1;
+    }
+
+    if (x->chunk != y->chunk) {
+        return x->chunk < y->chunk ? -1 : 1;
+    }
+
+    return x->offset < y->offset ? -1 : (x->offset > y->offset);
+}
+
+/*
+ * Checks the header and trailer of a mapped archive and locates the
+ * values and index of each stream.
+ */
+static int xiaReadArchiveLayout(XiaArchive* archive) {
+    unsigned int i;
+
+    const byte_t* base = (const byte_t*) archive->map.data;
+
+    size_t size = archive->map.size;
+    size_t pos = ARCH_HEADER_SIZE;
+
+    uint32_t u32[4];
+    uint32_t trailer[2];
+    uint64_t indexOffset;
+
+    if (size < ARCH_HEADER_SIZE + ARCH_TRAILER_SIZE ||
+        memcmp(base, ARCH_MAGIC, sizeof(ARCH_MAGIC)) != 0) {
+        return XIA_FILE_TYPE;
+    }
+
+    memcpy(u32, base + sizeof(ARCH_MAGIC), sizeof(u32));
+    memcpy(&indexOffset, base + size - ARCH_TRAILER_SIZE, sizeof(indexOffset));
+    memcpy(trailer, base + size - ARCH_TRAILER_SIZE + sizeof(indexOffset),
+           sizeof(trailer));
+
+    if (u32[0] != ARCH_BOM || u32[1] != ARCH_VERSION || u32[2] == 0 ||
+        trailer[1] != ARCH_BOM) {
+        return XIA_FILE_TYPE;
+    }
+
+    archive->nStreams = u32[2];
+    archive->nChunks = trailer[0];
+    archive->streams =
+        (ArchiveView*) handel_md_alloc(archive->nStreams * sizeof(ArchiveView));
+
+    if (archive->streams == NULL) {
+        return XIA_NOMEM;
+    }
+
+    memset(archive->streams, 0, archive->nStreams * sizeof(ArchiveView));
+
+    for (i = 0; i < archive->nStreams; i++) {
+        ArchiveView* v = &archive->streams[i];
+
+        uint32_t k;
+        int32_t detChan;
+
+        if (size - pos < sizeof(detChan) + sizeof(v->nValues)) {
+            return XIA_FILE_TYPE;
+        }
+
+        memcpy(&detChan, base + pos, sizeof(detChan));
+        memcpy(&v->nValues, base + pos + sizeof(detChan), sizeof(v->nValues));
+        pos += sizeof(detChan) + sizeof(v->nValues);
+
+        v->detChan = detChan;
+        v->values = base + pos;
+
+        for (k = 0; k < v->nValues; k++) {
+            uint32_t len;
+
+            if (size - pos < sizeof(len)) {
+                return XIA_FILE_TYPE;
+            }
+
+            memcpy(&len, base + pos, sizeof(len));
+
+            if (size - pos - sizeof(len) < (size_t) len + sizeof(double)) {
+                return XIA_FILE_TYPE;
+            }
+
+            pos += sizeof(len) + len + sizeof(double);
+        }
+    }
+
+    if (indexOffset % ARCH_ALIGN != 0 || indexOffset < pos ||
+        (size - ARCH_TRAILER_SIZE - indexOffset) / sizeof(uint64_t) <
+            archive->nChunks) {
+        return XIA_FILE_TYPE;
+    }
+
+    archive->chunkOffsets = (const uint64_t*) (base + indexOffset);
+    pos = (size_t) indexOffset + archive->nChunks * sizeof(uint64_t);
+
+    for (i = 0; i < archive->nStreams; i++) {
+        ArchiveView* v = &archive->streams[i];
+
+        if (size - ARCH_TRAILER_SIZE - pos < sizeof(v->nEntries)) {
+            return XIA_FILE_TYPE;
+        }
+
+        memcpy(&v->nEntries, base + pos, sizeof(v->nEntries));
+        pos += sizeof(v->nEntries);
+
+        if ((size - ARCH_TRAILER_SIZE - pos) / sizeof(ArchiveEntry) < v->nEntries) {
+            return XIA_FILE_TYPE;
+        }
+
+        v->entries = (const ArchiveEntry*) (base + pos);
+        pos += (size_t) v->nEntries * sizeof(ArchiveEntry);
+    }
+
+    return XIA_SUCCESS;
+}
@@ -0,0 +1,260 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_context.c
+ * @brief Independent detector systems in one process.
+ *
+ * A context holds everything Handel and Xerxes know about one system:
+ * the detectors, firmware sets, defaults, modules and detChans read from
+ * the .ini file, and the Xerxes boards built from them. Each thread has a
+ * current context, which every other Handel routine uses. Threads start
+ * out on the default context, so programs that never create a context
+ * behave exactly as before.
+ *
+ * Contexts are not fully independent. They share the open device table
+ * in the MD layer, the FDD parser, the file handle list and the Xerxes DSP
+ * cache, each behind its own narrow lock. Everything else a call touches
+ * belongs to the context or to one of its modules, so calls in different
+ * contexts, including xiaInitCtx(), xiaStartSystemCtx() and xiaExitCtx(),
+ * run in parallel.
+ */
+
+#include <stddef.h>
+
+#include "xerxes.h"
+#include "xerxes_errors.h"
+
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+
+#include "handel_constants.h"
+#include "handel_errors.h"
+#include "handel_log.h"
+
+static HandelContext defaultContext = {NULL, NULL, NULL, NULL, NULL, NULL,
+                                       XIA_RUN_DISPATCH_SERIAL, 0.0, {0}};
+
+XIA_THREAD_LOCAL HandelContext* xiaContext = &defaultContext;
+
+static HandelContext* HANDEL_API xiaSwapContext(HandelContext* ctx);
+
+/*
+ * Creates a new, empty context. Select it with xiaContextSelect() or
+ * pass it to the *Ctx routines to configure it.
+ */
+HANDEL_EXPORT int HANDEL_API xiaContextCreate(HandelContext** ctx) {
+    int status;
+
+    if (ctx == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaContextCreate",
+               "ctx cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    *ctx = (HandelContext*) handel_md_alloc(sizeof(HandelContext));
+
+    if (*ctx == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaContextCreate",
+               "Unable to allocate %zu bytes for a new context",
+               sizeof(HandelContext));
+        return XIA_NOMEM;
+    }
+
+    (*ctx)->detectorHead = NULL;
+    (*ctx)->firmwareSetHead = NULL;
+    (*ctx)->defaultsHead = NULL;
+    (*ctx)->detChanHead = NULL;
+    (*ctx)->moduleHead = NULL;
+    (*ctx)->runDispatch = XIA_RUN_DISPATCH_SERIAL;
+    (*ctx)->runStartSkew = 0.0;
+    handel_md_cancel_init(&(*ctx)->cancel);
+    (*ctx)->requests.lock.handle = NULL;
+
+    status = xiaInitRequests(*ctx);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaContextCreate",
+               "Error creating the request group");
+        handel_md_free(*ctx);
+        *ctx = NULL;
+        return status;
+    }
+
+    status = dxp_create_context(&(*ctx)->xerxes);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaContextCreate",
+               "Error creating the Xerxes context");
+        xiaFreeRequests(*ctx);
+        handel_md_free(*ctx);
+        *ctx = NULL;
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Shuts down the system in ctx, as xiaExit() would, and frees it. No
+ * thread may use ctx afterwards. The calling thread goes back to the
+ * default context if ctx was its current context.
+ */
+HANDEL_EXPORT int HANDEL_API xiaContextDestroy(HandelContext* ctx) {
+    int status;
+
+    if (ctx == NULL || ctx == &defaultContext) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaContextDestroy",
+               "The default context cannot be destroyed");
+        return XIA_BAD_VALUE;
+    }
+
+    status = xiaExitCtx(ctx);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaContextDestroy",
+               "Error shutting down the context");
+        return status;
+    }
+
+    if (xiaContext == ctx) {
+        xiaContextSelect(NULL);
+    }
+
+    xiaFreeRequests(ctx);
+
+    status = dxp_free_context(ctx->xerxes);
+
+    handel_md_free(ctx);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaContextDestroy",
+               "Error freeing the Xerxes context");
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Prepares the default context. Called once from xiaInitHandel().
+ */
+int HANDEL_API xiaInitDefaultContext(void) {
+    return xiaInitRequests(&defaultContext);
+}
+
+/*
+ * Makes ctx the context for all following Handel calls from the calling
+ * thread. A NULL ctx selects the default context.
+ */
+HANDEL_EXPORT int HANDEL_API xiaContextSelect(HandelContext* ctx) {
+    xiaSwapContext(ctx == NULL ? &defaultContext : ctx);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * xiaInit() for ctx, without changing the calling thread's context.
+ */
+HANDEL_EXPORT int HANDEL_API xiaInitCtx(HandelContext* ctx, char* iniFile) {
+    int status;
+
+    HandelContext* previous = NULL;
+
+    if (ctx == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaInitCtx", "ctx cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    previous = xiaSwapContext(ctx);
+
+    status = xiaInit(iniFile);
+
+    xiaSwapContext(previous);
+
+    return status;
+}
+
+/*
+ * xiaStartSystem() for ctx, without changing the calling thread's
+ * context.
+ */
+HANDEL_EXPORT int HANDEL_API xiaStartSystemCtx(HandelContext* ctx) {
+    int status;
+
+    HandelContext* previous = NULL;
+
+    if (ctx == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaStartSystemCtx",
+               "ctx cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    previous = xiaSwapContext(ctx);
+
+    status = xiaStartSystem();
+
+    xiaSwapContext(previous);
+
+    return status;
+}
+
+/*
+ * xiaExit() for ctx, without changing the calling thread's context.
+ * Only the modules in ctx are disconnected, once the requests queued in
+ * ctx have run.
+ */
+HANDEL_EXPORT int HANDEL_API xiaExitCtx(HandelContext* ctx) {
+    int status;
+
+    HandelContext* previous = NULL;
+
+    if (ctx == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaExitCtx", "ctx cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    previous = xiaSwapContext(ctx);
+
+    status = xiaExit();
+
+    xiaSwapContext(previous);
+
+    return status;
+}
+
+/*
+ * Selects ctx for the calling thread, in both Handel and Xerxes, and
+ * returns the context it replaces.
+ */
+static HandelContext* HANDEL_API xiaSwapContext(HandelContext* ctx) {
+    HandelContext* previous = xiaContext;
+
+    xiaContext = ctx;
+    dxp_select_context(ctx->xerxes);
+
+    return previous;
+}
@@ -0,0 +1,1085 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_cube.c
+ * @brief A file-backed spectrum cube that MCA mapping buffers are decoded
+ * into, created by xiaCreateCube() and reopened by xiaOpenCube().
+ *
+ * A map of many pixels with a full spectrum per channel can be far larger
+ * than memory, so the cube lives in a file mapped into the address space
+ * and the operating system pages it in and out. The file is extended
+ * without being written, so tiles no pixel has reached take no disk space
+ * where the file system supports sparse files.
+ *
+ * Pixel p of the run is at x = p % width, y = p / width. The counts are
+ * uint32, stored in tiles of CUBE_TILE_WIDTH x CUBE_TILE_HEIGHT pixels of
+ * one channel by CUBE_TILE_BINS bins:
+ *
+ *   header:  "XIACUBE\0", uint32 byte order mark, uint32 version,
+ *            uint32 width, height, channels, bins, tile width, tile
+ *            height, tile bins, uint32 reserved, uint64 data offset,
+ *            uint64 statistics offset
+ *   tiles:   tile (tx, ty) of channel c, bins [k * tile bins, ...) at
+ *            index ((ty * tiles across + tx) * channels + c) * bin tiles + k
+ *   tile:    counts[py][px][bin]
+ *   stats:   uint32 realtime, livetime, triggers, events of each channel
+ *            of each pixel, [y][x][channel][4]
+ *
+ * A spectrum is a short contiguous run in each of its bin tiles, and an
+ * image of a bin range reads only the tiles of those bins, so neither kind
+ * of read walks the whole file.
+ *
+ * xiaIndexCube() adds an index for region sums kept in memory: the summed
+ * spectrum and statistics of each square of index tile pixels, held in a
+ * two-dimensional Fenwick tree. xiaWriteCubeBuffer() collects the change
+ * to each square a buffer touches and adds it to the tree once per buffer.
+ * A region's sum is then four prefix queries for the squares inside it,
+ * plus the pixels of the partial squares along its edges, so the cost
+ * follows the region's perimeter rather than its area.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_mapping.h"
+
+#include "handel_errors.h"
+#include "handel_generic.h"
+#include "handel_log.h"
+#include "handel_mapping.h"
+#include "md_threads.h"
+
+#define CUBE_MAGIC "XIACUBE"
+#define CUBE_BOM 0x01020304UL
+#define CUBE_VERSION 2
+#define CUBE_DATA_OFFSET 4096
+#define CUBE_TILE_WIDTH 8
+#define CUBE_TILE_HEIGHT 8
+#define CUBE_TILE_BINS 64
+#define CUBE_N_STATS 4
+#define CUBE_DEFAULT_INDEX_TILE 16
+
+#define CUBE_CEIL(n, d) (((n) + (d) - 1) / (d))
+
+typedef struct {
+    char magic[8];
+    uint32_t bom;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t nChannels;
+    uint32_t nBins;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t tileBins;
+    uint32_t reserved;
+    uint64_t dataOffset;
+    uint64_t statsOffset;
+} CubeHeader;
+
+typedef struct {
+    unsigned long tile; /* pixels along each side of a square */
+    size_t across;
+    size_t down;
+    size_t chStride; /* sums per channel: bins then statistics */
+    size_t stride;   /* sums per square, all channels */
+
+    /* Node (i, j) covers squares as a Fenwick tree does, 0-based. */
+    uint64_t* tree;
+
+    handel_md_Mutex lock;
+} CubeIndex;
+
+struct XiaCube {
+    handel_md_FileMap map;
+
+    unsigned long width;
+    unsigned long height;
+    unsigned int nChannels;
+    unsigned int nBins;
+
+    size_t tilesAcross;
+    size_t binTiles;
+    size_t tileSize; /* counts per tile */
+
+    uint32_t* counts;
+    uint32_t* stats;
+
+    CubeIndex* index;
+};
+
+static double xiaCubeFileSize(const CubeHeader* header, uint64_t* statsOffset);
+static int xiaSetCubeLayout(XiaCube* cube, const CubeHeader* header);
+static void xiaFreeCubeIndex(CubeIndex* index);
+static void xiaAddSums(uint64_t* dst, const uint64_t* src, size_t n);
+static void xiaAddCubeIndex(CubeIndex* index, size_t sx, size_t sy,
+                            const uint64_t* delta, size_t first, size_t n);
+static void xiaQueryCubeIndex(const CubeIndex* index, size_t sx, size_t sy,
+                              unsigned int channel, boolean_t subtract,
+                              uint64_t* sums);
+static void xiaAddCubePixels(const XiaCube* cube, unsigned int channel,
+                             unsigned long x0, unsigned long x1, unsigned long y,
+                             uint64_t* sums);
+static uint32_t* xiaCubeTile(const XiaCube* cube, unsigned long x, unsigned long y,
+                             unsigned int channel, size_t binTile);
+
+/*
+ * Creates a cube file of width x height pixels, each with nChannels
+ * spectra of nBins bins, replacing any existing file. The counts all
+ * start at zero.
+ */
+HANDEL_EXPORT int HANDEL_API xiaCreateCube(const char* filename, unsigned long width,
+                                           unsigned long height, unsigned int nChannels,
+                                           unsigned int nBins, XiaCube** cube) {
+    int status;
+
+    double total;
+
+    CubeHeader header;
+
+    XiaCube* c;
+
+    if (filename == NULL || cube == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaCreateCube",
+               "filename and cube may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (width == 0 || height == 0 || nChannels == 0 || nBins == 0 ||
+        width > 0xFFFFFFFFUL || height > 0xFFFFFFFFUL) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaCreateCube",
+               "Invalid cube of %lu x %lu pixels, %u channels and %u bins", width,
+               height, nChannels, nBins);
+        return XIA_BAD_VALUE;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CUBE_MAGIC, sizeof(CUBE_MAGIC));
+    header.bom = CUBE_BOM;
+    header.version = CUBE_VERSION;
+    header.width = (uint32_t) width;
+    header.height = (uint32_t) height;
+    header.nChannels = nChannels;
+    header.nBins = nBins;
+    header.tileWidth = CUBE_TILE_WIDTH;
+    header.tileHeight = CUBE_TILE_HEIGHT;
+    header.tileBins = CUBE_TILE_BINS;
+    header.dataOffset = CUBE_DATA_OFFSET;
+
+    total = xiaCubeFileSize(&header, &header.statsOffset);
+
+    if (total > (double) ((size_t) -1)) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaCreateCube",
+               "A cube of %.0f bytes does not fit in the address space", total);
+        return XIA_BAD_VALUE;
+    }
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    c = (XiaCube*) handel_md_alloc(sizeof(XiaCube));
+
+    if (c == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCreateCube",
+               "Unable to allocate the cube");
+        return XIA_NOMEM;
+    }
+
+    memset(c, 0, sizeof(XiaCube));
+
+    /* Start from an empty file so old counts do not show through. */
+    remove(filename);
+
+    if (handel_md_file_map_write(filename, (size_t) total, &c->map) != 0) {
+        handel_md_free(c);
+        xiaLog(XIA_LOG_ERROR, XIA_OPEN_FILE, "xiaCreateCube",
+               "Could not create %s with %.0f bytes", filename, total);
+        return XIA_OPEN_FILE;
+    }
+
+    memcpy(c->map.data, &header, sizeof(header));
+
+    status = xiaSetCubeLayout(c, &header);
+
+    if (status != XIA_SUCCESS) {
+        xiaCloseCube(c);
+        xiaLog(XIA_LOG_ERROR, status, "xiaCreateCube", "Error laying out %s",
+               filename);
+        return status;
+    }
+
+    *cube = c;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Opens an existing cube file for reading and further writing.
+ */
+HANDEL_EXPORT int HANDEL_API xiaOpenCube(const char* filename, XiaCube** cube) {
+    int status;
+
+    CubeHeader header;
+
+    XiaCube* c;
+
+    if (filename == NULL || cube == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaOpenCube",
+               "filename and cube may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    c = (XiaCube*) handel_md_alloc(sizeof(XiaCube));
+
+    if (c == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaOpenCube", "Unable to allocate the cube");
+        return XIA_NOMEM;
+    }
+
+    memset(c, 0, sizeof(XiaCube));
+
+    if (handel_md_file_map_write(filename, 0, &c->map) != 0) {
+        handel_md_free(c);
+        xiaLog(XIA_LOG_ERROR, XIA_OPEN_FILE, "xiaOpenCube", "Could not map %s",
+               filename);
+        return XIA_OPEN_FILE;
+    }
+
+    if (c->map.size < sizeof(header)) {
+        status = XIA_FILE_TYPE;
+    } else {
+        memcpy(&header, c->map.data, sizeof(header));
+        status = xiaSetCubeLayout(c, &header);
+    }
+
+    if (status != XIA_SUCCESS) {
+        xiaCloseCube(c);
+        xiaLog(XIA_LOG_ERROR, status, "xiaOpenCube", "'%s' is not a valid cube",
+               filename);
+        return status;
+    }
+
+    *cube = c;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Decodes an MCA mapping buffer into the cube, with the statistics of
+ * each pixel. The buffer's channels are stored as channels firstChannel
+ * onwards, so the buffers of several modules can share a cube; threads
+ * writing different channels or pixels do not need a lock. A channel's
+ * spectrum may be shorter than the cube's bins, which leaves the rest
+ * zero. If the cube is indexed, the index is updated to match.
+ */
+HANDEL_EXPORT int HANDEL_API xiaWriteCubeBuffer(XiaCube* cube,
+                                                unsigned int firstChannel,
+                                                const unsigned long* buffer,
+                                                unsigned long len) {
+    int status = XIA_SUCCESS;
+
+    unsigned int c;
+    unsigned int nPresent = 0;
+    unsigned int present[MAP_MAX_CHANNELS];
+    unsigned int sizes[MAP_MAX_CHANNELS];
+
+    unsigned long i;
+    unsigned long nPixels;
+    unsigned long blockSize = MAP_MCA_PIXEL_HEADER_SIZE;
+
+    const unsigned long* block;
+
+    /* The change to each index square the buffer touches. */
+    size_t k;
+    size_t slot = 0;
+    size_t nSquares = 0;
+    size_t squareCapacity = 0;
+    size_t chStride;
+    size_t* squares = NULL;
+    uint64_t* deltas = NULL;
+
+    if (cube == NULL || buffer == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaWriteCubeBuffer",
+               "cube and buffer may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    chStride = (size_t) cube->nBins + CUBE_N_STATS;
+
+    if (len < MAP_BUFFER_HEADER_SIZE || MAP_WORD(buffer[0]) != MAP_BUFFER_TAG0 ||
+        MAP_WORD(buffer[1]) != MAP_BUFFER_TAG1) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteCubeBuffer",
+               "Missing mapping buffer header");
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    if (MAP_WORD(buffer[MAP_BH_MAPPING_MODE]) != MAP_MODE_MCA) {
+        xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN_MAPPING, "xiaWriteCubeBuffer",
+               "Only MCA mapping buffers have spectra, not mode %lu",
+               MAP_WORD(buffer[MAP_BH_MAPPING_MODE]));
+        return XIA_UNKNOWN_MAPPING;
+    }
+
+    nPixels = MAP_WORD(buffer[MAP_BH_N_PIXELS]);
+    block = buffer + MAP_BUFFER_HEADER_SIZE;
+
+    if (nPixels == 0) {
+        return XIA_SUCCESS;
+    }
+
+    if (len < MAP_BUFFER_HEADER_SIZE + MAP_MCA_PIXEL_HEADER_SIZE) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteCubeBuffer",
+               "Buffer length %lu is too short for %lu pixels", len, nPixels);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    /* Every pixel of a run has the same layout; take it from the first. */
+    for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+        unsigned int size = (unsigned int) MAP_WORD(block[MAP_PH_CHANNEL_SIZE + c]);
+
+        if (size == 0) {
+            continue;
+        }
+
+        if (firstChannel + nPresent >= cube->nChannels || size > cube->nBins) {
+            xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaWriteCubeBuffer",
+                   "Channel %u of %u bins does not fit a cube of %u channels and "
+                   "%u bins",
+                   firstChannel + nPresent, size, cube->nChannels, cube->nBins);
+            return XIA_BAD_VALUE;
+        }
+
+        present[nPresent] = c;
+        sizes[nPresent++] = size;
+        blockSize += size;
+    }
+
+    if ((len - MAP_BUFFER_HEADER_SIZE) / blockSize < nPixels) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteCubeBuffer",
+               "Buffer length %lu is too short for %lu pixels of %lu words", len,
+               nPixels, blockSize);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    for (i = 0; i < nPixels; i++, block += blockSize) {
+        const unsigned long* spectrum = block + MAP_MCA_PIXEL_HEADER_SIZE;
+
+        unsigned long pixel;
+        unsigned long x;
+        unsigned long y;
+
+        uint32_t* stats;
+
+        uint64_t* delta = NULL;
+
+        if (MAP_WORD(block[0]) != MAP_PIXEL_TAG0 ||
+            MAP_WORD(block[1]) != MAP_PIXEL_TAG1 ||
+            MAP_WORD32(block + MAP_PH_BLOCK_SIZE) != blockSize) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaWriteCubeBuffer",
+                   "Invalid header for pixel %lu of the buffer", i);
+            status = XIA_MALFORMED_BUFFER;
+            break;
+        }
+
+        pixel = MAP_WORD32(block + MAP_PH_PIXEL);
+        x = pixel % cube->width;
+        y = pixel / cube->width;
+
+        if (y >= cube->height) {
+            xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaWriteCubeBuffer",
+                   "Pixel %lu is past the end of a %lu x %lu cube", pixel, cube->width,
+                   cube->height);
+            status = XIA_BAD_VALUE;
+            break;
+        }
+
+        if (cube->index != NULL) {
+            size_t square = (y / cube->index->tile) * cube->index->across +
+                            x / cube->index->tile;
+
+            /* Pixels arrive in order, so the square is nearly always the last. */
+            if (nSquares == 0 || squares[slot] != square) {
+                for (slot = 0; slot < nSquares && squares[slot] != square; slot++) {
+                }
+            }
+
+            if (slot == nSquares) {
+                if (nSquares == squareCapacity) {
+                    size_t capacity = squareCapacity == 0 ? 8 : squareCapacity * 2;
+
+                    size_t* moreSquares = (size_t*) xiaGrowBlock(
+                        squares, nSquares * sizeof(size_t), capacity * sizeof(size_t));
+                    uint64_t* moreDeltas = NULL;
+
+                    if (moreSquares != NULL) {
+                        squares = moreSquares;
+                        moreDeltas = (uint64_t*) xiaGrowBlock(
+                            deltas, nSquares * nPresent * chStride * sizeof(uint64_t),
+                            capacity * nPresent * chStride * sizeof(uint64_t));
+                    }
+
+                    if (moreDeltas == NULL) {
+                        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaWriteCubeBuffer",
+                               "Unable to allocate the index changes for %lu squares",
+                               (unsigned long) capacity);
+                        status = XIA_NOMEM;
+                        break;
+                    }
+
+                    deltas = moreDeltas;
+                    squareCapacity = capacity;
+                }
+
+                squares[nSquares] = square;
+                memset(deltas + nSquares * nPresent * chStride, 0,
+                       nPresent * chStride * sizeof(uint64_t));
+                nSquares++;
+            }
+
+            delta = deltas + slot * nPresent * chStride;
+        }
+
+        stats = cube->stats +
+                ((size_t) y * cube->width + x) * cube->nChannels * CUBE_N_STATS;
+
+        /*
+         * The index takes the difference from what the pixel held before;
+         * unsigned arithmetic wraps, so the sums stay exact.
+         */
+        for (c = 0; c < nPresent; c++) {
+            const unsigned long* words =
+                block + MAP_PH_STATS + present[c] * MAP_PH_STATS_PER_CHANNEL;
+
+            uint32_t* pixelStats = stats + (size_t) (firstChannel + c) * CUBE_N_STATS;
+
+            uint64_t* d = delta != NULL ? delta + c * chStride : NULL;
+
+            unsigned int b;
+
+            for (b = 0; b < sizes[c]; b += CUBE_TILE_BINS) {
+                unsigned int n = MIN(CUBE_TILE_BINS, sizes[c] - b);
+
+                uint32_t* tile = xiaCubeTile(cube, x, y, firstChannel + c,
+                                             b / CUBE_TILE_BINS);
+
+                if (d != NULL) {
+                    for (k = 0; k < n; k++) {
+                        d[b + k] -= tile[k];
+                    }
+                }
+
+                xiaUnpackWords(spectrum + b, (unsigned int*) tile, n);
+
+                if (d != NULL) {
+                    for (k = 0; k < n; k++) {
+                        d[b + k] += tile[k];
+                    }
+                }
+            }
+
+            spectrum += sizes[c];
+
+            for (k = 0; k < CUBE_N_STATS; k++) {
+                uint32_t value = (uint32_t) MAP_WORD32(words + 2 * k);
+
+                if (d != NULL) {
+                    d[cube->nBins + k] += (uint64_t) value - pixelStats[k];
+                }
+
+                pixelStats[k] = value;
+            }
+        }
+    }
+
+    /* Pixels written before an error still go into the index. */
+    if (nSquares > 0) {
+        handel_md_mutex_lock(&cube->index->lock);
+
+        for (slot = 0; slot < nSquares; slot++) {
+            xiaAddCubeIndex(cube->index, squares[slot] % cube->index->across,
+                            squares[slot] / cube->index->across,
+                            deltas + slot * nPresent * chStride,
+                            (size_t) firstChannel * chStride, nPresent * chStride);
+        }
+
+        handel_md_mutex_unlock(&cube->index->lock);
+    }
+
+    handel_md_free(squares);
+    handel_md_free(deltas);
+
+    return status;
+}
+
+/*
+ * Reads the nBins bins of the spectrum of one channel at pixel (x, y).
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetCubeSpectrum(XiaCube* cube, unsigned long x,
+                                                unsigned long y, unsigned int channel,
+                                                unsigned int* spectrum) {
+    unsigned int b;
+
+    if (cube == NULL || spectrum == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetCubeSpectrum",
+               "cube and spectrum may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (x >= cube->width || y >= cube->height || channel >= cube->nChannels) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaGetCubeSpectrum",
+               "Pixel (%lu, %lu) channel %u is outside a %lu x %lu cube of %u "
+               "channels",
+               x, y, channel, cube->width, cube->height, cube->nChannels);
+        return XIA_BAD_VALUE;
+    }
+
+    for (b = 0; b < cube->nBins; b += CUBE_TILE_BINS) {
+        memcpy(spectrum + b, xiaCubeTile(cube, x, y, channel, b / CUBE_TILE_BINS),
+               MIN(CUBE_TILE_BINS, cube->nBins - b) * sizeof(uint32_t));
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Sums bins [firstBin, firstBin + nBins) of one channel at every pixel
+ * into a width x height image, row by row.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetCubeImage(XiaCube* cube, unsigned int channel,
+                                             unsigned int firstBin, unsigned int nBins,
+                                             uint64_t* image) {
+    size_t k;
+    size_t tx;
+    size_t ty;
+    size_t tilesDown;
+
+    if (cube == NULL || image == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetCubeImage",
+               "cube and image may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (channel >= cube->nChannels || nBins == 0 || firstBin >= cube->nBins ||
+        nBins > cube->nBins - firstBin) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaGetCubeImage",
+               "Channel %u, bins %u to %u are outside a cube of %u channels and %u "
+               "bins",
+               channel, firstBin, firstBin + nBins, cube->nChannels, cube->nBins);
+        return XIA_BAD_VALUE;
+    }
+
+    memset(image, 0, (size_t) cube->width * cube->height * sizeof(uint64_t));
+
+    tilesDown = CUBE_CEIL(cube->height, CUBE_TILE_HEIGHT);
+
+    /* Tile by tile so each tile is paged in once for all of its pixels. */
+    for (ty = 0; ty < tilesDown; ty++) {
+        for (tx = 0; tx < cube->tilesAcross; tx++) {
+            unsigned long x0 = (unsigned long) (tx * CUBE_TILE_WIDTH);
+            unsigned long y0 = (unsigned long) (ty * CUBE_TILE_HEIGHT);
+            unsigned long w = MIN(CUBE_TILE_WIDTH, cube->width - x0);
+            unsigned long h = MIN(CUBE_TILE_HEIGHT, cube->height - y0);
+
+            for (k = firstBin / CUBE_TILE_BINS;
+                 k <= (firstBin + nBins - 1) / CUBE_TILE_BINS; k++) {
+                const uint32_t* tile = xiaCubeTile(cube, x0, y0, channel, k);
+
+                unsigned int lo = (unsigned int) MAX(firstBin, k * CUBE_TILE_BINS);
+                unsigned int hi = (unsigned int) MIN(firstBin + nBins,
+                                                     (k + 1) * CUBE_TILE_BINS);
+                unsigned long px;
+                unsigned long py;
+
+                lo -= (unsigned int) (k * CUBE_TILE_BINS);
+                hi -= (unsigned int) (k * CUBE_TILE_BINS);
+
+                for (py = 0; py < h; py++) {
+                    uint64_t* row = image + (y0 + py) * cube->width + x0;
+
+                    for (px = 0; px < w; px++) {
+                        const uint32_t* bins =
+                            tile + (py * CUBE_TILE_WIDTH + px) * CUBE_TILE_BINS;
+
+                        uint64_t sum = 0;
+                        unsigned int b;
+
+                        for (b = lo; b < hi; b++) {
+                            sum += bins[b];
+                        }
+
+                        row[px] += sum;
+                    }
+                }
+            }
+        }
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Builds an index of the cube for xiaGetCubeRegion() from the counts it
+ * already holds, summing squares of tile x tile pixels, or 16 x 16 if tile
+ * is 0. xiaWriteCubeBuffer() keeps the index up to date from then on. The
+ * index is held in memory, 8 bytes for each bin and statistic of each
+ * channel of each square, so larger squares trade edge work in queries
+ * for less memory. Indexing again replaces the index; no other thread may
+ * use the cube meanwhile.
+ */
+HANDEL_EXPORT int HANDEL_API xiaIndexCube(XiaCube* cube, unsigned int tile) {
+    size_t i;
+    size_t j;
+    size_t sx;
+    size_t chStride;
+
+    unsigned int c;
+
+    unsigned long y;
+
+    double size;
+
+    CubeIndex* index;
+
+    if (cube == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaIndexCube", "cube may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (tile == 0) {
+        tile = CUBE_DEFAULT_INDEX_TILE;
+    }
+
+    xiaFreeCubeIndex(cube->index);
+    cube->index = NULL;
+
+    index = (CubeIndex*) handel_md_alloc(sizeof(CubeIndex));
+
+    if (index == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaIndexCube",
+               "Unable to allocate the cube index");
+        return XIA_NOMEM;
+    }
+
+    memset(index, 0, sizeof(CubeIndex));
+
+    chStride = (size_t) cube->nBins + CUBE_N_STATS;
+
+    index->tile = tile;
+    index->across = CUBE_CEIL((size_t) cube->width, tile);
+    index->down = CUBE_CEIL((size_t) cube->height, tile);
+    index->chStride = chStride;
+    index->stride = cube->nChannels * chStride;
+
+    size = (double) index->across * index->down * index->stride * sizeof(uint64_t);
+
+    if (size <= (double) ((size_t) -1)) {
+        index->tree = (uint64_t*) handel_md_alloc((size_t) size);
+    }
+
+    if (index->tree == NULL) {
+        handel_md_free(index);
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaIndexCube",
+               "Unable to allocate %.0f bytes to index squares of %u x %u pixels",
+               size, tile, tile);
+        return XIA_NOMEM;
+    }
+
+    memset(index->tree, 0, (size_t) size);
+
+    index->lock.name = "cube index";
+
+    if (handel_md_mutex_create(&index->lock) != THREADING_NO_ERROR) {
+        xiaFreeCubeIndex(index);
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaIndexCube",
+               "Error creating the cube index lock");
+        return XIA_THREAD_ERROR;
+    }
+
+    /* Sum each square, then turn the sums into a Fenwick tree in place. */
+    for (y = 0; y < cube->height; y++) {
+        for (sx = 0; sx < index->across; sx++) {
+            uint64_t* node =
+                index->tree + ((y / tile) * index->across + sx) * index->stride;
+
+            unsigned long x0 = (unsigned long) (sx * tile);
+
+            for (c = 0; c < cube->nChannels; c++) {
+                xiaAddCubePixels(cube, c, x0, MIN(x0 + tile, cube->width), y,
+                                 node + c * chStride);
+            }
+        }
+    }
+
+    for (j = 0; j < index->down; j++) {
+        uint64_t* row = index->tree + j * index->across * index->stride;
+
+        for (i = 1; i <= index->across; i++) {
+            size_t parent = i + (i & (~i + 1));
+
+            if (parent <= index->across) {
+                xiaAddSums(row + (parent - 1) * index->stride,
+                           row + (i - 1) * index->stride, index->stride);
+            }
+        }
+    }
+
+    for (i = 0; i < index->across; i++) {
+        uint64_t* column = index->tree + i * index->stride;
+
+        for (j = 1; j <= index->down; j++) {
+            size_t parent = j + (j & (~j + 1));
+
+            if (parent <= index->down) {
+                xiaAddSums(column + (parent - 1) * index->across * index->stride,
+                           column + (j - 1) * index->across * index->stride,
+                           index->stride);
+            }
+        }
+    }
+
+    cube->index = index;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Sums the spectra and statistics of one channel over the width x height
+ * pixels from (x, y). spectrum receives the cube's nBins sums. With an
+ * index from xiaIndexCube() the cost depends on the region's perimeter;
+ * without one, every pixel of the region is read.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetCubeRegion(XiaCube* cube, unsigned int channel,
+                                              unsigned long x, unsigned long y,
+                                              unsigned long width, unsigned long height,
+                                              uint64_t* spectrum,
+                                              XiaRegionStats* stats) {
+    unsigned long row;
+    unsigned long inner0 = 0;
+    unsigned long inner1 = 0;
+    unsigned long innerTop = 0;
+    unsigned long innerBottom = 0;
+
+    unsigned int b;
+
+    uint64_t* sums;
+
+    if (cube == NULL || spectrum == NULL || stats == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetCubeRegion",
+               "cube, spectrum and stats may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (channel >= cube->nChannels || width == 0 || height == 0 ||
+        x >= cube->width || width > cube->width - x || y >= cube->height ||
+        height > cube->height - y) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaGetCubeRegion",
+               "Channel %u, %lu x %lu pixels from (%lu, %lu) are outside a %lu x %lu "
+               "cube of %u channels",
+               channel, width, height, x, y, cube->width, cube->height,
+               cube->nChannels);
+        return XIA_BAD_VALUE;
+    }
+
+    sums = (uint64_t*) handel_md_alloc(((size_t) cube->nBins + CUBE_N_STATS) *
+                                       sizeof(uint64_t));
+
+    if (sums == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaGetCubeRegion",
+               "Unable to allocate the region sums");
+        return XIA_NOMEM;
+    }
+
+    memset(sums, 0, ((size_t) cube->nBins + CUBE_N_STATS) * sizeof(uint64_t));
+
+    /* The squares wholly inside the region come from the index. */
+    if (cube->index != NULL) {
+        CubeIndex* index = cube->index;
+
+        size_t sx0 = CUBE_CEIL((size_t) x, index->tile);
+        size_t sx1 = (x + width) / index->tile;
+        size_t sy0 = CUBE_CEIL((size_t) y, index->tile);
+        size_t sy1 = (y + height) / index->tile;
+
+        if (sx0 < sx1 && sy0 < sy1) {
+            handel_md_mutex_lock(&index->lock);
+
+            xiaQueryCubeIndex(index, sx1, sy1, channel, FALSE_, sums);
+            xiaQueryCubeIndex(index, sx0, sy0, channel, FALSE_, sums);
+            xiaQueryCubeIndex(index, sx0, sy1, channel, TRUE_, sums);
+            xiaQueryCubeIndex(index, sx1, sy0, channel, TRUE_, sums);
+
+            handel_md_mutex_unlock(&index->lock);
+
+            inner0 = (unsigned long) (sx0 * index->tile);
+            inner1 = (unsigned long) (sx1 * index->tile);
+            innerTop = (unsigned long) (sy0 * index->tile);
+            innerBottom = (unsigned long) (sy1 * index->tile);
+        }
+    }
+
+    for (row = y; row < y + height; row++) {
+        if (row >= innerTop && row < innerBottom) {
+            xiaAddCubePixels(cube, channel, x, inner0, row, sums);
+            xiaAddCubePixels(cube, channel, inner1, x + width, row, sums);
+        } else {
+            xiaAddCubePixels(cube, channel, x, x + width, row, sums);
+        }
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    stats->nPixels = width * height;
+
+    for (b = 0; b < cube->nBins; b++) {
+        spectrum[b] = sums[b];
+        stats->counts += sums[b];
+    }
+
+    stats->realtime = sums[cube->nBins];
+    stats->livetime = sums[cube->nBins + 1];
+    stats->triggers = sums[cube->nBins + 2];
+    stats->events = sums[cube->nBins + 3];
+
+    handel_md_free(sums);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Unmaps a cube and frees its index. Its counts reach the file as the
+ * operating system writes the mapped pages back.
+ */
+HANDEL_EXPORT int HANDEL_API xiaCloseCube(XiaCube* cube) {
+    if (cube == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaCloseCube", "cube may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    xiaFreeCubeIndex(cube->index);
+    handel_md_file_unmap(&cube->map);
+    handel_md_free(cube);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Returns the size in bytes of the file for a cube header and the offset
+ * of its statistics. The size is a double so that it cannot overflow.
+ */
+static double xiaCubeFileSize(const CubeHeader* header, uint64_t* statsOffset) {
+    double tiles = (double) CUBE_CEIL((uint64_t) header->width, CUBE_TILE_WIDTH) *
+                   (double) CUBE_CEIL((uint64_t) header->height, CUBE_TILE_HEIGHT) *
+                   (double) CUBE_CEIL((uint64_t) header->nBins, CUBE_TILE_BINS) *
+                   header->nChannels;
+    double stats = (double) header->width * header->height * header->nChannels *
+                   CUBE_N_STATS * sizeof(uint32_t);
+
+    double offset = CUBE_DATA_OFFSET + tiles * CUBE_TILE_WIDTH * CUBE_TILE_HEIGHT *
+                                           CUBE_TILE_BINS * sizeof(uint32_t);
+
+    *statsOffset = (uint64_t) offset;
+
+    return offset + stats;
+}
+
+/*
+ * Checks a cube header against the mapped file and sets up the tile
+ * geometry from it.
+ */
+static int xiaSetCubeLayout(XiaCube* cube, const CubeHeader* header) {
+    double total;
+
+    uint64_t statsOffset;
+
+    if (memcmp(header->magic, CUBE_MAGIC, sizeof(CUBE_MAGIC)) != 0 ||
+        header->bom != CUBE_BOM || header->version != CUBE_VERSION) {
+        xiaLog(XIA_LOG_ERROR, XIA_FILE_TYPE, "xiaSetCubeLayout",
+               "Missing cube header or unsupported version");
+        return XIA_FILE_TYPE;
+    }
+
+    if (header->width == 0 || header->height == 0 || header->nChannels == 0 ||
+        header->nBins == 0 || header->tileWidth != CUBE_TILE_WIDTH ||
+        header->tileHeight != CUBE_TILE_HEIGHT || header->tileBins != CUBE_TILE_BINS ||
+        header->dataOffset != CUBE_DATA_OFFSET) {
+        xiaLog(XIA_LOG_ERROR, XIA_FILE_TYPE, "xiaSetCubeLayout",
+               "Unsupported cube layout");
+        return XIA_FILE_TYPE;
+    }
+
+    cube->width = header->width;
+    cube->height = header->height;
+    cube->nChannels = header->nChannels;
+    cube->nBins = header->nBins;
+    cube->tilesAcross = CUBE_CEIL((size_t) header->width, CUBE_TILE_WIDTH);
+    cube->binTiles = CUBE_CEIL((size_t) header->nBins, CUBE_TILE_BINS);
+    cube->tileSize = CUBE_TILE_WIDTH * CUBE_TILE_HEIGHT * CUBE_TILE_BINS;
+
+    total = xiaCubeFileSize(header, &statsOffset);
+
+    if (header->statsOffset != statsOffset || total > (double) cube->map.size) {
+        xiaLog(XIA_LOG_ERROR, XIA_FILE_TYPE, "xiaSetCubeLayout",
+               "The file is %lu bytes, too short for its %.0f byte cube",
+               (unsigned long) cube->map.size, total);
+        return XIA_FILE_TYPE;
+    }
+
+    cube->counts = (uint32_t*) ((byte_t*) cube->map.data + CUBE_DATA_OFFSET);
+    cube->stats = (uint32_t*) ((byte_t*) cube->map.data + statsOffset);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Frees a cube index and its lock.
+ */
+static void xiaFreeCubeIndex(CubeIndex* index) {
+    if (index == NULL) {
+        return;
+    }
+
+    if (handel_md_mutex_ready(&index->lock)) {
+        handel_md_mutex_destroy(&index->lock);
+    }
+
+    handel_md_free(index->tree);
+    handel_md_free(index);
+}
+
+/*
+ * Adds n sums to another n.
+ */
+static void xiaAddSums(uint64_t* dst, const uint64_t* src, size_t n) {
+    size_t k;
+
+    for (k = 0; k < n; k++) {
+        dst[k] += src[k];
+    }
+}
+
+/*
+ * Adds the change to square (sx, sy), n sums starting at sum first of
+ * each node, to every node of the Fenwick tree that covers the square.
+ */
+static void xiaAddCubeIndex(CubeIndex* index, size_t sx, size_t sy,
+                            const uint64_t* delta, size_t first, size_t n) {
+    size_t i;
+    size_t j;
+
+    for (j = sy + 1; j <= index->down; j += j & (~j + 1)) {
+        for (i = sx + 1; i <= index->across; i += i & (~i + 1)) {
+            xiaAddSums(index->tree + ((j - 1) * index->across + i - 1) * index->stride +
+                           first,
+                       delta, n);
+        }
+    }
+}
+
+/*
+ * Adds, or subtracts, the sums of one channel over the squares [0, sx) x
+ * [0, sy) to sums.
+ */
+static void xiaQueryCubeIndex(const CubeIndex* index, size_t sx, size_t sy,
+                              unsigned int channel, boolean_t subtract,
+                              uint64_t* sums) {
+    size_t i;
+    size_t j;
+    size_t k;
+
+    for (j = sy; j > 0; j -= j & (~j + 1)) {
+        for (i = sx; i > 0; i -= i & (~i + 1)) {
+            const uint64_t* node = index->tree +
+                                   ((j - 1) * index->across + i - 1) * index->stride +
+                                   channel * index->chStride;
+
+            if (subtract) {
+                for (k = 0; k < index->chStride; k++) {
+                    sums[k] -= node[k];
+                }
+            } else {
+                xiaAddSums(sums, node, index->chStride);
+            }
+        }
+    }
+}
+
+/*
+ * Adds the spectra and statistics of one channel of pixels [x0, x1) of
+ * row y to sums, the bins followed by the statistics.
+ */
+static void xiaAddCubePixels(const XiaCube* cube, unsigned int channel,
+                             unsigned long x0, unsigned long x1, unsigned long y,
+                             uint64_t* sums) {
+    unsigned long x;
+
+    unsigned int b;
+    unsigned int k;
+
+    const uint32_t* stats = cube->stats + (((size_t) y * cube->width + x0) *
+                                               cube->nChannels +
+                                           channel) *
+                                              CUBE_N_STATS;
+
+    for (x = x0; x < x1; x++, stats += cube->nChannels * CUBE_N_STATS) {
+        for (b = 0; b < cube->nBins; b += CUBE_TILE_BINS) {
+            const uint32_t* bins = xiaCubeTile(cube, x, y, channel, b / CUBE_TILE_BINS);
+
+            unsigned int n = MIN(CUBE_TILE_BINS, cube->nBins - b);
+
+            for (k = 0; k < n; k++) {
+                sums[b + k] += bins[k];
+            }
+        }
+
+        for (k = 0; k < CUBE_N_STATS; k++) {
+            sums[cube->nBins + k] += stats[k];
+        }
+    }
+}
+
+/*
+ * Returns the counts of pixel (x, y) in bin tile binTile of a channel,
+ * the first of CUBE_TILE_BINS bins.
+ */
+static uint32_t* xiaCubeTile(const XiaCube* cube, unsigned long x, unsigned long y,
+                             unsigned int channel, size_t binTile) {
+    size_t tile = (((y / CUBE_TILE_HEIGHT) * cube->tilesAcross + x / CUBE_TILE_WIDTH) *
+                       cube->nChannels +
+                   channel) *
+                      cube->binTiles +
+                  binTile;
+
+    return cube->counts + tile * cube->tileSize +
+           ((y % CUBE_TILE_HEIGHT) * CUBE_TILE_WIDTH + x % CUBE_TILE_WIDTH) *
+               CUBE_TILE_BINS;
+}
@@ -62,7 +62,7 @@ HANDEL_EXPORT void HANDEL_API xiaDumpDetChanStruct(char* fileName) {
 
     fprintf(log, "****Dump of Global DetChanElement LL****\n\n");
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     for (i = 0; current != NULL; current = current->next, i++) {
         fprintf(log, "Element at position %d, Address = %p\n", i, current);
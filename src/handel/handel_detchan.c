@@ -54,7 +54,7 @@ static DetChanSetElem* HANDEL_API xiaGetDetSetTail(DetChanSetElem* head);
 boolean_t HANDEL_API xiaIsDetChanFree(int detChan) {
     DetChanElement* current;
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     if (isListEmpty(current)) {
         return TRUE_;
@@ -113,11 +113,11 @@ int HANDEL_API xiaAddDetChan(int type, unsigned int detChan, void* data) {
     newDetChan->isTagged = FALSE_;
     newDetChan->next = NULL;
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     if (isListEmpty(current)) {
-        xiaDetChanHead = newDetChan;
-        current = xiaDetChanHead;
+        xiaContext->detChanHead = newDetChan;
+        current = xiaContext->detChanHead;
     } else {
         while (current->next != NULL) {
             current = current->next;
@@ -240,7 +240,7 @@ int HANDEL_API xiaRemoveDetChan(unsigned int detChan) {
     DetChanElement* prev;
     DetChanElement* next;
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     if (isListEmpty(current)) {
         xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaRemoveDetChan",
@@ -265,8 +265,8 @@ int HANDEL_API xiaRemoveDetChan(unsigned int detChan) {
 
     xiaLog(XIA_LOG_INFO, "xiaRemoveDetChan", "Removing detChan %u", detChan);
 
-    if (current == xiaDetChanHead) {
-        xiaDetChanHead = current->next;
+    if (current == xiaContext->detChanHead) {
+        xiaContext->detChanHead = current->next;
     } else {
         prev->next = next;
     }
@@ -333,7 +333,7 @@ void HANDEL_API xiaFreeDetSet(DetChanSetElem* head) {
 int HANDEL_API xiaGetElemType(int detChan) {
     DetChanElement* current = NULL;
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     while (current != NULL) {
         if (current->detChan == detChan) {
@@ -384,7 +384,7 @@ char* HANDEL_API xiaGetAliasFromDetChan(int detChan) {
         return NULL;
     }
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     while ((current->next != NULL) && (current->detChan != detChan)) {
         current = current->next;
@@ -407,7 +407,7 @@ char* HANDEL_API xiaGetAliasFromDetChan(int detChan) {
  * rather try to implement some sort of encapsulation.
  */
 DetChanElement* HANDEL_API xiaGetDetChanHead(void) {
-    return xiaDetChanHead;
+    return xiaContext->detChanHead;
 }
 
 /*
@@ -415,7 +415,7 @@ DetChanElement* HANDEL_API xiaGetDetChanHead(void) {
  */
 void HANDEL_API xiaClearTags(void) {
     DetChanElement* current = NULL;
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
     while (current != NULL) {
         current->isTagged = FALSE_;
         current = getListNext(current);
@@ -429,7 +429,7 @@ void HANDEL_API xiaClearTags(void) {
 DetChanElement* HANDEL_API xiaGetDetChanPtr(int detChan) {
     DetChanElement* current = NULL;
 
-    current = xiaDetChanHead;
+    current = xiaContext->detChanHead;
 
     while (current != NULL) {
         if (current->detChan == detChan) {
@@ -81,13 +81,13 @@ int HANDEL_API xiaNewDefault(char* alias) {
         return XIA_ALIAS_EXISTS;
     }
     /* Check that the Head of the linked list exists */
-    if (xiaDefaultsHead == NULL) {
+    if (xiaContext->defaultsHead == NULL) {
         /* Create an entry that is the Head of the linked list */
-        xiaDefaultsHead = (XiaDefaults*) handel_md_alloc(sizeof(XiaDefaults));
-        current = xiaDefaultsHead;
+        xiaContext->defaultsHead = (XiaDefaults*) handel_md_alloc(sizeof(XiaDefaults));
+        current = xiaContext->defaultsHead;
     } else {
         /* Find the end of the linked list */
-        current = xiaDefaultsHead;
+        current = xiaContext->defaultsHead;
         while (current->next != NULL) {
             current = current->next;
         }
@@ -323,7 +323,7 @@ int HANDEL_API xiaRemoveDefault(char* alias) {
     xiaLog(XIA_LOG_DEBUG, "xiaRemoveDefault", "Preparing to remove default w/ alias %s",
            alias);
 
-    if (isListEmpty(xiaDefaultsHead)) {
+    if (isListEmpty(xiaContext->defaultsHead)) {
         xiaLog(XIA_LOG_ERROR, XIA_NO_ALIAS, "xiaRemoveDefault",
                "Alias %s does not exist", alias);
         return XIA_NO_ALIAS;
@@ -331,7 +331,7 @@ int HANDEL_API xiaRemoveDefault(char* alias) {
 
     /* First check if this alias exists already? */
     prev = NULL;
-    current = xiaDefaultsHead;
+    current = xiaContext->defaultsHead;
     next = current->next;
     while (next != NULL) {
         if (STREQ(alias, current->alias)) {
@@ -351,8 +351,8 @@ int HANDEL_API xiaRemoveDefault(char* alias) {
     }
 
     /* Check if match is the head of the list */
-    if (current == xiaDefaultsHead) {
-        xiaDefaultsHead = next;
+    if (current == xiaContext->defaultsHead) {
+        xiaContext->defaultsHead = next;
     } else {
         prev->next = next;
     }
@@ -371,7 +371,7 @@ XiaDefaults* HANDEL_API xiaFindDefault(char* alias) {
     XiaDefaults* current = NULL;
 
     /* First check if this alias exists already? */
-    current = xiaDefaultsHead;
+    current = xiaContext->defaultsHead;
     while (current != NULL) {
         /* If the alias matches, return a pointer to the detector */
         if (STREQ(alias, current->alias)) {
@@ -413,5 +413,5 @@ double HANDEL_API xiaGetValueFromDefaults(char* name, char* alias) {
  * This routine returns a pointer to the head of XiaDefaults linked-list.
  */
 XiaDefaults* HANDEL_API xiaGetDefaultsHead(void) {
-    return xiaDefaultsHead;
+    return xiaContext->defaultsHead;
 }
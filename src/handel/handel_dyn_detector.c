@@ -88,11 +88,11 @@ HANDEL_EXPORT int HANDEL_API xiaNewDetector(char* alias) {
 
     xiaLog(XIA_LOG_DEBUG, "xiaNewDetector", "create new detector w/ alias = %s", alias);
 
-    if (xiaDetectorHead == NULL) {
-        xiaDetectorHead = (Detector*) handel_md_alloc(sizeof(Detector));
-        current = xiaDetectorHead;
+    if (xiaContext->detectorHead == NULL) {
+        xiaContext->detectorHead = (Detector*) handel_md_alloc(sizeof(Detector));
+        current = xiaContext->detectorHead;
     } else {
-        current = xiaDetectorHead;
+        current = xiaContext->detectorHead;
         while (current->next != NULL) {
             current = current->next;
         }
@@ -452,7 +452,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetNumDetectors(unsigned int* numDetectors) {
         return XIA_NULL_VALUE;
     }
 
-    Detector* current = xiaDetectorHead;
+    Detector* current = xiaContext->detectorHead;
 
     while (current != NULL) {
         count++;
@@ -467,7 +467,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetNumDetectors(unsigned int* numDetectors) {
 HANDEL_EXPORT int HANDEL_API xiaGetDetectors(char* detectors[]) {
     int i;
 
-    Detector* current = xiaDetectorHead;
+    Detector* current = xiaContext->detectorHead;
 
     if (detectors == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetDetectors",
@@ -490,7 +490,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetDetectors(char* detectors[]) {
 HANDEL_EXPORT int HANDEL_API xiaGetDetectors_VB(unsigned int index, char* alias) {
     unsigned int curIdx;
 
-    Detector* current = xiaDetectorHead;
+    Detector* current = xiaContext->detectorHead;
 
     for (curIdx = 0; current != NULL; current = getListNext(current), curIdx++) {
         if (curIdx == index) {
@@ -521,7 +521,7 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveDetector(char* alias) {
     }
 
     found = xiaFindDetector(alias);
-    if (isListEmpty(xiaDetectorHead) || found == NULL) {
+    if (isListEmpty(xiaContext->detectorHead) || found == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NO_ALIAS, "xiaRemoveDetector",
                "Alias %s does not exist", alias);
         return XIA_NO_ALIAS;
@@ -529,7 +529,7 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveDetector(char* alias) {
 
     strtemp = xia_lower(alias);
 
-    current = xiaDetectorHead;
+    current = xiaContext->detectorHead;
     next = current->next;
     while (!STREQ(strtemp, current->alias)) {
         prev = current;
@@ -537,8 +537,8 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveDetector(char* alias) {
         next = current->next;
     }
 
-    if (current == xiaDetectorHead) {
-        xiaDetectorHead = current->next;
+    if (current == xiaContext->detectorHead) {
+        xiaContext->detectorHead = current->next;
     } else {
         if (prev != NULL) {
             prev->next = current->next;
@@ -565,7 +565,7 @@ Detector* HANDEL_API xiaFindDetector(char* alias) {
     strtemp = xia_lower(alias);
 
     /* First check if this alias exists already? */
-    current = xiaDetectorHead;
+    current = xiaContext->detectorHead;
     while (current != NULL) {
         if (STREQ(strtemp, current->alias)) {
             return current;
@@ -580,5 +580,5 @@ Detector* HANDEL_API xiaFindDetector(char* alias) {
  * This routine returns the head of the Detector LL
  */
 Detector* HANDEL_API xiaGetDetectorHead(void) {
-    return xiaDetectorHead;
+    return xiaContext->detectorHead;
 }
@@ -95,11 +95,11 @@ HANDEL_EXPORT int HANDEL_API xiaNewFirmware(char* alias) {
 
     xiaLog(XIA_LOG_DEBUG, "xiaNewFirmware", "create new firmware w/ alias = %s", alias);
 
-    if (xiaFirmwareSetHead == NULL) {
-        xiaFirmwareSetHead = (FirmwareSet*) handel_md_alloc(sizeof(FirmwareSet));
-        current = xiaFirmwareSetHead;
+    if (xiaContext->firmwareSetHead == NULL) {
+        xiaContext->firmwareSetHead = (FirmwareSet*) handel_md_alloc(sizeof(FirmwareSet));
+        current = xiaContext->firmwareSetHead;
     } else {
-        current = xiaFirmwareSetHead;
+        current = xiaContext->firmwareSetHead;
         while (current->next != NULL) {
             current = current->next;
         }
@@ -450,7 +450,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetFirmwareItem(char* alias, unsigned short ptrr
 HANDEL_EXPORT int HANDEL_API xiaGetNumFirmwareSets(unsigned int* numFirmware) {
     unsigned int count = 0;
 
-    FirmwareSet* current = xiaFirmwareSetHead;
+    FirmwareSet* current = xiaContext->firmwareSetHead;
 
     if (numFirmware == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetNumFirmwareSets",
@@ -470,7 +470,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetNumFirmwareSets(unsigned int* numFirmware) {
 
 HANDEL_EXPORT int HANDEL_API xiaGetFirmwareSets(char* firmwares[]) {
     int i;
-    FirmwareSet* current = xiaFirmwareSetHead;
+    FirmwareSet* current = xiaContext->firmwareSetHead;
 
     if (firmwares == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetFirmwareSets",
@@ -493,7 +493,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetFirmwareSets(char* firmwares[]) {
 HANDEL_EXPORT int HANDEL_API xiaGetFirmwareSets_VB(unsigned int index, char* alias) {
     unsigned int curIdx;
 
-    FirmwareSet* current = xiaFirmwareSetHead;
+    FirmwareSet* current = xiaContext->firmwareSetHead;
 
     for (curIdx = 0; current != NULL; current = getListNext(current), curIdx++) {
         if (curIdx == index) {
@@ -792,7 +792,7 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveFirmware(char* alias) {
     }
 
     found = xiaFindFirmware(alias);
-    if (isListEmpty(xiaFirmwareSetHead) || found == NULL) {
+    if (isListEmpty(xiaContext->firmwareSetHead) || found == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NO_ALIAS, "xiaRemoveFirmware",
                "Alias %s does not exist", alias);
         return XIA_NO_ALIAS;
@@ -800,7 +800,7 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveFirmware(char* alias) {
 
     strtemp = xia_lower(alias);
 
-    current = xiaFirmwareSetHead;
+    current = xiaContext->firmwareSetHead;
     next = current->next;
     while (!STREQ(strtemp, current->alias)) {
         prev = current;
@@ -808,8 +808,8 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveFirmware(char* alias) {
         next = current->next;
     }
 
-    if (current == xiaFirmwareSetHead) {
-        xiaFirmwareSetHead = current->next;
+    if (current == xiaContext->firmwareSetHead) {
+        xiaContext->firmwareSetHead = current->next;
     } else {
         if (prev != NULL) {
             prev->next = current->next;
@@ -837,7 +837,7 @@ FirmwareSet* HANDEL_API xiaFindFirmware(char* alias) {
     strtemp = xia_lower(alias);
 
     /* First check if this alias exists already? */
-    current = xiaFirmwareSetHead;
+    current = xiaContext->firmwareSetHead;
     while (current != NULL) {
         /* If the alias matches, return a pointer to the detector */
         if (STREQ(strtemp, current->alias)) {
@@ -868,7 +868,7 @@ static boolean_t HANDEL_API xiaIsPTRRFree(Firmware* firmware, unsigned short ptt
  * Returns the head of the FirmwareSet LL
  */
 FirmwareSet* HANDEL_API xiaGetFirmwareSetHead(void) {
-    return xiaFirmwareSetHead;
+    return xiaContext->firmwareSetHead;
 }
 
 /*
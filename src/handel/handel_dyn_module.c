@@ -228,8 +228,8 @@ HANDEL_EXPORT int HANDEL_API xiaNewModule(char* alias) {
 
     current = xiaGetModuleHead();
     if (current == NULL) {
-        xiaModuleHead = (Module*) handel_md_alloc(sizeof(Module));
-        current = xiaModuleHead;
+        xiaContext->moduleHead = (Module*) handel_md_alloc(sizeof(Module));
+        current = xiaContext->moduleHead;
     } else {
         while (current->next != NULL) {
             current = current->next;
@@ -1446,7 +1446,7 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveModule(char* alias) {
     }
 
     if (current == xiaGetModuleHead()) {
-        xiaModuleHead = current->next;
+        xiaContext->moduleHead = current->next;
     } else {
         if (prev != NULL) {
             prev->next = current->next;
@@ -1502,7 +1502,7 @@ unsigned int HANDEL_API xiaGetModChan(unsigned int detChan) {
  * Return the head of the Module LL
  */
 Module* HANDEL_API xiaGetModuleHead(void) {
-    return xiaModuleHead;
+    return xiaContext->moduleHead;
 }
 
 /*
@@ -1805,6 +1805,8 @@ int HANDEL_API xiaTagAllRunActive(Module* module, boolean_t state) {
  * memory for the base module instance.
  */
 static int _initModule(Module* module, char* alias) {
+    int status;
+
     size_t aliasLen;
 
     if (module == NULL) {
@@ -1855,6 +1857,18 @@ static int _initModule(Module* module, char* alias) {
     module->next = NULL;
     module->ch = NULL;
     module->isSetup = FALSE_;
+    module->images = NULL;
+    module->tune = NULL;
+
+    status = xiaInitModuleLock(module);
+
+    if (status != XIA_SUCCESS) {
+        handel_md_free(module->interface_info);
+        handel_md_free(module->alias);
+        xiaLog(XIA_LOG_ERROR, status, "_initModule",
+               "Error creating the lock for module '%s'.", alias);
+        return status;
+    }
 
     return XIA_SUCCESS;
 }
@@ -2017,6 +2031,7 @@ static int _initChannels(Module* module) {
         module->ch[i].n_sca = 0;
         module->ch[i].sca_lo = NULL;
         module->ch[i].sca_hi = NULL;
+        module->ch[i].in_batch = FALSE_;
     }
 
     return XIA_SUCCESS;
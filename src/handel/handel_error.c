@@ -221,6 +221,10 @@ HANDEL_EXPORT const char* HANDEL_API xiaGetErrorText(int errorcode) {
             return "The routine is unimplemented in this version";
         case XIA_PARAM_DEBUG_MISMATCH:
             return "A parameter mismatch was found with XIA_PARAM_DEBUG enabled";
+        case XIA_STREAM_FULL:
+            return "A list mode merger stream has no room for the events";
+        case XIA_CANCELLED:
+            return "The operation was cancelled by xiaCancel()";
         /* PSL errors 601-700 */
         case XIA_NOSUPPORT_FIRM:
             return "The specified firmware is not supported by this board type";
@@ -398,6 +402,8 @@ HANDEL_EXPORT const char* HANDEL_API xiaGetErrorText(int errorcode) {
             return "UART passthrough command error";
         case XIA_UNSUPPORTED:
             return "Feature unsupported by current hardware";
+        case XIA_MALFORMED_BUFFER:
+            return "Mapping buffer contents are malformed";
         /* handel-sitoro errors 690-700 */
         case XIA_DAC_GAIN_OOR:
             return "SiToro DAC gain is out of range";
@@ -571,6 +577,10 @@ const char* xiaGetXerxesErrorText(int errorcode) {
             return "Malformed firmware file";
         case DXP_UNKNOWN_CT:
             return "Unknown control task";
+        case DXP_BAD_PARAM:
+            return "Parameter value is invalid";
+        case DXP_CANCELLED:
+            return "Operation was cancelled";
         /* Host machine error codes 4401-4500 */
         case DXP_NOMEM:
             return "Error allocating memory";
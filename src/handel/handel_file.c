@@ -67,11 +67,6 @@ static int writeSerial(FILE* fp, Module* m);
 
 static int writeInterface(FILE* fp, Module* m);
 
-static char line[XIA_LINE_LEN];
-
-static int HANDEL_API xiaGetLine_N(FILE* fp, char* lline, int len);
-static int HANDEL_API xiaGetLine(FILE* fp, char* line);
-
 /* GLOBAL Variables */
 static InterfaceWriters_t INTERFACE_WRITERS[] = {
     /* Sentinel */
@@ -102,21 +97,23 @@ HANDEL_EXPORT int HANDEL_API xiaLoadSystem(char* type, char* filename) {
         return XIA_NO_FILENAME;
     }
 
-    /*
-     * If we support different output types in the future, we need to change
-     * this logic around.
-     */
-    if (!STREQ(type, "handel_ini")) {
+    if (STREQ(type, "handel_ini")) {
+        status = xiaInit(filename);
+    } else if (STREQ(type, "handel_binary")) {
+        status = xiaInitHandel();
+
+        if (status == XIA_SUCCESS) {
+            status = xiaReadSnapshot(filename);
+        }
+    } else {
         xiaLog(XIA_LOG_ERROR, XIA_FILE_TYPE, "xiaLoadSystem",
                "Unknown file type '%s' for target save file '%s'", type, filename);
         return XIA_FILE_TYPE;
     }
 
-    status = xiaInit(filename);
-
     if (status != XIA_SUCCESS) {
-        xiaLog(XIA_LOG_ERROR, status, "xiaLoadSystem",
-               "Error reading in .INI file '%s'", filename);
+        xiaLog(XIA_LOG_ERROR, status, "xiaLoadSystem", "Error reading in '%s'",
+               filename);
         return status;
     }
 
@@ -124,8 +121,10 @@ HANDEL_EXPORT int HANDEL_API xiaLoadSystem(char* type, char* filename) {
 }
 
 /*
- * Saves the configuration to the given filename and type. The only
- * supported type is "handel_ini".
+ * Saves the configuration to the given filename and type. The supported
+ * types are "handel_ini", "handel_binary" and "handel_binary_dsp". The
+ * latter also saves the DSP parameters of a started system so that the
+ * next xiaStartSystem() after loading it can restore them.
  */
 HANDEL_EXPORT int HANDEL_API xiaSaveSystem(char* type, char* filename) {
     int status;
@@ -143,6 +142,10 @@ HANDEL_EXPORT int HANDEL_API xiaSaveSystem(char* type, char* filename) {
 
     if (STREQ(type, "handel_ini")) {
         status = xiaWriteIniFile(filename);
+    } else if (STREQ(type, "handel_binary")) {
+        status = xiaWriteSnapshot(filename, FALSE_);
+    } else if (STREQ(type, "handel_binary_dsp")) {
+        status = xiaWriteSnapshot(filename, TRUE_);
     } else {
         status = XIA_FILE_TYPE;
     }
@@ -355,6 +358,10 @@ static int HANDEL_API xiaWriteIniFile(char* filename) {
 /*
  * Read in "handel_ini" type ini files.
  *
+ * The file is read once and tokenized into an index of sections and their
+ * START/END blocks. The sections are then loaded in the order given by
+ * sectionInfo, which need not match their order in the file.
+ *
  * Returns #XIA_OPEN_FILE if inifile cannot be found.
  */
 int HANDEL_API xiaReadIniFile(char* inifile) {
@@ -362,17 +369,12 @@ int HANDEL_API xiaReadIniFile(char* inifile) {
     int numSections;
     int i;
 
-    /*
-     * Pointers to keep track of the xia.ini file
-     */
-    FILE* fp = NULL;
+    size_t j;
 
-    char tmpLine[XIA_LINE_LEN];
+    FILE* fp = NULL;
 
-    fpos_t start;
-    fpos_t end;
-    fpos_t local;
-    fpos_t local_end;
+    IniIndex index;
+    IniSection* section;
 
     char xiaini[8] = "xia.ini";
 
@@ -392,335 +394,335 @@ int HANDEL_API xiaReadIniFile(char* inifile) {
         return XIA_OPEN_FILE;
     }
 
-    /* Loop over all the sections as defined in sectionInfo
-     * XXX BUG: Should be sectionInfo / sectionInfo[0]?
-     */
+    status = xiaIndexIniFile(fp, inifile, &index);
+
+    xia_file_close(fp);
+
+    if (status != XIA_SUCCESS) {
+        xiaFreeIniIndex(&index);
+        xiaLog(XIA_LOG_ERROR, status, "xiaReadIniFile", "Error parsing %s", inifile);
+        return status;
+    }
+
+    /* Loop over all the sections as defined in sectionInfo */
     numSections = (int) (sizeof(sectionInfo) / sizeof(SectionInfo));
 
     for (i = 0; i < numSections; i++) {
-        status = xiaFindEntryLimits(fp, sectionInfo[i].section, &start, &end);
+        section = xiaFindIniSection(&index, sectionInfo[i].section);
 
-        if (status != XIA_SUCCESS) {
+        if (section == NULL) {
             xiaLog(XIA_LOG_WARNING, "xiaReadIniFile",
                    "Section missing from ini file: %s", sectionInfo[i].section);
             continue;
         }
 
-        /*
-         * Here is the pseudocode for parsing in a section w/ multiple headings
-         *
-         * 1) Set local to line with START on it (this is a one shot thing)
-         * 2) Cache line pointed to by "end" (this is because we can't do direct
-         *    arithmetic comparisons with fpos_t structs). Also, actually do a
-         *    comparison between local's "line" and the end's "line". If they
-         *    match then we've reached the end of the section and are finished.
-         *    N.b.: I pray to god that a situation never comes up that would
-         *    break this comparison. In principle, it shouldn't happen since
-         *    end's "line" is either EOF or a section heading.
-         * 3) Increment local until we run into END
-         * 4) Set local_end
-         * 5) xiaLoadxxxxx(local, local_end);
-         * 6) Set current to local_end and jump to step (2)
-         */
+        for (j = 0; j < section->numBlocks; j++) {
+            status = sectionInfo[i].function_ptr(&index.blocks[section->firstBlock + j]);
 
-        status = fsetpos(fp, &end);
-
-        if (status != 0) {
-            xiaLog(XIA_LOG_ERROR, XIA_SET_POS, "xiaReadIniFile",
-                   "Error setting file position to the end of "
-                   "the current section. errno = %d, '%s'.",
-                   (int) errno, strerror(errno));
-            return XIA_SET_POS;
+            if (status != XIA_SUCCESS) {
+                xiaFreeIniIndex(&index);
+                xiaLog(XIA_LOG_ERROR, status, "xiaReadIniFile",
+                       "Error loading information from ini file");
+                return status;
+            }
         }
+    }
 
-        status = xiaGetLine(fp, tmpLine);
+    xiaFreeIniIndex(&index);
+    xiaLog(XIA_LOG_INFO, "xiaReadIniFile", "Successfully read ini file.");
 
-        if (status != XIA_SUCCESS && status != XIA_EOF) {
-            xiaLog(
-                XIA_LOG_ERROR, status, "xiaReadIniFile",
-                "Error getting end of section line after setting the file position.");
-            return status;
-        }
+    return XIA_SUCCESS;
+}
+
+/*
+ * Reads the entire .ini file into memory and tokenizes it in place.
+ *
+ * Lines are handled the same way the old line-by-line reader handled
+ * them: CR/LF line endings are accepted, lines are truncated to
+ * XIA_LINE_LEN - 2 characters and lines without any visible characters
+ * are skipped. A section runs from its heading to the next line starting
+ * with '['. Lines outside of a START/END block are ignored.
+ *
+ * index must be released with xiaFreeIniIndex(), even on failure.
+ */
+static int HANDEL_API xiaIndexIniFile(FILE* fp, char* inifile, IniIndex* index) {
+    long size;
+
+    size_t i;
+    size_t nRead;
+    size_t maxLines;
+    size_t blockStart = 0;
+
+    char* p;
+    char* next;
+    char* end;
+    char* close;
+
+    boolean_t inBlock = FALSE_;
+
+    memset(index, 0, sizeof(*index));
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+        fseek(fp, 0, SEEK_SET) != 0) {
+        xiaLog(XIA_LOG_ERROR, XIA_SET_POS, "xiaIndexIniFile",
+               "Error finding the size of %s. errno = %d, '%s'.", inifile, (int) errno,
+               strerror(errno));
+        return XIA_SET_POS;
+    }
+
+    index->data = (char*) handel_md_alloc((size_t) size + 1);
+
+    if (index->data == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaIndexIniFile",
+               "Unable to allocate %ld bytes for %s", size + 1, inifile);
+        return XIA_NOMEM;
+    }
+
+    nRead = fread(index->data, 1, (size_t) size, fp);
+
+    if (nRead != (size_t) size) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_FILE_READ, "xiaIndexIniFile",
+               "Read %zu of %ld bytes from %s", nRead, size, inifile);
+        return XIA_BAD_FILE_READ;
+    }
+
+    end = index->data + size;
+    *end = '\0';
+
+    /* Every entry, block and section uses up at least one line. */
+    maxLines = 1;
+    for (p = index->data; (p = memchr(p, '\n', (size_t) (end - p))) != NULL; p++) {
+        maxLines++;
+    }
 
-        ASSERT(tmpLine[0] == '[');
+    index->entries = (IniEntry*) handel_md_alloc(maxLines * sizeof(IniEntry));
+    index->blocks = (IniBlock*) handel_md_alloc(maxLines * sizeof(IniBlock));
+    index->sections = (IniSection*) handel_md_alloc(maxLines * sizeof(IniSection));
 
-        xiaLog(XIA_LOG_DEBUG, "xiaReadIniFile", "Cached end string = %s", tmpLine);
+    if (index->entries == NULL || index->blocks == NULL || index->sections == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaIndexIniFile",
+               "Unable to allocate the index for %zu lines in %s", maxLines, inifile);
+        return XIA_NOMEM;
+    }
+
+    for (p = index->data; p < end; p = next) {
+        size_t len;
 
-        status = fsetpos(fp, &start);
+        next = memchr(p, '\n', (size_t) (end - p));
 
-        if (status != 0) {
-            xiaLog(XIA_LOG_ERROR, XIA_SET_POS, "xiaReadIniFile",
-                   "Error setting file position to the end of "
-                   "the current section. errno = %d, '%s'.",
-                   (int) errno, strerror(errno));
-            return XIA_SET_POS;
+        if (next == NULL) {
+            next = end;
+        } else {
+            *next++ = '\0';
         }
 
-        status = xiaGetLine(fp, line);
+        len = strlen(p);
 
-        if (status != XIA_SUCCESS && status != XIA_EOF) {
-            xiaLog(
-                XIA_LOG_ERROR, status, "xiaReadIniFile",
-                "Error getting start of section line after setting the file position.");
-            return status;
+        if (len > XIA_LINE_LEN - 2) {
+            len = XIA_LINE_LEN - 2;
+            p[len] = '\0';
         }
 
-        while (!STREQ(line, tmpLine)) {
-            status = fgetpos(fp, &local);
+        if (len > 0 && p[len - 1] == '\r') {
+            p[--len] = '\0';
+        }
 
-            if (strncmp(line, "START", 5) == 0) {
-                do {
-                    status = fgetpos(fp, &local_end);
-                    status = xiaGetLine(fp, line);
-                    xiaLog(XIA_LOG_DEBUG, "xiaReadIniFile",
-                           "Inside START/END bracket: %s", line);
-                } while (strncmp(line, "END", 3) != 0);
+        /* Skip lines without any visible characters */
+        i = 0;
+        while (i < len && !isgraph(CTYPE_CHAR(p[i]))) {
+            i++;
+        }
 
-                status = sectionInfo[i].function_ptr(fp, &local, &local_end);
+        if (i == len) {
+            continue;
+        }
 
-                if (status != XIA_SUCCESS) {
-                    xia_file_close(fp);
-                    xiaLog(XIA_LOG_ERROR, status, "xiaReadIniFile",
-                           "Error loading information from ini file");
-                    return status;
-                }
+        if (inBlock) {
+            if (strncmp(p, "END", 3) == 0) {
+                index->blocks[index->numBlocks].entries = index->entries + blockStart;
+                index->blocks[index->numBlocks].count = index->numEntries - blockStart;
+                index->numBlocks++;
+                index->sections[index->numSections - 1].numBlocks++;
+                inBlock = FALSE_;
+                continue;
             }
 
-            status = xiaGetLine(fp, line);
+            if (p[0] == '[') {
+                xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaIndexIniFile",
+                       "Found section heading '%s' before END in %s", p, inifile);
+                return XIA_FORMAT_ERROR;
+            }
 
-            if (status == XIA_EOF) {
-                break;
+            index->entries[index->numEntries].line = p;
+            index->entries[index->numEntries].status =
+                xiaGetLineData(p, &index->entries[index->numEntries].name,
+                               &index->entries[index->numEntries].value);
+            index->numEntries++;
+            continue;
+        }
+
+        if (p[0] == '[') {
+            IniSection* section = &index->sections[index->numSections++];
+
+            close = strchr(p, ']');
+
+            if (close != NULL) {
+                *close = '\0';
+                section->heading = p + 1;
+            } else {
+                xiaLog(XIA_LOG_WARNING, "xiaIndexIniFile",
+                       "No terminating ] found for '%s' in %s", p, inifile);
+                section->heading = NULL;
             }
 
-            xiaLog(XIA_LOG_DEBUG, "xiaReadIniFile", "Looking for START: %s", line);
+            section->firstBlock = index->numBlocks;
+            section->numBlocks = 0;
+        } else if (strncmp(p, "START", 5) == 0 && index->numSections > 0) {
+            blockStart = index->numEntries;
+            inBlock = TRUE_;
         }
     }
 
-    xia_file_close(fp);
-    xiaLog(XIA_LOG_INFO, "xiaReadIniFile", "Successfully read ini file.");
+    if (inBlock) {
+        xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaIndexIniFile",
+               "Missing END for the last block in %s", inifile);
+        return XIA_FORMAT_ERROR;
+    }
 
     return XIA_SUCCESS;
 }
 
 /*
- * Gets the first line with text after the current file position.
+ * Releases the memory held by index.
  */
-static int HANDEL_API xiaGetLineData(char* lline, char* name, char* value) {
-    int status = XIA_SUCCESS;
+static void HANDEL_API xiaFreeIniIndex(IniIndex* index) {
+    if (index->data != NULL) {
+        handel_md_free(index->data);
+    }
+
+    if (index->entries != NULL) {
+        handel_md_free(index->entries);
+    }
+
+    if (index->blocks != NULL) {
+        handel_md_free(index->blocks);
+    }
+
+    if (index->sections != NULL) {
+        handel_md_free(index->sections);
+    }
+
+    memset(index, 0, sizeof(*index));
+}
+
+/*
+ * Returns the first section in index whose heading matches section, or NULL.
+ * As before, a heading matches if it is a prefix of section.
+ */
+static IniSection* HANDEL_API xiaFindIniSection(IniIndex* index, const char* section) {
+    size_t i;
+
+    for (i = 0; i < index->numSections; i++) {
+        const char* heading = index->sections[i].heading;
+
+        if (heading != NULL && strncmp(heading, section, strlen(heading)) == 0) {
+            return &index->sections[i];
+        }
+    }
+
+    xiaLog(XIA_LOG_WARNING, "xiaFindIniSection", "Unable to find section %s", section);
+
+    return NULL;
+}
+
+/*
+ * Splits lline into a name-value pair in place, trimming the white space
+ * around both. Comment lines, which start with '*', are given the name
+ * "COMMENT". See BUG ID #64.
+ */
+static int HANDEL_API xiaGetLineData(char* lline, char** name, char** value) {
+    static char comment[] = "COMMENT";
 
     size_t loc;
-    size_t begin;
-    size_t end;
     size_t len;
+    size_t nameBegin;
+    size_t nameEnd;
+    size_t valueBegin;
+    size_t valueEnd;
+
+    *name = NULL;
+    *value = NULL;
 
-    /*
-     * If this line is a comment then skip it. See BUG ID #64.
-     */
     if (lline[0] == '*') {
-        strcpy(name, "COMMENT");
-        strcpy(value, lline);
+        *name = comment;
+        *value = lline;
         return XIA_SUCCESS;
     }
 
     /* Start by finding the '=' within the line */
+    len = strlen(lline);
     loc = strcspn(lline, "=");
-    if (loc == 0) {
+
+    if (loc == 0 || loc == len) {
         xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaGetLineData",
                "No = present in xia.ini line: \n %s", lline);
         return XIA_FORMAT_ERROR;
     }
 
-    /* Strip all the leading blanks */
-    begin = 0;
-    while (isspace(CTYPE_CHAR(lline[begin]))) {
-        begin++;
+    nameBegin = 0;
+    while (nameBegin < loc && isspace(CTYPE_CHAR(lline[nameBegin]))) {
+        nameBegin++;
     }
 
-    /* Strip all the trailing blanks */
-    end = loc - 1;
-    while (isspace(CTYPE_CHAR(lline[end]))) {
-        end--;
+    nameEnd = loc;
+    while (nameEnd > nameBegin && isspace(CTYPE_CHAR(lline[nameEnd - 1]))) {
+        nameEnd--;
     }
 
     /* Bug #76, prevents a bad core dump */
-    if (begin > end) {
+    if (nameBegin == nameEnd) {
         xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaGetLineData",
                "Invalid name found in line:  %s", lline);
         return XIA_FORMAT_ERROR;
     }
 
-    /* copy the name */
-    len = end - begin + 1;
-    strncpy(name, lline + begin, len);
-    name[len] = '\0';
-
-    /* Strip all the leading blanks */
-    begin = loc + 1;
-
-    while (isspace(CTYPE_CHAR(lline[begin]))) {
-        begin++;
+    valueBegin = loc + 1;
+    while (valueBegin < len && isspace(CTYPE_CHAR(lline[valueBegin]))) {
+        valueBegin++;
     }
 
-    /* Strip all the trailing blanks */
-    end = strlen(lline) - 1;
-
-    while (isspace(CTYPE_CHAR(lline[end]))) {
-        end--;
+    valueEnd = len;
+    while (valueEnd > valueBegin && isspace(CTYPE_CHAR(lline[valueEnd - 1]))) {
+        valueEnd--;
     }
 
-    /* Bug #76, prevents a bad core dump */
-    if (begin > end) {
+    if (valueBegin == valueEnd) {
         xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaGetLineData",
                "Invalid value found in line:  %s", lline);
         return XIA_FORMAT_ERROR;
     }
 
-    /* copy the value */
-    len = end - begin + 1;
-    strncpy(value, lline + begin, len);
-    value[len] = '\0';
-
-    return status;
-}
-
-static int HANDEL_API xiaGetLine(FILE* fp, char* lline) {
-    return xiaGetLine_N(fp, lline, XIA_LINE_LEN);
-}
+    lline[nameEnd] = '\0';
+    lline[valueEnd] = '\0';
 
-/*
- * Gets the first line with text after the current file position.
- *
- * If the line is longer than llen, the file position is scanned to
- * the start of the next line.
- */
-static int HANDEL_API xiaGetLine_N(FILE* fp, char* lline, int llen) {
-    unsigned int j;
+    *name = lline + nameBegin;
+    *value = lline + valueBegin;
 
-    char* cstatus;
-
-    do {
-        size_t len;
-        char extra[8193];
-
-        cstatus = handel_md_fgets(lline, llen, fp);
-
-        /* lline won't be overwritten in this case */
-        if (cstatus == NULL) {
-            return XIA_EOF;
-        }
-
-        /*
-         * If a partial line was read, flush the rest of that line so the next read
-         * gets a new line.
-         */
-        while ((len = strlen(cstatus)) > 0 && cstatus[len - 1] != '\r' &&
-               cstatus[len - 1] != '\n') {
-            cstatus = handel_md_fgets(extra, sizeof(extra) - 1, fp);
-
-            if (!cstatus) {
-                break;
-            }
-        }
-
-        len = strlen(lline);
-
-        /*
-         * Remove the new line character to keep the log file output from
-         * containing the extra white space.
-         */
-        if (len > 1 && lline[len - 2] == '\n')
-            lline[len - 2] = '\0';
-        if (len > 0 && lline[len - 1] == '\n')
-            lline[len - 1] = '\0';
-
-        /* Check for any alphanumeric character in the line */
-        for (j = 0; j < (unsigned int) len; j++) {
-            if (isgraph(CTYPE_CHAR(lline[j]))) {
-                return XIA_SUCCESS;
-            }
-        }
-    } while (cstatus != NULL);
-
-    return XIA_EOF;
+    return XIA_SUCCESS;
 }
 
 /*
- * Searches through the .ini file and finds the start and end of a
- * specific section of the .ini file starting at [section] and ending at the
- * next [].
+ * Returns TRUE_ if entry is a valid name-value pair called name.
  */
-static int HANDEL_API xiaFindEntryLimits(FILE* fp, const char* section, fpos_t* start,
-                                         fpos_t* end) {
-    int status = XIA_SUCCESS;
-    unsigned int j;
-
-    boolean_t isStartFound = FALSE_;
-
-    char* cstatus;
-
-    /* First rewind the file to the beginning */
-    rewind(fp);
-
-    /* Now fine the match to the section entry */
-    do {
-        do {
-            cstatus = handel_md_fgets(line, XIA_LINE_LEN, fp);
-        } while ((line[0] != '[') && (cstatus != NULL));
-
-        if (cstatus == NULL) {
-            /* This isn't an error since the user has the option of specifying the missing
-             * information using the dynamic configuration routines.
-             */
-            xiaLog(XIA_LOG_WARNING, "xiaFindEntryLimits", "Unable to find section %s",
-                   section);
-            return XIA_NOSECTION;
-        }
-
-        /* Find the terminating ] to this section */
-        for (j = 1; j < (unsigned int) strlen(line) + 1; j++) {
-            if (line[j] == ']') {
-                break;
-            }
-        }
-        /* Did we not find the terminating ]? */
-        if (j == (unsigned int) strlen(line)) {
-            xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaFindEntryLimits",
-                   "Syntax error in Init file, no terminating ] found");
-            return XIA_FORMAT_ERROR;
-        }
-
-        if (strncmp(line + 1, section, j - 1) == 0) {
-            /* Record the starting position) */
-            fgetpos(fp, start);
-
-            isStartFound = TRUE_;
-        }
-        /* Else look for the next section entry */
-    } while (!isStartFound);
-
-    do {
-        /*
-         * Get the current file position before the next read.  If the file
-         * ends, or we find a '[' then we are done and want to send the ending
-         * position to the location of the previous read
-         */
-        status = fgetpos(fp, end);
-        cstatus = handel_md_fgets(line, XIA_LINE_LEN, fp);
-    } while ((line[0] != '[') && (cstatus != NULL));
-
-    if (!cstatus) {
-        ASSERT(feof(fp));
-    }
-
-    return XIA_SUCCESS;
+static boolean_t xiaIsIniEntry(const IniEntry* entry, const char* name) {
+    return (boolean_t) (entry->status == XIA_SUCCESS && STREQ(entry->name, name));
 }
 
 /*
- * Parses data in from fp (and bounded by start & end) as
- * detector information. If it fails, then it fails hard and the user needs
- * to fix their inifile.
+ * Parses the name-value pairs in block as detector information. If it
+ * fails, then it fails hard and the user needs to fix their inifile.
  */
-static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
+static int xiaLoadDetector(const IniBlock* block) {
     int status;
 
     unsigned short i;
@@ -741,7 +743,7 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
      * 3) rest of the detector information
      */
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(block, "alias", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadDetector",
@@ -760,7 +762,7 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "number_of_channels", value);
+    status = xiaFileRA(block, "number_of_channels", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadDetector",
@@ -780,7 +782,7 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "type", value);
+    status = xiaFileRA(block, "type", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadDetector",
@@ -796,7 +798,7 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "type_value", value);
+    status = xiaFileRA(block, "type_value", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadDetector",
@@ -816,7 +818,7 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
 
     for (i = 0; i < numChans; i++) {
         sprintf(name, "channel%hu_gain", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(block, name, value);
 
         if (status == XIA_FILE_RA) {
             xiaLog(XIA_LOG_WARNING, "xiaLoadDetector",
@@ -842,7 +844,7 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
         }
 
         sprintf(name, "channel%hu_polarity", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(block, name, value);
 
         if (status == XIA_FILE_RA) {
             xiaLog(XIA_LOG_WARNING, "xiaLoadDetector",
@@ -870,11 +872,10 @@ static int xiaLoadDetector(FILE* fp, fpos_t* start, fpos_t* end) {
 }
 
 /*
- * Parses data in from fp (and bounded by start & end) as
- * module information. If it fails, then it fails hard and the user needs
- * to fix their inifile.
+ * Parses the name-value pairs in block as module information. If it
+ * fails, then it fails hard and the user needs to fix their inifile.
  */
-static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
+static int xiaLoadModule(const IniBlock* block) {
     int status;
     int chanAlias;
 
@@ -903,7 +904,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
     char firmAlias[MAXALIAS_LEN];
     char defAlias[MAXALIAS_LEN];
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(block, "alias", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -922,7 +923,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "module_type", value);
+    status = xiaFileRA(block, "module_type", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule", "Unable to load module type");
@@ -941,7 +942,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "number_of_channels", value);
+    status = xiaFileRA(block, "number_of_channels", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -962,7 +963,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
     }
 
     /* Deal with interface here */
-    status = xiaFileRA(fp, start, end, "interface", value);
+    status = xiaFileRA(block, "interface", value);
 
     sscanf(value, "%s", interface);
 
@@ -982,7 +983,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "scsibus_number", value);
+        status = xiaFileRA(block, "scsibus_number", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1002,7 +1003,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "crate_number", value);
+        status = xiaFileRA(block, "crate_number", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1022,7 +1023,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "slot", value);
+        status = xiaFileRA(block, "slot", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1042,7 +1043,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
     } else if ((STREQ(interface, "epp")) || (STREQ(interface, "genericEPP"))) {
-        status = xiaFileRA(fp, start, end, "epp_address", value);
+        status = xiaFileRA(block, "epp_address", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1062,7 +1063,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "daisy_chain_id", value);
+        status = xiaFileRA(block, "daisy_chain_id", value);
 
         /*
          * This is an extremely optional setting, so we really only want to do
@@ -1091,7 +1092,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "device_number", value);
+        status = xiaFileRA(block, "device_number", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1120,7 +1121,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "device_number", value);
+        status = xiaFileRA(block, "device_number", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1140,7 +1141,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
     } else if (STREQ(interface, "pxi")) {
-        status = xiaFileRA(fp, start, end, "pci_slot", value);
+        status = xiaFileRA(block, "pci_slot", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule", "Unable to load 'pci_slot'");
@@ -1161,7 +1162,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "pci_bus", value);
+        status = xiaFileRA(block, "pci_bus", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule", "Unable to load 'pci_bus'");
@@ -1182,7 +1183,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
     } else if (STREQ(interface, "serial")) {
-        status = xiaFileRA(fp, start, end, "com_port", value);
+        status = xiaFileRA(block, "com_port", value);
 
         if (status == XIA_SUCCESS) {
             sscanf(value, "%u", &comPort);
@@ -1197,7 +1198,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
                 return status;
             }
         } else {
-            status = xiaFileRA(fp, start, end, "device_file", value);
+            status = xiaFileRA(block, "device_file", value);
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule",
@@ -1216,7 +1217,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
             }
         }
 
-        status = xiaFileRA(fp, start, end, "baud_rate", value);
+        status = xiaFileRA(block, "baud_rate", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule", "Unable to load baud rate");
@@ -1242,7 +1243,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
 
     for (i = 0; i < numChans; i++) {
         sprintf(name, "channel%u_alias", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(block, name, value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaLoadModule", "Unable to load %s from %s",
@@ -1263,7 +1264,7 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
         }
 
         sprintf(name, "channel%u_detector", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(block, name, value);
 
         if (status == XIA_FILE_RA) {
             xiaLog(XIA_LOG_WARNING, "xiaLoadModule",
@@ -1294,12 +1295,12 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
      * and defaults. Check for *_all first and if that isn't found then
      * try and find ones for individual channels.
      */
-    status = xiaFileRA(fp, start, end, "firmware_set_all", value);
+    status = xiaFileRA(block, "firmware_set_all", value);
 
     if (status != XIA_SUCCESS) {
         for (i = 0; i < numChans; i++) {
             sprintf(name, "firmware_set_chan%u", i);
-            status = xiaFileRA(fp, start, end, name, value);
+            status = xiaFileRA(block, name, value);
 
             if (status == XIA_FILE_RA) {
                 xiaLog(XIA_LOG_WARNING, "xiaLoadModule",
@@ -1336,12 +1337,12 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
         }
     }
 
-    status = xiaFileRA(fp, start, end, "default_all", value);
+    status = xiaFileRA(block, "default_all", value);
 
     if (status != XIA_SUCCESS) {
         for (i = 0; i < numChans; i++) {
             sprintf(name, "default_chan%u", i);
-            status = xiaFileRA(fp, start, end, name, value);
+            status = xiaFileRA(block, name, value);
 
             if (status == XIA_FILE_RA) {
                 xiaLog(XIA_LOG_INFO, "xiaLoadModule",
@@ -1381,11 +1382,10 @@ static int xiaLoadModule(FILE* fp, fpos_t* start, fpos_t* end) {
 }
 
 /*
- * Parses data in from fp (and bounded by start & end) as
- * firmware information. If it fails, then it fails hard and the user needs
- * to fix their inifile.
+ * Parses the name-value pairs in block as firmware information. If it
+ * fails, then it fails hard and the user needs to fix their inifile.
  */
-static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
+static int xiaLoadFirmware(const IniBlock* block) {
     int status;
 
     unsigned short i;
@@ -1402,7 +1402,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
      */
     char keyword[10];
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(block, "alias", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadFirmware",
@@ -1422,7 +1422,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
     }
 
     /* Check for an MMU first since we'll be exiting if we find a filename */
-    status = xiaFileRA(fp, start, end, "mmu", value);
+    status = xiaFileRA(block, "mmu", value);
 
     if (status == XIA_SUCCESS) {
         xiaLog(XIA_LOG_DEBUG, "xiaLoadFirmware", "mmu = %s", value);
@@ -1438,7 +1438,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
     }
 
     /* If we find a filename, then we are done and can return */
-    status = xiaFileRA(fp, start, end, "filename", value);
+    status = xiaFileRA(block, "filename", value);
 
     if (status == XIA_SUCCESS) {
         xiaLog(XIA_LOG_DEBUG, "xiaLoadFirmware", "filename = %s", value);
@@ -1452,7 +1452,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "fdd_tmp_path", value);
+        status = xiaFileRA(block, "fdd_tmp_path", value);
 
         if (status == XIA_SUCCESS) {
             strcpy(path, value);
@@ -1470,7 +1470,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
          * Check for keywords, if any...no need to really warn since the most
          * important "keywords" are generated by Handel.
          */
-        status = xiaFileRA(fp, start, end, "num_keywords", value);
+        status = xiaFileRA(block, "num_keywords", value);
 
         if (status == XIA_SUCCESS) {
             xiaLog(XIA_LOG_DEBUG, "xiaLoadFirmware", "num_keywords = %s", value);
@@ -1478,7 +1478,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
             sscanf(value, "%hu", &numKeywords);
             for (i = 0; i < numKeywords; i++) {
                 sprintf(keyword, "keyword%hu", i);
-                status = xiaFileRA(fp, start, end, keyword, value);
+                status = xiaFileRA(block, keyword, value);
 
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaLoadFirmware",
@@ -1505,7 +1505,7 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
      * Need to be a little careful here about how we parse in the PTRR chunks.
      * Start slowly by getting the number of PTRRs first.
      */
-    status = xiaReadPTRRs(fp, start, end, alias);
+    status = xiaReadPTRRs(block, alias);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadFirmware",
@@ -1519,21 +1519,19 @@ static int xiaLoadFirmware(FILE* fp, fpos_t* start, fpos_t* end) {
 /*
  * Parses in the information specified in the defaults definitions.
  */
-static int xiaLoadDefaults(FILE* fp, fpos_t* start, fpos_t* end) {
+static int xiaLoadDefaults(const IniBlock* block) {
     int status;
 
+    size_t i;
+
     char value[MAXITEM_LEN];
     char alias[MAXALIAS_LEN];
-    char tmpName[MAXITEM_LEN];
-    char tmpValue[MAXITEM_LEN];
-    char endLine[XIA_LINE_LEN];
-    char currentLine[XIA_LINE_LEN];
 
     double defValue;
 
-    fpos_t dataStart;
+    const IniEntry* entry;
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(block, "alias", value);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaLoadDefaults",
@@ -1552,43 +1550,36 @@ static int xiaLoadDefaults(FILE* fp, fpos_t* start, fpos_t* end) {
         return status;
     }
 
-    /*
-     * Want a position after the alias line so that we can just read in line-
-     * by-line until we reach endLine
-     */
-    xiaSetPosOnNext(fp, start, end, "alias", &dataStart, TRUE_);
-
-    fsetpos(fp, end);
-    status = xiaGetLine(fp, endLine);
+    /* Every entry after the alias is a default value. */
+    i = 0;
+    while (i < block->count && !xiaIsIniEntry(&block->entries[i], "alias")) {
+        i++;
+    }
 
-    fsetpos(fp, &dataStart);
-    status = xiaGetLine(fp, currentLine);
+    for (i++; i < block->count; i++) {
+        entry = &block->entries[i];
 
-    while (!STREQ(currentLine, endLine)) {
-        status = xiaGetLineData(currentLine, tmpName, tmpValue);
-        if (status != XIA_SUCCESS) {
-            xiaLog(XIA_LOG_ERROR, status, "xiaLoadDefaults",
-                   "Error getting data for entry %s", tmpName);
-            return status;
+        if (entry->status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, entry->status, "xiaLoadDefaults",
+                   "Error getting data for entry %s", entry->line);
+            return entry->status;
         }
 
-        if (!STREQ(tmpName, "COMMENT")) {
-            sscanf(tmpValue, "%lf", &defValue);
+        if (!STREQ(entry->name, "COMMENT")) {
+            sscanf(entry->value, "%lf", &defValue);
 
-            status = xiaAddDefaultItem(alias, tmpName, (void*) &defValue);
+            status = xiaAddDefaultItem(alias, entry->name, (void*) &defValue);
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaLoadDefaults",
-                       "Error adding %s (value = %.3f) to alias %s", tmpName, defValue,
-                       alias);
+                       "Error adding %s (value = %.3f) to alias %s", entry->name,
+                       defValue, alias);
                 return status;
             }
 
             xiaLog(XIA_LOG_DEBUG, "xiaLoadDefaults",
-                   "Added %s (value = %.3f) to alias %s", tmpName, defValue, alias);
+                   "Added %s (value = %.3f) to alias %s", entry->name, defValue, alias);
         }
-
-        status = xiaGetLine(fp, currentLine);
     }
 
     return XIA_SUCCESS;
@@ -1599,7 +1590,7 @@ static int xiaLoadDefaults(FILE* fp, fpos_t* start, fpos_t* end) {
  *
  * (*) -- Actually, it will read in the number specified by number_of_ptrrs.
  */
-static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* alias) {
+static int HANDEL_API xiaReadPTRRs(const IniBlock* block, char* alias) {
     int status;
 
     unsigned short i;
@@ -1607,6 +1598,9 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
     unsigned short numFilter;
     unsigned short filterInfo;
 
+    size_t first;
+    size_t last;
+
     double min_peaking_time;
     double max_peaking_time;
 
@@ -1614,29 +1608,32 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
     char filterName[14];
     char value[MAXITEM_LEN];
 
-    fpos_t newStart;
-    fpos_t newEnd;
-    fpos_t lookAheadStart;
-
-    boolean_t isLast = FALSE_;
+    IniBlock ptrrBlock;
 
     xiaLog(XIA_LOG_DEBUG, "xiaReadPTRRs", "Starting parse of PTRRs");
 
-    /* This assumes that there is at least one PTRR for a specified alias */
-    newEnd = *start;
-    while (!isLast) {
-        xiaSetPosOnNext(fp, &newEnd, end, "ptrr", &lookAheadStart, TRUE_);
-        xiaSetPosOnNext(fp, &newEnd, end, "ptrr", &newStart, FALSE_);
+    /*
+     * Each PTRR runs from a ptrr entry to the next one or the end of the
+     * block. This assumes that there is at least one PTRR for a specified alias.
+     */
+    first = 0;
+    while (first < block->count && !xiaIsIniEntry(&block->entries[first], "ptrr")) {
+        first++;
+    }
 
-        /* Find the end here: either the END or another ptrr */
-        status = xiaSetPosOnNext(fp, &lookAheadStart, end, "ptrr", &newEnd, FALSE_);
+    do {
+        last = first < block->count ? first + 1 : first;
 
-        if (status == XIA_END) {
-            isLast = TRUE_;
+        while (last < block->count && !xiaIsIniEntry(&block->entries[last], "ptrr")) {
+            last++;
         }
 
+        ptrrBlock.entries = block->entries + first;
+        ptrrBlock.count = last - first;
+        first = last;
+
         /* Do the actual actions here */
-        status = xiaFileRA(fp, &newStart, &newEnd, "ptrr", value);
+        status = xiaFileRA(&ptrrBlock, "ptrr", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1656,7 +1653,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "min_peaking_time", value);
+        status = xiaFileRA(&ptrrBlock, "min_peaking_time", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1675,7 +1672,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "max_peaking_time", value);
+        status = xiaFileRA(&ptrrBlock, "max_peaking_time", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1694,7 +1691,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "fippi", value);
+        status = xiaFileRA(&ptrrBlock, "fippi", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1710,7 +1707,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "dsp", value);
+        status = xiaFileRA(&ptrrBlock, "dsp", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1727,7 +1724,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
         }
 
         /* Check for the quite optional "user_fippi"... */
-        status = xiaFileRA(fp, &newStart, &newEnd, "user_fippi", value);
+        status = xiaFileRA(&ptrrBlock, "user_fippi", value);
 
         if (status == XIA_SUCCESS) {
             status = xiaAddFirmwareItem(alias, "user_fippi", (void*) value);
@@ -1745,7 +1742,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "num_filter", value);
+        status = xiaFileRA(&ptrrBlock, "num_filter", value);
 
         if (status != XIA_SUCCESS) {
             xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1759,7 +1756,7 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
 
         for (i = 0; i < numFilter; i++) {
             sprintf(filterName, "filter_info%hu", i);
-            status = xiaFileRA(fp, &newStart, &newEnd, filterName, value);
+            status = xiaFileRA(&ptrrBlock, filterName, value);
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaReadPTRRs",
@@ -1779,111 +1776,32 @@ static int HANDEL_API xiaReadPTRRs(FILE* fp, fpos_t* start, fpos_t* end, char* a
                 return status;
             }
         }
-    }
+    } while (first < block->count);
 
     return XIA_SUCCESS;
 }
 
-/*
- * This routine searches between start and end for name. If it finds a name,
- * it sets newPos to that location. If not, it returns a value of XIA_END
- * and sets newPos to end. There are a couple of important caveats here:
- * You can't use fpos_t pointers in direct arithmetic comparisons. They just
- * don't work that way. Instead, I set the file to the position and then read
- * a line from the file. This line serves as the "unique" identifier from
- * which all future comparisons are done. There is a finite probability that
- * the same string may appear elsewhere in the file. Hopefully the same string
- * won't appear twice between start and end.
- */
-static int HANDEL_API xiaSetPosOnNext(FILE* fp, fpos_t* start, fpos_t* end, char* name,
-                                      fpos_t* newPos, boolean_t after) {
-    int status;
-
-    char endLine[XIA_LINE_LEN];
-    char currentLine[XIA_LINE_LEN];
-    char tmpValue[XIA_LINE_LEN];
-    char tmpName[XIA_LINE_LEN];
-
-    fsetpos(fp, end);
-    status = xiaGetLine(fp, endLine);
-
-    fsetpos(fp, start);
-    fgetpos(fp, newPos);
-    status = xiaGetLine(fp, currentLine);
-
-    xiaLog(XIA_LOG_DEBUG, "xiaSetPosOnNext", "endLine: %s", endLine);
-    xiaLog(XIA_LOG_DEBUG, "xiaSetPosOnNext", "startLine: %s", currentLine);
-
-    while (!STREQ(currentLine, endLine)) {
-        status = xiaGetLineData(currentLine, tmpName, tmpValue);
-
-        if (status != XIA_SUCCESS) {
-            xiaLog(XIA_LOG_ERROR, status, "xiaSetPosOnNext", "Error trying to find %s",
-                   name);
-            return status;
-        }
-
-        if (STREQ(name, tmpName)) {
-            if (after) {
-                fgetpos(fp, newPos);
-            }
-
-            fsetpos(fp, newPos);
-            status = xiaGetLine(fp, currentLine);
-            xiaLog(XIA_LOG_DEBUG, "xiaSetPosOnNext", "newPos set to line: %s",
-                   currentLine);
-
-            return XIA_SUCCESS;
-        }
-
-        fgetpos(fp, newPos);
-
-        status = xiaGetLine(fp, currentLine);
-    }
-
-    /* Okay, we must have made it to the end of the file */
-    return XIA_END;
-}
-
 /*
  * This routine will attempt to find the value from the specified name-value
- * pair. Returns XIA_FILE_RA if it couldn't find anything. It calls
- * xiaGetLine() until the name is matched or the end condition is satisfied.
+ * pair in block. Returns XIA_FILE_RA if it couldn't find anything.
  */
-static int HANDEL_API xiaFileRA(FILE* fp, fpos_t* start, fpos_t* end, char* name,
-                                char* value) {
-    int status;
+static int HANDEL_API xiaFileRA(const IniBlock* block, char* name, char* value) {
+    size_t i;
 
-    /*
-     * Use this to hold the "value" of value until we're sure that this is the
-     * right name and we can return.
-     */
-    char tmpValue[XIA_LINE_LEN];
-    char tmpName[XIA_LINE_LEN];
-    char endLine[XIA_LINE_LEN];
+    for (i = 0; i < block->count; i++) {
+        const IniEntry* entry = &block->entries[i];
 
-    fsetpos(fp, end);
-    status = xiaGetLine(fp, endLine);
-
-    fsetpos(fp, start);
-    status = xiaGetLine(fp, line);
-
-    while (!STREQ(line, endLine)) {
-        status = xiaGetLineData(line, tmpName, tmpValue);
-
-        if (status != XIA_SUCCESS) {
-            xiaLog(XIA_LOG_ERROR, status, "xiaFileRA",
+        if (entry->status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, entry->status, "xiaFileRA",
                    "Error trying to find value for %s", name);
-            return status;
+            return entry->status;
         }
 
-        if (STREQ(name, tmpName)) {
-            strcpy(value, tmpValue);
+        if (STREQ(name, entry->name)) {
+            strcpy(value, entry->value);
 
             return XIA_SUCCESS;
         }
-
-        status = xiaGetLine(fp, line);
     }
 
     return XIA_FILE_RA;
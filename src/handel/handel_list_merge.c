@@ -0,0 +1,525 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_list_merge.c
+ * @brief A time-ordered merge of the list mode event streams of several
+ * modules.
+ *
+ * Each stream, normally one module, has a fixed-size ring of events in
+ * time order. The thread decoding a module pushes its events to the ring
+ * while the thread reading the merged stream pops them, so the two only
+ * share the lock for the ring positions; the events are copied outside
+ * it. An event is only popped once every stream that has not finished
+ * has pushed an event at least as late, the watermark, so a stream that
+ * lags holds back the merged stream rather than appearing out of order.
+ * The streams with events below the watermark are kept in a binary heap
+ * ordered by their oldest event.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xia_common.h"
+#include "xia_handel.h"
+
+#include "handel_errors.h"
+#include "handel_log.h"
+#include "handel_mapping.h"
+#include "md_threads.h"
+
+typedef struct {
+    uint64_t* timestamp;
+    unsigned short* energy;
+    unsigned char* channel;
+    unsigned short* flags;
+    unsigned long* pixel;
+
+    /*
+     * Free-running positions, changed under the merger lock: the pusher
+     * advances tail and the popper head.
+     */
+    size_t head;
+    size_t tail;
+
+    int64_t offset;
+    uint64_t latest;
+    boolean_t started;
+    boolean_t finished;
+} MergeStream;
+
+struct XiaListMerger {
+    unsigned int nStreams;
+    size_t capacity;
+
+    MergeStream* streams;
+
+    /* Scratch for xiaPopListEvents(). */
+    size_t* heads;
+    size_t* tails;
+    unsigned int* heap;
+
+    handel_md_Mutex lock;
+};
+
+static int xiaCheckStream(const char* fn, XiaListMerger* merger, unsigned int stream);
+static void xiaFreeStreams(XiaListMerger* merger);
+static boolean_t xiaMergeBefore(const XiaListMerger* merger, unsigned int a,
+                                unsigned int b);
+static void xiaMergeSiftDown(XiaListMerger* merger, size_t n, size_t i);
+
+/*
+ * Creates a merger for nStreams streams, each holding up to capacity
+ * events that have been pushed but not popped. capacity is rounded up to
+ * a power of two and must be at least the largest single push.
+ */
+HANDEL_EXPORT int HANDEL_API xiaCreateListMerger(unsigned int nStreams, size_t capacity,
+                                                 XiaListMerger** merger) {
+    unsigned int i;
+
+    size_t size = 1;
+
+    XiaListMerger* m;
+
+    if (merger == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaCreateListMerger",
+               "merger may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (nStreams == 0 || capacity == 0) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaCreateListMerger",
+               "A merger needs at least one stream with room for one event");
+        return XIA_BAD_VALUE;
+    }
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    m = (XiaListMerger*) calloc(1, sizeof(XiaListMerger));
+
+    if (m == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCreateListMerger",
+               "Unable to allocate the merger");
+        return XIA_NOMEM;
+    }
+
+    m->nStreams = nStreams;
+    m->capacity = size;
+    m->streams = (MergeStream*) calloc(nStreams, sizeof(MergeStream));
+    m->heads = (size_t*) calloc(nStreams, sizeof(size_t));
+    m->tails = (size_t*) calloc(nStreams, sizeof(size_t));
+    m->heap = (unsigned int*) calloc(nStreams, sizeof(unsigned int));
+
+    if (m->streams == NULL || m->heads == NULL || m->tails == NULL || m->heap == NULL) {
+        xiaFreeStreams(m);
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCreateListMerger",
+               "Unable to allocate %u merger streams", nStreams);
+        return XIA_NOMEM;
+    }
+
+    for (i = 0; i < nStreams; i++) {
+        MergeStream* s = &m->streams[i];
+
+        s->timestamp = (uint64_t*) malloc(size * sizeof(uint64_t));
+        s->energy = (unsigned short*) malloc(size * sizeof(unsigned short));
+        s->channel = (unsigned char*) malloc(size * sizeof(unsigned char));
+        s->flags = (unsigned short*) malloc(size * sizeof(unsigned short));
+        s->pixel = (unsigned long*) malloc(size * sizeof(unsigned long));
+
+        if (s->timestamp == NULL || s->energy == NULL || s->channel == NULL ||
+            s->flags == NULL || s->pixel == NULL) {
+            xiaFreeStreams(m);
+            xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCreateListMerger",
+                   "Unable to allocate %zu events for stream %u", size, i);
+            return XIA_NOMEM;
+        }
+    }
+
+    m->lock.handle = NULL;
+    m->lock.name = "list merger";
+
+    if (handel_md_mutex_create(&m->lock) != THREADING_NO_ERROR) {
+        xiaFreeStreams(m);
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaCreateListMerger",
+               "Error creating the merger lock");
+        return XIA_THREAD_ERROR;
+    }
+
+    *merger = m;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Releases a merger and the events it still holds.
+ */
+HANDEL_EXPORT int HANDEL_API xiaDestroyListMerger(XiaListMerger* merger) {
+    if (merger == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaDestroyListMerger",
+               "merger may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    handel_md_mutex_destroy(&merger->lock);
+    xiaFreeStreams(merger);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Sets the offset, in clock ticks, added to the timestamps of the events
+ * pushed to a stream from now on, to line up modules whose clocks were
+ * not started together.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetListMergerOffset(XiaListMerger* merger,
+                                                    unsigned int stream,
+                                                    int64_t offset) {
+    int status = xiaCheckStream("xiaSetListMergerOffset", merger, stream);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    handel_md_mutex_lock(&merger->lock);
+    merger->streams[stream].offset = offset;
+    handel_md_mutex_unlock(&merger->lock);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Queues decoded events on a stream. The events must be in time order and
+ * no earlier than those already pushed to the stream. Only one thread may
+ * push to a stream at a time. If the stream does not have room for all of
+ * the events none are queued and XIA_STREAM_FULL is returned; pop events
+ * and push again.
+ */
+HANDEL_EXPORT int HANDEL_API xiaPushListEvents(XiaListMerger* merger,
+                                               unsigned int stream,
+                                               const XiaListEvents* events) {
+    int status;
+
+    size_t i;
+    size_t n;
+    size_t head;
+    size_t tail;
+    size_t mask;
+
+    int64_t offset;
+    uint64_t latest;
+    boolean_t started;
+    boolean_t finished;
+
+    MergeStream* s;
+
+    status = xiaCheckStream("xiaPushListEvents", merger, stream);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    if (events == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaPushListEvents",
+               "events may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    s = &merger->streams[stream];
+    n = events->nEvents;
+    mask = merger->capacity - 1;
+
+    handel_md_mutex_lock(&merger->lock);
+    head = s->head;
+    tail = s->tail;
+    offset = s->offset;
+    latest = s->latest;
+    started = s->started;
+    finished = s->finished;
+    handel_md_mutex_unlock(&merger->lock);
+
+    if (finished) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaPushListEvents",
+               "Stream %u has finished", stream);
+        return XIA_BAD_VALUE;
+    }
+
+    if (n > merger->capacity - (tail - head)) {
+        xiaLog(XIA_LOG_DEBUG, "xiaPushListEvents",
+               "Stream %u has room for %zu of %zu events", stream,
+               merger->capacity - (tail - head), n);
+        return XIA_STREAM_FULL;
+    }
+
+    /*
+     * The slots from tail on belong to this thread until the new tail is
+     * published, so fill them without the lock.
+     */
+    for (i = 0; i < n; i++) {
+        size_t k = (tail + i) & mask;
+        uint64_t t = events->timestamp[i] + (uint64_t) offset;
+
+        if (started && t < latest) {
+            xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaPushListEvents",
+                   "Event %zu of stream %u is earlier than the one before it", i,
+                   stream);
+            return XIA_BAD_VALUE;
+        }
+
+        s->timestamp[k] = t;
+        s->energy[k] = events->energy[i];
+        s->channel[k] = events->channel[i];
+        s->flags[k] = events->flags[i];
+        s->pixel[k] = events->pixel[i];
+
+        latest = t;
+        started = TRUE_;
+    }
+
+    handel_md_mutex_lock(&merger->lock);
+    s->tail = tail + n;
+    s->latest = latest;
+    s->started = started;
+    handel_md_mutex_unlock(&merger->lock);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Marks the end of a stream, such as the end of a run or a module that
+ * has stopped sending, so it no longer holds back the watermark. Its
+ * queued events are still popped.
+ */
+HANDEL_EXPORT int HANDEL_API xiaFinishListStream(XiaListMerger* merger,
+                                                 unsigned int stream) {
+    int status = xiaCheckStream("xiaFinishListStream", merger, stream);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    handel_md_mutex_lock(&merger->lock);
+    merger->streams[stream].finished = TRUE_;
+    handel_md_mutex_unlock(&merger->lock);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Pops up to max events, in time order, that no stream still running can
+ * precede. events receives the events and streams, if not NULL, the
+ * stream of each. Events with equal timestamps come out in stream order.
+ * Only one thread may pop at a time.
+ */
+HANDEL_EXPORT int HANDEL_API xiaPopListEvents(XiaListMerger* merger, size_t max,
+                                              XiaListEvents* events,
+                                              unsigned int* streams) {
+    int status;
+
+    unsigned int i;
+
+    size_t n = 0;
+    size_t nHeap = 0;
+    size_t mask;
+
+    uint64_t watermark = UINT64_MAX;
+
+    boolean_t blocked = FALSE_;
+
+    if (merger == NULL || events == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaPopListEvents",
+               "merger and events may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    status = xiaReserveListEvents(events, max);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaPopListEvents",
+               "Unable to allocate %zu merged events", max);
+        return status;
+    }
+
+    events->nEvents = 0;
+    mask = merger->capacity - 1;
+
+    handel_md_mutex_lock(&merger->lock);
+
+    for (i = 0; i < merger->nStreams; i++) {
+        MergeStream* s = &merger->streams[i];
+
+        merger->heads[i] = s->head;
+        merger->tails[i] = s->tail;
+
+        if (!s->finished) {
+            /* A stream that has not started could still send the earliest event. */
+            if (!s->started) {
+                blocked = TRUE_;
+            } else if (s->latest < watermark) {
+                watermark = s->latest;
+            }
+        }
+    }
+
+    handel_md_mutex_unlock(&merger->lock);
+
+    if (blocked) {
+        return XIA_SUCCESS;
+    }
+
+    for (i = 0; i < merger->nStreams; i++) {
+        if (merger->heads[i] != merger->tails[i]) {
+            merger->heap[nHeap++] = i;
+        }
+    }
+
+    for (i = (unsigned int) (nHeap / 2); i-- > 0;) {
+        xiaMergeSiftDown(merger, nHeap, i);
+    }
+
+    while (nHeap > 0 && n < max) {
+        unsigned int top = merger->heap[0];
+        MergeStream* s = &merger->streams[top];
+        size_t k = merger->heads[top] & mask;
+
+        if (s->timestamp[k] > watermark) {
+            break;
+        }
+
+        events->timestamp[n] = s->timestamp[k];
+        events->energy[n] = s->energy[k];
+        events->channel[n] = s->channel[k];
+        events->flags[n] = s->flags[k];
+        events->pixel[n] = s->pixel[k];
+
+        if (streams != NULL) {
+            streams[n] = top;
+        }
+
+        n++;
+
+        if (++merger->heads[top] == merger->tails[top]) {
+            merger->heap[0] = merger->heap[--nHeap];
+        }
+
+        xiaMergeSiftDown(merger, nHeap, 0);
+    }
+
+    events->nEvents = n;
+
+    /* Hand the slots of the popped events back to the pushers. */
+    handel_md_mutex_lock(&merger->lock);
+
+    for (i = 0; i < merger->nStreams; i++) {
+        merger->streams[i].head = merger->heads[i];
+    }
+
+    handel_md_mutex_unlock(&merger->lock);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Checks the merger and stream arguments of a merger routine.
+ */
+static int xiaCheckStream(const char* fn, XiaListMerger* merger, unsigned int stream) {
+    if (merger == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, fn, "merger may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (stream >= merger->nStreams) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, fn,
+               "Stream %u is out of range for a merger of %u streams", stream,
+               merger->nStreams);
+        return XIA_BAD_VALUE;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Frees a merger and whatever of its arrays were allocated.
+ */
+static void xiaFreeStreams(XiaListMerger* merger) {
+    unsigned int i;
+
+    if (merger->streams != NULL) {
+        for (i = 0; i < merger->nStreams; i++) {
+            MergeStream* s = &merger->streams[i];
+
+            free(s->timestamp);
+            free(s->energy);
+            free(s->channel);
+            free(s->flags);
+            free(s->pixel);
+        }
+    }
+
+    free(merger->streams);
+    free(merger->heads);
+    free(merger->tails);
+    free(merger->heap);
+    free(merger);
+}
+
+/*
+ * Orders two streams by their oldest event not yet popped, then by index.
+ */
+static boolean_t xiaMergeBefore(const XiaListMerger* merger, unsigned int a,
+                                unsigned int b) {
+    size_t mask = merger->capacity - 1;
+
+    uint64_t ta = merger->streams[a].timestamp[merger->heads[a] & mask];
+    uint64_t tb = merger->streams[b].timestamp[merger->heads[b] & mask];
+
+    return ta < tb || (ta == tb && a < b);
+}
+
+/*
+ * Moves heap entry i down to its place among the n entries.
+ */
+static void xiaMergeSiftDown(XiaListMerger* merger, size_t n, size_t i) {
+    unsigned int* heap = merger->heap;
+
+    for (;;) {
+        size_t least = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+
+        unsigned int swap;
+
+        if (left < n && xiaMergeBefore(merger, heap[left], heap[least])) {
+            least = left;
+        }
+
+        if (right < n && xiaMergeBefore(merger, heap[right], heap[least])) {
+            least = right;
+        }
+
+        if (least == i) {
+            return;
+        }
+
+        swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
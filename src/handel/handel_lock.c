@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_lock.c
+ * @brief Locks that let independent modules be driven from separate threads.
+ *
+ * Each module owns a recursive mutex that serializes everything that touches
+ * its hardware: the PSL, the Xerxes board and the transport handle. Run
+ * control, run data, acquisition value, gain, parameter, firmware and board
+ * operations take the module lock, so threads that each own a module, in the
+ * same context or in different ones, drive them in parallel. The few
+ * process-wide resources those operations share have their own narrow locks:
+ * the FDD parser in fdd.c, the file handle list in xia_file.c and the DSP
+ * cache and symbol lists in Xerxes.
+ *
+ * Calls that change the system configuration (xiaInit(), xiaStartSystem(),
+ * xiaExit(), xiaLoadSystem() and the xiaNew*, xiaAdd*, xiaModify* and
+ * xiaRemove* families) are not locked. They must not run concurrently with
+ * any other Handel call. Neither are the raw xiaMemoryOperation() and
+ * xiaCommandOperation() routines.
+ *
+ * Each module also owns a cancellation token. The thread that holds the
+ * module lock is bound to it, and the wait engine and the MD transports
+ * poll it between I/O steps. xiaCancel() cancels the tokens of a detChan's
+ * modules, which makes the calls that hold those locks fail at their next
+ * I/O step instead of waiting out their timeouts. The layers below report
+ * DXP_CANCELLED; xiaCancelStatus() turns it into XIA_CANCELLED where Handel
+ * hands a PSL status back to the caller. Calls that take the lock after
+ * xiaCancel() are not affected.
+ */
+
+#include <stddef.h>
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+
+#include "handel_errors.h"
+#include "handel_log.h"
+#include "md_threads.h"
+#include "xerxes_errors.h"
+
+/*
+ * Creates the lock for a new module.
+ */
+int HANDEL_API xiaInitModuleLock(Module* module) {
+    ASSERT(module != NULL);
+
+    module->lock.handle = NULL;
+    module->lock.name = module->alias;
+
+    handel_md_cancel_init(&module->cancel);
+    module->lockDepth = 0;
+
+    if (handel_md_mutex_create(&module->lock) != THREADING_NO_ERROR) {
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaInitModuleLock",
+               "Error creating the lock for module '%s'", module->alias);
+        return XIA_THREAD_ERROR;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Destroys a module's lock. The module must not be locked.
+ */
+void HANDEL_API xiaFreeModuleLock(Module* module) {
+    ASSERT(module != NULL);
+
+    if (handel_md_mutex_ready(&module->lock)) {
+        handel_md_mutex_destroy(&module->lock);
+    }
+}
+
+/*
+ * Locks the module that detChan belongs to and returns it. detChan must be
+ * a valid SINGLE detChan. Release with xiaUnlockModule(). Returns NULL,
+ * without taking the lock, if detChan has no module.
+ */
+Module* HANDEL_API xiaLockModule(int detChan) {
+    char* alias = xiaGetAliasFromDetChan(detChan);
+    Module* module = alias == NULL ? NULL : xiaFindModule(alias);
+
+    if (module == NULL) {
+        return NULL;
+    }
+
+    handel_md_mutex_lock(&module->lock);
+
+    if (module->lockDepth++ == 0) {
+        handel_md_cancel_enter(&module->cancel, &module->cancelScope);
+    }
+
+    return module;
+}
+
+/*
+ * Releases the lock taken by xiaLockModule().
+ */
+void HANDEL_API xiaUnlockModule(Module* module) {
+    ASSERT(module != NULL);
+
+    if (--module->lockDepth == 0) {
+        handel_md_cancel_leave(&module->cancelScope);
+    }
+
+    handel_md_mutex_unlock(&module->lock);
+}
+
+/*
+ * Cancels the work in progress on the modules of detChan, which may be a
+ * detChan set. Does not wait for the cancelled calls to return; they fail
+ * with XIA_CANCELLED at their next I/O step. A running xiaStartSystem()
+ * is cancelled as a whole, including the module that is being set up when
+ * it holds that module's lock.
+ */
+HANDEL_EXPORT int HANDEL_API xiaCancel(int detChan) {
+    int status;
+
+    unsigned int i;
+    unsigned int nMembers = 0;
+
+    int* members = NULL;
+
+    status = xiaCountSetMembers(detChan, &nMembers);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaCancel",
+               "detChan number %d is not in the list of valid values", detChan);
+        return status;
+    }
+
+    members = handel_md_alloc(nMembers * sizeof(int));
+
+    if (members == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaCancel",
+               "Unable to allocate the member list for detChan %d", detChan);
+        return XIA_NOMEM;
+    }
+
+    nMembers = 0;
+    xiaCollectSetMembers(detChan, members, &nMembers);
+
+    for (i = 0; i < nMembers; i++) {
+        char* alias = xiaGetAliasFromDetChan(members[i]);
+        Module* module = alias == NULL ? NULL : xiaFindModule(alias);
+
+        if (module != NULL) {
+            handel_md_cancel_request(&module->cancel);
+        }
+    }
+
+    handel_md_free(members);
+
+    handel_md_cancel_request(&xiaContext->cancel);
+
+    xiaLog(XIA_LOG_INFO, "xiaCancel", "Cancelled the work in progress on detChan %d",
+           detChan);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Maps the DXP_CANCELLED that a PSL passes up from Xerxes or the MD layer
+ * to XIA_CANCELLED. Other status codes are returned unchanged.
+ */
+int HANDEL_API xiaCancelStatus(int status) {
+    return status == DXP_CANCELLED ? XIA_CANCELLED : status;
+}
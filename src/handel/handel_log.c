@@ -41,12 +41,13 @@
 #include "handel_generic.h"
 #include "handel_log.h"
 #include "handeldef.h"
+#include "xia_common.h"
 #include "xia_handel.h"
 
 /**
  * Format the log messages into this buffer.
  */
-static char formatBuffer[2048];
+static XIA_THREAD_LOCAL char formatBuffer[2048];
 
 /**
  * This routine enables the logging output
@@ -0,0 +1,492 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_map_tune.c
+ * @brief Measures the mapping buffers of the first part of a run and
+ * recommends a num_map_pixels_per_buffer for the module, see
+ * xiaSetMapTune().
+ *
+ * The module fills one buffer while the host reads the other and marks it
+ * done. A buffer size is safe when filling a buffer takes longer than the
+ * host needs to service the other one; the ratio of the two is the
+ * headroom. Small buffers keep the latency low but switch often, large
+ * buffers switch rarely but risk an overrun when the host stalls.
+ *
+ * Once enabled, xiaStartRun(), xiaGetRunData() and xiaBoardOperation()
+ * pass the buffer traffic of the module through the hooks below:
+ *
+ *   - a buffer starts filling when the run starts or, for the other
+ *     buffer, when the one before it is seen full, or when it is marked
+ *     done if the other buffer was already full then,
+ *   - it has filled when buffer_full_a or buffer_full_b first reads
+ *     nonzero,
+ *   - its service time is the time spent reading it, whole or in partial
+ *     reads, plus the time spent in buffer_done.
+ *
+ * After the requested number of buffers the means are turned into a pixel
+ * rate and a headroom. The read time is taken to grow with the pixels in
+ * the buffer and the buffer_done time to be fixed, so the smallest buffer
+ * that reaches the target headroom h at pixel rate r is
+ *
+ *   n = h * done / (1 / r - h * read per pixel)
+ *
+ * If the denominator is not positive the host cannot keep up at that
+ * headroom whatever the size, and the maximum the module allows is
+ * recommended instead; see xia_map_tune_size(). The size of a buffer
+ * cannot change during a run, so with XIA_MAP_TUNE_APPLY the value is
+ * written once xiaStopRun() has released the module and takes effect
+ * from the next run.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+#include "xia_mapping.h"
+
+#include "handel_constants.h"
+#include "handel_errors.h"
+#include "handel_log.h"
+#include "handel_mapping.h"
+#include "md_threads.h"
+#include <util/xia_map_tune.h>
+
+#define MAP_TUNE_DEFAULT_HEADROOM 2.0
+
+struct MapTune {
+    unsigned int nBuffers; /* buffers to measure per run */
+    double target;         /* headroom the recommendation is sized for */
+    unsigned int flags;
+
+    boolean_t active;
+
+    /* Per buffer, A then B. A negative time is not known yet. */
+    boolean_t full[2];
+    double fillStart[2];
+    double fillTime[2];
+    double readTime[2];
+    unsigned long pixels[2];
+
+    double fillSum;
+    double readSum;
+    double doneSum;
+    double pixelSum;
+
+    XiaMapTune result;
+};
+
+static int xiaBufferIndex(const char* name);
+static void xiaFinishMapTune(Module* module, struct MapTune* tune);
+
+/*
+ * Measures the mapping buffers of the module of detChan from its next run
+ * on, see handel_map_tune.c. nBuffers is the number of buffers to measure
+ * at the start of each run; 0 turns the tuner off. headroom is the ratio
+ * of fill time to service time the recommendation is sized for, 0 for the
+ * default of 2. With XIA_MAP_TUNE_APPLY in flags the recommended value is
+ * set on every channel of the module when the run stops.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetMapTune(int detChan, unsigned int nBuffers,
+                                           double headroom, unsigned int flags) {
+    Module* module;
+
+    if (xiaGetElemType((unsigned int) detChan) != SINGLE) {
+        xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaSetMapTune",
+               "detChan %d is not a single channel", detChan);
+        return XIA_INVALID_DETCHAN;
+    }
+
+    if (headroom < 0.0 || (headroom > 0.0 && headroom < 1.0)) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaSetMapTune",
+               "A headroom of %0.3f cannot keep up with the module", headroom);
+        return XIA_BAD_VALUE;
+    }
+
+    if ((flags & ~((unsigned int) XIA_MAP_TUNE_APPLY)) != 0) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaSetMapTune",
+               "Unknown flags %#x", flags);
+        return XIA_BAD_VALUE;
+    }
+
+    module = xiaLockModule(detChan);
+
+    if (nBuffers == 0) {
+        xiaFreeMapTune(module);
+        xiaUnlockModule(module);
+        return XIA_SUCCESS;
+    }
+
+    if (module->tune == NULL) {
+        module->tune = handel_md_alloc(sizeof(struct MapTune));
+
+        if (module->tune == NULL) {
+            xiaUnlockModule(module);
+            xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaSetMapTune",
+                   "Unable to allocate the tuner for module '%s'", module->alias);
+            return XIA_NOMEM;
+        }
+
+        memset(module->tune, 0, sizeof(struct MapTune));
+    }
+
+    module->tune->nBuffers = nBuffers;
+    module->tune->target = headroom > 0.0 ? headroom : MAP_TUNE_DEFAULT_HEADROOM;
+    module->tune->flags = flags;
+
+    xiaUnlockModule(module);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Copies the measurement of the current or most recent run of the module
+ * of detChan into result. result->complete is set once the requested
+ * number of buffers has been measured.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetMapTune(int detChan, XiaMapTune* result) {
+    Module* module;
+
+    if (result == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetMapTune",
+               "result cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (xiaGetElemType((unsigned int) detChan) != SINGLE) {
+        xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaGetMapTune",
+               "detChan %d is not a single channel", detChan);
+        return XIA_INVALID_DETCHAN;
+    }
+
+    module = xiaLockModule(detChan);
+
+    if (module->tune == NULL) {
+        xiaUnlockModule(module);
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaGetMapTune",
+               "The tuner is not enabled for module '%s'", module->alias);
+        return XIA_BAD_VALUE;
+    }
+
+    *result = module->tune->result;
+
+    xiaUnlockModule(module);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Releases the tuner of the module, if it has one.
+ */
+void HANDEL_API xiaFreeMapTune(Module* module) {
+    ASSERT(module != NULL);
+
+    if (module->tune != NULL) {
+        handel_md_free(module->tune);
+        module->tune = NULL;
+    }
+}
+
+/*
+ * Called with the module locked once its run has started. Buffer A starts
+ * filling now; B waits for A.
+ */
+void HANDEL_API xiaMapTuneStarted(Module* module) {
+    struct MapTune* tune = module->tune;
+
+    unsigned int i;
+
+    if (tune == NULL) {
+        return;
+    }
+
+    tune->active = TRUE_;
+
+    for (i = 0; i < 2; i++) {
+        tune->full[i] = FALSE_;
+        tune->fillStart[i] = -1.0;
+        tune->fillTime[i] = -1.0;
+        tune->readTime[i] = 0.0;
+        tune->pixels[i] = 0;
+    }
+
+    tune->fillStart[0] = handel_md_clock();
+
+    tune->fillSum = 0.0;
+    tune->readSum = 0.0;
+    tune->doneSum = 0.0;
+    tune->pixelSum = 0.0;
+
+    memset(&tune->result, 0, sizeof(tune->result));
+}
+
+/*
+ * Called with the module locked after xiaGetRunData() read name into
+ * value; the read began at started.
+ */
+void HANDEL_API xiaMapTuneRunData(Module* module, const char* name, const void* value,
+                                  double started) {
+    struct MapTune* tune = module->tune;
+
+    double now = handel_md_clock();
+
+    int b;
+
+    if (tune == NULL || !tune->active || tune->result.complete) {
+        return;
+    }
+
+    if (STREQ(name, "buffer_full_a") || STREQ(name, "buffer_full_b")) {
+        b = name[12] == 'a' ? 0 : 1;
+
+        if (*((const unsigned short*) value) == 0 || tune->full[b]) {
+            return;
+        }
+
+        tune->full[b] = TRUE_;
+
+        if (tune->fillStart[b] >= 0.0) {
+            tune->fillTime[b] = now - tune->fillStart[b];
+        }
+
+        if (!tune->full[1 - b]) {
+            tune->fillStart[1 - b] = now;
+        }
+
+        return;
+    }
+
+    b = xiaBufferIndex(name);
+
+    if (b >= 0) {
+        const unsigned long* buffer = (const unsigned long*) value;
+
+        tune->readTime[b] += now - started;
+
+        if (MAP_WORD(buffer[0]) == MAP_BUFFER_TAG0 &&
+            MAP_WORD(buffer[1]) == MAP_BUFFER_TAG1 &&
+            MAP_WORD(buffer[MAP_BH_MAPPING_MODE]) != MAP_MODE_LIST) {
+            /* A partial read only counts the pixels written so far. */
+            tune->pixels[b] = MAX(tune->pixels[b], MAP_WORD(buffer[MAP_BH_N_PIXELS]));
+        }
+    }
+}
+
+/*
+ * Called with the module locked after xiaBoardOperation() ran name; the
+ * operation began at started.
+ */
+void HANDEL_API xiaMapTuneBoardOperation(Module* module, const char* name,
+                                         const void* value, double started) {
+    struct MapTune* tune = module->tune;
+
+    double now = handel_md_clock();
+
+    char buffer;
+    int b;
+
+    if (tune == NULL || !tune->active || tune->result.complete ||
+        !STREQ(name, "buffer_done")) {
+        return;
+    }
+
+    buffer = *((const char*) value);
+    b = (buffer == 'a' || buffer == 'A') ? 0 : 1;
+
+    if (tune->fillTime[b] >= 0.0) {
+        tune->fillSum += tune->fillTime[b];
+        tune->readSum += tune->readTime[b];
+        tune->doneSum += now - started;
+        tune->pixelSum += (double) tune->pixels[b];
+        tune->result.nBuffers++;
+    }
+
+    tune->full[b] = FALSE_;
+    tune->fillStart[b] = tune->full[1 - b] ? now : -1.0;
+    tune->fillTime[b] = -1.0;
+    tune->readTime[b] = 0.0;
+    tune->pixels[b] = 0;
+
+    if (tune->result.nBuffers == tune->nBuffers) {
+        xiaFinishMapTune(module, tune);
+    }
+}
+
+/*
+ * Called with the module locked once its run has stopped. Returns TRUE_
+ * if the recommendation is to be applied, with the value to set in value.
+ * The caller applies it with xiaApplyMapTune() after releasing the module.
+ */
+boolean_t HANDEL_API xiaMapTuneStopped(Module* module, double* value) {
+    struct MapTune* tune = module->tune;
+
+    if (tune == NULL || !tune->active) {
+        return FALSE_;
+    }
+
+    tune->active = FALSE_;
+
+    if (!tune->result.complete) {
+        xiaLog(XIA_LOG_WARNING, "xiaMapTuneStopped",
+               "The run of module '%s' stopped after %u of %u tuning buffers",
+               module->alias, tune->result.nBuffers, tune->nBuffers);
+        return FALSE_;
+    }
+
+    if ((tune->flags & XIA_MAP_TUNE_APPLY) == 0) {
+        return FALSE_;
+    }
+
+    /* 0 selects the maximum, which the acquisition value spells -1. */
+    *value = tune->result.recommended > 0 ? (double) tune->result.recommended : -1.0;
+
+    return TRUE_;
+}
+
+/*
+ * Sets value, from xiaMapTuneStopped(), as num_map_pixels_per_buffer on
+ * every channel of the module, after the caller has released the module
+ * lock, so the sets run like any other xiaSetAcquisitionValues() call.
+ */
+int HANDEL_API xiaApplyMapTune(Module* module, double value) {
+    int status;
+    int first = -1;
+    int ignore = 0;
+
+    unsigned int i;
+
+    if (value < 0.0) {
+        xiaLog(XIA_LOG_WARNING, "xiaApplyMapTune",
+               "No recommended size for module '%s', setting "
+               "num_map_pixels_per_buffer to -1 for the maximum",
+               module->alias);
+    }
+
+    for (i = 0; i < module->number_of_channels; i++) {
+        int detChan = module->channels[i];
+
+        if (detChan == -1) {
+            continue;
+        }
+
+        status = xiaSetAcquisitionValues(detChan, "num_map_pixels_per_buffer", &value);
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "xiaApplyMapTune",
+                   "Error setting num_map_pixels_per_buffer for detChan %d", detChan);
+            return status;
+        }
+
+        if (first == -1) {
+            first = detChan;
+        }
+    }
+
+    if (first == -1) {
+        return XIA_SUCCESS;
+    }
+
+    status = xiaBoardOperation(first, "apply", &ignore);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaApplyMapTune",
+               "Error applying num_map_pixels_per_buffer for module '%s'",
+               module->alias);
+        return status;
+    }
+
+    xiaLockModule(first);
+
+    if (module->tune != NULL) {
+        module->tune->result.applied = 1;
+    }
+
+    xiaUnlockModule(module);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Returns 0 for the names that read buffer A, 1 for those that read
+ * buffer B and -1 otherwise.
+ */
+static int xiaBufferIndex(const char* name) {
+    if (STREQ(name, "buffer_a") || STREQ(name, "buffer_packed_a") ||
+        STREQ(name, "buffer_partial_a")) {
+        return 0;
+    }
+
+    if (STREQ(name, "buffer_b") || STREQ(name, "buffer_packed_b") ||
+        STREQ(name, "buffer_partial_b")) {
+        return 1;
+    }
+
+    return -1;
+}
+
+/*
+ * Turns the sums into the result and logs it.
+ */
+static void xiaFinishMapTune(Module* module, struct MapTune* tune) {
+    XiaMapTune* result = &tune->result;
+
+    double n = (double) result->nBuffers;
+    double service;
+
+    result->fillTime = tune->fillSum / n;
+    result->readTime = tune->readSum / n;
+    result->doneTime = tune->doneSum / n;
+    result->pixels = tune->pixelSum / n;
+    result->target = tune->target;
+    result->complete = 1;
+
+    service = result->readTime + result->doneTime;
+
+    result->headroom = service > 0.0 ? result->fillTime / service : 0.0;
+    result->pixelRate = result->fillTime > 0.0 ? result->pixels / result->fillTime
+                                               : 0.0;
+    result->recommended = xia_map_tune_size(result->fillTime, result->readTime,
+                                            result->doneTime, result->pixels,
+                                            tune->target);
+
+    xiaLog(XIA_LOG_INFO, "xiaFinishMapTune",
+           "Module '%s': %u buffers of %0.1f pixels, fill %0.3f ms, read %0.3f ms, "
+           "done %0.3f ms, %0.1f pixels/s, headroom %0.2f",
+           module->alias, result->nBuffers, result->pixels, result->fillTime * 1.0e3,
+           result->readTime * 1.0e3, result->doneTime * 1.0e3, result->pixelRate,
+           result->headroom);
+
+    if (result->headroom < tune->target) {
+        xiaLog(XIA_LOG_WARNING, "xiaFinishMapTune",
+               "Module '%s' has a headroom of %0.2f, below the target of %0.2f",
+               module->alias, result->headroom, tune->target);
+    }
+
+    if (result->recommended == 0) {
+        xiaLog(XIA_LOG_WARNING, "xiaFinishMapTune",
+               "No buffer size reaches a headroom of %0.2f on module '%s', "
+               "recommending the maximum",
+               tune->target, module->alias);
+    } else {
+        xiaLog(XIA_LOG_INFO, "xiaFinishMapTune",
+               "Recommended num_map_pixels_per_buffer for module '%s' = %lu",
+               module->alias, result->recommended);
+    }
+}
@@ -0,0 +1,1065 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_mapping.c
+ * @brief Decoders for the mapping buffers of the xMAP, Mercury and STJ.
+ *
+ * xiaGetRunData("buffer_a"/"buffer_b") returns one 16-bit word in each
+ * unsigned long element. A buffer starts with a 256-word buffer header
+ * followed by one block per pixel. In MCA mode a pixel block is a 256-word
+ * pixel header, holding the statistics of each channel, followed by the
+ * spectrum of each channel, one word per bin. In SCA mode the pixel header
+ * is 64 words and is followed by the SCA counters of each channel. 32-bit
+ * values, including the SCA counters, are split across two words, low
+ * word first.
+ *
+ * In list mode the buffer header is followed by fixed-size event records.
+ * The header gives the list mode variant, the words per event, the number
+ * of events and the total length of the buffer, which may end in padding.
+ * Each record starts with the energy, a word holding the channel in its
+ * low byte and status flags in its high byte, and the 32-bit event clock.
+ * The pixel variants append the 32-bit pixel number of the event.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_mapping.h"
+
+#include "handel_constants.h"
+#include "handel_errors.h"
+#include "handel_log.h"
+#include "handel_mapping.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAPPING_SSE2
+#endif
+
+/* List mode event record layout, in words */
+#define MAP_EV_ENERGY 0
+#define MAP_EV_CHANNEL 1
+#define MAP_EV_TIME 2
+#define MAP_EV_PIXEL 4
+#define MAP_CLOCK_EVENT_SIZE 4
+#define MAP_PIXEL_EVENT_SIZE 6
+
+/* Event records are unpacked to 32 bits this many words at a time. */
+#define MAP_LIST_BLOCK_WORDS 1024
+
+static int xiaCheckBufferHeader(const unsigned long* buffer, unsigned long len,
+                                unsigned long mode);
+static int xiaReserve(void** array, size_t* capacity, size_t n, size_t size);
+static int xiaReserveStats(unsigned long** stats[4], size_t* capacity, size_t n);
+static boolean_t xiaIsPixelHeader(const unsigned long* block, unsigned long headerSize,
+                                  unsigned long mode, unsigned long blockSize);
+static void xiaReadPixelStats(const unsigned long* block, const unsigned int* present,
+                              unsigned int nChannels, size_t k,
+                              unsigned long** stats[4]);
+static int xiaReadListHeader(XiaListDecoder* decoder);
+static void xiaDecodeListEvents(XiaListDecoder* decoder, const unsigned long* src,
+                                size_t n, XiaListEvents* events);
+static void xiaExtractListEvents(XiaListDecoder* decoder, const unsigned int* words,
+                                 size_t n, XiaListEvents* events);
+static void xiaExtractListEvent(XiaListDecoder* decoder, const unsigned int* record,
+                                XiaListEvents* events, size_t k);
+
+/*
+ * Splits an MCA mapping buffer into its pixels. buffer and len are the
+ * data and length returned by xiaGetRunData("buffer_a"/"buffer_b") and
+ * "buffer_len". Channels with no spectrum in the buffer, such as the
+ * missing channels of a Mercury-1, are left out of the decoded arrays.
+ */
+HANDEL_EXPORT int HANDEL_API xiaDecodeMCABuffer(const unsigned long* buffer,
+                                                unsigned long len,
+                                                XiaMCAPixels* pixels) {
+    int status;
+
+    unsigned int i;
+    unsigned int c;
+    unsigned int nPixels;
+    unsigned int nChannels = 0;
+    unsigned int mcaLength = 0;
+    unsigned int present[MAP_MAX_CHANNELS];
+
+    unsigned long blockSize;
+
+    const unsigned long* block;
+
+    unsigned long** stats[4];
+
+    if (buffer == NULL || pixels == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaDecodeMCABuffer",
+               "buffer and pixels may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    status = xiaCheckBufferHeader(buffer, len, MAP_MODE_MCA);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaDecodeMCABuffer",
+               "Invalid MCA mapping buffer header");
+        return status;
+    }
+
+    stats[0] = &pixels->realtime;
+    stats[1] = &pixels->livetime;
+    stats[2] = &pixels->triggers;
+    stats[3] = &pixels->events;
+
+    nPixels = (unsigned int) MAP_WORD(buffer[MAP_BH_N_PIXELS]);
+    block = buffer + MAP_BUFFER_HEADER_SIZE;
+
+    /* Every pixel of a run has the same layout; take it from the first. */
+    if (nPixels > 0) {
+        if (len < MAP_BUFFER_HEADER_SIZE + MAP_MCA_PIXEL_HEADER_SIZE) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeMCABuffer",
+                   "Buffer length %lu is too short for %u pixels", len, nPixels);
+            return XIA_MALFORMED_BUFFER;
+        }
+
+        for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+            unsigned int size = (unsigned int) MAP_WORD(block[MAP_PH_CHANNEL_SIZE + c]);
+
+            if (size == 0) {
+                continue;
+            }
+
+            if (mcaLength != 0 && size != mcaLength) {
+                xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeMCABuffer",
+                       "Channel %u has %u bins, expected %u", c, size, mcaLength);
+                return XIA_MALFORMED_BUFFER;
+            }
+
+            mcaLength = size;
+            present[nChannels++] = c;
+        }
+    }
+
+    blockSize = MAP_MCA_PIXEL_HEADER_SIZE + (unsigned long) nChannels * mcaLength;
+
+    if ((len - MAP_BUFFER_HEADER_SIZE) / blockSize < nPixels) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeMCABuffer",
+               "Buffer length %lu is too short for %u pixels of %lu words", len,
+               nPixels, blockSize);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    status = xiaReserve((void**) &pixels->pixel, &pixels->pixelCapacity, nPixels,
+                        sizeof(unsigned long));
+
+    if (status == XIA_SUCCESS) {
+        status = xiaReserveStats(stats, &pixels->statCapacity,
+                                 (size_t) nPixels * nChannels);
+    }
+
+    if (status == XIA_SUCCESS) {
+        status = xiaReserve((void**) &pixels->spectra, &pixels->spectraCapacity,
+                            (size_t) nPixels * nChannels * mcaLength,
+                            sizeof(unsigned int));
+    }
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaDecodeMCABuffer",
+               "Unable to allocate the decoded arrays for %u pixels", nPixels);
+        return status;
+    }
+
+    pixels->runNumber = (unsigned int) MAP_WORD(buffer[MAP_BH_RUN_NUMBER]);
+    pixels->bufferNumber = MAP_WORD32(buffer + MAP_BH_BUFFER_NUMBER);
+    pixels->bufferId = (unsigned int) MAP_WORD(buffer[MAP_BH_BUFFER_ID]);
+    pixels->startPixel = MAP_WORD32(buffer + MAP_BH_START_PIXEL);
+    pixels->serialNumber = (unsigned int) MAP_WORD(buffer[MAP_BH_SERIAL_NUMBER]);
+    pixels->nPixels = nPixels;
+    pixels->nChannels = nChannels;
+    pixels->mcaLength = mcaLength;
+
+    for (i = 0; i < nPixels; i++, block += blockSize) {
+        const unsigned long* spectrum = block + MAP_MCA_PIXEL_HEADER_SIZE;
+
+        if (!xiaIsPixelHeader(block, MAP_MCA_PIXEL_HEADER_SIZE, MAP_MODE_MCA,
+                              blockSize)) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeMCABuffer",
+                   "Invalid header for pixel %u of the buffer", i);
+            return XIA_MALFORMED_BUFFER;
+        }
+
+        pixels->pixel[i] = MAP_WORD32(block + MAP_PH_PIXEL);
+
+        xiaReadPixelStats(block, present, nChannels, (size_t) i * nChannels,
+                          stats);
+
+        /* The spectra of the channels in the buffer are contiguous. */
+        xiaUnpackWords(spectrum, pixels->spectra + (size_t) i * nChannels * mcaLength,
+                       (size_t) nChannels * mcaLength);
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Releases the arrays of a decoded MCA buffer and zeroes it for reuse.
+ */
+HANDEL_EXPORT int HANDEL_API xiaFreeMCAPixels(XiaMCAPixels* pixels) {
+    if (pixels == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaFreeMCAPixels",
+               "pixels may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    free(pixels->pixel);
+    free(pixels->spectra);
+    free(pixels->realtime);
+    free(pixels->livetime);
+    free(pixels->triggers);
+    free(pixels->events);
+
+    memset(pixels, 0, sizeof(*pixels));
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Splits an SCA mapping buffer into its pixels. With XIA_SCA_DEADTIME_CORRECT
+ * in flags, the dead-time corrected counters are computed in the same pass.
+ * Channels with no SCAs in the buffer are left out of the decoded arrays.
+ */
+HANDEL_EXPORT int HANDEL_API xiaDecodeSCABuffer(const unsigned long* buffer,
+                                                unsigned long len, int flags,
+                                                XiaSCAPixels* pixels) {
+    int status;
+
+    unsigned int i;
+    unsigned int c;
+    unsigned int nPixels;
+    unsigned int nChannels = 0;
+    unsigned int nSCAs = 0;
+    unsigned int present[MAP_MAX_CHANNELS];
+    unsigned int count[MAP_MAX_CHANNELS];
+
+    unsigned long blockSize = MAP_SCA_PIXEL_HEADER_SIZE;
+
+    size_t nCounters;
+
+    const unsigned long* block;
+
+    unsigned long** stats[4];
+
+    if (buffer == NULL || pixels == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaDecodeSCABuffer",
+               "buffer and pixels may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if ((flags & ~XIA_SCA_DEADTIME_CORRECT) != 0) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaDecodeSCABuffer",
+               "Unknown flags %#x", flags);
+        return XIA_BAD_VALUE;
+    }
+
+    status = xiaCheckBufferHeader(buffer, len, MAP_MODE_SCA);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaDecodeSCABuffer",
+               "Invalid SCA mapping buffer header");
+        return status;
+    }
+
+    stats[0] = &pixels->realtime;
+    stats[1] = &pixels->livetime;
+    stats[2] = &pixels->triggers;
+    stats[3] = &pixels->events;
+
+    nPixels = (unsigned int) MAP_WORD(buffer[MAP_BH_N_PIXELS]);
+    block = buffer + MAP_BUFFER_HEADER_SIZE;
+
+    if (nPixels > 0) {
+        if (len < MAP_BUFFER_HEADER_SIZE + MAP_SCA_PIXEL_HEADER_SIZE) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeSCABuffer",
+                   "Buffer length %lu is too short for %u pixels", len, nPixels);
+            return XIA_MALFORMED_BUFFER;
+        }
+
+        for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+            unsigned int n = (unsigned int) MAP_WORD(block[MAP_PH_CHANNEL_SIZE + c]);
+
+            if (n == 0) {
+                continue;
+            }
+
+            present[nChannels] = c;
+            count[nChannels++] = n;
+            nSCAs = n > nSCAs ? n : nSCAs;
+
+            /* Each counter is two words. */
+            blockSize += 2 * (unsigned long) n;
+        }
+    }
+
+    if ((len - MAP_BUFFER_HEADER_SIZE) / blockSize < nPixels) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeSCABuffer",
+               "Buffer length %lu is too short for %u pixels of %lu words", len,
+               nPixels, blockSize);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    nCounters = (size_t) nPixels * nChannels * nSCAs;
+
+    status = xiaReserve((void**) &pixels->pixel, &pixels->pixelCapacity, nPixels,
+                        sizeof(unsigned long));
+
+    if (status == XIA_SUCCESS) {
+        status = xiaReserveStats(stats, &pixels->statCapacity,
+                                 (size_t) nPixels * nChannels);
+    }
+
+    if (status == XIA_SUCCESS) {
+        status = xiaReserve((void**) &pixels->sca, &pixels->scaCapacity, nCounters,
+                            sizeof(unsigned int));
+    }
+
+    if (status == XIA_SUCCESS && (flags & XIA_SCA_DEADTIME_CORRECT)) {
+        status = xiaReserve((void**) &pixels->corrected, &pixels->correctedCapacity,
+                            nCounters, sizeof(float));
+    }
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaDecodeSCABuffer",
+               "Unable to allocate the decoded arrays for %u pixels", nPixels);
+        return status;
+    }
+
+    pixels->runNumber = (unsigned int) MAP_WORD(buffer[MAP_BH_RUN_NUMBER]);
+    pixels->bufferNumber = MAP_WORD32(buffer + MAP_BH_BUFFER_NUMBER);
+    pixels->bufferId = (unsigned int) MAP_WORD(buffer[MAP_BH_BUFFER_ID]);
+    pixels->startPixel = MAP_WORD32(buffer + MAP_BH_START_PIXEL);
+    pixels->serialNumber = (unsigned int) MAP_WORD(buffer[MAP_BH_SERIAL_NUMBER]);
+    pixels->nPixels = nPixels;
+    pixels->nChannels = nChannels;
+    pixels->nSCAs = nSCAs;
+
+    for (i = 0; i < nPixels; i++, block += blockSize) {
+        const unsigned long* counters = block + MAP_SCA_PIXEL_HEADER_SIZE;
+
+        if (!xiaIsPixelHeader(block, MAP_SCA_PIXEL_HEADER_SIZE, MAP_MODE_SCA,
+                              blockSize)) {
+            xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaDecodeSCABuffer",
+                   "Invalid header for pixel %u of the buffer", i);
+            return XIA_MALFORMED_BUFFER;
+        }
+
+        pixels->pixel[i] = MAP_WORD32(block + MAP_PH_PIXEL);
+
+        xiaReadPixelStats(block, present, nChannels, (size_t) i * nChannels, stats);
+
+        for (c = 0; c < nChannels; c++) {
+            size_t k = (size_t) i * nChannels + c;
+            unsigned int* sca = pixels->sca + k * nSCAs;
+
+            xiaUnpackWords32(counters, sca, count[c]);
+            memset(sca + count[c], 0, (nSCAs - count[c]) * sizeof(unsigned int));
+            counters += 2 * (size_t) count[c];
+
+            /* Scale while the counters are still in cache. */
+            if (flags & XIA_SCA_DEADTIME_CORRECT) {
+                double factor = 1.0;
+
+                if (pixels->events[k] > 0 && pixels->livetime[k] > 0) {
+                    factor = ((double) pixels->triggers[k] * pixels->realtime[k]) /
+                             ((double) pixels->events[k] * pixels->livetime[k]);
+                }
+
+                xiaScaleCounts(sca, pixels->corrected + k * nSCAs, nSCAs,
+                               (float) factor);
+            }
+        }
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Releases the arrays of a decoded SCA buffer and zeroes it for reuse.
+ */
+HANDEL_EXPORT int HANDEL_API xiaFreeSCAPixels(XiaSCAPixels* pixels) {
+    if (pixels == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaFreeSCAPixels",
+               "pixels may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    free(pixels->pixel);
+    free(pixels->sca);
+    free(pixels->corrected);
+    free(pixels->realtime);
+    free(pixels->livetime);
+    free(pixels->triggers);
+    free(pixels->events);
+
+    memset(pixels, 0, sizeof(*pixels));
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Decodes the events in len words of a stream of list mode buffers, such
+ * as the data returned by xiaGetRunData("buffer_a"/"buffer_b") with the
+ * length from "list_buffer_len_a"/"list_buffer_len_b". The words may stop,
+ * and the next call resume, anywhere in a buffer header or event record.
+ * events receives the events completed by this call. Reset the decoder
+ * after an error.
+ */
+HANDEL_EXPORT int HANDEL_API xiaDecodeListBuffer(XiaListDecoder* decoder,
+                                                 const unsigned long* words,
+                                                 unsigned long len,
+                                                 XiaListEvents* events) {
+    int status;
+
+    unsigned long n;
+
+    if (decoder == NULL || events == NULL || (words == NULL && len > 0)) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaDecodeListBuffer",
+               "decoder, words and events may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    /* Every event record is at least MAP_CLOCK_EVENT_SIZE words. */
+    status = xiaReserveListEvents(events,
+                                  (decoder->nPending + len) / MAP_CLOCK_EVENT_SIZE + 1);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaDecodeListBuffer",
+               "Unable to allocate the decoded arrays for %lu words", len);
+        return status;
+    }
+
+    events->nEvents = 0;
+
+    while (len > 0) {
+        if (decoder->eventsLeft == 0 && decoder->padLeft == 0) {
+            /* Between buffers, collect the next buffer header. */
+            n = MIN(MAP_BUFFER_HEADER_SIZE - decoder->nPending, len);
+            memcpy(decoder->pending + decoder->nPending, words,
+                   n * sizeof(unsigned long));
+            decoder->nPending += n;
+            words += n;
+            len -= n;
+
+            if (decoder->nPending < MAP_BUFFER_HEADER_SIZE) {
+                break;
+            }
+
+            decoder->nPending = 0;
+            status = xiaReadListHeader(decoder);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaDecodeListBuffer",
+                       "Invalid list mode buffer header");
+                return status;
+            }
+        } else if (decoder->eventsLeft == 0) {
+            n = MIN(decoder->padLeft, len);
+            decoder->padLeft -= n;
+            words += n;
+            len -= n;
+        } else if (decoder->nPending > 0 || len < decoder->wordsPerEvent) {
+            /* An event record split across calls. */
+            n = MIN(decoder->wordsPerEvent - decoder->nPending, len);
+            memcpy(decoder->pending + decoder->nPending, words,
+                   n * sizeof(unsigned long));
+            decoder->nPending += n;
+            words += n;
+            len -= n;
+
+            if (decoder->nPending < decoder->wordsPerEvent) {
+                break;
+            }
+
+            xiaDecodeListEvents(decoder, decoder->pending, 1, events);
+            decoder->nPending = 0;
+            decoder->eventsLeft--;
+        } else {
+            n = MIN(len / decoder->wordsPerEvent, decoder->eventsLeft);
+            xiaDecodeListEvents(decoder, words, n, events);
+            decoder->eventsLeft -= n;
+            words += n * decoder->wordsPerEvent;
+            len -= n * decoder->wordsPerEvent;
+        }
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Returns a list mode decoder to the start of a stream.
+ */
+HANDEL_EXPORT int HANDEL_API xiaResetListDecoder(XiaListDecoder* decoder) {
+    if (decoder == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaResetListDecoder",
+               "decoder may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    memset(decoder, 0, sizeof(*decoder));
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Releases the arrays of decoded list mode events and zeroes them for
+ * reuse.
+ */
+HANDEL_EXPORT int HANDEL_API xiaFreeListEvents(XiaListEvents* events) {
+    if (events == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaFreeListEvents",
+               "events may not be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    free(events->timestamp);
+    free(events->energy);
+    free(events->channel);
+    free(events->flags);
+    free(events->pixel);
+
+    memset(events, 0, sizeof(*events));
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Copies n 16-bit buffer words into a packed array.
+ */
+void HANDEL_API xiaUnpackWords(const unsigned long* src, unsigned int* dst, size_t n) {
+    size_t i = 0;
+
+#ifdef MAPPING_SSE2
+    if (sizeof(unsigned long) == 8) {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+
+        /* Keep the low half of each element, four elements per store. */
+        for (; i + 8 <= n; i += 8) {
+            __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*) (src + i)));
+            __m128 b =
+                _mm_castsi128_ps(_mm_loadu_si128((const __m128i*) (src + i + 2)));
+            __m128 c =
+                _mm_castsi128_ps(_mm_loadu_si128((const __m128i*) (src + i + 4)));
+            __m128 d =
+                _mm_castsi128_ps(_mm_loadu_si128((const __m128i*) (src + i + 6)));
+            __m128i lo =
+                _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i hi =
+                _mm_castps_si128(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+
+            _mm_storeu_si128((__m128i*) (dst + i), _mm_and_si128(lo, mask));
+            _mm_storeu_si128((__m128i*) (dst + i + 4), _mm_and_si128(hi, mask));
+        }
+    } else {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+
+        for (; i + 4 <= n; i += 4) {
+            __m128i w = _mm_loadu_si128((const __m128i*) (src + i));
+            _mm_storeu_si128((__m128i*) (dst + i), _mm_and_si128(w, mask));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        dst[i] = (unsigned int) (src[i] & 0xFFFF);
+    }
+}
+
+/*
+ * Joins n pairs of 16-bit buffer words, low word first, into 32-bit
+ * values.
+ */
+void HANDEL_API xiaUnpackWords32(const unsigned long* src, unsigned int* dst,
+                                 size_t n) {
+    size_t i = 0;
+
+#ifdef MAPPING_SSE2
+    if (sizeof(unsigned long) == 8) {
+        const __m128i lowMask = _mm_set1_epi64x(0xFFFF);
+        const __m128i highMask = _mm_set1_epi64x(0xFFFF0000);
+
+        /*
+         * Each 64-bit lane holds a low word; the high word is the next
+         * lane. Fold the pair into the low 32 bits of a 128-bit register
+         * holding two pairs, then gather four results per store.
+         */
+        for (; i + 4 <= n; i += 4) {
+            __m128i a = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+            __m128i b = _mm_loadu_si128((const __m128i*) (src + 2 * i + 2));
+            __m128i c = _mm_loadu_si128((const __m128i*) (src + 2 * i + 4));
+            __m128i d = _mm_loadu_si128((const __m128i*) (src + 2 * i + 6));
+            __m128 ab = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b),
+                                       _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 cd = _mm_shuffle_ps(_mm_castsi128_ps(c), _mm_castsi128_ps(d),
+                                       _MM_SHUFFLE(2, 0, 2, 0));
+            __m128i x = _mm_castps_si128(ab);
+            __m128i y = _mm_castps_si128(cd);
+
+            x = _mm_or_si128(_mm_and_si128(x, lowMask),
+                             _mm_and_si128(_mm_srli_epi64(x, 16), highMask));
+            y = _mm_or_si128(_mm_and_si128(y, lowMask),
+                             _mm_and_si128(_mm_srli_epi64(y, 16), highMask));
+
+            _mm_storeu_si128((__m128i*) (dst + i),
+                             _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(x),
+                                                             _mm_castsi128_ps(y),
+                                                             _MM_SHUFFLE(2, 0, 2, 0))));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        dst[i] = (unsigned int) MAP_WORD32(src + 2 * i);
+    }
+}
+
+/*
+ * Converts n counters to floats scaled by factor.
+ */
+void HANDEL_API xiaScaleCounts(const unsigned int* src, float* dst, size_t n,
+                               float factor) {
+    size_t i = 0;
+
+#ifdef MAPPING_SSE2
+    const __m128 scale = _mm_set1_ps(factor);
+    const __m128i sign = _mm_set1_epi32((int) 0x80000000);
+    const __m128 offset = _mm_set1_ps(2147483648.0f);
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+
+        /*
+         * There is no unsigned conversion in SSE2: convert the low 31 bits
+         * and add 2^31 back where the top bit was set.
+         */
+        __m128i top = _mm_srai_epi32(_mm_and_si128(x, sign), 31);
+        __m128 f = _mm_cvtepi32_ps(_mm_andnot_si128(sign, x));
+
+        f = _mm_add_ps(f, _mm_and_ps(_mm_castsi128_ps(top), offset));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(f, scale));
+    }
+#endif
+
+    for (; i < n; i++) {
+        dst[i] = (float) src[i] * factor;
+    }
+}
+
+/*
+ * Grows the arrays of decoded list mode events together to hold at least
+ * n events. The contents are not preserved.
+ */
+int HANDEL_API xiaReserveListEvents(XiaListEvents* events, size_t n) {
+    if (n <= events->capacity && events->timestamp != NULL) {
+        return XIA_SUCCESS;
+    }
+
+    free(events->timestamp);
+    free(events->energy);
+    free(events->channel);
+    free(events->flags);
+    free(events->pixel);
+
+    events->timestamp = (uint64_t*) malloc(n * sizeof(uint64_t));
+    events->energy = (unsigned short*) malloc(n * sizeof(unsigned short));
+    events->channel = (unsigned char*) malloc(n * sizeof(unsigned char));
+    events->flags = (unsigned short*) malloc(n * sizeof(unsigned short));
+    events->pixel = (unsigned long*) malloc(n * sizeof(unsigned long));
+
+    if (events->timestamp == NULL || events->energy == NULL ||
+        events->channel == NULL || events->flags == NULL || events->pixel == NULL) {
+        xiaFreeListEvents(events);
+        return XIA_NOMEM;
+    }
+
+    events->capacity = n;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Moves the first used bytes of a block from handel_md_alloc() to a new
+ * block of size bytes and frees the old one. Returns NULL, leaving the old
+ * block in place, if the new one cannot be allocated.
+ */
+void* HANDEL_API xiaGrowBlock(void* block, size_t used, size_t size) {
+    void* grown = handel_md_alloc(size);
+
+    if (grown == NULL) {
+        return NULL;
+    }
+
+    if (block != NULL) {
+        memcpy(grown, block, used);
+        handel_md_free(block);
+    }
+
+    return grown;
+}
+
+/*
+ * Checks the tags, size and mapping mode of a buffer header and that the
+ * buffer is long enough to hold it.
+ */
+static int xiaCheckBufferHeader(const unsigned long* buffer, unsigned long len,
+                                unsigned long mode) {
+    if (len < MAP_BUFFER_HEADER_SIZE) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaCheckBufferHeader",
+               "Buffer length %lu is shorter than the buffer header", len);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    if (MAP_WORD(buffer[0]) != MAP_BUFFER_TAG0 ||
+        MAP_WORD(buffer[1]) != MAP_BUFFER_TAG1) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaCheckBufferHeader",
+               "Bad buffer header tags %#lx %#lx", MAP_WORD(buffer[0]),
+               MAP_WORD(buffer[1]));
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    if (MAP_WORD(buffer[MAP_BH_HEADER_SIZE]) != MAP_BUFFER_HEADER_SIZE) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaCheckBufferHeader",
+               "Unexpected buffer header size %lu",
+               MAP_WORD(buffer[MAP_BH_HEADER_SIZE]));
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    if (MAP_WORD(buffer[MAP_BH_MAPPING_MODE]) != mode) {
+        xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN_MAPPING, "xiaCheckBufferHeader",
+               "Buffer has mapping mode %lu, expected %lu",
+               MAP_WORD(buffer[MAP_BH_MAPPING_MODE]), mode);
+        return XIA_UNKNOWN_MAPPING;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Grows a decoded array to hold at least n elements of size bytes. The
+ * contents are not preserved.
+ */
+static int xiaReserve(void** array, size_t* capacity, size_t n, size_t size) {
+    void* grown;
+
+    if (n <= *capacity && *array != NULL) {
+        return XIA_SUCCESS;
+    }
+
+    grown = malloc((n > 0 ? n : 1) * size);
+
+    if (grown == NULL) {
+        return XIA_NOMEM;
+    }
+
+    free(*array);
+    *array = grown;
+    *capacity = n;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Grows the four statistics arrays of a decoded buffer together.
+ */
+static int xiaReserveStats(unsigned long** stats[4], size_t* capacity, size_t n) {
+    int i;
+
+    size_t bytes = (n > 0 ? n : 1) * sizeof(unsigned long);
+
+    if (n <= *capacity && *stats[0] != NULL) {
+        return XIA_SUCCESS;
+    }
+
+    for (i = 0; i < 4; i++) {
+        free(*stats[i]);
+        *stats[i] = (unsigned long*) malloc(bytes);
+    }
+
+    for (i = 0; i < 4; i++) {
+        if (*stats[i] == NULL) {
+            for (i = 0; i < 4; i++) {
+                free(*stats[i]);
+                *stats[i] = NULL;
+            }
+
+            *capacity = 0;
+            return XIA_NOMEM;
+        }
+    }
+
+    *capacity = n;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Checks the tags, header size, mapping mode and block size of a pixel
+ * header.
+ */
+static boolean_t xiaIsPixelHeader(const unsigned long* block, unsigned long headerSize,
+                                  unsigned long mode, unsigned long blockSize) {
+    return MAP_WORD(block[0]) == MAP_PIXEL_TAG0 &&
+           MAP_WORD(block[1]) == MAP_PIXEL_TAG1 &&
+           MAP_WORD(block[MAP_PH_HEADER_SIZE]) == headerSize &&
+           MAP_WORD(block[MAP_PH_MAPPING_MODE]) == mode &&
+           MAP_WORD32(block + MAP_PH_BLOCK_SIZE) == blockSize;
+}
+
+/*
+ * Copies the realtime, livetime, triggers and events of the channels in a
+ * pixel header to the four statistics arrays, starting at index k.
+ */
+static void xiaReadPixelStats(const unsigned long* block, const unsigned int* present,
+                              unsigned int nChannels, size_t k,
+                              unsigned long** stats[4]) {
+    unsigned int c;
+
+    for (c = 0; c < nChannels; c++, k++) {
+        const unsigned long* words =
+            block + MAP_PH_STATS + present[c] * MAP_PH_STATS_PER_CHANNEL;
+
+        (*stats[0])[k] = MAP_WORD32(words);
+        (*stats[1])[k] = MAP_WORD32(words + 2);
+        (*stats[2])[k] = MAP_WORD32(words + 4);
+        (*stats[3])[k] = MAP_WORD32(words + 6);
+    }
+}
+
+/*
+ * Checks the list mode buffer header collected in the decoder and sets up
+ * the decoder to read its events. The clock unwrapping restarts with each
+ * run.
+ */
+static int xiaReadListHeader(XiaListDecoder* decoder) {
+    int status;
+
+    unsigned int runNumber;
+
+    unsigned long variant;
+    unsigned long wordsPerEvent;
+    unsigned long minWords;
+    unsigned long nEvents;
+    unsigned long total;
+
+    const unsigned long* header = decoder->pending;
+
+    status = xiaCheckBufferHeader(header, MAP_BUFFER_HEADER_SIZE, MAP_MODE_LIST);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    variant = MAP_WORD(header[MAP_BH_LIST_VARIANT]);
+
+    if (variant == (unsigned long) XIA_LIST_MODE_CLOCK) {
+        minWords = MAP_CLOCK_EVENT_SIZE;
+    } else if (variant == (unsigned long) XIA_LIST_MODE_SLOW_PIXEL ||
+               variant == (unsigned long) XIA_LIST_MODE_FAST_PIXEL) {
+        minWords = MAP_PIXEL_EVENT_SIZE;
+    } else {
+        xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN_LIST_MODE_VARIANT, "xiaReadListHeader",
+               "List mode variant %lu is not supported", variant);
+        return XIA_UNKNOWN_LIST_MODE_VARIANT;
+    }
+
+    wordsPerEvent = MAP_WORD(header[MAP_BH_WORDS_PER_EVENT]);
+
+    if (wordsPerEvent < minWords || wordsPerEvent > MAP_BUFFER_HEADER_SIZE) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaReadListHeader",
+               "Unexpected event size %lu for list mode variant %lu", wordsPerEvent,
+               variant);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    nEvents = MAP_WORD(header[MAP_BH_N_EVENTS]);
+    total = MAP_WORD32(header + MAP_BH_TOTAL_WORDS);
+
+    if (total < MAP_BUFFER_HEADER_SIZE ||
+        (total - MAP_BUFFER_HEADER_SIZE) / wordsPerEvent < nEvents) {
+        xiaLog(XIA_LOG_ERROR, XIA_MALFORMED_BUFFER, "xiaReadListHeader",
+               "Buffer length %lu is too short for %lu events of %lu words", total,
+               nEvents, wordsPerEvent);
+        return XIA_MALFORMED_BUFFER;
+    }
+
+    runNumber = (unsigned int) MAP_WORD(header[MAP_BH_RUN_NUMBER]);
+
+    if (runNumber != decoder->runNumber) {
+        decoder->haveTime = 0;
+        decoder->epoch = 0;
+    }
+
+    decoder->runNumber = runNumber;
+    decoder->variant = (unsigned int) variant;
+    decoder->wordsPerEvent = wordsPerEvent;
+    decoder->eventsLeft = nEvents;
+    decoder->padLeft = total - MAP_BUFFER_HEADER_SIZE - nEvents * wordsPerEvent;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Decodes n consecutive event records, packing them to 32-bit words a
+ * block at a time so the fields are read from cache.
+ */
+static void xiaDecodeListEvents(XiaListDecoder* decoder, const unsigned long* src,
+                                size_t n, XiaListEvents* events) {
+    unsigned int words[MAP_LIST_BLOCK_WORDS];
+
+    size_t perBlock = MAP_LIST_BLOCK_WORDS / decoder->wordsPerEvent;
+
+    while (n > 0) {
+        size_t k = MIN(n, perBlock);
+
+        xiaUnpackWords(src, words, k * decoder->wordsPerEvent);
+        xiaExtractListEvents(decoder, words, k, events);
+
+        src += k * decoder->wordsPerEvent;
+        n -= k;
+    }
+}
+
+/*
+ * Appends n packed event records to the decoded arrays.
+ */
+static void xiaExtractListEvents(XiaListDecoder* decoder, const unsigned int* words,
+                                 size_t n, XiaListEvents* events) {
+    size_t i = 0;
+    size_t k = events->nEvents;
+
+#ifdef MAPPING_SSE2
+    if (decoder->wordsPerEvent == MAP_CLOCK_EVENT_SIZE &&
+        decoder->variant == (unsigned int) XIA_LIST_MODE_CLOCK) {
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        const __m128i sign = _mm_set1_epi32((int) 0x80000000);
+        const __m128i bias32 = _mm_set1_epi32(0x8000);
+        const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+        const __m128i zero = _mm_setzero_si128();
+
+        /*
+         * Transpose four records so each register holds one field of four
+         * events. A group whose clock wraps is left to the scalar code.
+         */
+        for (; i + 4 <= n; i += 4, k += 4) {
+            const unsigned int* record = words + i * MAP_CLOCK_EVENT_SIZE;
+
+            __m128 r0 = _mm_loadu_ps((const float*) record);
+            __m128 r1 = _mm_loadu_ps((const float*) (record + 4));
+            __m128 r2 = _mm_loadu_ps((const float*) (record + 8));
+            __m128 r3 = _mm_loadu_ps((const float*) (record + 12));
+
+            __m128i energy;
+            __m128i status;
+            __m128i time;
+            __m128i prev;
+            __m128i epoch;
+            __m128i packed;
+
+            int channels;
+
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            energy = _mm_castps_si128(r0);
+            status = _mm_castps_si128(r1);
+            time = _mm_or_si128(_mm_castps_si128(r2),
+                                _mm_slli_epi32(_mm_castps_si128(r3), 16));
+            prev = _mm_or_si128(_mm_slli_si128(time, 4),
+                                _mm_cvtsi32_si128((int) decoder->lastTime));
+
+            if (!decoder->haveTime ||
+                _mm_movemask_epi8(_mm_cmpgt_epi32(_mm_xor_si128(prev, sign),
+                                                  _mm_xor_si128(time, sign))) != 0) {
+                size_t j;
+
+                for (j = 0; j < 4; j++) {
+                    xiaExtractListEvent(decoder, record + j * MAP_CLOCK_EVENT_SIZE,
+                                        events, k + j);
+                }
+
+                continue;
+            }
+
+            epoch = _mm_set1_epi64x((long long) decoder->epoch);
+            _mm_storeu_si128((__m128i*) (events->timestamp + k),
+                             _mm_add_epi64(_mm_unpacklo_epi32(time, zero), epoch));
+            _mm_storeu_si128((__m128i*) (events->timestamp + k + 2),
+                             _mm_add_epi64(_mm_unpackhi_epi32(time, zero), epoch));
+            decoder->lastTime = (uint32_t) _mm_cvtsi128_si32(
+                _mm_shuffle_epi32(time, _MM_SHUFFLE(3, 3, 3, 3)));
+
+            /* SSE2 only packs with signed saturation: bias the words first. */
+            packed = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(energy, bias32), zero),
+                                   bias16);
+            _mm_storel_epi64((__m128i*) (events->energy + k), packed);
+
+            packed = _mm_packs_epi32(_mm_srli_epi32(status, 8), zero);
+            _mm_storel_epi64((__m128i*) (events->flags + k), packed);
+
+            packed = _mm_packs_epi32(_mm_and_si128(status, byteMask), zero);
+            channels = _mm_cvtsi128_si32(_mm_packus_epi16(packed, zero));
+            memcpy(events->channel + k, &channels, 4);
+
+            memset(events->pixel + k, 0, 4 * sizeof(unsigned long));
+        }
+    }
+#endif
+
+    for (; i < n; i++, k++) {
+        xiaExtractListEvent(decoder, words + i * decoder->wordsPerEvent, events, k);
+    }
+
+    events->nEvents = k;
+}
+
+/*
+ * Decodes one packed event record into index k of the decoded arrays,
+ * unwrapping its clock against the previous event.
+ */
+static void xiaExtractListEvent(XiaListDecoder* decoder, const unsigned int* record,
+                                XiaListEvents* events, size_t k) {
+    uint32_t time = (uint32_t) (record[MAP_EV_TIME] | (record[MAP_EV_TIME + 1] << 16));
+
+    unsigned short flags = (unsigned short) (record[MAP_EV_CHANNEL] >> 8);
+
+    if (decoder->haveTime && time < decoder->lastTime) {
+        decoder->epoch += (uint64_t) 1 << 32;
+        flags |= XIA_LIST_EVENT_ROLLOVER;
+    }
+
+    decoder->haveTime = 1;
+    decoder->lastTime = time;
+
+    events->timestamp[k] = decoder->epoch + time;
+    events->energy[k] = (unsigned short) record[MAP_EV_ENERGY];
+    events->channel[k] = (unsigned char) (record[MAP_EV_CHANNEL] & 0xFF);
+    events->flags[k] = flags;
+
+    if (decoder->variant == (unsigned int) XIA_LIST_MODE_CLOCK) {
+        events->pixel[k] = 0;
+    } else {
+        events->pixel[k] = (unsigned long) record[MAP_EV_PIXEL] |
+                           ((unsigned long) record[MAP_EV_PIXEL + 1] << 16);
+    }
+}
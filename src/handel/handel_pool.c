@@ -0,0 +1,675 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_pool.c
+ * @brief A work-stealing pool of library threads for internal parallelism.
+ *
+ * Each worker owns a deque of tasks. A worker runs its own tasks newest
+ * first and, when it has none, steals the oldest task of another worker.
+ * Tasks submitted from outside the pool are dealt round-robin to the
+ * workers; tasks submitted by a task go to its own worker. A thread that
+ * waits for a task group runs the group's queued tasks itself, so a wait
+ * never depends on a worker being free.
+ *
+ * The pool starts on first use, with the size and CPU affinity set by
+ * xiaSetPoolConfig(), and is shared by every context. It runs until
+ * xiaSetPoolConfig() changes it; xiaExit() only waits for the exiting
+ * context's own task group.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+
+#include "handel_constants.h"
+#include "handel_errors.h"
+#include "handel_log.h"
+#include "md_threads.h"
+
+/* How long an idle worker or a waiter sleeps before it looks again, in ms */
+#define POOL_IDLE_WAIT 10
+
+/* Starting capacity of a worker's deque. It doubles when full. */
+#define POOL_DEQUE_START 16
+
+typedef struct {
+    XiaTaskFn fn;
+    void* arg;
+    XiaTaskGroup* group;
+} PoolTask;
+
+/*
+ * A worker thread and its deque. The deque is a ring buffer: the owner
+ * pushes and pops at the tail, thieves take from the head. lock protects
+ * the deque and the statistics. peers is the worker array the worker was
+ * started with; it does not change while the worker runs.
+ */
+typedef struct PoolWorker {
+    unsigned int index;
+    int cpu;
+    struct PoolWorker* peers;
+    unsigned int nPeers;
+    char name[32];
+    handel_md_Thread thread;
+    handel_md_Mutex lock;
+    handel_md_Event wake;
+    handel_md_Event exited;
+    PoolTask* tasks;
+    unsigned int capacity;
+    unsigned int head;
+    unsigned int count;
+    unsigned long stats[XIA_POOL_STATS_LEN];
+} PoolWorker;
+
+/*
+ * Protects starting and stopping the pool, the worker array and the
+ * round-robin position. Readers outside it work on a snapshot taken by
+ * xiaPoolWorkers().
+ */
+static handel_md_Mutex poolLock = {NULL, "handel_pool"};
+
+static PoolWorker* workers = NULL;
+static unsigned int nWorkers = 0;
+static unsigned int nextWorker = 0;
+static volatile boolean_t stopping = FALSE_;
+
+/* 0 threads means one per CPU; a negative CPU means no affinity. */
+static unsigned int configThreads = 0;
+static int configCpu = -1;
+
+/* The pool worker running on this thread, if any. */
+static XIA_THREAD_LOCAL PoolWorker* currentWorker = NULL;
+
+static int HANDEL_API xiaPoolStart(void);
+static void HANDEL_API xiaPoolStop(void);
+static void HANDEL_API xiaFreeWorker(PoolWorker* w);
+static unsigned int HANDEL_API xiaPoolWorkers(PoolWorker** ws);
+static int HANDEL_API xiaPoolPush(PoolWorker* w, PoolTask* task);
+static boolean_t HANDEL_API xiaPoolTake(PoolWorker* w, PoolTask* task);
+static boolean_t HANDEL_API xiaPoolTakeGroup(XiaTaskGroup* group, PoolTask* task);
+static void HANDEL_API xiaPoolRun(PoolTask* task);
+static void xiaPoolWorkerMain(void* arg);
+
+/*
+ * Creates the pool lock. Called once from xiaInitHandel().
+ */
+int HANDEL_API xiaInitPoolLock(void) {
+    if (handel_md_mutex_ready(&poolLock)) {
+        return XIA_SUCCESS;
+    }
+
+    if (handel_md_mutex_create(&poolLock) != THREADING_NO_ERROR) {
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaInitPoolLock",
+               "Error creating the worker pool lock");
+        return XIA_THREAD_ERROR;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Sets the number of worker threads (0 for one per CPU) and the CPU the
+ * first worker is pinned to, the others following on the next CPUs. A
+ * negative cpu leaves the workers unpinned. A running pool is shut down
+ * once its queued tasks have run and restarts on its next use.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetPoolConfig(unsigned int threads, int cpu) {
+    int status;
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    if (cpu >= (int) handel_md_cpu_count()) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaSetPoolConfig",
+               "CPU %d is out of range, there are %u CPUs", cpu, handel_md_cpu_count());
+        return XIA_BAD_VALUE;
+    }
+
+    if (currentWorker != NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_ILLEGAL_OPERATION, "xiaSetPoolConfig",
+               "The worker pool cannot be reconfigured from one of its tasks");
+        return XIA_ILLEGAL_OPERATION;
+    }
+
+    handel_md_mutex_lock(&poolLock);
+
+    xiaPoolStop();
+
+    configThreads = threads;
+    configCpu = cpu < 0 ? -1 : cpu;
+
+    handel_md_mutex_unlock(&poolLock);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Returns the number of running worker threads, 0 if the pool has not
+ * started.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetPoolSize(unsigned int* threads) {
+    if (threads == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetPoolSize", "threads cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    handel_md_mutex_lock(&poolLock);
+    *threads = nWorkers;
+    handel_md_mutex_unlock(&poolLock);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Copies the statistics of one worker's queue into stats, which must
+ * hold XIA_POOL_STATS_LEN values indexed by the XIA_POOL_STAT_* constants.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetPoolStats(unsigned int worker, unsigned long* stats) {
+    int status = XIA_SUCCESS;
+
+    if (stats == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetPoolStats", "stats cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    handel_md_mutex_lock(&poolLock);
+
+    if (worker < nWorkers) {
+        PoolWorker* w = &workers[worker];
+
+        handel_md_mutex_lock(&w->lock);
+        memcpy(stats, w->stats, sizeof(w->stats));
+        handel_md_mutex_unlock(&w->lock);
+    } else {
+        status = XIA_BAD_VALUE;
+    }
+
+    handel_md_mutex_unlock(&poolLock);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaGetPoolStats",
+               "Worker %u is out of range, the pool has %u workers", worker, nWorkers);
+    }
+
+    return status;
+}
+
+/*
+ * Queues fn(arg) on the pool, starting the pool if needed. If group is
+ * not NULL the task is counted in it; see xiaTaskGroupWait(). The task
+ * has to select its own Handel context.
+ */
+int HANDEL_API xiaPoolSubmit(XiaTaskGroup* group, XiaTaskFn fn, void* arg) {
+    int status = XIA_SUCCESS;
+
+    PoolTask task;
+
+    ASSERT(fn != NULL);
+
+    task.fn = fn;
+    task.arg = arg;
+    task.group = group;
+
+    if (group != NULL) {
+        handel_md_mutex_lock(&group->lock);
+        group->pending++;
+        handel_md_mutex_unlock(&group->lock);
+    }
+
+    /* A task's subtasks stay on its worker, where the pool cannot be stopped. */
+    if (currentWorker != NULL) {
+        status = xiaPoolPush(currentWorker, &task);
+    } else {
+        if (!isHandelInit) {
+            status = xiaInitHandel();
+        }
+
+        handel_md_mutex_lock(&poolLock);
+
+        if (status == XIA_SUCCESS && workers == NULL) {
+            status = xiaPoolStart();
+        }
+
+        if (status == XIA_SUCCESS) {
+            status = xiaPoolPush(&workers[nextWorker++ % nWorkers], &task);
+        }
+
+        handel_md_mutex_unlock(&poolLock);
+    }
+
+    if (status != XIA_SUCCESS && group != NULL) {
+        handel_md_mutex_lock(&group->lock);
+        group->pending--;
+        handel_md_mutex_unlock(&group->lock);
+    }
+
+    return status;
+}
+
+/*
+ * Prepares an empty task group.
+ */
+int HANDEL_API xiaTaskGroupInit(XiaTaskGroup* group) {
+    ASSERT(group != NULL);
+
+    group->lock.handle = NULL;
+    group->lock.name = "task_group";
+    group->done.handle = NULL;
+    group->done.name = "task_group";
+    group->pending = 0;
+
+    if (handel_md_mutex_create(&group->lock) != THREADING_NO_ERROR) {
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaTaskGroupInit",
+               "Error creating the task group lock");
+        return XIA_THREAD_ERROR;
+    }
+
+    if (handel_md_event_create(&group->done) != THREADING_NO_ERROR) {
+        handel_md_mutex_destroy(&group->lock);
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaTaskGroupInit",
+               "Error creating the task group event");
+        return XIA_THREAD_ERROR;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Waits until every task submitted in group has run, running the ones
+ * still queued on the calling thread, and releases the group.
+ */
+void HANDEL_API xiaTaskGroupWait(XiaTaskGroup* group) {
+    xiaTaskGroupDrain(group);
+
+    handel_md_event_destroy(&group->done);
+    handel_md_mutex_destroy(&group->lock);
+}
+
+/*
+ * Waits like xiaTaskGroupWait() but keeps the group for further tasks.
+ */
+void HANDEL_API xiaTaskGroupDrain(XiaTaskGroup* group) {
+    unsigned int pending;
+
+    PoolTask task;
+
+    ASSERT(group != NULL);
+
+    for (;;) {
+        handel_md_mutex_lock(&group->lock);
+        pending = group->pending;
+        handel_md_mutex_unlock(&group->lock);
+
+        if (pending == 0) {
+            break;
+        }
+
+        if (xiaPoolTakeGroup(group, &task)) {
+            xiaPoolRun(&task);
+            continue;
+        }
+
+        handel_md_event_wait(&group->done, POOL_IDLE_WAIT);
+    }
+}
+
+/*
+ * Creates the workers. The pool lock must be held.
+ */
+static int HANDEL_API xiaPoolStart(void) {
+    unsigned int i;
+    unsigned int n = configThreads > 0 ? configThreads : handel_md_cpu_count();
+    unsigned int nCpus = handel_md_cpu_count();
+
+    workers = handel_md_alloc(n * sizeof(PoolWorker));
+
+    if (workers == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaPoolStart",
+               "Unable to allocate %u pool workers", n);
+        return XIA_NOMEM;
+    }
+
+    stopping = FALSE_;
+
+    for (i = 0; i < n; i++) {
+        PoolWorker* w = &workers[i];
+
+        memset(w, 0, sizeof(PoolWorker));
+
+        w->index = i;
+        w->peers = workers;
+        w->nPeers = n;
+        w->cpu = configCpu < 0 ? -1 : (int) (((unsigned int) configCpu + i) % nCpus);
+        sprintf(w->name, "handel_pool_%u", i);
+
+        w->lock.name = w->name;
+        w->wake.name = w->name;
+        w->exited.name = w->name;
+
+        w->thread.state = handel_md_ThreadsDetached;
+        w->thread.name = w->name;
+        w->thread.realtime = FALSE_;
+        w->thread.entryPoint = xiaPoolWorkerMain;
+        w->thread.argument = w;
+
+        w->capacity = POOL_DEQUE_START;
+        w->tasks = handel_md_alloc(w->capacity * sizeof(PoolTask));
+
+        if (w->tasks == NULL || handel_md_mutex_create(&w->lock) != THREADING_NO_ERROR ||
+            handel_md_event_create(&w->wake) != THREADING_NO_ERROR ||
+            handel_md_event_create(&w->exited) != THREADING_NO_ERROR) {
+            nWorkers = i + 1;
+            xiaPoolStop();
+            xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaPoolStart",
+                   "Unable to set up pool worker %u", i);
+            return XIA_THREAD_ERROR;
+        }
+    }
+
+    nWorkers = n;
+
+    /* Every deque is ready before the first worker can try to steal. */
+    for (i = 0; i < n; i++) {
+        if (handel_md_thread_create(&workers[i].thread) != THREADING_NO_ERROR) {
+            xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, "xiaPoolStart",
+                   "Unable to start pool worker %u", i);
+            xiaPoolStop();
+            return XIA_THREAD_ERROR;
+        }
+    }
+
+    xiaLog(XIA_LOG_INFO, "xiaPoolStart", "Started %u pool workers", n);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Lets the workers run what is queued, waits for them to exit and frees
+ * the pool. The pool lock must be held.
+ */
+static void HANDEL_API xiaPoolStop(void) {
+    unsigned int i;
+
+    if (workers == NULL) {
+        return;
+    }
+
+    stopping = TRUE_;
+
+    for (i = 0; i < nWorkers; i++) {
+        handel_md_event_signal(&workers[i].wake);
+    }
+
+    for (i = 0; i < nWorkers; i++) {
+        if (handel_md_thread_ready(&workers[i].thread)) {
+            handel_md_event_wait(&workers[i].exited, 0);
+        }
+    }
+
+    for (i = 0; i < nWorkers; i++) {
+        xiaFreeWorker(&workers[i]);
+    }
+
+    handel_md_free(workers);
+    workers = NULL;
+    nWorkers = 0;
+    nextWorker = 0;
+    stopping = FALSE_;
+}
+
+/*
+ * Returns the number of workers and the worker array. A worker uses the
+ * array it was started with, since xiaPoolStop() holds the pool lock while
+ * it waits for the workers to exit. Other threads read it under the pool
+ * lock; the array stays valid until xiaPoolStop(), which only runs from
+ * xiaSetPoolConfig().
+ */
+static unsigned int HANDEL_API xiaPoolWorkers(PoolWorker** ws) {
+    unsigned int n;
+
+    if (currentWorker != NULL) {
+        *ws = currentWorker->peers;
+        return currentWorker->nPeers;
+    }
+
+    handel_md_mutex_lock(&poolLock);
+    *ws = workers;
+    n = nWorkers;
+    handel_md_mutex_unlock(&poolLock);
+
+    return n;
+}
+
+static void HANDEL_API xiaFreeWorker(PoolWorker* w) {
+    if (handel_md_event_ready(&w->exited)) {
+        handel_md_event_destroy(&w->exited);
+    }
+
+    if (handel_md_event_ready(&w->wake)) {
+        handel_md_event_destroy(&w->wake);
+    }
+
+    if (handel_md_mutex_ready(&w->lock)) {
+        handel_md_mutex_destroy(&w->lock);
+    }
+
+    handel_md_free(w->tasks);
+}
+
+/*
+ * Adds a task at the tail of a worker's deque and wakes the worker, and
+ * its neighbour to steal if the worker is already busy.
+ */
+static int HANDEL_API xiaPoolPush(PoolWorker* w, PoolTask* task) {
+    unsigned int i;
+    unsigned int depth;
+    unsigned int n;
+
+    PoolWorker* ws;
+
+    handel_md_mutex_lock(&w->lock);
+
+    if (w->count == w->capacity) {
+        PoolTask* tasks = handel_md_alloc(2 * w->capacity * sizeof(PoolTask));
+
+        if (tasks == NULL) {
+            handel_md_mutex_unlock(&w->lock);
+            xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaPoolPush",
+                   "Unable to grow the deque of pool worker %u", w->index);
+            return XIA_NOMEM;
+        }
+
+        for (i = 0; i < w->count; i++) {
+            tasks[i] = w->tasks[(w->head + i) % w->capacity];
+        }
+
+        handel_md_free(w->tasks);
+        w->tasks = tasks;
+        w->capacity *= 2;
+        w->head = 0;
+    }
+
+    w->tasks[(w->head + w->count) % w->capacity] = *task;
+    depth = ++w->count;
+
+    w->stats[XIA_POOL_STAT_SUBMITTED]++;
+    w->stats[XIA_POOL_STAT_MAX_DEPTH] = MAX(w->stats[XIA_POOL_STAT_MAX_DEPTH], depth);
+
+    handel_md_mutex_unlock(&w->lock);
+
+    handel_md_event_signal(&w->wake);
+
+    n = xiaPoolWorkers(&ws);
+
+    if (depth > 1 && n > 1) {
+        handel_md_event_signal(&ws[(w->index + 1) % n].wake);
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Takes the newest task of w's own deque or, if it is empty, steals the
+ * oldest task of the first other worker that has one.
+ */
+static boolean_t HANDEL_API xiaPoolTake(PoolWorker* w, PoolTask* task) {
+    unsigned int k;
+    unsigned int n;
+
+    boolean_t found = FALSE_;
+
+    PoolWorker* ws;
+
+    handel_md_mutex_lock(&w->lock);
+
+    if (w->count > 0) {
+        w->count--;
+        *task = w->tasks[(w->head + w->count) % w->capacity];
+        w->stats[XIA_POOL_STAT_EXECUTED]++;
+        found = TRUE_;
+    }
+
+    handel_md_mutex_unlock(&w->lock);
+
+    n = xiaPoolWorkers(&ws);
+
+    for (k = 1; k < n && !found; k++) {
+        PoolWorker* victim = &ws[(w->index + k) % n];
+
+        handel_md_mutex_lock(&victim->lock);
+
+        if (victim->count > 0) {
+            *task = victim->tasks[victim->head];
+            victim->head = (victim->head + 1) % victim->capacity;
+            victim->count--;
+            found = TRUE_;
+        }
+
+        handel_md_mutex_unlock(&victim->lock);
+
+        if (found) {
+            handel_md_mutex_lock(&w->lock);
+            w->stats[XIA_POOL_STAT_EXECUTED]++;
+            w->stats[XIA_POOL_STAT_STOLEN]++;
+            handel_md_mutex_unlock(&w->lock);
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Removes the oldest queued task of group from whichever deque holds it.
+ */
+static boolean_t HANDEL_API xiaPoolTakeGroup(XiaTaskGroup* group, PoolTask* task) {
+    unsigned int i;
+    unsigned int j;
+    unsigned int k;
+    unsigned int n;
+
+    PoolWorker* ws;
+
+    n = xiaPoolWorkers(&ws);
+
+    for (k = 0; k < n; k++) {
+        PoolWorker* w = &ws[k];
+
+        handel_md_mutex_lock(&w->lock);
+
+        for (i = 0; i < w->count; i++) {
+            if (w->tasks[(w->head + i) % w->capacity].group == group) {
+                *task = w->tasks[(w->head + i) % w->capacity];
+
+                for (j = i; j + 1 < w->count; j++) {
+                    w->tasks[(w->head + j) % w->capacity] =
+                        w->tasks[(w->head + j + 1) % w->capacity];
+                }
+
+                w->count--;
+                handel_md_mutex_unlock(&w->lock);
+                return TRUE_;
+            }
+        }
+
+        handel_md_mutex_unlock(&w->lock);
+    }
+
+    return FALSE_;
+}
+
+/*
+ * Runs a task and counts it off its group. The group may be released as
+ * soon as its lock is dropped.
+ */
+static void HANDEL_API xiaPoolRun(PoolTask* task) {
+    XiaTaskGroup* group = task->group;
+
+    task->fn(task->arg);
+
+    if (group != NULL) {
+        handel_md_mutex_lock(&group->lock);
+
+        if (--group->pending == 0) {
+            handel_md_event_signal(&group->done);
+        }
+
+        handel_md_mutex_unlock(&group->lock);
+    }
+}
+
+static void xiaPoolWorkerMain(void* arg) {
+    PoolWorker* w = (PoolWorker*) arg;
+
+    PoolTask task;
+
+    currentWorker = w;
+    handel_md_thread_set_library(1);
+
+    if (w->cpu >= 0 &&
+        handel_md_thread_set_affinity((unsigned int) w->cpu) != THREADING_NO_ERROR) {
+        xiaLog(XIA_LOG_WARNING, "xiaPoolWorkerMain",
+               "Unable to pin pool worker %u to CPU %d", w->index, w->cpu);
+    }
+
+    for (;;) {
+        if (xiaPoolTake(w, &task)) {
+            xiaPoolRun(&task);
+            continue;
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        handel_md_event_wait(&w->wake, POOL_IDLE_WAIT);
+    }
+
+    currentWorker = NULL;
+
+    handel_md_event_signal(&w->exited);
+}
@@ -0,0 +1,325 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_request.c
+ * @brief Special runs, gain operations and run waits that complete in the
+ * background.
+ *
+ * xiaDoSpecialRunAsync(), xiaGainOperationAsync() and
+ * xiaWaitRunCompleteAsync() return as soon as the operation is queued.
+ * It runs on a worker pool thread (see handel_pool.c), in the caller's
+ * context, and reports its status to the optional callback and to
+ * xiaWaitRequest(). The module locks let requests for different modules
+ * run at the same time; requests for the same module run one after the
+ * other.
+ *
+ * Each context counts its requests in its own task group, so xiaExit()
+ * waits only for the exiting context's requests, running the ones that
+ * are still queued itself, and leaves the shared pool to the others.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+
+#include "handel_errors.h"
+#include "handel_generic.h"
+#include "handel_log.h"
+#include "md_threads.h"
+
+enum XiaRequestType {
+    XIA_REQUEST_SPECIAL_RUN,
+    XIA_REQUEST_GAIN_OPERATION,
+    XIA_REQUEST_RUN_COMPLETE
+};
+
+struct XiaRequest {
+    enum XiaRequestType type;
+    int detChan;
+    char name[MAXITEM_LEN];
+    void* value;
+    double timeout;
+    XiaRequestCallback callback;
+    void* arg;
+    HandelContext* context;
+    /* No one will wait for this request, so it frees itself. */
+    boolean_t detached;
+    int status;
+    handel_md_Event done;
+};
+
+static int HANDEL_API xiaCheckOperation(char* fn, char* name, void* value);
+static int HANDEL_API xiaQueueRequest(enum XiaRequestType type, char* fn, int detChan,
+                                      char* name, void* value, double timeout,
+                                      XiaRequestCallback callback, void* arg,
+                                      XiaRequest** request);
+static void xiaRequestMain(void* arg);
+
+/*
+ * Starts xiaDoSpecialRun(detChan, name, info) on a library thread.
+ * info must stay valid until the request completes.
+ *
+ * callback, if not NULL, is called from the library thread with the
+ * status of the special run. If request is not NULL it receives a
+ * handle that must be passed to xiaWaitRequest(). Otherwise the
+ * request cleans up after itself and callback is required.
+ */
+HANDEL_EXPORT int HANDEL_API xiaDoSpecialRunAsync(int detChan, char* name, void* info,
+                                                  XiaRequestCallback callback, void* arg,
+                                                  XiaRequest** request) {
+    int status = xiaCheckOperation("xiaDoSpecialRunAsync", name, info);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    return xiaQueueRequest(XIA_REQUEST_SPECIAL_RUN, "xiaDoSpecialRunAsync", detChan,
+                           name, info, 0.0, callback, arg, request);
+}
+
+/*
+ * Starts xiaGainOperation(detChan, name, value) on a library thread. See
+ * xiaDoSpecialRunAsync() for the remaining arguments.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGainOperationAsync(int detChan, char* name, void* value,
+                                                   XiaRequestCallback callback,
+                                                   void* arg, XiaRequest** request) {
+    int status = xiaCheckOperation("xiaGainOperationAsync", name, value);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    return xiaQueueRequest(XIA_REQUEST_GAIN_OPERATION, "xiaGainOperationAsync", detChan,
+                           name, value, 0.0, callback, arg, request);
+}
+
+/*
+ * Starts xiaWaitRunComplete(detChan, timeout) on a library thread, so that
+ * callback runs as soon as the run ends. See xiaDoSpecialRunAsync() for
+ * the remaining arguments.
+ */
+HANDEL_EXPORT int HANDEL_API xiaWaitRunCompleteAsync(int detChan, double timeout,
+                                                     XiaRequestCallback callback,
+                                                     void* arg, XiaRequest** request) {
+    return xiaQueueRequest(XIA_REQUEST_RUN_COMPLETE, "xiaWaitRunCompleteAsync", detChan,
+                           "run_complete", NULL, timeout, callback, arg, request);
+}
+
+/*
+ * Waits up to timeout milliseconds, or forever if timeout is 0, for the
+ * request to complete. On completion status receives the status of the
+ * operation and the request is freed. Returns XIA_TIMEOUT, leaving the
+ * request valid, if it is still running.
+ */
+HANDEL_EXPORT int HANDEL_API xiaWaitRequest(XiaRequest* request, unsigned int timeout,
+                                            int* status) {
+    if (request == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaWaitRequest", "request cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (status == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaWaitRequest", "status cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    if (handel_md_event_wait(&request->done, timeout) != THREADING_NO_ERROR) {
+        xiaLog(XIA_LOG_DEBUG, "xiaWaitRequest",
+               "Request '%s' for detChan %d is still running", request->name,
+               request->detChan);
+        return XIA_TIMEOUT;
+    }
+
+    *status = request->status;
+
+    handel_md_event_destroy(&request->done);
+    handel_md_free(request);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Creates the task group that counts the requests queued in ctx.
+ */
+int HANDEL_API xiaInitRequests(HandelContext* ctx) {
+    ASSERT(ctx != NULL);
+
+    if (handel_md_mutex_ready(&ctx->requests.lock)) {
+        return XIA_SUCCESS;
+    }
+
+    return xiaTaskGroupInit(&ctx->requests);
+}
+
+/*
+ * Waits for every request queued in the current context. Called from
+ * xiaExit().
+ */
+void HANDEL_API xiaDrainRequests(void) {
+    if (handel_md_mutex_ready(&xiaContext->requests.lock)) {
+        xiaTaskGroupDrain(&xiaContext->requests);
+    }
+}
+
+/*
+ * Waits for the requests queued in ctx and releases its task group.
+ */
+void HANDEL_API xiaFreeRequests(HandelContext* ctx) {
+    ASSERT(ctx != NULL);
+
+    if (handel_md_mutex_ready(&ctx->requests.lock)) {
+        xiaTaskGroupWait(&ctx->requests);
+    }
+}
+
+/*
+ * Checks the arguments of a named operation before it is queued.
+ */
+static int HANDEL_API xiaCheckOperation(char* fn, char* name, void* value) {
+    if (name == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_NAME, fn, "name cannot be NULL");
+        return XIA_NULL_NAME;
+    }
+
+    if (strlen(name) >= MAXITEM_LEN) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_NAME, fn, "name '%s' is too long", name);
+        return XIA_BAD_NAME;
+    }
+
+    if (value == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, fn, "value cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Allocates the request and queues it on the worker pool.
+ */
+static int HANDEL_API xiaQueueRequest(enum XiaRequestType type, char* fn, int detChan,
+                                      char* name, void* value, double timeout,
+                                      XiaRequestCallback callback, void* arg,
+                                      XiaRequest** request) {
+    int status;
+
+    XiaRequest* r = NULL;
+
+    if (callback == NULL && request == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, fn,
+               "A callback is required when no request handle is returned");
+        return XIA_NULL_VALUE;
+    }
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    r = handel_md_alloc(sizeof(XiaRequest));
+
+    if (r == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, fn, "Unable to allocate %zu bytes for request",
+               sizeof(XiaRequest));
+        return XIA_NOMEM;
+    }
+
+    r->type = type;
+    r->detChan = detChan;
+    strcpy(r->name, name);
+    r->value = value;
+    r->timeout = timeout;
+    r->callback = callback;
+    r->arg = arg;
+    r->context = xiaContext;
+    r->detached = request == NULL ? TRUE_ : FALSE_;
+    r->status = XIA_SUCCESS;
+
+    r->done.handle = NULL;
+    r->done.name = r->name;
+
+    if (handel_md_event_create(&r->done) != THREADING_NO_ERROR) {
+        handel_md_free(r);
+        xiaLog(XIA_LOG_ERROR, XIA_THREAD_ERROR, fn,
+               "Unable to create the completion event for '%s'", name);
+        return XIA_THREAD_ERROR;
+    }
+
+    /* The task may finish, and free a detached request, before this returns. */
+    if (request != NULL) {
+        *request = r;
+    }
+
+    status = xiaPoolSubmit(&xiaContext->requests, xiaRequestMain, r);
+
+    if (status != XIA_SUCCESS) {
+        handel_md_event_destroy(&r->done);
+        handel_md_free(r);
+
+        if (request != NULL) {
+            *request = NULL;
+        }
+
+        xiaLog(XIA_LOG_ERROR, status, fn,
+               "Unable to queue '%s' on detChan %d", name, detChan);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+static void xiaRequestMain(void* arg) {
+    XiaRequest* r = (XiaRequest*) arg;
+
+    xiaContextSelect(r->context);
+
+    switch (r->type) {
+        case XIA_REQUEST_SPECIAL_RUN:
+            r->status = xiaDoSpecialRun(r->detChan, r->name, r->value);
+            break;
+        case XIA_REQUEST_GAIN_OPERATION:
+            r->status = xiaGainOperation(r->detChan, r->name, r->value);
+            break;
+        case XIA_REQUEST_RUN_COMPLETE:
+            r->status = xiaWaitRunComplete(r->detChan, r->timeout);
+            break;
+        default:
+            FAIL();
+            break;
+    }
+
+    if (r->callback != NULL) {
+        r->callback(r->detached ? NULL : r, r->status, r->arg);
+    }
+
+    if (r->detached) {
+        handel_md_event_destroy(&r->done);
+        handel_md_free(r);
+        return;
+    }
+
+    handel_md_event_signal(&r->done);
+}
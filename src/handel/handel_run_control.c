@@ -44,8 +44,12 @@
 #include "xia_handel_structures.h"
 #include "xia_system.h"
 
+#include "xerxes_wait.h"
+
+#include "handel_constants.h"
 #include "handel_errors.h"
 #include "handel_log.h"
+#include "md_threads.h"
 
 /*
  * Starts a run on the specified detChan or detChan set. If resume is
@@ -55,6 +59,8 @@
  * For some products, even if a single channel is specified, all channels for
  * that module will have a run started. This is an intrinsic property of the
  * hardware and there is no way to circumvent it in the software.
+ *
+ * See xiaSetRunDispatch() for starting the modules of a set in parallel.
  */
 HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
     int status;
@@ -87,7 +93,7 @@ HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
              * the run broadcast...
              */
             alias = xiaGetAliasFromDetChan(detChan);
-            module = xiaFindModule(alias);
+            module = xiaLockModule(detChan);
 
             if (module->isMultiChannel) {
                 status = xiaGetAbsoluteChannel(detChan, module, &chan);
@@ -95,6 +101,7 @@ HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaStartRun",
                            "detChan = %d not found in module '%s'", detChan, alias);
+                    xiaUnlockModule(module);
                     return status;
                 }
 
@@ -103,6 +110,7 @@ HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
                         XIA_LOG_INFO, "xiaStartRun",
                         "detChan %d is part of a multichannel module whose run was already started",
                         detChan);
+                    xiaUnlockModule(module);
                     break;
                 }
             }
@@ -112,6 +120,7 @@ HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaStartRun",
                        "Unable to get boardType for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
@@ -120,19 +129,24 @@ HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaStartRun",
                        "Unable to load PSL funcs for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
 
-            status = localFuncs.startRun(detChan, resume, defaults, module);
+            status = xiaCancelStatus(localFuncs.startRun(detChan, resume, defaults,
+                                                         module));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaStartRun",
                        "Unable to start run for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
+            xiaMapTuneStarted(module);
+
             /*
              * Tag all the channels if this is a multichannel module.
              */
@@ -142,11 +156,24 @@ HANDEL_EXPORT int HANDEL_API xiaStartRun(int detChan, unsigned short resume) {
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaStartRun",
                            "Error setting channel state information: runActive");
+                    xiaUnlockModule(module);
                     return status;
                 }
             }
+            xiaUnlockModule(module);
             break;
         case SET:
+            if (xiaContext->runDispatch == XIA_RUN_DISPATCH_PARALLEL) {
+                status = xiaDispatchRunSet(detChan, resume, TRUE_);
+
+                if (status != XIA_SUCCESS) {
+                    xiaLog(XIA_LOG_ERROR, status, "xiaStartRun",
+                           "Error starting run for detChan %d", detChan);
+                    return status;
+                }
+                break;
+            }
+
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
 
             detChanSetElem = detChanElem->data.detChanSet;
@@ -186,6 +213,10 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
 
     unsigned int chan = 0;
 
+    double tunedSize = 0.0;
+
+    boolean_t tuned;
+
     char boardType[MAXITEM_LEN];
 
     char* alias = NULL;
@@ -205,7 +236,7 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
     switch (elemType) {
         case SINGLE:
             alias = xiaGetAliasFromDetChan(detChan);
-            module = xiaFindModule(alias);
+            module = xiaLockModule(detChan);
 
             if (module->isMultiChannel) {
                 status = xiaGetAbsoluteChannel(detChan, module, &chan);
@@ -213,6 +244,7 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
                            "detChan = %d not found in module '%s'", detChan, alias);
+                    xiaUnlockModule(module);
                     return status;
                 }
 
@@ -221,6 +253,7 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
                         XIA_LOG_INFO, "xiaStopRun",
                         "detChan %d is part of a multichannel module whose run was already stopped",
                         detChan);
+                    xiaUnlockModule(module);
                     break;
                 }
             }
@@ -230,6 +263,7 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
                        "Unable to get boardType for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
@@ -238,14 +272,16 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
                        "Unable to load PSL funcs for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
-            status = localFuncs.stopRun(detChan, module);
+            status = xiaCancelStatus(localFuncs.stopRun(detChan, module));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
                        "Unable to stop run for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
@@ -255,11 +291,37 @@ HANDEL_EXPORT int HANDEL_API xiaStopRun(int detChan) {
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
                            "Error setting channel state information: runActive");
+                    xiaUnlockModule(module);
+                    return status;
+                }
+            }
+
+            tuned = xiaMapTuneStopped(module, &tunedSize);
+            xiaUnlockModule(module);
+
+            if (tuned) {
+                status = xiaApplyMapTune(module, tunedSize);
+
+                if (status != XIA_SUCCESS) {
+                    xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
+                           "Unable to apply the tuned buffer size for detChan %d",
+                           detChan);
                     return status;
                 }
             }
             break;
         case SET:
+            if (xiaContext->runDispatch == XIA_RUN_DISPATCH_PARALLEL) {
+                status = xiaDispatchRunSet(detChan, 0, FALSE_);
+
+                if (status != XIA_SUCCESS) {
+                    xiaLog(XIA_LOG_ERROR, status, "xiaStopRun",
+                           "Error stopping run for detChan %d", detChan);
+                    return status;
+                }
+                break;
+            }
+
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
 
             detChanSetElem = detChanElem->data.detChanSet;
@@ -297,8 +359,6 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value)
     int status;
     int elemType;
 
-    char* alias = NULL;
-
     char boardType[MAXITEM_LEN];
 
     PSLFuncs localFuncs;
@@ -307,6 +367,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value)
 
     Module* m = NULL;
 
+    double started;
+
     if (name == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NULL_NAME, "xiaGetRunData", "name cannot be NULL");
         return XIA_NULL_NAME;
@@ -338,8 +400,7 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value)
             }
 
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
-            alias = xiaGetAliasFromDetChan(detChan);
-            m = xiaFindModule(alias);
+            m = xiaLockModule(detChan);
 
             /* A NULL module would indicate that something is broken
              * internally since the value returned by xiaGetAliasFromDetChan()
@@ -347,13 +408,22 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value)
              */
             ASSERT(m != NULL);
 
-            status = localFuncs.getRunData(detChan, name, value, defaults, m);
+            started = m->tune != NULL ? handel_md_clock() : 0.0;
+
+            status = xiaCancelStatus(localFuncs.getRunData(detChan, name, value,
+                                                           defaults, m));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetRunData",
                        "Unable get run data %s for detChan %d", name, detChan);
+                xiaUnlockModule(m);
                 return status;
             }
+
+            if (m->tune != NULL) {
+                xiaMapTuneRunData(m, name, value, started);
+            }
+            xiaUnlockModule(m);
             break;
         case SET:
             /*
@@ -376,6 +446,186 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char* name, void* value)
     return XIA_SUCCESS;
 }
 
+/*
+ * The run state of one module while waiting for its run to end.
+ */
+typedef struct {
+    int detChan;
+    Module* module;
+    XiaDefaults* defaults;
+    PSLFuncs funcs;
+    boolean_t active;
+    long epoch;
+} RunWatch;
+
+/*
+ * Blocks until the hardware run has ended on detChan, or on every module
+ * of a detChan set, e.g. when a preset run reaches its preset. Waits at
+ * most timeout seconds and returns XIA_TIMEOUT if a run is still active.
+ *
+ * Each poll reads the run state once per module, directly through the
+ * PSL, and the polling interval adapts as for the other hardware waits
+ * (see xiaSetWaitProfile() and XIA_WAIT_RUN_END). The run must still be
+ * stopped with xiaStopRun(). Returns XIA_CANCELLED if xiaCancel() is
+ * called for one of the modules while waiting.
+ */
+HANDEL_EXPORT int HANDEL_API xiaWaitRunComplete(int detChan, double timeout) {
+    int status;
+
+    unsigned int i;
+    unsigned int j;
+    unsigned int nMembers = 0;
+    unsigned int nWatches = 0;
+    unsigned int nActive;
+
+    int* members = NULL;
+
+    char boardType[MAXITEM_LEN];
+
+    RunWatch* watches = NULL;
+
+    Dxp_Wait w;
+
+    if (timeout <= 0.0) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaWaitRunComplete",
+               "timeout must be positive, not %0.3f", timeout);
+        return XIA_BAD_VALUE;
+    }
+
+    status = xiaCountSetMembers(detChan, &nMembers);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaWaitRunComplete",
+               "detChan number %d is not in the list of valid values", detChan);
+        return status;
+    }
+
+    /* An empty set has no run to wait for. */
+    if (nMembers == 0) {
+        return XIA_SUCCESS;
+    }
+
+    members = handel_md_alloc(nMembers * sizeof(int));
+    watches = handel_md_alloc(nMembers * sizeof(RunWatch));
+
+    if (members == NULL || watches == NULL) {
+        handel_md_free(members);
+        handel_md_free(watches);
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaWaitRunComplete",
+               "Unable to allocate the run watch for detChan %d", detChan);
+        return XIA_NOMEM;
+    }
+
+    nMembers = 0;
+    xiaCollectSetMembers(detChan, members, &nMembers);
+
+    /* One watch per module: the run state is a module property. */
+    for (i = 0; i < nMembers; i++) {
+        char* alias = xiaGetAliasFromDetChan(members[i]);
+        Module* module = alias == NULL ? NULL : xiaFindModule(alias);
+        RunWatch* watch = &watches[nWatches];
+
+        for (j = 0; j < nWatches; j++) {
+            if (watches[j].module == module) {
+                break;
+            }
+        }
+
+        if (j < nWatches) {
+            continue;
+        }
+
+        status = xiaGetBoardType(members[i], boardType);
+
+        if (status == XIA_SUCCESS) {
+            status = xiaLoadPSL(boardType, &watch->funcs);
+        }
+
+        if (status != XIA_SUCCESS || module == NULL) {
+            status = status == XIA_SUCCESS ? XIA_INVALID_DETCHAN : status;
+            xiaLog(XIA_LOG_ERROR, status, "xiaWaitRunComplete",
+                   "Unable to load the PSL for detChan %d", members[i]);
+            handel_md_free(members);
+            handel_md_free(watches);
+            return status;
+        }
+
+        watch->detChan = members[i];
+        watch->module = module;
+        watch->defaults = xiaGetDefaultFromDetChan((unsigned int) members[i]);
+        watch->active = TRUE_;
+        watch->epoch = handel_md_cancel_epoch(&module->cancel);
+        nWatches++;
+    }
+
+    handel_md_free(members);
+
+    dxp_wait_begin(&w, DXP_WAIT_RUN_END, timeout);
+
+    do {
+        nActive = 0;
+
+        for (j = 0; j < nWatches; j++) {
+            RunWatch* watch = &watches[j];
+            unsigned long active = 0;
+
+            if (!watch->active) {
+                continue;
+            }
+
+            /* The wait runs outside the module lock, so check the token here. */
+            if (handel_md_cancel_epoch(&watch->module->cancel) != watch->epoch) {
+                handel_md_free(watches);
+                xiaLog(XIA_LOG_ERROR, XIA_CANCELLED, "xiaWaitRunComplete",
+                       "Cancelled waiting for the run to end on detChan %d",
+                       watch->detChan);
+                return XIA_CANCELLED;
+            }
+
+            if (xiaLockModule(watch->detChan) == NULL) {
+                handel_md_free(watches);
+                xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaWaitRunComplete",
+                       "detChan %d no longer belongs to a module", watch->detChan);
+                return XIA_INVALID_DETCHAN;
+            }
+
+            status = xiaCancelStatus(
+                watch->funcs.getRunData(watch->detChan, "run_active", &active,
+                                        watch->defaults, watch->module));
+            xiaUnlockModule(watch->module);
+
+            if (status != XIA_SUCCESS) {
+                handel_md_free(watches);
+                xiaLog(XIA_LOG_ERROR, status, "xiaWaitRunComplete",
+                       "Error reading the run state of detChan %d", watch->detChan);
+                return status;
+            }
+
+            /* Bit 0 (XIA_RUN_HARDWARE in handel.h) is the hardware run state. */
+            watch->active = (active & 0x1) ? TRUE_ : FALSE_;
+
+            if (watch->active) {
+                nActive++;
+            }
+        }
+
+        if (nActive == 0) {
+            dxp_wait_end(&w);
+            handel_md_free(watches);
+            return XIA_SUCCESS;
+        }
+    } while (dxp_wait_next(&w));
+
+    handel_md_free(watches);
+
+    xiaLog(XIA_LOG_ERROR, XIA_TIMEOUT, "xiaWaitRunComplete",
+           "Timeout after %0.3f s waiting for the run to end on %u of %u module(s) "
+           "for detChan %d",
+           timeout, nActive, nWatches, detChan);
+
+    return XIA_TIMEOUT;
+}
+
 /*
  * Starts and stops a special run.
  *
@@ -400,7 +650,6 @@ HANDEL_EXPORT int HANDEL_API xiaDoSpecialRun(int detChan, char* name, void* info
     /* The following declarations are used to retrieve the preampGain. */
     Module* module = NULL;
     Detector* detector = NULL;
-    char* boardAlias;
     char* detectorAlias;
     int detector_chan;
     unsigned int modChan;
@@ -442,21 +691,33 @@ HANDEL_EXPORT int HANDEL_API xiaDoSpecialRun(int detChan, char* name, void* info
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
 
             /* Retrieve the preampGain for the specialRun routine */
-            boardAlias = xiaGetAliasFromDetChan(detChan);
-            module = xiaFindModule(boardAlias);
+            module = xiaLockModule(detChan);
             modChan = xiaGetModChan((unsigned int) detChan);
             detectorAlias = module->detector[modChan];
             detector_chan = module->detector_chan[modChan];
             detector = xiaFindDetector(detectorAlias);
 
-            status = localFuncs.doSpecialRun(detChan, name, info, defaults, detector,
-                                             detector_chan);
+            status = xiaCancelStatus(localFuncs.doSpecialRun(detChan, name, info,
+                                                             defaults, detector,
+                                                             detector_chan));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaDoSpecialRun",
                        "Unable to perform special run for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+
+            status = xiaFlushDSPParams(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaDoSpecialRun",
+                       "Unable to write the special run parameters for detChan %d",
+                       detChan);
+                xiaUnlockModule(module);
+                return status;
+            }
+            xiaUnlockModule(module);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
@@ -513,6 +774,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetSpecialRunData(int detChan, char* name,
 
     PSLFuncs localFuncs;
 
+    Module* module = NULL;
+
     if (name == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NULL_NAME, "xiaGetSpecialRunData",
                "name cannot be NULL");
@@ -548,13 +811,28 @@ HANDEL_EXPORT int HANDEL_API xiaGetSpecialRunData(int detChan, char* name,
             /* Load the defaults */
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
 
-            status = localFuncs.getSpecialRunData(detChan, name, value, defaults);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.getSpecialRunData(detChan, name, value,
+                                                                  defaults));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetSpecialRunData",
                        "Unable to get special run data for detChan %d", detChan);
+                xiaUnlockModule(module);
+                return status;
+            }
+
+            status = xiaFlushDSPParams(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaGetSpecialRunData",
+                       "Unable to write the special run parameters for detChan %d",
+                       detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
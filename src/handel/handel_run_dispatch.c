@@ -0,0 +1,425 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_run_dispatch.c
+ * @brief Parallel run start and stop for detChan sets.
+ *
+ * By default xiaStartRun() and xiaStopRun() walk a detChan set one
+ * channel at a time, so the time between the first and last module
+ * starting grows with the number of modules. With
+ * XIA_RUN_DISPATCH_PARALLEL selected, the set members are grouped by
+ * module and each module is started or stopped as its own task on the
+ * worker pool. The module locks keep the tasks apart.
+ *
+ * Modules configured as a gate, sync or LBUS master drive the other
+ * modules, so they are handled apart from the rest: on start the other
+ * modules are armed first and the masters are started once they all
+ * have, on stop the masters are stopped first.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+
+#include "handel_constants.h"
+#include "handel_errors.h"
+#include "handel_log.h"
+#include "md_threads.h"
+
+/*
+ * The set members that belong to one module, and the state of the task
+ * that starts or stops them.
+ */
+typedef struct {
+    Module* module;
+    HandelContext* context;
+    int* detChans;
+    unsigned int n;
+    boolean_t master;
+    boolean_t start;
+    unsigned short resume;
+    int status;
+    double started;
+} RunGroup;
+
+/* Acquisition values that make a module drive the run of the others. */
+static char* MASTER_NAMES[] = {"gate_master", "sync_master", "lbus_master"};
+
+static boolean_t HANDEL_API xiaIsRunMaster(int detChan);
+static void HANDEL_API xiaRunGroup(RunGroup* group);
+static void xiaRunGroupMain(void* arg);
+static int HANDEL_API xiaRunGroups(RunGroup* groups, unsigned int nGroups,
+                                   boolean_t masters);
+
+/*
+ * Selects how xiaStartRun() and xiaStopRun() handle a detChan set in the
+ * current context: XIA_RUN_DISPATCH_SERIAL (the default) handles the
+ * channels one at a time, XIA_RUN_DISPATCH_PARALLEL handles each module
+ * on its own thread.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetRunDispatch(int mode) {
+    if (mode != XIA_RUN_DISPATCH_SERIAL && mode != XIA_RUN_DISPATCH_PARALLEL) {
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_VALUE, "xiaSetRunDispatch",
+               "Unknown run dispatch mode %d", mode);
+        return XIA_BAD_VALUE;
+    }
+
+    xiaContext->runDispatch = mode;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Returns, in seconds, the time between the first and the last module
+ * starting in the most recent parallel start of a detChan set.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetRunStartSkew(double* skew) {
+    if (skew == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetRunStartSkew",
+               "skew cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    *skew = xiaContext->runStartSkew;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Starts (start = TRUE_) or stops the run on every module in the detChan
+ * set, one thread per module.
+ */
+int HANDEL_API xiaDispatchRunSet(int detChan, unsigned short resume, boolean_t start) {
+    int status;
+
+    unsigned int i;
+    unsigned int j;
+    unsigned int nMembers = 0;
+    unsigned int nGroups = 0;
+    unsigned int next = 0;
+
+    int* members = NULL;
+    int* ordered = NULL;
+    unsigned int* memberGroup = NULL;
+
+    RunGroup* groups = NULL;
+
+    double first = 0.0;
+    double last = 0.0;
+
+    char* fn = start ? "xiaStartRun" : "xiaStopRun";
+
+    status = xiaCountSetMembers(detChan, &nMembers);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, fn, "Error reading detChan set %d", detChan);
+        return status;
+    }
+
+    if (nMembers == 0) {
+        return XIA_SUCCESS;
+    }
+
+    members = handel_md_alloc(nMembers * sizeof(int));
+    ordered = handel_md_alloc(nMembers * sizeof(int));
+    memberGroup = handel_md_alloc(nMembers * sizeof(unsigned int));
+    groups = handel_md_alloc(nMembers * sizeof(RunGroup));
+
+    if (members == NULL || ordered == NULL || memberGroup == NULL || groups == NULL) {
+        handel_md_free(members);
+        handel_md_free(ordered);
+        handel_md_free(memberGroup);
+        handel_md_free(groups);
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, fn,
+               "Unable to allocate the run groups for detChan set %d", detChan);
+        return XIA_NOMEM;
+    }
+
+    nMembers = 0;
+    xiaCollectSetMembers(detChan, members, &nMembers);
+
+    /* Group the members by module, keeping the set order within a module. */
+    for (i = 0; i < nMembers; i++) {
+        char* alias = xiaGetAliasFromDetChan(members[i]);
+        Module* module = alias == NULL ? NULL : xiaFindModule(alias);
+
+        if (module == NULL) {
+            handel_md_free(members);
+            handel_md_free(ordered);
+            handel_md_free(memberGroup);
+            handel_md_free(groups);
+            xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, fn,
+                   "detChan %d in set %d is not assigned to a module", members[i],
+                   detChan);
+            return XIA_INVALID_DETCHAN;
+        }
+
+        for (j = 0; j < nGroups; j++) {
+            if (groups[j].module == module) {
+                break;
+            }
+        }
+
+        if (j == nGroups) {
+            groups[j].module = module;
+            groups[j].context = xiaContext;
+            groups[j].n = 0;
+            groups[j].master = FALSE_;
+            groups[j].start = start;
+            groups[j].resume = resume;
+            groups[j].status = XIA_SUCCESS;
+            groups[j].started = 0.0;
+            nGroups++;
+        }
+
+        memberGroup[i] = j;
+        groups[j].n++;
+
+        if (xiaIsRunMaster(members[i])) {
+            groups[j].master = TRUE_;
+        }
+    }
+
+    for (j = 0; j < nGroups; j++) {
+        groups[j].detChans = &ordered[next];
+        next += groups[j].n;
+        groups[j].n = 0;
+    }
+
+    for (i = 0; i < nMembers; i++) {
+        RunGroup* group = &groups[memberGroup[i]];
+        group->detChans[group->n++] = members[i];
+    }
+
+    xiaLog(XIA_LOG_INFO, fn, "Dispatching detChan set %d to %u module(s)", detChan,
+           nGroups);
+
+    /*
+     * The masters go last on start, so that every other module is armed
+     * when the gate or sync signal starts, and first on stop.
+     */
+    status = xiaRunGroups(groups, nGroups, start ? FALSE_ : TRUE_);
+
+    if (status == XIA_SUCCESS) {
+        status = xiaRunGroups(groups, nGroups, start ? TRUE_ : FALSE_);
+    }
+
+    if (status == XIA_SUCCESS && start) {
+        first = groups[0].started;
+        last = groups[0].started;
+
+        for (j = 1; j < nGroups; j++) {
+            first = MIN(first, groups[j].started);
+            last = MAX(last, groups[j].started);
+        }
+
+        xiaContext->runStartSkew = last - first;
+
+        xiaLog(XIA_LOG_INFO, fn, "Started %u module(s), start skew %.3f ms", nGroups,
+               xiaContext->runStartSkew * 1000.0);
+    }
+
+    handel_md_free(members);
+    handel_md_free(ordered);
+    handel_md_free(memberGroup);
+    handel_md_free(groups);
+
+    return status;
+}
+
+/*
+ * Counts the single detChans in a set, including those of nested sets.
+ */
+int HANDEL_API xiaCountSetMembers(int detChan, unsigned int* n) {
+    int status;
+
+    DetChanElement* detChanElem = NULL;
+    DetChanSetElem* detChanSetElem = NULL;
+
+    switch (xiaGetElemType(detChan)) {
+        case SINGLE:
+            (*n)++;
+            return XIA_SUCCESS;
+        case SET:
+            detChanElem = xiaGetDetChanPtr(detChan);
+            detChanSetElem = detChanElem->data.detChanSet;
+
+            while (detChanSetElem != NULL) {
+                status = xiaCountSetMembers((int) detChanSetElem->channel, n);
+
+                if (status != XIA_SUCCESS) {
+                    return status;
+                }
+
+                detChanSetElem = getListNext(detChanSetElem);
+            }
+            return XIA_SUCCESS;
+        default:
+            return XIA_INVALID_DETCHAN;
+    }
+}
+
+/*
+ * Fills members with the single detChans in a set, in set order.
+ * xiaCountSetMembers() must have succeeded for the same set.
+ */
+void HANDEL_API xiaCollectSetMembers(int detChan, int* members, unsigned int* n) {
+    DetChanElement* detChanElem = NULL;
+    DetChanSetElem* detChanSetElem = NULL;
+
+    if (xiaGetElemType(detChan) == SINGLE) {
+        members[(*n)++] = detChan;
+        return;
+    }
+
+    detChanElem = xiaGetDetChanPtr(detChan);
+    detChanSetElem = detChanElem->data.detChanSet;
+
+    while (detChanSetElem != NULL) {
+        xiaCollectSetMembers((int) detChanSetElem->channel, members, n);
+        detChanSetElem = getListNext(detChanSetElem);
+    }
+}
+
+/*
+ * Is detChan configured to drive the gate, sync or LBUS of other
+ * modules? Read from the defaults directly, since not every product has
+ * these acquisition values.
+ */
+static boolean_t HANDEL_API xiaIsRunMaster(int detChan) {
+    int i;
+
+    XiaDefaults* defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
+    XiaDaqEntry* entry = NULL;
+
+    if (defaults == NULL) {
+        return FALSE_;
+    }
+
+    for (entry = defaults->entry; entry != NULL; entry = entry->next) {
+        for (i = 0; i < (int) N_ELEMS(MASTER_NAMES); i++) {
+            if (STREQ(entry->name, MASTER_NAMES[i]) && entry->data != 0.0) {
+                return TRUE_;
+            }
+        }
+    }
+
+    return FALSE_;
+}
+
+/*
+ * Starts or stops the run on each detChan of the group in turn. The
+ * first call is the one that reaches the hardware on multichannel
+ * modules; the rest find the run already in the requested state.
+ */
+static void HANDEL_API xiaRunGroup(RunGroup* group) {
+    unsigned int i;
+
+    for (i = 0; i < group->n; i++) {
+        if (group->start) {
+            group->status = xiaStartRun(group->detChans[i], group->resume);
+        } else {
+            group->status = xiaStopRun(group->detChans[i]);
+        }
+
+        if (i == 0) {
+            group->started = handel_md_clock();
+        }
+
+        if (group->status != XIA_SUCCESS) {
+            return;
+        }
+    }
+}
+
+static void xiaRunGroupMain(void* arg) {
+    RunGroup* group = (RunGroup*) arg;
+
+    xiaContextSelect(group->context);
+    xiaRunGroup(group);
+}
+
+/*
+ * Runs the master groups (masters = TRUE_) one after the other, or the
+ * other groups in parallel on the worker pool, and returns the first
+ * error.
+ */
+static int HANDEL_API xiaRunGroups(RunGroup* groups, unsigned int nGroups,
+                                   boolean_t masters) {
+    int status = XIA_SUCCESS;
+
+    unsigned int j;
+
+    boolean_t pooled = FALSE_;
+
+    XiaTaskGroup tasks;
+
+    if (!masters) {
+        pooled = xiaTaskGroupInit(&tasks) == XIA_SUCCESS ? TRUE_ : FALSE_;
+
+        if (!pooled) {
+            xiaLog(XIA_LOG_WARNING, "xiaRunGroups",
+                   "Unable to create a task group, running the modules one at a time");
+        }
+    }
+
+    for (j = 0; j < nGroups; j++) {
+        RunGroup* group = &groups[j];
+
+        if (group->master != masters) {
+            continue;
+        }
+
+        if (pooled && xiaPoolSubmit(&tasks, xiaRunGroupMain, group) == XIA_SUCCESS) {
+            continue;
+        }
+
+        if (pooled) {
+            xiaLog(XIA_LOG_WARNING, "xiaRunGroups",
+                   "Unable to queue module '%s', running it in place",
+                   group->module->alias);
+        }
+
+        xiaRunGroup(group);
+    }
+
+    if (pooled) {
+        xiaTaskGroupWait(&tasks);
+    }
+
+    for (j = 0; j < nGroups; j++) {
+        RunGroup* group = &groups[j];
+
+        if (group->master != masters) {
+            continue;
+        }
+
+        if (group->status != XIA_SUCCESS && status == XIA_SUCCESS) {
+            status = group->status;
+            xiaLog(XIA_LOG_ERROR, status, "xiaRunGroups",
+                   "Error %s the run on module '%s'",
+                   group->start ? "starting" : "stopping", group->module->alias);
+        }
+    }
+
+    return status;
+}
@@ -51,7 +51,15 @@
 #include "handel_log.h"
 #include "handeldef.h"
 
+#include "xerxes.h"
+#include "xerxes_errors.h"
+
 static boolean_t HANDEL_API xiaIsUpperCase(char* string);
+static int HANDEL_API xiaCommitAcquisitionBatchChan(int detChan);
+static void HANDEL_API xiaAbortAcquisitionBatch(DetChanSetElem* head,
+                                                DetChanSetElem* stop);
+static int HANDEL_API xiaCommitModifiedValues(int detChan, XiaDefaults* defaults,
+                                              Module* module, unsigned int modChan);
 
 /*
  * Sets an acquisition value.
@@ -62,6 +70,10 @@ static boolean_t HANDEL_API xiaIsUpperCase(char* string);
  *
  * value must be a double *. value may be adjusted in translation. The
  * updated value is returned through the same parameter.
+ *
+ * Inside an acquisition value batch the value is checked and set right
+ * away, but the PSL may postpone dependent updates, e.g. the filter
+ * recompute after a peaking time change, until xiaCommitAcquisitionBatch().
  */
 HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
                                                      void* value) {
@@ -75,7 +87,6 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
 
     char detectorType[MAXITEM_LEN];
 
-    char* boardAlias;
     char* firmAlias;
     char* detectorAlias;
 
@@ -140,8 +151,7 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
              */
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
 
-            boardAlias = xiaGetAliasFromDetChan(detChan);
-            module = xiaFindModule(boardAlias);
+            module = xiaLockModule(detChan);
             modChan = xiaGetModChan((unsigned int) detChan);
             firmAlias = module->firmware[modChan];
             firmwareSet = xiaFindFirmware(firmAlias);
@@ -165,6 +175,7 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
                 case XIA_DET_UNKNOWN:
                     xiaLog(XIA_LOG_ERROR, XIA_MISSING_TYPE, "xiaSetAcquisitionValues",
                            "No detector type specified for detChan %d", detChan);
+                    xiaUnlockModule(module);
                     return XIA_MISSING_TYPE;
             }
 
@@ -193,20 +204,43 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaSetAcquisitionValues",
                            "Error adding %s to defaults %s", name, defaults->alias);
+                    xiaUnlockModule(module);
                     return status;
                 }
             }
 
-            status = localFuncs.setAcquisitionValues(
+            status = xiaCancelStatus(localFuncs.setAcquisitionValues(
                 detChan, name, value, defaults, firmwareSet, currentFirmware,
-                detectorType, detector, detector_chan, module, modChan);
+                detectorType, detector, detector_chan, module, modChan));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaSetAcquisitionValues",
                        "Unable to set '%s' to %0.3f for detChan %d.", name,
                        *((double*) value), detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+
+            if (module->ch[modChan].in_batch) {
+                /* xiaAddDefaultItem() may have just appended the entry. */
+                for (entry = defaults->entry; entry != NULL; entry = entry->next) {
+                    if (STREQ(name, entry->name)) {
+                        entry->state |= AV_STATE_MODIFIED;
+                        break;
+                    }
+                }
+            } else {
+                /* A batch leaves the writes to xiaCommitAcquisitionBatch(). */
+                status = xiaFlushDSPParams(detChan);
+
+                if (status != XIA_SUCCESS) {
+                    xiaLog(XIA_LOG_ERROR, status, "xiaSetAcquisitionValues",
+                           "Unable to write '%s' for detChan %d.", name, detChan);
+                    xiaUnlockModule(module);
+                    return status;
+                }
+            }
+            xiaUnlockModule(module);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
@@ -245,6 +279,290 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char* name,
     return XIA_SUCCESS;
 }
 
+/*
+ * Starts an acquisition value batch for detChan, which may be a single
+ * detChan or a detChan set.
+ *
+ * Until xiaCommitAcquisitionBatch() is called, xiaSetAcquisitionValues()
+ * may leave updates that depend on several acquisition values to the
+ * commit. Values that the PSL adjusts in those updates, such as the
+ * peaking time, are only returned adjusted after the commit, and the
+ * commit reports any error those updates run into.
+ *
+ * If a batch cannot be started for every detChan of a set, the batches
+ * started by this call are closed again before returning the error.
+ */
+HANDEL_EXPORT int HANDEL_API xiaBeginAcquisitionBatch(int detChan) {
+    int status;
+    int elemType;
+
+    unsigned int modChan;
+
+    DetChanElement* detChanElem = NULL;
+
+    DetChanSetElem* detChanSetElem = NULL;
+
+    Module* module = NULL;
+
+    elemType = xiaGetElemType((unsigned int) detChan);
+
+    switch (elemType) {
+        case SINGLE:
+            module = xiaLockModule(detChan);
+            modChan = xiaGetModChan((unsigned int) detChan);
+
+            if (module->ch[modChan].in_batch) {
+                xiaLog(XIA_LOG_ERROR, XIA_ILLEGAL_OPERATION, "xiaBeginAcquisitionBatch",
+                       "An acquisition value batch is already open for detChan %d",
+                       detChan);
+                xiaUnlockModule(module);
+                return XIA_ILLEGAL_OPERATION;
+            }
+
+            module->ch[modChan].in_batch = TRUE_;
+            xiaUnlockModule(module);
+            break;
+        case SET:
+            detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
+            detChanSetElem = detChanElem->data.detChanSet;
+
+            while (detChanSetElem != NULL) {
+                status = xiaBeginAcquisitionBatch((int) detChanSetElem->channel);
+
+                if (status != XIA_SUCCESS) {
+                    xiaLog(XIA_LOG_ERROR, status, "xiaBeginAcquisitionBatch",
+                           "Error starting acquisition value batch for detChan %d",
+                           detChan);
+                    xiaAbortAcquisitionBatch(detChanElem->data.detChanSet,
+                                             detChanSetElem);
+                    return status;
+                }
+                detChanSetElem = getListNext(detChanSetElem);
+            }
+            break;
+        case 999:
+            xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaBeginAcquisitionBatch",
+                   "detChan number is not in the list of valid values ");
+            return XIA_INVALID_DETCHAN;
+        default:
+            xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN, "xiaBeginAcquisitionBatch",
+                   "Should not be seeing this message");
+            return XIA_UNKNOWN;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Finishes the acquisition value batch started by
+ * xiaBeginAcquisitionBatch() and closes it.
+ *
+ * PSLs that implement commitAcquisitionValues resolve the dependent
+ * filter and gain settings once for the whole batch and apply them
+ * together. Other PSLs have already set each value in full. Nothing is
+ * sent to the PSL if no value was set during the batch.
+ *
+ * The batch is closed even if the commit fails.
+ */
+HANDEL_EXPORT int HANDEL_API xiaCommitAcquisitionBatch(int detChan) {
+    int status = XIA_SUCCESS;
+    int memberStatus;
+    int elemType;
+
+    DetChanElement* detChanElem = NULL;
+
+    DetChanSetElem* detChanSetElem = NULL;
+
+    elemType = xiaGetElemType((unsigned int) detChan);
+
+    switch (elemType) {
+        case SINGLE:
+            status = xiaCommitAcquisitionBatchChan(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaCommitAcquisitionBatch",
+                       "Error committing acquisition values for detChan %d", detChan);
+                return status;
+            }
+            break;
+        case SET:
+            detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
+            detChanSetElem = detChanElem->data.detChanSet;
+
+            /* Close every member's batch, even after a failure. */
+            while (detChanSetElem != NULL) {
+                memberStatus =
+                    xiaCommitAcquisitionBatch((int) detChanSetElem->channel);
+
+                if (memberStatus != XIA_SUCCESS && status == XIA_SUCCESS) {
+                    status = memberStatus;
+                }
+                detChanSetElem = getListNext(detChanSetElem);
+            }
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaCommitAcquisitionBatch",
+                       "Error committing acquisition values for detChan %d", detChan);
+                return status;
+            }
+            break;
+        case 999:
+            xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaCommitAcquisitionBatch",
+                   "detChan number is not in the list of valid values ");
+            return XIA_INVALID_DETCHAN;
+        default:
+            xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN, "xiaCommitAcquisitionBatch",
+                   "Should not be seeing this message");
+            return XIA_UNKNOWN;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Commits the acquisition value batch for a single detChan.
+ */
+static int HANDEL_API xiaCommitAcquisitionBatchChan(int detChan) {
+    int status = XIA_SUCCESS;
+
+    unsigned int modChan;
+
+    boolean_t modified = FALSE_;
+
+    XiaDefaults* defaults = NULL;
+
+    XiaDaqEntry* entry = NULL;
+
+    Module* module = NULL;
+
+    module = xiaLockModule(detChan);
+    modChan = xiaGetModChan((unsigned int) detChan);
+
+    if (!module->ch[modChan].in_batch) {
+        xiaLog(XIA_LOG_ERROR, XIA_ILLEGAL_OPERATION, "xiaCommitAcquisitionBatchChan",
+               "No acquisition value batch is open for detChan %d", detChan);
+        xiaUnlockModule(module);
+        return XIA_ILLEGAL_OPERATION;
+    }
+
+    module->ch[modChan].in_batch = FALSE_;
+
+    defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
+
+    for (entry = defaults->entry; entry != NULL; entry = entry->next) {
+        if (entry->state & AV_STATE_MODIFIED) {
+            modified = TRUE_;
+            entry->state &= (flag_t) ~AV_STATE_MODIFIED;
+        }
+    }
+
+    if (modified) {
+        status = xiaCommitModifiedValues(detChan, defaults, module, modChan);
+    } else {
+        xiaLog(XIA_LOG_DEBUG, "xiaCommitAcquisitionBatchChan",
+               "No acquisition values were set in the batch for detChan %d", detChan);
+    }
+
+    xiaUnlockModule(module);
+    return status;
+}
+
+/*
+ * Closes the acquisition value batches of the set members from head up
+ * to, but not including, stop. Used to undo a partially started batch.
+ */
+static void HANDEL_API xiaAbortAcquisitionBatch(DetChanSetElem* head,
+                                                DetChanSetElem* stop) {
+    int status;
+
+    for (; head != NULL && head != stop; head = getListNext(head)) {
+        status = xiaCommitAcquisitionBatch((int) head->channel);
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_WARNING, "xiaAbortAcquisitionBatch",
+                   "Error closing acquisition value batch for detChan %u (%d)",
+                   head->channel, status);
+        }
+    }
+}
+
+/*
+ * Lets the PSL finish the work it postponed while the batch for detChan
+ * was open and writes out any DSP parameters Xerxes is holding back.
+ */
+static int HANDEL_API xiaCommitModifiedValues(int detChan, XiaDefaults* defaults,
+                                              Module* module, unsigned int modChan) {
+    int status;
+
+    char boardType[MAXITEM_LEN];
+    char detectorType[MAXITEM_LEN];
+
+    FirmwareSet* firmwareSet = NULL;
+
+    Detector* detector = NULL;
+
+    PSLFuncs localFuncs;
+
+    status = xiaGetBoardType(detChan, boardType);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaCommitModifiedValues",
+               "Unable to get boardType for detChan %d", detChan);
+        return status;
+    }
+
+    status = xiaLoadPSL(boardType, &localFuncs);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaCommitModifiedValues",
+               "Unable to load PSL funcs for detChan %d", detChan);
+        return status;
+    }
+
+    if (localFuncs.commitAcquisitionValues != NULL) {
+        firmwareSet = xiaFindFirmware(module->firmware[modChan]);
+        detector = xiaFindDetector(module->detector[modChan]);
+
+        switch (detector->type) {
+            case XIA_DET_RESET:
+                strcpy(detectorType, "RESET");
+                break;
+            case XIA_DET_RCFEED:
+                strcpy(detectorType, "RC");
+                break;
+            default:
+            case XIA_DET_UNKNOWN:
+                xiaLog(XIA_LOG_ERROR, XIA_MISSING_TYPE, "xiaCommitModifiedValues",
+                       "No detector type specified for detChan %d", detChan);
+                return XIA_MISSING_TYPE;
+        }
+
+        status = xiaCancelStatus(
+            localFuncs.commitAcquisitionValues(detChan, defaults, firmwareSet,
+                                               &module->currentFirmware[modChan],
+                                               detectorType, detector,
+                                               module->detector_chan[modChan], module,
+                                               (int) modChan));
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "xiaCommitModifiedValues",
+                   "Unable to commit acquisition values for detChan %d", detChan);
+            return status;
+        }
+    }
+
+    /* Push out any DSP parameter writes that Xerxes is holding back. */
+    status = xiaFlushDSPParams(detChan);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaCommitModifiedValues",
+               "Error writing DSP parameters for detChan %d", detChan);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
 /*
  * Gets an acquisition value. Unless otherwise noted, all acquisition
  * values require value to be a double *, cast as void *.
@@ -258,6 +576,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetAcquisitionValues(int detChan, char* name,
 
     XiaDefaults* defaults = NULL;
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
     if (name == NULL) {
@@ -297,13 +617,18 @@ HANDEL_EXPORT int HANDEL_API xiaGetAcquisitionValues(int detChan, char* name,
 
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
 
-            status = localFuncs.getAcquisitionValues(detChan, name, value, defaults);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.getAcquisitionValues(detChan, name,
+                                                                     value, defaults));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetAcquisitionValues",
                        "Unable to get acquisition values for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case 999:
             xiaLog(XIA_LOG_ERROR, XIA_INVALID_DETCHAN, "xiaGetAcquisitionValues",
@@ -355,7 +680,6 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveAcquisitionValues(int detChan, char* name)
 
     Detector* det = NULL;
 
-    char* alias = NULL;
     char* firmAlias = NULL;
     char* detAlias = NULL;
 
@@ -385,6 +709,8 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveAcquisitionValues(int detChan, char* name)
                 return status;
             }
 
+            m = xiaLockModule(detChan);
+
             defaults = xiaGetDefaultFromDetChan(detChan);
 
             entry = defaults->entry;
@@ -409,8 +735,6 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveAcquisitionValues(int detChan, char* name)
             /* Since we don't know what was removed, we better re-download all
              * the acquisition values again.
              */
-            alias = xiaGetAliasFromDetChan(detChan);
-            m = xiaFindModule(alias);
             modChan = xiaGetModChan(detChan);
             firmAlias = m->firmware[modChan];
             fs = xiaFindFirmware(firmAlias);
@@ -430,20 +754,24 @@ HANDEL_EXPORT int HANDEL_API xiaRemoveAcquisitionValues(int detChan, char* name)
                 case XIA_DET_UNKNOWN:
                     xiaLog(XIA_LOG_ERROR, XIA_MISSING_TYPE, "xiaSetAcquisitionValues",
                            "No detector type specified for detChan %d", detChan);
+                    xiaUnlockModule(m);
                     return XIA_MISSING_TYPE;
             }
 
-            status = localFuncs.userSetup(detChan, defaults, fs,
-                                          &(m->currentFirmware[modChan]), detType, det,
-                                          m->detector_chan[modChan], m, modChan);
+            status = xiaCancelStatus(
+                localFuncs.userSetup(detChan, defaults, fs,
+                                     &(m->currentFirmware[modChan]), detType, det,
+                                     m->detector_chan[modChan], m, modChan));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(
                     XIA_LOG_ERROR, status, "xiaRemoveAcquisitionValues",
                     "Error updating acquisition values after '%s' removed from list for detChan %d",
                     name, detChan);
+                xiaUnlockModule(m);
                 return status;
             }
+            xiaUnlockModule(m);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr(detChan);
@@ -557,7 +885,6 @@ HANDEL_EXPORT int HANDEL_API xiaGainOperation(int detChan, char* name, void* val
 
     char boardType[MAXITEM_LEN];
 
-    char* boardAlias;
     char* detectorAlias;
 
     DetChanElement* detChanElem = NULL;
@@ -603,20 +930,31 @@ HANDEL_EXPORT int HANDEL_API xiaGainOperation(int detChan, char* name, void* val
             }
 
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
-            boardAlias = xiaGetAliasFromDetChan(detChan);
-            module = xiaFindModule(boardAlias);
+            module = xiaLockModule(detChan);
             modChan = xiaGetModChan((unsigned int) detChan);
             detectorAlias = module->detector[modChan];
             detector = xiaFindDetector(detectorAlias);
 
-            status = localFuncs.gainOperation(detChan, name, value, detector, modChan,
-                                              module, defaults);
+            status = xiaCancelStatus(localFuncs.gainOperation(detChan, name, value,
+                                                              detector, modChan, module,
+                                                              defaults));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGainOperation",
                        "Error performing the gain Operation for detChan %d", detChan);
+                xiaUnlockModule(module);
+                return status;
+            }
+
+            status = xiaFlushDSPParams(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaGainOperation",
+                       "Unable to write the new gain for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr(detChan);
@@ -660,7 +998,6 @@ HANDEL_EXPORT int HANDEL_API xiaGainCalibrate(int detChan, double deltaGain) {
     char boardType[MAXITEM_LEN];
 
     char* detectorAlias;
-    char* boardAlias;
 
     Detector* detector = NULL;
 
@@ -695,20 +1032,31 @@ HANDEL_EXPORT int HANDEL_API xiaGainCalibrate(int detChan, double deltaGain) {
             }
 
             defaults = xiaGetDefaultFromDetChan((unsigned int) detChan);
-            boardAlias = xiaGetAliasFromDetChan(detChan);
-            module = xiaFindModule(boardAlias);
+            module = xiaLockModule(detChan);
             modChan = xiaGetModChan((unsigned int) detChan);
             detectorAlias = module->detector[modChan];
             detector = xiaFindDetector(detectorAlias);
 
-            status = localFuncs.gainCalibrate(detChan, detector, modChan, module,
-                                              defaults, deltaGain);
+            status = xiaCancelStatus(localFuncs.gainCalibrate(detChan, detector,
+                                                              modChan, module, defaults,
+                                                              deltaGain));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGainCalibrate",
                        "Error calibrating the gain for detChan %d", detChan);
+                xiaUnlockModule(module);
+                return status;
+            }
+
+            status = xiaFlushDSPParams(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaGainCalibrate",
+                       "Unable to write the new gain for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
@@ -747,6 +1095,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetParameter(int detChan, const char* name,
 
     char boardType[MAXITEM_LEN];
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
     if (name == NULL) {
@@ -781,13 +1131,17 @@ HANDEL_EXPORT int HANDEL_API xiaGetParameter(int detChan, const char* name,
                 return status;
             }
 
-            status = localFuncs.getParameter(detChan, name, value);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.getParameter(detChan, name, value));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetParameter",
                        "Error getting parameter %s from detChan %d", name, detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             xiaLog(XIA_LOG_ERROR, XIA_BAD_TYPE, "xiaGetParameter",
@@ -820,6 +1174,8 @@ HANDEL_EXPORT int HANDEL_API xiaSetParameter(int detChan, const char* name,
 
     DetChanElement* detChanElem = NULL;
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
     if (name == NULL) {
@@ -848,13 +1204,26 @@ HANDEL_EXPORT int HANDEL_API xiaSetParameter(int detChan, const char* name,
                 return status;
             }
 
-            status = localFuncs.setParameter(detChan, name, value);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.setParameter(detChan, name, value));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaSetParameter",
                        "Error setting parameter %s from detChan %d", name, detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+
+            status = xiaFlushDSPParams(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaSetParameter",
+                       "Unable to write parameter %s for detChan %d", name, detChan);
+                xiaUnlockModule(module);
+                return status;
+            }
+            xiaUnlockModule(module);
             break;
         case SET:
             detChanElem = xiaGetDetChanPtr((unsigned int) detChan);
@@ -895,6 +1264,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetNumParams(int detChan, unsigned short* value)
 
     char boardType[MAXITEM_LEN];
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
     if (value == NULL) {
@@ -924,13 +1295,17 @@ HANDEL_EXPORT int HANDEL_API xiaGetNumParams(int detChan, unsigned short* value)
                 return status;
             }
 
-            status = localFuncs.getNumParams(detChan, value);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.getNumParams(detChan, value));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetNumParams",
                        "Error getting number of DSP params from detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             xiaLog(XIA_LOG_ERROR, XIA_BAD_TYPE, "xiaGetNumParams",
@@ -974,6 +1349,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetParamData(int detChan, char* name, void* valu
 
     char boardType[MAXITEM_LEN];
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
     if (name == NULL) {
@@ -1007,13 +1384,17 @@ HANDEL_EXPORT int HANDEL_API xiaGetParamData(int detChan, char* name, void* valu
                 return status;
             }
 
-            status = localFuncs.getParamData(detChan, name, value);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.getParamData(detChan, name, value));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetParamData",
                        "Error getting DSP param data from detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             xiaLog(XIA_LOG_ERROR, XIA_BAD_TYPE, "xiaGetParamData",
@@ -1045,6 +1426,8 @@ HANDEL_EXPORT int HANDEL_API xiaGetParamName(int detChan, unsigned short index,
 
     char boardType[MAXITEM_LEN];
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
     if (name == NULL) {
@@ -1073,13 +1456,17 @@ HANDEL_EXPORT int HANDEL_API xiaGetParamName(int detChan, unsigned short index,
                 return status;
             }
 
-            status = localFuncs.getParamName(detChan, index, name);
+            module = xiaLockModule(detChan);
+
+            status = xiaCancelStatus(localFuncs.getParamName(detChan, index, name));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaGetParamName",
                        "Error getting DSP params from detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             xiaLog(XIA_LOG_ERROR, XIA_BAD_TYPE, "xiaGetParamName",
@@ -0,0 +1,1226 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file handel_snapshot.c
+ * @brief Binary system snapshots for xiaSaveSystem() and xiaLoadSystem().
+ *
+ * A snapshot holds the same configuration as a "handel_ini" file, in a form
+ * that loads without any text parsing. It also keeps the complete state of
+ * every acquisition value and, optionally, an image of each channel's DSP
+ * parameters.
+ *
+ * Everything is written in host byte order:
+ *
+ *   header: "XIASNAP\0", uint32 byte order mark, uint32 version, uint32 flags
+ *   object: uint8 kind, string alias, items..., empty string
+ *   item:   string name, uint8 type, value
+ *   string: uint32 length, characters without a terminator
+ *
+ * Objects are written in the order xiaReadIniFile() loads sections:
+ * detectors, firmware, defaults and modules, followed by any DSP images.
+ * Items are replayed through the same xiaAdd*Item() calls the .ini loader
+ * uses, so a snapshot is validated exactly like an .ini file.
+ *
+ * DSP images are attached to their modules and consumed by the next
+ * xiaStartSystem(). If a channel runs the firmware and DSP symbol table its
+ * image was captured with, the image's writable parameters are written
+ * straight to the DSP in blocks of consecutive parameters and applied, in
+ * place of the user setup that would recompute them from the acquisition
+ * values. Other channels get their usual user setup. Images are only meant
+ * to be restored onto the hardware they were captured from.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xerxes.h"
+#include "xerxes_errors.h"
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_file.h"
+#include "xia_handel.h"
+#include "xia_handel_structures.h"
+#include "xia_module.h"
+#include "xia_system.h"
+
+#include "handel_errors.h"
+#include "handel_generic.h"
+#include "handel_log.h"
+
+#define SNAP_MAGIC "XIASNAP"
+#define SNAP_BOM 0x01020304UL
+#define SNAP_VERSION 1
+
+/* Header flags */
+#define SNAP_HAS_IMAGES 0x1
+
+/* Object kinds */
+#define SNAP_END 0
+#define SNAP_DETECTOR 'D'
+#define SNAP_FIRMWARE 'F'
+#define SNAP_DEFAULTS 'A'
+#define SNAP_MODULE 'M'
+#define SNAP_IMAGE 'I'
+
+/* Item types */
+#define SNAP_STRING 's'
+#define SNAP_DOUBLE 'd'
+#define SNAP_UINT 'u'
+#define SNAP_INT 'i'
+#define SNAP_USHORT 'h'
+#define SNAP_BYTE 'b'
+#define SNAP_DAQ 'e'
+
+/* DSP image items that name the running firmware */
+static const struct {
+    const char* name;
+    size_t offset;
+} FIRMWARE_ITEMS[] = {
+    {"fippi", offsetof(CurrentFirmware, currentFiPPI)},
+    {"user_fippi", offsetof(CurrentFirmware, currentUserFiPPI)},
+    {"dsp", offsetof(CurrentFirmware, currentDSP)},
+    {"user_dsp", offsetof(CurrentFirmware, currentUserDSP)},
+    {"mmu", offsetof(CurrentFirmware, currentMMU)},
+    {"system_fpga", offsetof(CurrentFirmware, currentSysFPGA)},
+    {"system_fippi", offsetof(CurrentFirmware, currentSysFiPPI)},
+};
+
+typedef struct {
+    FILE* fp;
+    boolean_t isOk;
+} SnapWriter;
+
+typedef struct {
+    const byte_t* p;
+    const byte_t* end;
+    boolean_t isOk;
+} SnapReader;
+
+/* A decoded item value. Strings are kept separately. */
+typedef struct {
+    byte_t type;
+    double d;
+    double pending;
+    unsigned int u;
+    int i;
+    unsigned short h;
+    byte_t b;
+    flag_t state;
+    char s[MAX_PATH_LEN];
+} SnapValue;
+
+static int snapWriteConfig(SnapWriter* w);
+static int snapWriteImages(SnapWriter* w);
+static int snapReadObject(SnapReader* r, byte_t kind, char* alias);
+static int snapAddImageItem(Module* module, DspImage** image, char* name,
+                            SnapValue* value, unsigned short* nParams);
+static int snapImageMatches(int detChan, DspImage* image, CurrentFirmware* running,
+                            PSLFuncs* localFuncs, boolean_t* matches);
+static int snapWriteImage(int detChan, DspImage* image, PSLFuncs* localFuncs,
+                          XiaDefaults* defaults);
+
+/*
+ * Low-level writers. The first failure is latched in w->isOk so callers
+ * only need to check once per object.
+ */
+static void snapPut(SnapWriter* w, const void* data, size_t n) {
+    if (w->isOk && fwrite(data, 1, n, w->fp) != n) {
+        w->isOk = FALSE_;
+    }
+}
+
+static void snapPutU8(SnapWriter* w, byte_t v) {
+    snapPut(w, &v, sizeof(v));
+}
+
+static void snapPutU32(SnapWriter* w, unsigned long v) {
+    uint32_t v32 = (uint32_t) v;
+    snapPut(w, &v32, sizeof(v32));
+}
+
+static void snapPutString(SnapWriter* w, const char* s) {
+    size_t len = strlen(s);
+    snapPutU32(w, (unsigned long) len);
+    snapPut(w, s, len);
+}
+
+static void snapBeginObject(SnapWriter* w, byte_t kind, const char* alias) {
+    snapPutU8(w, kind);
+    snapPutString(w, alias);
+}
+
+static void snapEndObject(SnapWriter* w) {
+    snapPutString(w, "");
+}
+
+static void snapItemString(SnapWriter* w, const char* name, const char* value) {
+    snapPutString(w, name);
+    snapPutU8(w, SNAP_STRING);
+    snapPutString(w, value);
+}
+
+static void snapItemDouble(SnapWriter* w, const char* name, double value) {
+    snapPutString(w, name);
+    snapPutU8(w, SNAP_DOUBLE);
+    snapPut(w, &value, sizeof(value));
+}
+
+static void snapItemUInt(SnapWriter* w, const char* name, unsigned int value) {
+    snapPutString(w, name);
+    snapPutU8(w, SNAP_UINT);
+    snapPut(w, &value, sizeof(value));
+}
+
+static void snapItemInt(SnapWriter* w, const char* name, int value) {
+    snapPutString(w, name);
+    snapPutU8(w, SNAP_INT);
+    snapPut(w, &value, sizeof(value));
+}
+
+static void snapItemUShort(SnapWriter* w, const char* name, unsigned short value) {
+    snapPutString(w, name);
+    snapPutU8(w, SNAP_USHORT);
+    snapPut(w, &value, sizeof(value));
+}
+
+static void snapItemByte(SnapWriter* w, const char* name, byte_t value) {
+    snapPutString(w, name);
+    snapPutU8(w, SNAP_BYTE);
+    snapPutU8(w, value);
+}
+
+static void snapItemDaq(SnapWriter* w, XiaDaqEntry* entry) {
+    snapPutString(w, entry->name);
+    snapPutU8(w, SNAP_DAQ);
+    snapPut(w, &entry->data, sizeof(entry->data));
+    snapPut(w, &entry->pending, sizeof(entry->pending));
+    snapPut(w, &entry->state, sizeof(entry->state));
+}
+
+/*
+ * Low-level readers. Reading past the end of the buffer latches r->isOk.
+ */
+static void snapGet(SnapReader* r, void* data, size_t n) {
+    if (!r->isOk || (size_t) (r->end - r->p) < n) {
+        r->isOk = FALSE_;
+        memset(data, 0, n);
+        return;
+    }
+
+    memcpy(data, r->p, n);
+    r->p += n;
+}
+
+static byte_t snapGetU8(SnapReader* r) {
+    byte_t v;
+    snapGet(r, &v, sizeof(v));
+    return v;
+}
+
+static unsigned long snapGetU32(SnapReader* r) {
+    uint32_t v;
+    snapGet(r, &v, sizeof(v));
+    return (unsigned long) v;
+}
+
+static void snapGetString(SnapReader* r, char* s, size_t size) {
+    unsigned long len = snapGetU32(r);
+
+    if (len >= size) {
+        r->isOk = FALSE_;
+    }
+
+    if (!r->isOk) {
+        s[0] = '\0';
+        return;
+    }
+
+    snapGet(r, s, (size_t) len);
+    s[len] = '\0';
+}
+
+static void snapGetValue(SnapReader* r, SnapValue* value) {
+    value->type = snapGetU8(r);
+
+    switch (value->type) {
+        case SNAP_STRING:
+            snapGetString(r, value->s, sizeof(value->s));
+            break;
+        case SNAP_DOUBLE:
+            snapGet(r, &value->d, sizeof(value->d));
+            break;
+        case SNAP_UINT:
+            snapGet(r, &value->u, sizeof(value->u));
+            break;
+        case SNAP_INT:
+            snapGet(r, &value->i, sizeof(value->i));
+            break;
+        case SNAP_USHORT:
+            snapGet(r, &value->h, sizeof(value->h));
+            break;
+        case SNAP_BYTE:
+            value->b = snapGetU8(r);
+            break;
+        case SNAP_DAQ:
+            snapGet(r, &value->d, sizeof(value->d));
+            snapGet(r, &value->pending, sizeof(value->pending));
+            snapGet(r, &value->state, sizeof(value->state));
+            break;
+        default:
+            r->isOk = FALSE_;
+            break;
+    }
+}
+
+/*
+ * Returns a pointer to the decoded value in the form the xiaAdd*Item()
+ * routines expect.
+ */
+static void* snapValuePtr(SnapValue* value) {
+    switch (value->type) {
+        case SNAP_STRING:
+            return value->s;
+        case SNAP_UINT:
+            return &value->u;
+        case SNAP_INT:
+            return &value->i;
+        case SNAP_USHORT:
+            return &value->h;
+        case SNAP_BYTE:
+            return &value->b;
+        case SNAP_DOUBLE:
+        case SNAP_DAQ:
+        default:
+            return &value->d;
+    }
+}
+
+/*
+ * Writes the current configuration to filename as a binary snapshot. If
+ * withImages is set, the DSP parameters of every enabled channel are
+ * included. This requires the system to have been started.
+ */
+int HANDEL_API xiaWriteSnapshot(char* filename, boolean_t withImages) {
+    int status;
+
+    SnapWriter w;
+
+    Module* module;
+
+    if (filename == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_PATH, "xiaWriteSnapshot",
+               "filename cannot be NULL");
+        return XIA_NULL_PATH;
+    }
+
+    if (STREQ(filename, "")) {
+        xiaLog(XIA_LOG_ERROR, XIA_NO_FILENAME, "xiaWriteSnapshot",
+               "filename cannot be empty string");
+        return XIA_NO_FILENAME;
+    }
+
+    if (withImages) {
+        for (module = xiaGetModuleHead(); module != NULL; module = module->next) {
+            if (!module->isSetup) {
+                xiaLog(XIA_LOG_ERROR, XIA_ILLEGAL_OPERATION, "xiaWriteSnapshot",
+                       "Module '%s' must be started before its DSP parameters "
+                       "can be saved",
+                       module->alias);
+                return XIA_ILLEGAL_OPERATION;
+            }
+        }
+    }
+
+    w.fp = xia_file_open(filename, "wb");
+    w.isOk = TRUE_;
+
+    if (w.fp == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_OPEN_FILE, "xiaWriteSnapshot", "Could not open %s",
+               filename);
+        return XIA_OPEN_FILE;
+    }
+
+    snapPut(&w, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+    snapPutU32(&w, SNAP_BOM);
+    snapPutU32(&w, SNAP_VERSION);
+    snapPutU32(&w, withImages ? SNAP_HAS_IMAGES : 0);
+
+    status = snapWriteConfig(&w);
+
+    if (status == XIA_SUCCESS && withImages) {
+        status = snapWriteImages(&w);
+    }
+
+    snapPutU8(&w, SNAP_END);
+
+    xia_file_close(w.fp);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaWriteSnapshot",
+               "Error writing snapshot '%s'", filename);
+        return status;
+    }
+
+    if (!w.isOk) {
+        xiaLog(XIA_LOG_ERROR, XIA_FILEERR, "xiaWriteSnapshot",
+               "Error writing to snapshot '%s'", filename);
+        return XIA_FILEERR;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes the detectors, firmware sets, defaults and modules, in that order.
+ */
+static int snapWriteConfig(SnapWriter* w) {
+    unsigned int i;
+
+    char name[MAXITEM_LEN];
+    char value[MAXITEM_LEN];
+
+    Detector* detector;
+    FirmwareSet* firmwareSet;
+    Firmware* firmware;
+    XiaDefaults* defaults;
+    XiaDaqEntry* entry;
+    Module* module;
+
+    for (detector = xiaGetDetectorHead(); detector != NULL; detector = detector->next) {
+        snapBeginObject(w, SNAP_DETECTOR, detector->alias);
+        snapItemUShort(w, "number_of_channels", detector->nchan);
+
+        switch (detector->type) {
+            case XIA_DET_RESET:
+                snapItemString(w, "type", "reset");
+                break;
+            case XIA_DET_RCFEED:
+                snapItemString(w, "type", "rc_feedback");
+                break;
+            default:
+            case XIA_DET_UNKNOWN:
+                xiaLog(XIA_LOG_ERROR, XIA_MISSING_TYPE, "snapWriteConfig",
+                       "Unknown detector type for alias %s", detector->alias);
+                return XIA_MISSING_TYPE;
+        }
+
+        snapItemDouble(w, "type_value", detector->typeValue[0]);
+
+        for (i = 0; i < detector->nchan; i++) {
+            sprintf(name, "channel%u_gain", i);
+            snapItemDouble(w, name, detector->gain[i]);
+
+            sprintf(name, "channel%u_polarity", i);
+            snapItemString(w, name, detector->polarity[i] ? "+" : "-");
+        }
+
+        snapEndObject(w);
+    }
+
+    for (firmwareSet = xiaGetFirmwareSetHead(); firmwareSet != NULL;
+         firmwareSet = firmwareSet->next) {
+        snapBeginObject(w, SNAP_FIRMWARE, firmwareSet->alias);
+
+        if (firmwareSet->mmu != NULL) {
+            snapItemString(w, "mmu", firmwareSet->mmu);
+        }
+
+        if (firmwareSet->filename != NULL) {
+            snapItemString(w, "filename", firmwareSet->filename);
+
+            if (firmwareSet->tmpPath != NULL) {
+                snapItemString(w, "fdd_tmp_path", firmwareSet->tmpPath);
+            }
+
+            for (i = 0; i < firmwareSet->numKeywords; i++) {
+                snapItemString(w, "keyword", firmwareSet->keywords[i]);
+            }
+        }
+
+        for (firmware = firmwareSet->firmware; firmware != NULL;
+             firmware = firmware->next) {
+            snapItemUShort(w, "ptrr", firmware->ptrr);
+            snapItemDouble(w, "min_peaking_time", firmware->min_ptime);
+            snapItemDouble(w, "max_peaking_time", firmware->max_ptime);
+
+            if (firmware->fippi != NULL) {
+                snapItemString(w, "fippi", firmware->fippi);
+            }
+
+            if (firmware->user_fippi != NULL) {
+                snapItemString(w, "user_fippi", firmware->user_fippi);
+            }
+
+            if (firmware->dsp != NULL) {
+                snapItemString(w, "dsp", firmware->dsp);
+            }
+
+            for (i = 0; i < firmware->numFilter; i++) {
+                snapItemUShort(w, "filter_info", firmware->filterInfo[i]);
+            }
+        }
+
+        snapEndObject(w);
+    }
+
+    for (defaults = xiaGetDefaultsHead(); defaults != NULL; defaults = defaults->next) {
+        snapBeginObject(w, SNAP_DEFAULTS, defaults->alias);
+
+        for (entry = defaults->entry; entry != NULL; entry = entry->next) {
+            snapItemDaq(w, entry);
+        }
+
+        snapEndObject(w);
+    }
+
+    for (module = xiaGetModuleHead(); module != NULL; module = module->next) {
+        HDLInterface* iface = module->interface_info;
+
+        snapBeginObject(w, SNAP_MODULE, module->alias);
+        snapItemString(w, "module_type", module->type);
+        snapItemUInt(w, "number_of_channels", module->number_of_channels);
+
+        /* Mirrors the items that xiaLoadModule() adds for each interface. */
+        switch (iface->type) {
+            case XIA_PLX:
+                snapItemByte(w, "pci_slot", (byte_t) iface->info.plx->slot);
+                snapItemByte(w, "pci_bus", (byte_t) iface->info.plx->bus);
+                break;
+            case XIA_EPP:
+            case XIA_GENERIC_EPP:
+                snapItemUInt(w, "epp_address", iface->info.epp->epp_address);
+                snapItemUInt(w, "daisy_chain_id", iface->info.epp->daisy_chain_id);
+                break;
+            case XIA_USB:
+                snapItemString(w, "interface", "usb");
+                snapItemUInt(w, "device_number", iface->info.usb->device_number);
+                break;
+            case XIA_USB2:
+                snapItemString(w, "interface", "usb2");
+                snapItemUInt(w, "device_number", iface->info.usb2->device_number);
+                break;
+            case XIA_SERIAL:
+                if (iface->info.serial->device_file != NULL) {
+                    snapItemString(w, "device_file", iface->info.serial->device_file);
+                } else {
+                    snapItemUInt(w, "com_port", iface->info.serial->com_port);
+                }
+
+                snapItemUInt(w, "baud_rate", iface->info.serial->baud_rate);
+                break;
+            default:
+                xiaLog(XIA_LOG_ERROR, XIA_BAD_INTERFACE, "snapWriteConfig",
+                       "Unknown interface type '%u' for module '%s'", iface->type,
+                       module->alias);
+                return XIA_BAD_INTERFACE;
+        }
+
+        for (i = 0; i < module->number_of_channels; i++) {
+            sprintf(name, "channel%u_alias", i);
+            snapItemInt(w, name, module->channels[i]);
+
+            if (module->detector[i] != NULL) {
+                sprintf(name, "channel%u_detector", i);
+                sprintf(value, "%s:%d", module->detector[i], module->detector_chan[i]);
+                snapItemString(w, name, value);
+            }
+
+            if (module->firmware[i] != NULL) {
+                sprintf(name, "firmware_set_chan%u", i);
+                snapItemString(w, name, module->firmware[i]);
+            }
+
+            if (module->defaults[i] != NULL) {
+                sprintf(name, "default_chan%u", i);
+                snapItemString(w, name, module->defaults[i]);
+            }
+        }
+
+        snapEndObject(w);
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes an image of the DSP parameters for every enabled channel.
+ */
+static int snapWriteImages(SnapWriter* w) {
+    int status;
+    int detChan;
+
+    unsigned int modChan;
+    unsigned short i;
+    unsigned short numParams;
+
+    char name[MAXITEM_LEN];
+
+    parameter_t* values;
+
+    CurrentFirmware* current;
+
+    Module* module;
+
+    PSLFuncs localFuncs;
+
+    for (module = xiaGetModuleHead(); module != NULL; module = module->next) {
+        status = xiaLoadPSL(module->type, &localFuncs);
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "snapWriteImages",
+                   "Unable to load PSL funcs for module type %s.", module->type);
+            return status;
+        }
+
+        for (modChan = 0; modChan < module->number_of_channels; modChan++) {
+            detChan = module->channels[modChan];
+
+            if (detChan < 0) {
+                continue;
+            }
+
+            status = localFuncs.getNumParams(detChan, &numParams);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "snapWriteImages",
+                       "Error getting the number of DSP parameters for detChan %d",
+                       detChan);
+                return status;
+            }
+
+            values = handel_md_alloc(numParams * sizeof(parameter_t));
+
+            if (values == NULL) {
+                xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "snapWriteImages",
+                       "Unable to allocate %zu bytes for the DSP parameters of "
+                       "detChan %d",
+                       numParams * sizeof(parameter_t), detChan);
+                return XIA_NOMEM;
+            }
+
+            status = localFuncs.getParamData(detChan, "values", values);
+
+            if (status != XIA_SUCCESS) {
+                handel_md_free(values);
+                xiaLog(XIA_LOG_ERROR, status, "snapWriteImages",
+                       "Error reading the DSP parameters for detChan %d", detChan);
+                return status;
+            }
+
+            current = &module->currentFirmware[modChan];
+
+            snapBeginObject(w, SNAP_IMAGE, module->alias);
+            snapItemUInt(w, "channel", modChan);
+            snapItemUShort(w, "num_params", numParams);
+            snapItemString(w, "fippi", current->currentFiPPI);
+            snapItemString(w, "user_fippi", current->currentUserFiPPI);
+            snapItemString(w, "dsp", current->currentDSP);
+            snapItemString(w, "user_dsp", current->currentUserDSP);
+            snapItemString(w, "mmu", current->currentMMU);
+            snapItemString(w, "system_fpga", current->currentSysFPGA);
+            snapItemString(w, "system_fippi", current->currentSysFiPPI);
+
+            for (i = 0; i < numParams; i++) {
+                status = localFuncs.getParamName(detChan, i, name);
+
+                if (status != XIA_SUCCESS) {
+                    handel_md_free(values);
+                    xiaLog(XIA_LOG_ERROR, status, "snapWriteImages",
+                           "Error getting the name of DSP parameter %hu for "
+                           "detChan %d",
+                           i, detChan);
+                    return status;
+                }
+
+                snapItemUShort(w, name, values[i]);
+            }
+
+            snapEndObject(w);
+            handel_md_free(values);
+        }
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Loads a binary snapshot written by xiaWriteSnapshot(). Handel must
+ * already be initialized and empty.
+ */
+int HANDEL_API xiaReadSnapshot(char* filename) {
+    int status = XIA_SUCCESS;
+
+    long size;
+
+    byte_t kind;
+    byte_t* data;
+
+    char magic[sizeof(SNAP_MAGIC)];
+    char alias[MAXALIAS_LEN];
+
+    unsigned long version;
+
+    FILE* fp;
+
+    SnapReader r;
+
+    fp = xia_find_file(filename, "rb");
+
+    if (fp == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_OPEN_FILE, "xiaReadSnapshot", "Could not open %s",
+               filename);
+        return XIA_OPEN_FILE;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+        fseek(fp, 0, SEEK_SET) != 0) {
+        xia_file_close(fp);
+        xiaLog(XIA_LOG_ERROR, XIA_SET_POS, "xiaReadSnapshot",
+               "Error finding the size of %s", filename);
+        return XIA_SET_POS;
+    }
+
+    data = handel_md_alloc((size_t) size + 1);
+
+    if (data == NULL) {
+        xia_file_close(fp);
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "xiaReadSnapshot",
+               "Unable to allocate %ld bytes for %s", size, filename);
+        return XIA_NOMEM;
+    }
+
+    if (fread(data, 1, (size_t) size, fp) != (size_t) size) {
+        xia_file_close(fp);
+        handel_md_free(data);
+        xiaLog(XIA_LOG_ERROR, XIA_BAD_FILE_READ, "xiaReadSnapshot",
+               "Error reading %s", filename);
+        return XIA_BAD_FILE_READ;
+    }
+
+    xia_file_close(fp);
+
+    r.p = data;
+    r.end = data + size;
+    r.isOk = TRUE_;
+
+    snapGet(&r, magic, sizeof(magic));
+
+    if (!r.isOk || memcmp(magic, SNAP_MAGIC, sizeof(magic)) != 0 ||
+        snapGetU32(&r) != SNAP_BOM) {
+        handel_md_free(data);
+        xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaReadSnapshot",
+               "'%s' is not a snapshot written on this platform", filename);
+        return XIA_FORMAT_ERROR;
+    }
+
+    version = snapGetU32(&r);
+
+    if (version != SNAP_VERSION) {
+        handel_md_free(data);
+        xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaReadSnapshot",
+               "Unsupported snapshot version %lu in '%s'", version, filename);
+        return XIA_FORMAT_ERROR;
+    }
+
+    /* The flags are informational; images are found by their objects. */
+    snapGetU32(&r);
+
+    while (r.isOk) {
+        kind = snapGetU8(&r);
+
+        if (kind == SNAP_END) {
+            break;
+        }
+
+        snapGetString(&r, alias, sizeof(alias));
+
+        if (!r.isOk) {
+            break;
+        }
+
+        status = snapReadObject(&r, kind, alias);
+
+        if (status != XIA_SUCCESS) {
+            handel_md_free(data);
+            xiaLog(XIA_LOG_ERROR, status, "xiaReadSnapshot",
+                   "Error loading '%s' from '%s'", alias, filename);
+            return status;
+        }
+    }
+
+    handel_md_free(data);
+
+    if (!r.isOk) {
+        xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "xiaReadSnapshot",
+               "Snapshot '%s' is truncated or corrupt", filename);
+        return XIA_FORMAT_ERROR;
+    }
+
+    xiaLog(XIA_LOG_INFO, "xiaReadSnapshot", "Successfully read snapshot '%s'",
+           filename);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Creates the object named alias and replays its items.
+ */
+static int snapReadObject(SnapReader* r, byte_t kind, char* alias) {
+    int status;
+
+    unsigned short nParams = 0;
+
+    char name[MAXITEM_LEN];
+
+    SnapValue value;
+
+    Module* module = NULL;
+    DspImage* image = NULL;
+    XiaDefaults* defaults = NULL;
+    XiaDaqEntry* entry = NULL;
+
+    switch (kind) {
+        case SNAP_DETECTOR:
+            status = xiaNewDetector(alias);
+            break;
+        case SNAP_FIRMWARE:
+            status = xiaNewFirmware(alias);
+            break;
+        case SNAP_DEFAULTS:
+            status = xiaNewDefault(alias);
+            defaults = xiaFindDefault(alias);
+            break;
+        case SNAP_MODULE:
+            status = xiaNewModule(alias);
+            break;
+        case SNAP_IMAGE:
+            module = xiaFindModule(alias);
+            status = module != NULL ? XIA_SUCCESS : XIA_NO_ALIAS;
+            break;
+        default:
+            status = XIA_FORMAT_ERROR;
+            break;
+    }
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "snapReadObject",
+               "Error creating object of kind '%c' for '%s'", kind, alias);
+        return status;
+    }
+
+    while (TRUE_) {
+        snapGetString(r, name, sizeof(name));
+
+        if (!r->isOk) {
+            return XIA_FORMAT_ERROR;
+        }
+
+        if (name[0] == '\0') {
+            break;
+        }
+
+        snapGetValue(r, &value);
+
+        if (!r->isOk) {
+            return XIA_FORMAT_ERROR;
+        }
+
+        switch (kind) {
+            case SNAP_DETECTOR:
+                status = xiaAddDetectorItem(alias, name, snapValuePtr(&value));
+                break;
+            case SNAP_FIRMWARE:
+                status = xiaAddFirmwareItem(alias, name, snapValuePtr(&value));
+                break;
+            case SNAP_DEFAULTS:
+                status = xiaAddDefaultItem(alias, name, &value.d);
+
+                if (status == XIA_SUCCESS && value.type == SNAP_DAQ) {
+                    for (entry = defaults->entry; entry != NULL; entry = entry->next) {
+                        if (STREQ(entry->name, name)) {
+                            entry->pending = value.pending;
+                            entry->state = value.state;
+                            break;
+                        }
+                    }
+                }
+                break;
+            case SNAP_MODULE:
+                status = xiaAddModuleItem(alias, name, snapValuePtr(&value));
+                break;
+            case SNAP_IMAGE:
+                status = snapAddImageItem(module, &image, name, &value, &nParams);
+                break;
+            default:
+                FAIL();
+                break;
+        }
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "snapReadObject",
+                   "Error adding '%s' to '%s'", name, alias);
+            return status;
+        }
+    }
+
+    if (image != NULL && nParams != image->numParams) {
+        xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "snapReadObject",
+               "DSP image for '%s' has %hu of %hu parameters", alias, nParams,
+               image->numParams);
+        return XIA_FORMAT_ERROR;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Adds one item of a DSP image object. The channel and parameter count
+ * come first, followed by the running firmware and then the parameters.
+ */
+static int snapAddImageItem(Module* module, DspImage** image, char* name,
+                            SnapValue* value, unsigned short* nParams) {
+    unsigned int i;
+
+    size_t len;
+
+    char* field;
+
+    if (*image == NULL) {
+        if (!STREQ(name, "channel") || value->type != SNAP_UINT ||
+            value->u >= module->number_of_channels) {
+            xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "snapAddImageItem",
+                   "DSP image for '%s' must start with a valid channel",
+                   module->alias);
+            return XIA_FORMAT_ERROR;
+        }
+
+        if (module->images == NULL) {
+            module->images =
+                handel_md_alloc(module->number_of_channels * sizeof(DspImage));
+
+            if (module->images == NULL) {
+                xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "snapAddImageItem",
+                       "Unable to allocate DSP images for '%s'", module->alias);
+                return XIA_NOMEM;
+            }
+
+            memset(module->images, 0, module->number_of_channels * sizeof(DspImage));
+        }
+
+        *image = &module->images[value->u];
+        xiaFreeDSPImage(*image);
+        return XIA_SUCCESS;
+    }
+
+    if ((*image)->values == NULL) {
+        if (!STREQ(name, "num_params") || value->type != SNAP_USHORT) {
+            xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "snapAddImageItem",
+                   "DSP image for '%s' is missing its parameter count",
+                   module->alias);
+            return XIA_FORMAT_ERROR;
+        }
+
+        (*image)->names = handel_md_alloc(value->h * sizeof(char*));
+        (*image)->values = handel_md_alloc(value->h * sizeof(parameter_t) + 1);
+
+        if ((*image)->names == NULL || (*image)->values == NULL) {
+            xiaFreeDSPImage(*image);
+            xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "snapAddImageItem",
+                   "Unable to allocate a DSP image of %hu parameters for '%s'",
+                   value->h, module->alias);
+            return XIA_NOMEM;
+        }
+
+        memset((*image)->names, 0, value->h * sizeof(char*));
+        (*image)->numParams = value->h;
+        return XIA_SUCCESS;
+    }
+
+    if (value->type == SNAP_STRING) {
+        for (i = 0; i < N_ELEMS(FIRMWARE_ITEMS); i++) {
+            if (STREQ(name, FIRMWARE_ITEMS[i].name)) {
+                len = strlen(value->s);
+
+                if (len >= MAXFILENAME_LEN) {
+                    xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "snapAddImageItem",
+                           "Firmware '%s' in DSP image for '%s' is longer than %d "
+                           "characters",
+                           name, module->alias, MAXFILENAME_LEN - 1);
+                    return XIA_FORMAT_ERROR;
+                }
+
+                field = (char*) &(*image)->currentFirmware + FIRMWARE_ITEMS[i].offset;
+                memcpy(field, value->s, len);
+                field[len] = '\0';
+                return XIA_SUCCESS;
+            }
+        }
+
+        xiaLog(XIA_LOG_WARNING, "snapAddImageItem",
+               "Ignoring unknown DSP image item '%s' for '%s'", name, module->alias);
+        return XIA_SUCCESS;
+    }
+
+    if (value->type != SNAP_USHORT || *nParams >= (*image)->numParams) {
+        xiaLog(XIA_LOG_ERROR, XIA_FORMAT_ERROR, "snapAddImageItem",
+               "Unexpected DSP parameter '%s' in image for '%s'", name, module->alias);
+        return XIA_FORMAT_ERROR;
+    }
+
+    (*image)->names[*nParams] = handel_md_alloc(strlen(name) + 1);
+
+    if ((*image)->names[*nParams] == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "snapAddImageItem",
+               "Unable to allocate the name of DSP parameter '%s'", name);
+        return XIA_NOMEM;
+    }
+
+    strcpy((*image)->names[*nParams], name);
+    (*image)->values[*nParams] = value->h;
+    (*nParams)++;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Releases the memory held by image, leaving it empty.
+ */
+void HANDEL_API xiaFreeDSPImage(DspImage* image) {
+    unsigned short i;
+
+    if (image->names != NULL) {
+        for (i = 0; i < image->numParams; i++) {
+            if (image->names[i] != NULL) {
+                handel_md_free(image->names[i]);
+            }
+        }
+
+        handel_md_free(image->names);
+    }
+
+    if (image->values != NULL) {
+        handel_md_free(image->values);
+    }
+
+    memset(image, 0, sizeof(*image));
+}
+
+/*
+ * Checks that image can be written to detChan as it stands: the channel
+ * must run the firmware the image was captured with and have the same DSP
+ * symbol table. Sets matches and returns XIA_SUCCESS whether or not it does.
+ */
+static int snapImageMatches(int detChan, DspImage* image, CurrentFirmware* running,
+                            PSLFuncs* localFuncs, boolean_t* matches) {
+    int status;
+
+    unsigned int j;
+
+    unsigned short i;
+    unsigned short numParams;
+
+    char name[MAXITEM_LEN];
+
+    *matches = FALSE_;
+
+    for (j = 0; j < N_ELEMS(FIRMWARE_ITEMS); j++) {
+        if (!STREQ((char*) running + FIRMWARE_ITEMS[j].offset,
+                   (char*) &image->currentFirmware + FIRMWARE_ITEMS[j].offset)) {
+            xiaLog(XIA_LOG_INFO, "snapImageMatches",
+                   "DSP image for detChan %d was captured with %s '%s' but '%s' is "
+                   "running. Not restoring it.",
+                   detChan, FIRMWARE_ITEMS[j].name,
+                   (char*) &image->currentFirmware + FIRMWARE_ITEMS[j].offset,
+                   (char*) running + FIRMWARE_ITEMS[j].offset);
+            return XIA_SUCCESS;
+        }
+    }
+
+    status = localFuncs->getNumParams(detChan, &numParams);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "snapImageMatches",
+               "Unable to get the number of DSP parameters for detChan %d", detChan);
+        return status;
+    }
+
+    if (numParams != image->numParams) {
+        xiaLog(XIA_LOG_INFO, "snapImageMatches",
+               "DSP image for detChan %d has %hu parameters but the DSP has %hu. "
+               "Not restoring it.",
+               detChan, image->numParams, numParams);
+        return XIA_SUCCESS;
+    }
+
+    for (i = 0; i < numParams; i++) {
+        status = localFuncs->getParamName(detChan, i, name);
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "snapImageMatches",
+                   "Unable to get the name of DSP parameter %hu for detChan %d", i,
+                   detChan);
+            return status;
+        }
+
+        if (!STREQ(name, image->names[i])) {
+            xiaLog(XIA_LOG_INFO, "snapImageMatches",
+                   "DSP parameter %hu for detChan %d is '%s' but the image has "
+                   "'%s'. Not restoring it.",
+                   i, detChan, name, image->names[i]);
+            return XIA_SUCCESS;
+        }
+    }
+
+    *matches = TRUE_;
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes the writable parameters of image to detChan, one block of
+ * consecutive writable parameters at a time, and applies them. Read-only
+ * parameters are run statistics and DSP state, so they are never written.
+ */
+static int snapWriteImage(int detChan, DspImage* image, PSLFuncs* localFuncs,
+                          XiaDefaults* defaults) {
+    int status;
+    int ignored = 0;
+
+    unsigned short i;
+    unsigned short first;
+    unsigned short n;
+    unsigned short nWritten = 0;
+    unsigned short nBlocks = 0;
+
+    unsigned short* access = NULL;
+
+    access = handel_md_alloc(image->numParams * sizeof(unsigned short));
+
+    if (access == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NOMEM, "snapWriteImage",
+               "Unable to allocate %zu bytes for the DSP parameter access modes of "
+               "detChan %d",
+               image->numParams * sizeof(unsigned short), detChan);
+        return XIA_NOMEM;
+    }
+
+    status = dxp_symbolname_limits(&detChan, access, NULL, NULL);
+
+    if (status != DXP_SUCCESS) {
+        handel_md_free(access);
+        xiaLog(XIA_LOG_ERROR, status, "snapWriteImage",
+               "Error reading the DSP parameter access modes for detChan %d", detChan);
+        return status;
+    }
+
+    for (i = 0; i < image->numParams; i++) {
+        if (access[i] == 0) {
+            continue;
+        }
+
+        first = i;
+
+        while ((unsigned short) (i + 1) < image->numParams && access[i + 1] != 0) {
+            i++;
+        }
+
+        n = (unsigned short) (i - first + 1);
+        status = dxp_write_dspsymbols(&detChan, &first, &n, &image->values[first]);
+
+        if (status != DXP_SUCCESS) {
+            handel_md_free(access);
+            xiaLog(XIA_LOG_ERROR, status, "snapWriteImage",
+                   "Error restoring DSP parameters '%s' to '%s' for detChan %d",
+                   image->names[first], image->names[i], detChan);
+            return status;
+        }
+
+        nWritten = (unsigned short) (nWritten + n);
+        nBlocks++;
+    }
+
+    handel_md_free(access);
+
+    /* Devices that defer writes must have them in place before the apply. */
+    status = xiaFlushDSPParams(detChan);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "snapWriteImage",
+               "Error writing the restored DSP parameters for detChan %d", detChan);
+        return status;
+    }
+
+    status = localFuncs->boardOperation(detChan, "apply", &ignored, defaults);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "snapWriteImage",
+               "Error applying the restored DSP parameters for detChan %d", detChan);
+        return status;
+    }
+
+    xiaLog(XIA_LOG_INFO, "snapWriteImage",
+           "Restored DSP image for detChan %d (%hu of %hu parameters written in %hu "
+           "blocks)",
+           detChan, nWritten, image->numParams, nBlocks);
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Writes the DSP image loaded for modChan, if there is one, to the channel
+ * in place of its user setup. restored is set if the image was written, in
+ * which case the caller skips the user setup. Nothing is restored if the
+ * channel's firmware or DSP symbol table no longer match the image. The
+ * image is released either way so that it only applies to the first
+ * xiaStartSystem() after the snapshot was loaded.
+ */
+int HANDEL_API xiaRestoreDSPImage(int detChan, Module* module, unsigned int modChan,
+                                  PSLFuncs* localFuncs, XiaDefaults* defaults,
+                                  boolean_t* restored) {
+    int status;
+
+    boolean_t matches = FALSE_;
+
+    DspImage* image;
+
+    ASSERT(module != NULL);
+    ASSERT(localFuncs != NULL);
+    ASSERT(restored != NULL);
+
+    *restored = FALSE_;
+
+    if (module->images == NULL || module->images[modChan].values == NULL) {
+        return XIA_SUCCESS;
+    }
+
+    image = &module->images[modChan];
+
+    status = snapImageMatches(detChan, image, &module->currentFirmware[modChan],
+                              localFuncs, &matches);
+
+    if (status == XIA_SUCCESS && matches) {
+        status = snapWriteImage(detChan, image, localFuncs, defaults);
+        *restored = (boolean_t) (status == XIA_SUCCESS);
+    }
+
+    xiaFreeDSPImage(image);
+
+    return status;
+}
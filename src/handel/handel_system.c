@@ -41,6 +41,7 @@
 
 #include "handel_errors.h"
 #include "handel_log.h"
+#include "md_threads.h"
 
 #include "fdd.h"
 #include "psl.h"
@@ -82,6 +83,9 @@ HANDEL_EXPORT int HANDEL_API xiaStartSystem(void) {
     int status;
 
     DetChanElement* current = NULL;
+
+    handel_md_CancelScope cancelScope;
+
     xiaLog(XIA_LOG_INFO, "xiaStartSystem", "Starting system...");
 
     status = xiaValidateFirmwareSets();
@@ -145,7 +149,10 @@ HANDEL_EXPORT int HANDEL_API xiaStartSystem(void) {
         return status;
     }
 
+    /* The firmware downloads and module setup can be cancelled by xiaCancel(). */
+    handel_md_cancel_enter(&xiaContext->cancel, &cancelScope);
     status = xiaUserSetup();
+    handel_md_cancel_leave(&cancelScope);
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xiaStartSystem",
@@ -182,7 +189,6 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
     char rawFilename[MAXFILENAME_LEN];
     char detType[MAXITEM_LEN];
 
-    char* alias;
     char* firmAlias;
     char* defAlias;
 
@@ -214,12 +220,11 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
 
     switch (elemType) {
         case SINGLE:
-            alias = xiaGetAliasFromDetChan(detChan);
             /* Might want to check for NULL here but should be okay since I believe
              * that xiaGetElemType returns an error value if the detChan doesn't
              * exist.
              */
-            module = xiaFindModule(alias);
+            module = xiaLockModule(detChan);
             modChan = xiaGetModChan((unsigned int) detChan);
             detector = xiaFindDetector(module->detector[modChan]);
             firmAlias = module->firmware[modChan];
@@ -240,6 +245,7 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaDownloadFirmware",
                            "Error getting %s from %s", type, firmAlias);
+                    xiaUnlockModule(module);
                     return status;
                 }
 
@@ -262,6 +268,7 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
                     default:
                         xiaLog(XIA_LOG_ERROR, XIA_UNKNOWN, "xiaDownloadFirmware",
                                "Should not be seeing this message");
+                        xiaUnlockModule(module);
                         return XIA_UNKNOWN;
                 }
 
@@ -276,6 +283,7 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
                 if (status != XIA_SUCCESS) {
                     xiaLog(XIA_LOG_ERROR, status, "xiaDownloadFirmware",
                            "Error getting firmware from FDD");
+                    xiaUnlockModule(module);
                     return status;
                 }
             }
@@ -285,6 +293,7 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaDownloadFirmware",
                        "Unable to get boardType for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
@@ -293,15 +302,18 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaDownloadFirmware",
                        "Unable to load PSL functions for boardType %s", boardType);
+                xiaUnlockModule(module);
                 return status;
             }
 
-            status = localFuncs.downloadFirmware(detChan, type, fileName, module,
-                                                 rawFilename, defs);
+            status = xiaCancelStatus(localFuncs.downloadFirmware(detChan, type,
+                                                                 fileName, module,
+                                                                 rawFilename, defs));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaDownloadFirmware",
                        "Unable to download Firmware for detChan %d", detChan);
+                xiaUnlockModule(module);
                 return status;
             }
 
@@ -317,6 +329,7 @@ HANDEL_EXPORT int HANDEL_API xiaDownloadFirmware(int detChan, char* type) {
             } else if (STREQ(type, "system_fpga")) {
                 strcpy(currentFirmware->currentSysFPGA, rawFilename);
             }
+            xiaUnlockModule(module);
             break;
         case SET:
             /* We've already verified that there are no infinite loops in the detChan sets
@@ -760,8 +773,12 @@ HANDEL_EXPORT int HANDEL_API xiaBoardOperation(int detChan, char* name, void* va
 
     XiaDefaults* defs = NULL;
 
+    Module* module = NULL;
+
     PSLFuncs localFuncs;
 
+    double started;
+
     if (name == NULL) {
         xiaLog(XIA_LOG_ERROR, XIA_NULL_NAME, "xiaBoardOperation",
                "name cannot be NULL");
@@ -800,13 +817,34 @@ HANDEL_EXPORT int HANDEL_API xiaBoardOperation(int detChan, char* name, void* va
                 return status;
             }
 
-            status = localFuncs.boardOperation(detChan, name, value, defs);
+            module = xiaLockModule(detChan);
+
+            started = module->tune != NULL ? handel_md_clock() : 0.0;
+
+            status = xiaCancelStatus(localFuncs.boardOperation(detChan, name, value,
+                                                               defs));
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaBoardOperation",
                        "Unable to do board operation (%s) for detChan %d", name,
                        detChan);
+                xiaUnlockModule(module);
                 return status;
             }
+
+            /* Push out any DSP parameter writes that Xerxes is holding back. */
+            status = xiaFlushDSPParams(detChan);
+
+            if (status != XIA_SUCCESS) {
+                xiaLog(XIA_LOG_ERROR, status, "xiaBoardOperation",
+                       "Error writing DSP parameters for detChan %d", detChan);
+                xiaUnlockModule(module);
+                return status;
+            }
+
+            if (module->tune != NULL) {
+                xiaMapTuneBoardOperation(module, name, value, started);
+            }
+            xiaUnlockModule(module);
             break;
         case SET:
             xiaLog(XIA_LOG_ERROR, XIA_BAD_TYPE, "xiaBoardOperation",
@@ -952,6 +990,122 @@ HANDEL_EXPORT int HANDEL_API xiaSetIOPriority(int pri) {
     return XIA_SUCCESS;
 }
 
+/*
+ * Sets the scheduling of the calling thread and of the library's pool
+ * threads: one of XIA_IO_SCHED_OTHER, with priority as the nice level, or
+ * XIA_IO_SCHED_FIFO and XIA_IO_SCHED_RR, with priority as the real-time
+ * priority. cpu pins the calling thread to one CPU, or -1 to leave it
+ * unpinned, and XIA_IO_SCHED_LOCK_MEMORY in flags locks the process in RAM.
+ * The calling thread switches immediately. The pool threads take the policy
+ * and priority at their next I/O and keep the CPUs set by
+ * xiaSetPoolConfig(). Other application threads are not changed; each one
+ * that drives modules calls this itself. XIA_IO_SCHED_OTHER at priority 0
+ * with cpu -1 restores what the threads had before.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetIOScheduling(int policy, int priority, int cpu,
+                                                int flags) {
+    int status;
+
+    int params[3];
+
+    if (!isHandelInit) {
+        status = xiaInitHandel();
+
+        if (status != XIA_SUCCESS) {
+            return status;
+        }
+    }
+
+    params[0] = priority;
+    params[1] = cpu;
+    params[2] = flags;
+
+    status = dxp_set_io_scheduling(&policy, params);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaSetIOScheduling",
+               "Error setting policy %d, priority %d, CPU %d, flags %#x", policy,
+               priority, cpu, flags);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Sets how parsed DSP code and symbol tables are cached between system
+ * initializations. Pass one of XIA_DSP_CACHE_OFF, XIA_DSP_CACHE_MEMORY (the
+ * default) or XIA_DSP_CACHE_DISK. The disk cache stores the parsed files in
+ * the temporary directory so that later processes skip the parse as well.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetDSPCache(int mode) {
+    int status;
+
+    status = dxp_set_dsp_cache(&mode);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaSetDSPCache",
+               "Error setting DSP cache mode %d", mode);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Sets how the devices poll for operations of one type to complete: one
+ * of XIA_WAIT_BUSY, XIA_WAIT_ACTIVE, XIA_WAIT_RUN_ENABLE or
+ * XIA_WAIT_RUN_END (xiaWaitRunComplete()). The device polls without
+ * sleeping for spin seconds, then sleeps for interval seconds, doubling
+ * it after each poll up to maxInterval.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetWaitProfile(int type, double spin, double interval,
+                                               double maxInterval) {
+    int status;
+
+    double profile[3];
+
+    profile[0] = spin;
+    profile[1] = interval;
+    profile[2] = maxInterval;
+
+    status = dxp_set_wait_profile(&type, profile);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaSetWaitProfile",
+               "Error setting the profile for wait type %d", type);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+/*
+ * Returns how long operations of one XIA_WAIT_* type have taken to
+ * complete, as a histogram of XIA_WAIT_HISTOGRAM_BINS counts. The first
+ * bin counts completions within 100 us and every following bin doubles
+ * the limit; the last bin counts all slower completions.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetWaitStats(int type, unsigned long* histogram) {
+    int status;
+
+    if (histogram == NULL) {
+        xiaLog(XIA_LOG_ERROR, XIA_NULL_VALUE, "xiaGetWaitStats",
+               "histogram cannot be NULL");
+        return XIA_NULL_VALUE;
+    }
+
+    status = dxp_get_wait_stats(&type, histogram);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaGetWaitStats",
+               "Error reading the statistics for wait type %d", type);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
 /*
  * Parses in a memory string of the format defined for xiaMemoryOperation().
  */
@@ -961,6 +1115,7 @@ static int HANDEL_API _parseMemoryName(char* name, char* type, boolean_t* isRead
 
     char* n = NULL;
     char* tok = NULL;
+    char* save = NULL;
     char* delim = ":";
 
     if (name == NULL) {
@@ -1001,7 +1156,7 @@ static int HANDEL_API _parseMemoryName(char* name, char* type, boolean_t* isRead
 
     strncpy(n, name, strlen(name) + 1);
 
-    tok = strtok(n, delim);
+    tok = XIA_STRTOK(n, delim, &save);
 
     if (tok == NULL) {
         handel_md_free(n);
@@ -1012,7 +1167,7 @@ static int HANDEL_API _parseMemoryName(char* name, char* type, boolean_t* isRead
 
     strncpy(type, tok, strlen(tok) + 1);
 
-    tok = strtok(NULL, delim);
+    tok = XIA_STRTOK(NULL, delim, &save);
 
     if (tok == NULL) {
         handel_md_free(n);
@@ -1032,7 +1187,7 @@ static int HANDEL_API _parseMemoryName(char* name, char* type, boolean_t* isRead
         return XIA_INVALID_STR;
     }
 
-    tok = strtok(NULL, delim);
+    tok = XIA_STRTOK(NULL, delim, &save);
 
     if (tok == NULL) {
         handel_md_free(n);
@@ -1050,7 +1205,7 @@ static int HANDEL_API _parseMemoryName(char* name, char* type, boolean_t* isRead
         return XIA_INVALID_STR;
     }
 
-    tok = strtok(NULL, delim);
+    tok = XIA_STRTOK(NULL, delim, &save);
 
     if (tok == NULL) {
         handel_md_free(n);
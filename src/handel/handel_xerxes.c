@@ -224,6 +224,25 @@ int HANDEL_API xiaBuildXerxesConfig(void) {
     return XIA_SUCCESS;
 }
 
+/*
+ * Writes any DSP parameters that Xerxes is holding back for detChan, so the
+ * hardware matches every parameter write before control returns to the
+ * caller. Devices that write parameters directly have nothing to flush.
+ */
+int HANDEL_API xiaFlushDSPParams(int detChan) {
+    int status;
+
+    status = dxp_flush_dspparams(&detChan);
+
+    if (status != DXP_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xiaFlushDSPParams",
+               "Error writing DSP parameters for detChan %d", detChan);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
 /*
  * Essentially a wrapper around dxp_user_setup().
  */
@@ -305,7 +324,8 @@ int HANDEL_API xiaUserSetup(void) {
             detChanInModule = module->channels[i];
 
             defaults = xiaGetDefaultFromDetChan(detChanInModule);
-            status = localFuncs.moduleSetup(detChanInModule, defaults, module);
+            status = xiaCancelStatus(localFuncs.moduleSetup(detChanInModule, defaults,
+                                                            module));
 
             if (status != XIA_SUCCESS) {
                 xiaLog(XIA_LOG_ERROR, status, "xiaUserSetup",
@@ -335,6 +355,8 @@ static int xia__SetupSingleChan(Module* module, unsigned int detChan,
 
     char detectorType[MAXITEM_LEN];
 
+    boolean_t restored = FALSE_;
+
     FirmwareSet* firmwareSet = NULL;
 
     CurrentFirmware* currentFirmware = NULL;
@@ -372,16 +394,28 @@ static int xia__SetupSingleChan(Module* module, unsigned int detChan,
             break;
     }
 
-    status =
-        localFuncs->userSetup(detChan, defaults, firmwareSet, currentFirmware,
-                              detectorType, detector, detector_chan, module, modChan);
+    /* A DSP image from a binary snapshot stands in for the user setup. */
+    status = xiaCancelStatus(xiaRestoreDSPImage((int) detChan, module, modChan,
+                                                localFuncs, defaults, &restored));
 
     if (status != XIA_SUCCESS) {
         xiaLog(XIA_LOG_ERROR, status, "xia__SetupSingleChan",
-               "Unable to complete user setup for detChan %u.", detChan);
+               "Unable to restore the DSP image for detChan %u.", detChan);
         return status;
     }
 
+    if (!restored) {
+        status = xiaCancelStatus(localFuncs->userSetup(
+            detChan, defaults, firmwareSet, currentFirmware, detectorType, detector,
+            detector_chan, module, modChan));
+
+        if (status != XIA_SUCCESS) {
+            xiaLog(XIA_LOG_ERROR, status, "xia__SetupSingleChan",
+                   "Unable to complete user setup for detChan %u.", detChan);
+            return status;
+        }
+    }
+
     /* Having a single channel set up is enough for some per module operation */
     module->isSetup = TRUE_;
 
@@ -394,6 +428,15 @@ static int xia__SetupSingleChan(Module* module, unsigned int detChan,
         return status;
     }
 
+    /* Leave the hardware matching the setup, rather than waiting for a run. */
+    status = xiaFlushDSPParams((int) detChan);
+
+    if (status != XIA_SUCCESS) {
+        xiaLog(XIA_LOG_ERROR, status, "xia__SetupSingleChan",
+               "Unable to write DSP parameters for detChan %u.", detChan);
+        return status;
+    }
+
     return XIA_SUCCESS;
 }
 
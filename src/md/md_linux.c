@@ -41,18 +41,30 @@
 
 /* System include files */
 
+/* For sched_setaffinity() and the CPU_* macros. */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #define _XOPEN_SOURCE 500
 #include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #ifndef EXCLUDE_SERIAL
-#include <errno.h>
 #include <fcntl.h>
 #include <termios.h>
 #endif
@@ -60,6 +72,7 @@
 /* XIA include files */
 #include "md_generic.h"
 #include "md_linux.h"
+#include "md_threads.h"
 #include "xerxes_errors.h"
 #include "xerxes_structures.h"
 #include "xia_assert.h"
@@ -74,7 +87,36 @@ static unsigned int numMod = 0;
 
 /* error string used as a place holder for calls to dxp_md_error() */
 #define ERROR_STRING_LEN 4096
-static char ERROR_STRING[ERROR_STRING_LEN];
+static XIA_THREAD_LOCAL char ERROR_STRING[ERROR_STRING_LEN];
+
+static int dxp_md_check_cancel(char* routine, int camChan);
+static void dxp_md_io_thread_setup(void);
+static int dxp_md_apply_scheduling(int policy, int priority, int cpu);
+
+/*
+ * Scheduling for the threads that perform transport I/O, set by
+ * dxp_md_set_scheduling(). The calling thread applies it at once. The
+ * library's own threads apply the policy and priority the next time they do
+ * I/O after the generation changes, and keep their own CPU affinity. Other
+ * application threads are left alone.
+ */
+static int ioSchedPolicy = MD_IO_SCHED_OTHER;
+static int ioSchedPriority = 0;
+static int ioSchedCPU = -1;
+static int ioSchedFlags = 0;
+static long ioSchedGeneration = 0;
+static XIA_THREAD_LOCAL long ioSchedApplied = 0;
+
+/* What a thread had before it was first changed, restored by the defaults. */
+static XIA_THREAD_LOCAL int ioSchedSaved = 0;
+static XIA_THREAD_LOCAL int ioSchedSavedPolicy;
+static XIA_THREAD_LOCAL struct sched_param ioSchedSavedParam;
+static XIA_THREAD_LOCAL int ioSchedSavedNice;
+
+#ifdef __linux__
+static XIA_THREAD_LOCAL int ioSchedPinned = 0;
+static XIA_THREAD_LOCAL cpu_set_t ioSchedSavedMask;
+#endif
 
 /* maximum number of words able to transfer in a single call to dxp_md_io() */
 static unsigned int maxblk = 0;
@@ -147,18 +189,8 @@ static int dxp_md_serial_read_data(int fd, unsigned long size, unsigned short* b
 /* PLCF 4p add functions so Linux looks like Windows.
    It hurts, but it was the easy way out.		*/
 typedef unsigned int DWORD;
-typedef unsigned int BOOL;
-
-#define NORMAL_PRIORITY_CLASS 0
-#define REALTIME_PRIORITY_CLASS -20
-#define HIGH_PRIORITY_CLASS -10
-#define ABOVE_NORMAL_PRIORITY_CLASS -5
-#define BELOW_NORMAL_PRIORITY_CLASS 5
-#define IDLE_PRIORITY_CLASS 19
 
 void Sleep(DWORD sleep_msec);
-unsigned int GetCurrentProcess(void);
-BOOL SetPriorityClass(unsigned int hProcess, DWORD dwPriorityClass);
 
 static char* TMP_PATH = "/tmp";
 static char* PATH_SEP = "/";
@@ -172,22 +204,6 @@ void Sleep(DWORD sleep_msec) {
     nanosleep(&ts, 0);
 }
 
-/* This only works for SetPriorityClass, not a true
- * replacement for Microsoft Windows GetCurrentProcess.
- */
-unsigned int GetCurrentProcess() {
-    return (0);
-}
-
-BOOL SetPriorityClass(unsigned int hProcess, DWORD dwPriorityClass) {
-    int error;
-    error = setpriority(PRIO_PROCESS, hProcess, dwPriorityClass);
-    if (error == 0)
-        return (1);
-    else
-        return (0);
-}
-
 /*
  * Routine to create pointers to the MD utility routines
  *
@@ -221,6 +237,7 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_util(Xia_Util_Functions* funcs, char* t
     funcs->dxp_md_set_log_level = dxp_md_set_log_level;
     funcs->dxp_md_log = dxp_md_log;
     funcs->dxp_md_set_priority = dxp_md_set_priority;
+    funcs->dxp_md_set_scheduling = dxp_md_set_scheduling;
     funcs->dxp_md_fgets = dxp_md_fgets;
     funcs->dxp_md_tmp_path = dxp_md_tmp_path;
     funcs->dxp_md_clear_tmp = dxp_md_clear_tmp;
@@ -437,6 +454,14 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_io(int* camChan, unsigned int* function,
     int ullength = (int) *length / 2;
     unsigned long* temp = NULL;
 
+    dxp_md_io_thread_setup();
+
+    status = dxp_md_check_cancel("dxp_md_epp_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     if ((currentID != eppID[*camChan]) && (eppID[*camChan] != -1)) {
         DxpSetID((unsigned short) eppID[*camChan]);
 
@@ -633,6 +658,14 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_usb_io(int* camChan, unsigned int* function,
     int status;
     unsigned short* us_data = (unsigned short*) data;
 
+    dxp_md_io_thread_setup();
+
+    status = dxp_md_check_cancel("dxp_md_usb_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     if (*address == 0) {
         if (*function == MD_IO_READ) {
             rstat = xia_usb_read(usb_addr, (long) *length, usbName[*camChan], us_data);
@@ -896,6 +929,14 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int* camChan, unsigned int* functi
 
     UNUSED(wait_in_ms);
 
+    dxp_md_io_thread_setup();
+
+    status = dxp_md_check_cancel("dxp_md_serial_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     if (*function == MD_IO_READ) {
         status = dxp_md_serial_read_header(fd, &n_bytes, us_data);
 
@@ -1143,7 +1184,10 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_close(int* camChan) {
 XIA_MD_STATIC int dxp_md_usb2_initialize(unsigned int* maxMod, char* dllname) {
     UNUSED(maxMod);
     UNUSED(dllname);
-    numUSB2 = 0;
+    /*
+     * The device slots are shared by every Handel context and are freed by
+     * dxp_md_usb2_close(), so there is nothing to reset here.
+     */
     return DXP_SUCCESS;
 }
 
@@ -1159,8 +1203,8 @@ XIA_MD_STATIC int dxp_md_usb2_open(char* ioname, int* camChan) {
     ASSERT(ioname != NULL);
     ASSERT(camChan != NULL);
 
-    for (i = 0; i < (int) numUSB2; i++) {
-        if (STREQ(usb2Names[i], ioname)) {
+    for (i = 0; i < MAXMOD; i++) {
+        if (usb2Names[i] != NULL && STREQ(usb2Names[i], ioname)) {
             *camChan = i;
             return DXP_SUCCESS;
         }
@@ -1168,7 +1212,20 @@ XIA_MD_STATIC int dxp_md_usb2_open(char* ioname, int* camChan) {
 
     sscanf(ioname, "%d", &dev);
 
-    *camChan = numUSB2++;
+    /* Take the first free slot. Devices may be closed in any order. */
+    for (i = 0; i < MAXMOD; i++) {
+        if (usb2Names[i] == NULL) {
+            break;
+        }
+    }
+
+    if (i == MAXMOD) {
+        sprintf(ERROR_STRING, "No free slot to open USB device '%d'", dev);
+        dxp_md_log_error("dxp_md_usb2_open", ERROR_STRING, DXP_MDOPEN);
+        return DXP_MDOPEN;
+    }
+
+    *camChan = i;
 
     status = xia_usb2_open(dev, &usb2Handles[*camChan]);
 
@@ -1198,6 +1255,7 @@ XIA_MD_STATIC int dxp_md_usb2_open(char* ioname, int* camChan) {
 
     usb2AddrCache[*camChan] = MD_INVALID_ADDR;
 
+    numUSB2++;
     numMod++;
 
     return DXP_SUCCESS;
@@ -1245,6 +1303,14 @@ XIA_MD_STATIC int dxp_md_usb2_io(int* camChan, unsigned int* function,
      */
     switch (*addr) {
         case 0:
+            dxp_md_io_thread_setup();
+
+            status = dxp_md_check_cancel("dxp_md_usb2_io", *camChan);
+
+            if (status != DXP_SUCCESS) {
+                return status;
+            }
+
             if (usb2AddrCache[*camChan] == MD_INVALID_ADDR) {
                 sprintf(ERROR_STRING, "No target address set for camChan %d", *camChan);
                 dxp_md_log_error("dxp_md_usb2_io", ERROR_STRING, DXP_MD_TARGET_ADDR);
@@ -1440,8 +1506,30 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int* blksiz) {
  * float *time;							Input: Time to wait in seconds
  */
 XIA_MD_STATIC int XIA_MD_API dxp_md_wait(float* time) {
-    DWORD wait = (DWORD) (1000.0 * (*time));
-    Sleep(wait);
+    struct timespec ts;
+
+    /* Keep the sub-millisecond part, which the wait engine relies on. */
+    ts.tv_sec = (time_t) *time;
+    ts.tv_nsec = (long) ((*time - (float) ts.tv_sec) * 1.0e9f);
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Returns DXP_CANCELLED if the work the calling thread is bound to has been
+ * cancelled, so that a transfer sequence stops at the next I/O step instead
+ * of running into the driver timeouts.
+ */
+static int dxp_md_check_cancel(char* routine, int camChan) {
+    if (handel_md_cancelled()) {
+        sprintf(ERROR_STRING, "I/O cancelled for camChan %d", camChan);
+        dxp_md_log_error(routine, ERROR_STRING, DXP_CANCELLED);
+        return DXP_CANCELLED;
+    }
+
     return DXP_SUCCESS;
 }
 
@@ -1534,18 +1622,12 @@ XIA_MD_STATIC char* dxp_md_path_separator(void) {
 }
 
 /*
- * Sets the priority of the current process
+ * Sets the priority of the calling thread and the library's I/O threads.
+ * MD_IO_PRI_HIGH runs them at the highest nice level, keeping any CPU and
+ * memory settings from dxp_md_set_scheduling().
  */
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_priority(int* priority) {
-    BOOL status;
-
-    DWORD pri;
-
-    unsigned int h;
-
-    char pri_str[5];
-
-    h = GetCurrentProcess();
+    int status;
 
     switch (*priority) {
         default:
@@ -1553,28 +1635,252 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_set_priority(int* priority) {
             dxp_md_log_error("dxp_md_set_priority", ERROR_STRING,
                              DXP_MDINVALIDPRIORITY);
             return DXP_MDINVALIDPRIORITY;
-            break;
         case MD_IO_PRI_NORMAL:
-            pri = NORMAL_PRIORITY_CLASS;
-            strncpy(pri_str, "NORM", 5);
+            status = dxp_md_set_scheduling(MD_IO_SCHED_OTHER, 0, ioSchedCPU, ioSchedFlags);
             break;
         case MD_IO_PRI_HIGH:
-            pri = REALTIME_PRIORITY_CLASS;
-            strncpy(pri_str, "HIGH", 5);
+            status = dxp_md_set_scheduling(MD_IO_SCHED_OTHER, -20, ioSchedCPU, ioSchedFlags);
             break;
     }
 
-    status = SetPriorityClass(h, pri);
+    if (status != DXP_SUCCESS) {
+        sprintf(ERROR_STRING, "Error setting priority %#x for the I/O threads",
+                *priority);
+        dxp_md_log_error("dxp_md_set_priority", ERROR_STRING, status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Sets the scheduling of the calling thread and of the library's own I/O
+ * threads: the policy, the nice level (MD_IO_SCHED_OTHER) or real-time
+ * priority (MD_IO_SCHED_FIFO, MD_IO_SCHED_RR), the CPU to pin the calling
+ * thread to or -1, and MD_IO_SCHED_LOCK_MEMORY to lock the process in RAM.
+ * The calling thread is switched immediately so that missing privileges are
+ * reported here; the library's threads take the policy and priority at their
+ * next I/O. MD_IO_SCHED_OTHER at nice level 0 with no CPU restores what each
+ * thread had before.
+ */
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_scheduling(int policy, int priority, int cpu,
+                                                   int flags) {
+    int status;
+    int lo = -20;
+    int hi = 19;
 
-    if (!status) {
-        sprintf(ERROR_STRING, "Error setting priority class (%s) for current process",
-                pri_str);
-        dxp_md_log_error("dxp_md_set_priority", ERROR_STRING, DXP_MDPRIORITY);
+    switch (policy) {
+        case MD_IO_SCHED_OTHER:
+            break;
+        case MD_IO_SCHED_FIFO:
+            lo = sched_get_priority_min(SCHED_FIFO);
+            hi = sched_get_priority_max(SCHED_FIFO);
+            break;
+        case MD_IO_SCHED_RR:
+            lo = sched_get_priority_min(SCHED_RR);
+            hi = sched_get_priority_max(SCHED_RR);
+            break;
+        default:
+            sprintf(ERROR_STRING, "Invalid scheduling policy: %d", policy);
+            dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING,
+                             DXP_MDINVALIDPRIORITY);
+            return DXP_MDINVALIDPRIORITY;
+    }
+
+    if (priority < lo || priority > hi) {
+        sprintf(ERROR_STRING, "Priority %d is outside [%d, %d] for policy %d", priority,
+                lo, hi, policy);
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDINVALIDPRIORITY);
+        return DXP_MDINVALIDPRIORITY;
+    }
+
+#ifdef __linux__
+    if (cpu < -1 || cpu >= CPU_SETSIZE || cpu >= sysconf(_SC_NPROCESSORS_CONF)) {
+#else
+    if (cpu != -1) {
+#endif
+        sprintf(ERROR_STRING, "Invalid CPU %d for the I/O threads", cpu);
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDINVALIDPRIORITY);
+        return DXP_MDINVALIDPRIORITY;
+    }
+
+    if ((flags & ~MD_IO_SCHED_LOCK_MEMORY) != 0) {
+        sprintf(ERROR_STRING, "Invalid scheduling flags: %#x", flags);
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDINVALIDPRIORITY);
+        return DXP_MDINVALIDPRIORITY;
+    }
+
+    status = dxp_md_apply_scheduling(policy, priority, cpu);
+
+    if (status != 0) {
+        sprintf(ERROR_STRING, "Error applying policy %d, priority %d, CPU %d: %s",
+                policy, priority, cpu, strerror(status));
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDPRIORITY);
         return DXP_MDPRIORITY;
     }
 
-    sprintf(ERROR_STRING, "Priority class set to '%s' for current process", pri_str);
-    dxp_md_log_debug("dxp_md_set_priority", ERROR_STRING);
+    if ((flags & MD_IO_SCHED_LOCK_MEMORY) && !(ioSchedFlags & MD_IO_SCHED_LOCK_MEMORY)) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            sprintf(ERROR_STRING, "Error locking the process memory: %s",
+                    strerror(errno));
+            dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDPRIORITY);
+            return DXP_MDPRIORITY;
+        }
+    } else if (!(flags & MD_IO_SCHED_LOCK_MEMORY) &&
+               (ioSchedFlags & MD_IO_SCHED_LOCK_MEMORY)) {
+        munlockall();
+    }
+
+    ioSchedPolicy = policy;
+    ioSchedPriority = priority;
+    ioSchedCPU = cpu;
+    ioSchedFlags = flags;
+
+    ioSchedApplied = __atomic_add_fetch(&ioSchedGeneration, 1, __ATOMIC_RELEASE);
+
+    sprintf(ERROR_STRING, "I/O threads set to policy %d, priority %d, CPU %d, flags %#x",
+            policy, priority, cpu, flags);
+    dxp_md_log_debug("dxp_md_set_scheduling", ERROR_STRING);
 
     return DXP_SUCCESS;
 }
+
+/*
+ * Applies a scheduling policy and CPU to the calling thread. Returns 0 or an
+ * errno value. The defaults (MD_IO_SCHED_OTHER at nice level 0) restore the
+ * policy and nice level the thread had before it was first changed, and
+ * unpinning restores its CPU mask.
+ */
+static int dxp_md_apply_scheduling(int policy, int priority, int cpu) {
+    int status;
+
+    struct sched_param param;
+
+#ifdef __linux__
+    /* Linux keeps the nice level per thread. */
+    id_t self = (id_t) syscall(SYS_gettid);
+#else
+    id_t self = 0;
+#endif
+
+    if (policy == MD_IO_SCHED_OTHER && priority == 0) {
+        if (ioSchedSaved) {
+            status = pthread_setschedparam(pthread_self(), ioSchedSavedPolicy,
+                                           &ioSchedSavedParam);
+
+            if (status != 0) {
+                return status;
+            }
+
+            if (setpriority(PRIO_PROCESS, self, ioSchedSavedNice) != 0) {
+                return errno;
+            }
+
+            ioSchedSaved = 0;
+        }
+    } else {
+        if (!ioSchedSaved) {
+            status = pthread_getschedparam(pthread_self(), &ioSchedSavedPolicy,
+                                           &ioSchedSavedParam);
+
+            if (status != 0) {
+                return status;
+            }
+
+            errno = 0;
+            ioSchedSavedNice = getpriority(PRIO_PROCESS, self);
+
+            if (errno != 0) {
+                return errno;
+            }
+
+            ioSchedSaved = 1;
+        }
+
+        memset(&param, 0, sizeof(param));
+
+        if (policy == MD_IO_SCHED_OTHER) {
+            status = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+            if (status != 0) {
+                return status;
+            }
+
+            if (setpriority(PRIO_PROCESS, self, priority) != 0) {
+                return errno;
+            }
+        } else {
+            param.sched_priority = priority;
+            status = pthread_setschedparam(pthread_self(),
+                                           policy == MD_IO_SCHED_FIFO ? SCHED_FIFO
+                                                                      : SCHED_RR,
+                                           &param);
+
+            if (status != 0) {
+                return status;
+            }
+        }
+    }
+
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+
+        if (!ioSchedPinned) {
+            pthread_getaffinity_np(pthread_self(), sizeof(ioSchedSavedMask),
+                                   &ioSchedSavedMask);
+        }
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        if (status != 0) {
+            return status;
+        }
+
+        ioSchedPinned = 1;
+    } else if (ioSchedPinned) {
+        pthread_setaffinity_np(pthread_self(), sizeof(ioSchedSavedMask),
+                               &ioSchedSavedMask);
+        ioSchedPinned = 0;
+    }
+#else
+    UNUSED(cpu);
+#endif
+
+    return 0;
+}
+
+/*
+ * Brings one of the library's own threads up to date with
+ * dxp_md_set_scheduling() before it performs I/O. The CPU is not applied,
+ * so pool workers keep the affinity they were started with. Application
+ * threads are left alone. A thread that cannot apply the settings logs a
+ * warning and carries on.
+ */
+static void dxp_md_io_thread_setup(void) {
+    int status;
+
+    long generation;
+
+    if (!handel_md_thread_library()) {
+        return;
+    }
+
+    generation = __atomic_load_n(&ioSchedGeneration, __ATOMIC_ACQUIRE);
+
+    if (generation == ioSchedApplied) {
+        return;
+    }
+
+    ioSchedApplied = generation;
+
+    status = dxp_md_apply_scheduling(ioSchedPolicy, ioSchedPriority, -1);
+
+    if (status != 0) {
+        sprintf(ERROR_STRING, "Error applying the I/O scheduling to this thread: %s",
+                strerror(status));
+        dxp_md_log_warning("dxp_md_io_thread_setup", ERROR_STRING);
+    }
+}
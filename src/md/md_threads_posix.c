@@ -33,12 +33,20 @@
  * SUCH DAMAGE.
  */
 
+/* For pthread_setaffinity_np(). */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <ctype.h>
 #include <errno.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
@@ -88,7 +96,7 @@ XIA_SHARED int handel_md_thread_create(handel_md_Thread* thread) {
         /*
          * If the stack is not the min make it the minimum.
          */
-#if PTHREAD_STACK_MIN
+#ifdef PTHREAD_STACK_MIN
         if (ssize < PTHREAD_STACK_MIN)
             ssize = PTHREAD_STACK_MIN;
 #endif
@@ -172,6 +180,26 @@ XIA_SHARED int handel_md_thread_ready(handel_md_Thread* thread) {
     return thread->handle != NULL;
 }
 
+/*
+ * Pins the calling thread to one CPU.
+ */
+XIA_SHARED int handel_md_thread_set_affinity(unsigned int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    UNUSED(cpu);
+    return ENOTSUP;
+#endif
+}
+
+XIA_SHARED unsigned int handel_md_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned int) n : 1;
+}
+
 XIA_SHARED int handel_md_mutex_create(handel_md_Mutex* mutex) {
     int r = EBUSY;
     if (mutex->handle == NULL) {
@@ -359,3 +387,153 @@ XIA_SHARED int handel_md_event_signal(handel_md_Event* event) {
 XIA_SHARED int handel_md_event_ready(handel_md_Event* event) {
     return event->handle != NULL;
 }
+
+XIA_SHARED double handel_md_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1.0e9;
+}
+
+/*
+ * Maps the file read-only. Lookups into a mapping are expected to be
+ * scattered, so readahead is turned down.
+ */
+XIA_SHARED int handel_md_file_map(const char* path, handel_md_FileMap* map) {
+    int r = 0;
+    int fd;
+    struct stat st;
+    void* p;
+
+    map->data = NULL;
+    map->size = 0;
+    map->handle = NULL;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return errno;
+
+    if (fstat(fd, &st) != 0) {
+        r = errno;
+    } else if (st.st_size == 0) {
+        r = EINVAL;
+    } else {
+        p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            r = errno;
+        } else {
+            madvise(p, (size_t) st.st_size, MADV_RANDOM);
+            map->data = p;
+            map->size = (size_t) st.st_size;
+        }
+    }
+
+    close(fd);
+    return r;
+}
+
+XIA_SHARED int handel_md_file_map_write(const char* path, size_t size,
+                                        handel_md_FileMap* map) {
+    int r = 0;
+    int fd;
+    struct stat st;
+    void* p;
+
+    map->data = NULL;
+    map->size = 0;
+    map->handle = NULL;
+
+    fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+        return errno;
+
+    /* ftruncate leaves a hole, so untouched parts take no disk space. */
+    if (fstat(fd, &st) != 0) {
+        r = errno;
+    } else if ((size_t) st.st_size < size && ftruncate(fd, (off_t) size) != 0) {
+        r = errno;
+    } else {
+        if ((size_t) st.st_size > size)
+            size = (size_t) st.st_size;
+
+        if (size == 0) {
+            r = EINVAL;
+        } else {
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                r = errno;
+            } else {
+                map->data = p;
+                map->size = size;
+            }
+        }
+    }
+
+    close(fd);
+    return r;
+}
+
+XIA_SHARED int handel_md_file_unmap(handel_md_FileMap* map) {
+    int r = ENOENT;
+    if (map->data != NULL) {
+        r = munmap(map->data, map->size) == 0 ? 0 : errno;
+        map->data = NULL;
+        map->size = 0;
+    }
+    return r;
+}
+
+/*
+ * Set on the threads the library starts for itself.
+ */
+static XIA_THREAD_LOCAL int libraryThread = 0;
+
+XIA_SHARED void handel_md_thread_set_library(int library) {
+    libraryThread = library;
+}
+
+XIA_SHARED int handel_md_thread_library(void) {
+    return libraryThread;
+}
+
+/*
+ * The token the calling thread is bound to, if any.
+ */
+static XIA_THREAD_LOCAL handel_md_CancelScope cancelScope = {NULL, 0, NULL};
+
+XIA_SHARED void handel_md_cancel_init(handel_md_Cancel* token) {
+    __atomic_store_n(&token->epoch, 0, __ATOMIC_SEQ_CST);
+}
+
+XIA_SHARED void handel_md_cancel_request(handel_md_Cancel* token) {
+    __atomic_add_fetch(&token->epoch, 1, __ATOMIC_SEQ_CST);
+}
+
+XIA_SHARED long handel_md_cancel_epoch(handel_md_Cancel* token) {
+    return __atomic_load_n(&token->epoch, __ATOMIC_SEQ_CST);
+}
+
+XIA_SHARED void handel_md_cancel_enter(handel_md_Cancel* token,
+                                       handel_md_CancelScope* saved) {
+    *saved = cancelScope;
+    cancelScope.token = token;
+    cancelScope.epoch = handel_md_cancel_epoch(token);
+    cancelScope.outer = saved;
+}
+
+XIA_SHARED void handel_md_cancel_leave(handel_md_CancelScope* saved) {
+    cancelScope = *saved;
+}
+
+XIA_SHARED int handel_md_cancelled(void) {
+    handel_md_CancelScope* scope;
+
+    /* An inner binding must not hide a cancelled outer one. */
+    for (scope = &cancelScope; scope != NULL && scope->token != NULL;
+         scope = scope->outer) {
+        if (handel_md_cancel_epoch(scope->token) != scope->epoch) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -39,6 +39,7 @@
 #include <time.h>
 
 #include <windows.h>
+#include <winioctl.h>
 
 #include "xia_assert.h"
 #include "xia_common.h"
@@ -106,6 +107,21 @@ XIA_SHARED int handel_md_thread_ready(handel_md_Thread* thread) {
     return thread->handle != NULL;
 }
 
+/*
+ * Pins the calling thread to one CPU.
+ */
+XIA_SHARED int handel_md_thread_set_affinity(unsigned int cpu) {
+    if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) == 0)
+        return GetLastError();
+    return THREADING_NO_ERROR;
+}
+
+XIA_SHARED unsigned int handel_md_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
 XIA_SHARED int handel_md_mutex_create(handel_md_Mutex* mutex) {
     int r = ERROR_INVALID_HANDLE;
     if (mutex->handle == NULL) {
@@ -234,3 +250,173 @@ XIA_SHARED int handel_md_event_signal(handel_md_Event* event) {
 XIA_SHARED int handel_md_event_ready(handel_md_Event* event) {
     return event->handle != NULL;
 }
+
+XIA_SHARED double handel_md_clock(void) {
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double) now.QuadPart / (double) freq.QuadPart;
+}
+
+/*
+ * Maps the file read-only.
+ */
+XIA_SHARED int handel_md_file_map(const char* path, handel_md_FileMap* map) {
+    int r = NO_ERROR;
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER size;
+
+    map->data = NULL;
+    map->size = 0;
+    map->handle = NULL;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    if (!GetFileSizeEx(file, &size)) {
+        r = GetLastError();
+    } else if (size.QuadPart == 0) {
+        r = ERROR_FILE_INVALID;
+    } else {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            r = GetLastError();
+        } else {
+            map->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (map->data == NULL) {
+                r = GetLastError();
+                CloseHandle(mapping);
+            } else {
+                map->size = (size_t) size.QuadPart;
+                map->handle = mapping;
+            }
+        }
+    }
+
+    CloseHandle(file);
+    return r;
+}
+
+XIA_SHARED int handel_md_file_map_write(const char* path, size_t size,
+                                        handel_md_FileMap* map) {
+    int r = NO_ERROR;
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER current;
+    DWORD ignored;
+
+    map->data = NULL;
+    map->size = 0;
+    map->handle = NULL;
+
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                       OPEN_ALWAYS, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    /* A sparse file takes no disk space for the parts never written. */
+    DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &ignored, NULL);
+
+    if (!GetFileSizeEx(file, &current)) {
+        r = GetLastError();
+    } else {
+        if ((unsigned __int64) current.QuadPart > size)
+            size = (size_t) current.QuadPart;
+
+        if (size == 0) {
+            r = ERROR_FILE_INVALID;
+        } else {
+            /* Mapping more than the file's size extends it. */
+            mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+                                         (DWORD) ((unsigned __int64) size >> 32),
+                                         (DWORD) size, NULL);
+            if (mapping == NULL) {
+                r = GetLastError();
+            } else {
+                map->data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+                if (map->data == NULL) {
+                    r = GetLastError();
+                    CloseHandle(mapping);
+                } else {
+                    map->size = size;
+                    map->handle = mapping;
+                }
+            }
+        }
+    }
+
+    CloseHandle(file);
+    return r;
+}
+
+XIA_SHARED int handel_md_file_unmap(handel_md_FileMap* map) {
+    int r = ERROR_INVALID_HANDLE;
+    if (map->data != NULL) {
+        r = UnmapViewOfFile(map->data) ? NO_ERROR : GetLastError();
+        CloseHandle(map->handle);
+        map->data = NULL;
+        map->size = 0;
+        map->handle = NULL;
+    }
+    return r;
+}
+
+/*
+ * Set on the threads the library starts for itself.
+ */
+static XIA_THREAD_LOCAL int libraryThread = 0;
+
+XIA_SHARED void handel_md_thread_set_library(int library) {
+    libraryThread = library;
+}
+
+XIA_SHARED int handel_md_thread_library(void) {
+    return libraryThread;
+}
+
+/*
+ * The token the calling thread is bound to, if any.
+ */
+static XIA_THREAD_LOCAL handel_md_CancelScope cancelScope = {NULL, 0, NULL};
+
+XIA_SHARED void handel_md_cancel_init(handel_md_Cancel* token) {
+    InterlockedExchange(&token->epoch, 0);
+}
+
+XIA_SHARED void handel_md_cancel_request(handel_md_Cancel* token) {
+    InterlockedIncrement(&token->epoch);
+}
+
+XIA_SHARED long handel_md_cancel_epoch(handel_md_Cancel* token) {
+    return InterlockedCompareExchange(&token->epoch, 0, 0);
+}
+
+XIA_SHARED void handel_md_cancel_enter(handel_md_Cancel* token,
+                                       handel_md_CancelScope* saved) {
+    *saved = cancelScope;
+    cancelScope.token = token;
+    cancelScope.epoch = handel_md_cancel_epoch(token);
+    cancelScope.outer = saved;
+}
+
+XIA_SHARED void handel_md_cancel_leave(handel_md_CancelScope* saved) {
+    cancelScope = *saved;
+}
+
+XIA_SHARED int handel_md_cancelled(void) {
+    handel_md_CancelScope* scope;
+
+    /* An inner binding must not hide a cancelled outer one. */
+    for (scope = &cancelScope; scope != NULL && scope->token != NULL;
+         scope = scope->outer) {
+        if (handel_md_cancel_epoch(scope->token) != scope->epoch) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
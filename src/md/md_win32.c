@@ -53,6 +53,7 @@
 #include <time.h>
 
 #include "md_generic.h"
+#include "md_threads.h"
 #include "md_win32.h"
 #include "xerxes_errors.h"
 #include "xerxes_structures.h"
@@ -65,7 +66,9 @@
  * Just make this a local global so that each routine that wants to write an
  * error message doesn't have to define a new variable.
  */
-static char ERROR_STRING[XIA_LINE_LEN];
+static XIA_THREAD_LOCAL char ERROR_STRING[XIA_LINE_LEN];
+
+static int dxp_md_check_cancel(char* routine, int camChan);
 
 static unsigned int MAXBLK = 0;
 
@@ -189,6 +192,7 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_util(Xia_Util_Functions* funcs, char* t
     funcs->dxp_md_set_log_level = dxp_md_set_log_level;
     funcs->dxp_md_log = dxp_md_log;
     funcs->dxp_md_set_priority = dxp_md_set_priority;
+    funcs->dxp_md_set_scheduling = dxp_md_set_scheduling;
     funcs->dxp_md_fgets = dxp_md_fgets;
     funcs->dxp_md_tmp_path = dxp_md_tmp_path;
     funcs->dxp_md_clear_tmp = dxp_md_clear_tmp;
@@ -419,6 +423,12 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_io(int* camChan, unsigned int* function,
     int ullength = (int) *length / 2;
     unsigned long* temp = NULL;
 
+    status = dxp_md_check_cancel("dxp_md_epp_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     if ((currentID != eppID[*camChan]) && (eppID[*camChan] != -1)) {
         DxpSetID((unsigned short) eppID[*camChan]);
 
@@ -609,6 +619,12 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_usb_io(int* camChan, unsigned int* function,
 
     unsigned short* us_data = (unsigned short*) data;
 
+    status = dxp_md_check_cancel("dxp_md_usb_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     if (*address == 0) {
         if (*function == MD_IO_READ) {
             rstat = xia_usb_read(usb_addr, (long) *length, usbName[*camChan], us_data);
@@ -751,6 +767,12 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int* camChan, unsigned int* functi
 
     double to = (double) (*wait_in_ms);
 
+    status = dxp_md_check_cancel("dxp_md_serial_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     /*
      * Get the proper comPort information. Use this when we need to support multiple
      * serial ports.
@@ -1120,6 +1142,21 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_wait(float* time) {
     return DXP_SUCCESS;
 }
 
+/*
+ * Returns DXP_CANCELLED if the work the calling thread is bound to has been
+ * cancelled, so that a transfer sequence stops at the next I/O step instead
+ * of running into the driver timeouts.
+ */
+static int dxp_md_check_cancel(char* routine, int camChan) {
+    if (handel_md_cancelled()) {
+        sprintf(ERROR_STRING, "I/O cancelled for camChan %d", camChan);
+        dxp_md_log_error(routine, ERROR_STRING, DXP_CANCELLED);
+        return DXP_CANCELLED;
+    }
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Routine to allocate memory.  The calling structure is the same as the
  * ANSI C standard routine malloc().
@@ -1315,6 +1352,99 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_set_priority(int* priority) {
     return DXP_SUCCESS;
 }
 
+/* What the calling thread had before it was first changed. */
+static XIA_THREAD_LOCAL int ioSchedSaved = 0;
+static XIA_THREAD_LOCAL int ioSchedSavedPriority;
+static XIA_THREAD_LOCAL DWORD_PTR ioSchedSavedMask = 0;
+
+/*
+ * Sets the scheduling of the calling thread using the Win32 API. The real-time
+ * policies run it at time-critical priority and MD_IO_SCHED_OTHER maps the
+ * nice level onto the thread priorities. MD_IO_SCHED_OTHER at nice level 0
+ * restores the priority the thread had before, and unpinning restores its
+ * affinity. Windows has no equivalent of mlockall(), so
+ * MD_IO_SCHED_LOCK_MEMORY is rejected.
+ */
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_scheduling(int policy, int priority, int cpu,
+                                                   int flags) {
+    int pri;
+
+    DWORD_PTR previous;
+
+    if (flags != 0) {
+        sprintf(ERROR_STRING, "Unsupported scheduling flags: %#x", flags);
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDINVALIDPRIORITY);
+        return DXP_MDINVALIDPRIORITY;
+    }
+
+    if (cpu < -1 || cpu >= (int) (sizeof(DWORD_PTR) * 8)) {
+        sprintf(ERROR_STRING, "Invalid CPU %d for the I/O threads", cpu);
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDINVALIDPRIORITY);
+        return DXP_MDINVALIDPRIORITY;
+    }
+
+    switch (policy) {
+        default:
+            sprintf(ERROR_STRING, "Invalid scheduling policy: %d", policy);
+            dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING,
+                             DXP_MDINVALIDPRIORITY);
+            return DXP_MDINVALIDPRIORITY;
+        case MD_IO_SCHED_FIFO:
+        case MD_IO_SCHED_RR:
+            pri = THREAD_PRIORITY_TIME_CRITICAL;
+            break;
+        case MD_IO_SCHED_OTHER:
+            if (priority < -20 || priority > 19) {
+                sprintf(ERROR_STRING, "Nice level %d is outside [-20, 19]", priority);
+                dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING,
+                                 DXP_MDINVALIDPRIORITY);
+                return DXP_MDINVALIDPRIORITY;
+            }
+
+            pri = priority <= -10  ? THREAD_PRIORITY_HIGHEST
+                  : priority < 0   ? THREAD_PRIORITY_ABOVE_NORMAL
+                  : priority == 0  ? THREAD_PRIORITY_NORMAL
+                  : priority < 10  ? THREAD_PRIORITY_BELOW_NORMAL
+                                   : THREAD_PRIORITY_LOWEST;
+            break;
+    }
+
+    if (policy == MD_IO_SCHED_OTHER && priority == 0) {
+        if (ioSchedSaved) {
+            pri = ioSchedSavedPriority;
+            ioSchedSaved = 0;
+        }
+    } else if (!ioSchedSaved) {
+        ioSchedSavedPriority = GetThreadPriority(GetCurrentThread());
+        ioSchedSaved = 1;
+    }
+
+    if (!SetThreadPriority(GetCurrentThread(), pri)) {
+        sprintf(ERROR_STRING, "Error setting thread priority %d", pri);
+        dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDPRIORITY);
+        return DXP_MDPRIORITY;
+    }
+
+    if (cpu >= 0) {
+        previous = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu);
+
+        if (previous == 0) {
+            sprintf(ERROR_STRING, "Error pinning the thread to CPU %d", cpu);
+            dxp_md_log_error("dxp_md_set_scheduling", ERROR_STRING, DXP_MDPRIORITY);
+            return DXP_MDPRIORITY;
+        }
+
+        if (ioSchedSavedMask == 0) {
+            ioSchedSavedMask = previous;
+        }
+    } else if (ioSchedSavedMask != 0) {
+        SetThreadAffinityMask(GetCurrentThread(), ioSchedSavedMask);
+        ioSchedSavedMask = 0;
+    }
+
+    return DXP_SUCCESS;
+}
+
 #ifndef EXCLUDE_PLX
 
 /*
@@ -1443,6 +1573,12 @@ static int dxp_md_plx_io(int* camChan, unsigned int* function, unsigned long* ad
 
     /* How do we check if the handle is valid? These aren't pointers... */
 
+    status = dxp_md_check_cancel("dxp_md_plx_io", *camChan);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
     switch (*function) {
         case 0:
             /* Single word write */
@@ -1536,7 +1672,10 @@ static int dxp_md_plx_close(int* camChan) {
 XIA_MD_STATIC int dxp_md_usb2_initialize(unsigned int* maxMod, char* dllname) {
     UNUSED(maxMod);
     UNUSED(dllname);
-    numUSB2 = 0;
+    /*
+     * The device slots are shared by every Handel context and are freed by
+     * dxp_md_usb2_close(), so there is nothing to reset here.
+     */
     return DXP_SUCCESS;
 }
 
@@ -1552,8 +1691,8 @@ XIA_MD_STATIC int dxp_md_usb2_open(char* ioname, int* camChan) {
     ASSERT(ioname != NULL);
     ASSERT(camChan != NULL);
 
-    for (i = 0; i < (int) numUSB2; i++) {
-        if (STREQ(usb2Names[i], ioname)) {
+    for (i = 0; i < MAXMOD; i++) {
+        if (usb2Names[i] != NULL && STREQ(usb2Names[i], ioname)) {
             *camChan = i;
             return DXP_SUCCESS;
         }
@@ -1561,7 +1700,20 @@ XIA_MD_STATIC int dxp_md_usb2_open(char* ioname, int* camChan) {
 
     sscanf(ioname, "%d", &dev);
 
-    *camChan = numUSB2++;
+    /* Take the first free slot. Devices may be closed in any order. */
+    for (i = 0; i < MAXMOD; i++) {
+        if (usb2Names[i] == NULL) {
+            break;
+        }
+    }
+
+    if (i == MAXMOD) {
+        sprintf(ERROR_STRING, "No free slot to open USB device '%d'", dev);
+        dxp_md_log_error("dxp_md_usb2_open", ERROR_STRING, DXP_MDOPEN);
+        return DXP_MDOPEN;
+    }
+
+    *camChan = i;
 
     status = xia_usb2_open(dev, &usb2Handles[*camChan]);
 
@@ -1593,6 +1745,7 @@ XIA_MD_STATIC int dxp_md_usb2_open(char* ioname, int* camChan) {
 
     usb2AddrCache[*camChan] = MD_INVALID_ADDR;
 
+    numUSB2++;
     numMod++;
 
     return DXP_SUCCESS;
@@ -1639,6 +1792,12 @@ XIA_MD_STATIC int dxp_md_usb2_io(int* camChan, unsigned int* function,
      */
     switch (*addr) {
         case 0:
+            status = dxp_md_check_cancel("dxp_md_usb2_io", *camChan);
+
+            if (status != DXP_SUCCESS) {
+                return status;
+            }
+
             if (usb2AddrCache[*camChan] == MD_INVALID_ADDR) {
                 sprintf(ERROR_STRING, "No target address set for camChan %d", *camChan);
                 dxp_md_log_error("dxp_md_usb2_io", ERROR_STRING, DXP_MD_TARGET_ADDR);
@@ -57,6 +57,7 @@
 #endif /* _WIN32 */
 
 #include "xia_assert.h"
+#include "xia_common.h"
 #include "xia_usb2_api.h"
 #include "xia_usb2_errors.h"
 #include "xia_usb2_private.h"
@@ -102,7 +103,7 @@ static unsigned long XIA_USB2_SMALL_READ_PACKET_SIZE = 0;
 /* The text of last printf info is reset every time the status code is updated
  * so that callers can retrieve it in case of an error status
  */
-static char info_string[INFO_LEN];
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 /*
  * Opens the device with the specified number (dev) and returns
@@ -51,6 +51,7 @@
 #include "xia_usb2_errors.h"
 #include "xia_usb2_private.h"
 
+#include "xia_common.h"
 #include "xia_md.h"
 
 #define FALSE 0
@@ -78,7 +79,7 @@ static void print_debug(const char* fmt, ...);
 static struct usb_dev_handle* xia_usb_handle = NULL;
 static struct usb_device* xia_usb_device = NULL;
 
-static char info_string[400];
+static XIA_THREAD_LOCAL char info_string[400];
 
 XIA_EXPORT int XIA_API xia_usb_open(char* device, HANDLE* hDevice) {
     int device_number;
@@ -41,20 +41,35 @@
 #include "xia_assert.h"
 #include "xia_common.h"
 #include "xia_file_private.h"
+#include "md_threads.h"
 
 /* Private functions */
 static void xia__add_handle(FILE* fp, char* file, int line);
 static void xia__remove_handle(FILE* fp);
 static FILE* xia__open_home(const char* filename, const char* mode, const char* env);
+static void xia__lock_handles(void);
+static void xia__unlock_handles(void);
 
 /* Global variables */
 
-/* If this library wants to become thread-safe, this variable
- * needs to be handled carefully. (Currently, it is not handled carefully
- * at all.)
- */
+/* Shared by every thread and context; only touch it under handlesLock. */
 static xia_file_handle_t* FILE_HANDLES = NULL;
 
+static handel_md_Mutex handlesLock = {NULL, "xia_file"};
+
+/*
+ * Creates the lock for the handle list. Called once from xiaInitHandel().
+ * Files opened before then are tracked without it, when no other thread
+ * can be using the library yet. Returns 0 on success.
+ */
+XIA_SHARED int xia_file_init(void) {
+    if (handel_md_mutex_ready(&handlesLock)) {
+        return 0;
+    }
+
+    return handel_md_mutex_create(&handlesLock);
+}
+
 /*
  * Opens a file stream.
  *
@@ -95,10 +110,14 @@ XIA_SHARED int xia_num_open_handles(void) {
 
     int n_handles = 0;
 
+    xia__lock_handles();
+
     for (fh = FILE_HANDLES; fh != NULL; fh = fh->next, n_handles++) {
         /* Do nothing. */
     }
 
+    xia__unlock_handles();
+
     return n_handles;
 }
 
@@ -113,9 +132,13 @@ XIA_SHARED void xia_print_open_handles(FILE* stream) {
 
     ASSERT(stream != NULL);
 
+    xia__lock_handles();
+
     for (fh = FILE_HANDLES; fh != NULL; fh = fh->next) {
         fprintf(stream, "<%p> %s, line %d\n", fh->fp, fh->file, fh->line);
     }
+
+    xia__unlock_handles();
 }
 
 /*
@@ -157,8 +180,10 @@ static void xia__add_handle(FILE* fp, char* file, int line) {
     new_handle->line = line;
     strncpy(new_handle->file, file, MAX_FILE_SIZE);
 
+    xia__lock_handles();
     new_handle->next = FILE_HANDLES;
     FILE_HANDLES = new_handle;
+    xia__unlock_handles();
 }
 
 /*
@@ -172,6 +197,8 @@ static void xia__remove_handle(FILE* fp) {
         return;
     }
 
+    xia__lock_handles();
+
     for (fh = FILE_HANDLES, prev = NULL; fh != NULL; fh = fh->next) {
         if (fh->fp == fp) {
             if (prev == NULL) {
@@ -180,6 +207,8 @@ static void xia__remove_handle(FILE* fp) {
                 prev->next = fh->next;
             }
 
+            xia__unlock_handles();
+
             free(fh);
             fh = NULL;
             return;
@@ -188,6 +217,8 @@ static void xia__remove_handle(FILE* fp) {
         prev = fh;
     }
 
+    xia__unlock_handles();
+
     /* This means that we couldn't find the pointer in our list of handles. */
     FAIL();
 }
@@ -248,4 +279,16 @@ static FILE* xia__open_home(const char* filename, const char* mode, const char*
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+static void xia__lock_handles(void) {
+    if (handel_md_mutex_ready(&handlesLock)) {
+        handel_md_mutex_lock(&handlesLock);
+    }
+}
+
+static void xia__unlock_handles(void) {
+    if (handel_md_mutex_ready(&handlesLock)) {
+        handel_md_mutex_unlock(&handlesLock);
+    }
+}
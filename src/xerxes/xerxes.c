@@ -52,6 +52,9 @@
 
 /* General DXP information */
 #include "md_generic.h"
+#include "xerxes_dsp_cache.h"
+#include "xerxes_wait.h"
+#include "xerxes_dsp_shadow.h"
 #include "xerxes_errors.h"
 #include "xerxes_structures.h"
 #include "xia_xerxes.h"
@@ -62,6 +65,8 @@
 #include "xia_file.h"
 #include "xia_version.h"
 
+#include "md_threads.h"
+
 #include <util/xia_str_manip.h>
 
 /* Private routines */
@@ -87,41 +92,61 @@ static int dxp_fipconfig(void);
 /* Shorthand notation telling routines to act on all channels of the DXP (-1 currently). */
 static int allChan = ALLCHAN;
 
-static int numDxpMod = 0;
-static char info_string[INFO_LEN];
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
 
 /*
- *  Head of Linked list of Interfaces
+ * Everything Xerxes knows about one system. Each Handel context owns
+ * one of these; callers that never create a context share the default.
  */
-static Interface* iface_head = NULL;
+struct Xerxes_Context {
+    int numDxpMod;
 
-/*
- *  Structure to contain the board types in the system
- */
-static Board_Info* btypes_head = NULL;
+    /*
+     *  Head of Linked list of Interfaces
+     */
+    Interface* iface_head;
 
-/*
- *	Define the Head of the linked list of items in the system
- */
-static Board* system_head = NULL;
+    /*
+     *  Structure to contain the board types in the system
+     */
+    Board_Info* btypes_head;
 
-/*
- *	Define the head of the DSP linked list
- */
-static Dsp_Info* dsp_head = NULL;
+    /*
+     *	Define the Head of the linked list of items in the system
+     */
+    Board* system_head;
 
-/*
- *	Define the head of the FIPPI linked list
- */
-static Fippi_Info* fippi_head = NULL;
+    /*
+     *	Define the head of the DSP linked list
+     */
+    Dsp_Info* dsp_head;
+
+    /*
+     *	Define the head of the FIPPI linked list
+     */
+    Fippi_Info* fippi_head;
+
+    /*
+     * Hold the information used to assign new board information.
+     */
+    Board_Info* working_btype;
+    Board* working_board;
+    Interface* working_iface;
+
+    /*
+     * Guards the DSP and FiPPI lists while modules in this context switch
+     * firmware from separate threads.
+     */
+    handel_md_Mutex lock;
+};
+
+static Xerxes_Context defaultContext = {0,    NULL, NULL, NULL, NULL, NULL, NULL,
+                                        NULL, NULL, {NULL, "xerxes_context"}};
 
 /*
- * Define global static variables to hold the information
- * used to assign new board information.
+ * The context used by the calling thread. See dxp_select_context().
  */
-static Board_Info* working_btype = NULL;
-static Board* working_board = NULL;
-static Interface* working_iface = NULL;
+static XIA_THREAD_LOCAL Xerxes_Context* xs = &defaultContext;
 
 /*
  * Routines to perform global initialization functions.  Read in configuration
@@ -154,6 +179,25 @@ XERXES_EXPORT int XERXES_API dxp_init_library(void) {
         return status;
     }
 
+    if ((status = dxp_wait_init()) != DXP_SUCCESS) {
+        dxp_log_error("dxp_init_library", "Unable to initialize the wait engine",
+                      status);
+        return status;
+    }
+
+    if ((status = dxp_dsp_cache_init()) != DXP_SUCCESS) {
+        dxp_log_error("dxp_init_library", "Unable to initialize the DSP cache",
+                      status);
+        return status;
+    }
+
+    if (!handel_md_mutex_ready(&defaultContext.lock) &&
+        handel_md_mutex_create(&defaultContext.lock) != THREADING_NO_ERROR) {
+        dxp_log_error("dxp_init_library", "Error creating the default context lock",
+                      DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
     return status;
 }
 
@@ -190,6 +234,7 @@ XERXES_EXPORT int XERXES_API dxp_install_utils(const char* utilname) {
     xerxes_md_wait = util_funcs.dxp_md_wait;
     xerxes_md_puts = util_funcs.dxp_md_puts;
     xerxes_md_set_priority = util_funcs.dxp_md_set_priority;
+    xerxes_md_set_scheduling = util_funcs.dxp_md_set_scheduling;
     xerxes_md_fgets = util_funcs.dxp_md_fgets;
     xerxes_md_tmp_path = util_funcs.dxp_md_tmp_path;
     xerxes_md_clear_tmp = util_funcs.dxp_md_clear_tmp;
@@ -237,7 +282,7 @@ XERXES_EXPORT int XERXES_API dxp_install_utils(const char* utilname) {
 XERXES_EXPORT int XERXES_API dxp_init_ds(void) {
     int status = DXP_SUCCESS;
 
-    Board_Info* current = btypes_head;
+    Board_Info* current = xs->btypes_head;
     Board_Info* next = NULL;
 
     /* CLEAR BTYPES LINK LIST */
@@ -250,11 +295,11 @@ XERXES_EXPORT int XERXES_API dxp_init_ds(void) {
         current = next;
     }
     /* And clear out the pointer to the head of the list(the memory is freed) */
-    btypes_head = NULL;
+    xs->btypes_head = NULL;
 
     /* NULL the current board type in the static variable, to ensure we dont point
      * free memory */
-    working_btype = NULL;
+    xs->working_btype = NULL;
 
     /* CLEAR BOARDS,DSP,FIPPI,DEFAULTS LINK LIST */
     if ((status = dxp_init_boards_ds()) != DXP_SUCCESS) {
@@ -273,7 +318,7 @@ XERXES_EXPORT int XERXES_API dxp_init_boards_ds(void) {
     int status = DXP_SUCCESS;
 
     Board* next;
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     /* Initialize the system_head linked list */
     if (current != NULL) {
@@ -283,12 +328,12 @@ XERXES_EXPORT int XERXES_API dxp_init_boards_ds(void) {
             dxp_free_board(current);
             current = next;
         } while (next != NULL);
-        system_head = NULL;
+        xs->system_head = NULL;
     }
 
     /* NULL the current board in the static variable, to ensure we dont point
      * free memory */
-    working_board = NULL;
+    xs->working_board = NULL;
 
     /* CLEAR INTERFACE LINK LIST */
     if ((status = dxp_init_iface_ds()) != DXP_SUCCESS) {
@@ -312,7 +357,7 @@ XERXES_EXPORT int XERXES_API dxp_init_boards_ds(void) {
     }
 
     /* Initialize the number of modules and channels */
-    numDxpMod = 0;
+    xs->numDxpMod = 0;
 
     return DXP_SUCCESS;
 }
@@ -322,7 +367,7 @@ XERXES_EXPORT int XERXES_API dxp_init_boards_ds(void) {
  */
 static int XERXES_API dxp_init_iface_ds(void) {
     Interface* next;
-    Interface* current = iface_head;
+    Interface* current = xs->iface_head;
 
     /* Search thru the iface LL and clear them out */
     while (current != NULL) {
@@ -332,11 +377,11 @@ static int XERXES_API dxp_init_iface_ds(void) {
         current = next;
     }
     /* And clear out the pointer to the head of the list(the memory is freed) */
-    iface_head = NULL;
+    xs->iface_head = NULL;
 
     /* NULL the current board type in the static variable, to ensure we dont point
      * free memory */
-    working_iface = NULL;
+    xs->working_iface = NULL;
 
     return DXP_SUCCESS;
 }
@@ -346,7 +391,7 @@ static int XERXES_API dxp_init_iface_ds(void) {
  */
 static int XERXES_API dxp_init_dsp_ds(void) {
     Dsp_Info* next;
-    Dsp_Info* current = dsp_head;
+    Dsp_Info* current = xs->dsp_head;
 
     /* Search thru the iface LL and clear them out */
     while (current != NULL) {
@@ -356,7 +401,7 @@ static int XERXES_API dxp_init_dsp_ds(void) {
         current = next;
     }
     /* And clear out the pointer to the head of the list(the memory is freed) */
-    dsp_head = NULL;
+    xs->dsp_head = NULL;
 
     return DXP_SUCCESS;
 }
@@ -366,7 +411,7 @@ static int XERXES_API dxp_init_dsp_ds(void) {
  */
 static int XERXES_API dxp_init_fippi_ds(void) {
     Fippi_Info* next;
-    Fippi_Info* current = fippi_head;
+    Fippi_Info* current = xs->fippi_head;
 
     /* Search thru the iface LL and clear them out */
     while (current != NULL) {
@@ -376,11 +421,83 @@ static int XERXES_API dxp_init_fippi_ds(void) {
         current = next;
     }
     /* And clear out the pointer to the head of the list(the memory is freed) */
-    fippi_head = NULL;
+    xs->fippi_head = NULL;
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Allocates an empty system context. Select it with
+ * dxp_select_context() before configuring it.
+ */
+XERXES_EXPORT int XERXES_API dxp_create_context(Xerxes_Context** ctx) {
+    if (ctx == NULL) {
+        dxp_log_error("dxp_create_context", "'ctx' may not be NULL", DXP_NULL);
+        return DXP_NULL;
+    }
+
+    *ctx = (Xerxes_Context*) xerxes_md_alloc(sizeof(Xerxes_Context));
+
+    if (*ctx == NULL) {
+        sprintf(info_string, "Unable to allocate %zu bytes for a Xerxes context",
+                sizeof(Xerxes_Context));
+        dxp_log_error("dxp_create_context", info_string, DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    memset(*ctx, 0, sizeof(Xerxes_Context));
+
+    (*ctx)->lock.name = "xerxes_context";
+
+    if (handel_md_mutex_create(&(*ctx)->lock) != THREADING_NO_ERROR) {
+        dxp_log_error("dxp_create_context", "Error creating the context lock",
+                      DXP_NOMEM);
+        xerxes_md_free(*ctx);
+        *ctx = NULL;
+        return DXP_NOMEM;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Clears and frees a context created by dxp_create_context(). Threads
+ * that had ctx selected go back to the default context.
+ */
+XERXES_EXPORT int XERXES_API dxp_free_context(Xerxes_Context* ctx) {
+    int status;
+
+    Xerxes_Context* previous = xs;
+
+    if (ctx == NULL || ctx == &defaultContext) {
+        dxp_log_error("dxp_free_context", "The default context cannot be freed",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    xs = ctx;
+    status = dxp_init_ds();
+    xs = (previous == ctx) ? &defaultContext : previous;
+
+    handel_md_mutex_destroy(&ctx->lock);
+    xerxes_md_free(ctx);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_free_context", "Error clearing the context", status);
+        return status;
+    }
 
     return DXP_SUCCESS;
 }
 
+/*
+ * Makes ctx the context for all following Xerxes calls from the calling
+ * thread. A NULL ctx selects the default context.
+ */
+XERXES_EXPORT void XERXES_API dxp_select_context(Xerxes_Context* ctx) {
+    xs = (ctx == NULL) ? &defaultContext : ctx;
+}
+
 /*
  * Add an item specified by token to the system configuration.
  */
@@ -459,15 +576,15 @@ int dxp_add_board_item(char* ltoken, char** values) {
 
         /* Search thru board types to match find the structure
            in the linked list */
-        working_btype = btypes_head;
+        xs->working_btype = xs->btypes_head;
 
-        while ((working_btype != NULL) && !found) {
-            if (STREQ(working_btype->name, board_type)) {
+        while ((xs->working_btype != NULL) && !found) {
+            if (STREQ(xs->working_btype->name, board_type)) {
                 found = TRUE_;
                 break;
             }
 
-            working_btype = working_btype->next;
+            xs->working_btype = xs->working_btype->next;
         }
 
         if (!found) {
@@ -476,7 +593,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return DXP_UNKNOWN_BTYPE;
         }
 
-        sprintf(info_string, "working_btype->name = '%s'", working_btype->name);
+        sprintf(info_string, "xs->working_btype->name = '%s'", xs->working_btype->name);
         dxp_log_debug("dxp_add_board_item", info_string);
     } else if (STREQ(ltoken, "interface")) {
         /*
@@ -494,7 +611,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
 
         values[0] = xia_lower(values[0]);
 
-        status = dxp_add_iface(values[0], values[1], &working_iface);
+        status = dxp_add_iface(values[0], values[1], &xs->working_iface);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to load '%s' interface %s",
@@ -503,29 +620,29 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
 
-        if (working_board) {
-            working_board->iface = working_iface;
+        if (xs->working_board) {
+            xs->working_board->iface = xs->working_iface;
         }
     } else if (STREQ(ltoken, "module")) {
         sprintf(info_string, "New module '%d': interface = '%s', # channels = %s",
-                numDxpMod, values[0], values[1]);
+                xs->numDxpMod, values[0], values[1]);
         dxp_log_info("dxp_add_board_item", info_string);
 
-        if (numDxpMod == MAXDXP) {
+        if (xs->numDxpMod == MAXDXP) {
             sprintf(info_string, "Too many modules specified: only %d are allowed",
                     MAXDXP);
             dxp_log_error("dxp_add_board_item", info_string, DXP_MAX_MODULES);
             return DXP_MAX_MODULES;
         }
 
-        if (working_btype == NULL) {
-            sprintf(info_string, "No board type defined for module '%d'", numDxpMod);
+        if (xs->working_btype == NULL) {
+            sprintf(info_string, "No board type defined for module '%d'", xs->numDxpMod);
             dxp_log_error("dxp_add_board_item", info_string, DXP_UNKNOWN_BTYPE);
             return DXP_UNKNOWN_BTYPE;
         }
 
-        if (working_iface == NULL) {
-            sprintf(info_string, "No interface define for module '%d'", numDxpMod);
+        if (xs->working_iface == NULL) {
+            sprintf(info_string, "No interface define for module '%d'", xs->numDxpMod);
             dxp_log_error("dxp_add_board_item", info_string, DXP_INITIALIZE);
             return DXP_INITIALIZE;
         }
@@ -540,14 +657,14 @@ int dxp_add_board_item(char* ltoken, char** values) {
          * identify how to talk to this module. */
 
         sprintf(info_string, "Opening interface ioname=%s iface_dllname=%s funcs=%p",
-                values[0], working_iface->dllname, working_iface->funcs);
+                values[0], xs->working_iface->dllname, xs->working_iface->funcs);
         dxp_log_info("dxp_add_board_item", info_string);
 
-        status = working_iface->funcs->dxp_md_open(values[0], &ioChan);
+        status = xs->working_iface->funcs->dxp_md_open(values[0], &ioChan);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Error opening module '%d' with interface '%s'",
-                    numDxpMod, PRINT_NON_NULL(values[0]));
+                    xs->numDxpMod, PRINT_NON_NULL(values[0]));
             dxp_log_error("dxp_add_board_item", info_string, status);
             return status;
         }
@@ -577,64 +694,65 @@ int dxp_add_board_item(char* ltoken, char** values) {
         }
 
         /* Find the last entry in the Linked list and add to the end */
-        working_board = system_head;
+        xs->working_board = xs->system_head;
 
-        if (working_board != NULL) {
-            while (working_board->next != NULL) {
-                working_board = working_board->next;
+        if (xs->working_board != NULL) {
+            while (xs->working_board->next != NULL) {
+                xs->working_board = xs->working_board->next;
             }
 
-            working_board->next = (Board*) xerxes_md_alloc(sizeof(Board));
-            working_board = working_board->next;
+            xs->working_board->next = (Board*) xerxes_md_alloc(sizeof(Board));
+            xs->working_board = xs->working_board->next;
         } else {
-            system_head = (Board*) xerxes_md_alloc(sizeof(Board));
-            working_board = system_head;
+            xs->system_head = (Board*) xerxes_md_alloc(sizeof(Board));
+            xs->working_board = xs->system_head;
         }
 
-        working_board->ioChan = ioChan;
-        working_board->used = used;
-        working_board->detChan = detChan;
-        working_board->mod = numDxpMod;
-        working_board->nchan = nchan;
-        working_board->btype = working_btype;
-        working_board->iface = working_iface;
-        working_board->is_full_reboot = FALSE_;
+        xs->working_board->ioChan = ioChan;
+        xs->working_board->used = used;
+        xs->working_board->detChan = detChan;
+        xs->working_board->mod = xs->numDxpMod;
+        xs->working_board->nchan = nchan;
+        xs->working_board->btype = xs->working_btype;
+        xs->working_board->iface = xs->working_iface;
+        xs->working_board->is_full_reboot = FALSE_;
 
-        memset(working_board->state, 0, sizeof(working_board->state));
+        memset(xs->working_board->state, 0, sizeof(xs->working_board->state));
 
-        working_board->btype->funcs->dxp_init_driver(working_iface);
-        working_board->next = NULL;
+        xs->working_board->btype->funcs->dxp_init_driver(xs->working_iface);
+        xs->working_board->next = NULL;
 
-        working_board->mmu = NULL;
-        working_board->system_dsp = NULL;
-        working_board->fippi_a = NULL;
-        working_board->system_fpga = NULL;
-        working_board->system_fippi = NULL;
+        xs->working_board->mmu = NULL;
+        xs->working_board->system_dsp = NULL;
+        xs->working_board->fippi_a = NULL;
+        xs->working_board->system_fpga = NULL;
+        xs->working_board->system_fippi = NULL;
+        xs->working_board->shadow = NULL;
 
         /* Memory assignments */
-        working_board->chanstate =
+        xs->working_board->chanstate =
             (Chan_State*) xerxes_md_alloc(nchan * sizeof(Chan_State));
 
-        memset(working_board->chanstate, 0, nchan * sizeof(Chan_State));
+        memset(xs->working_board->chanstate, 0, nchan * sizeof(Chan_State));
 
-        working_board->params =
+        xs->working_board->params =
             (unsigned short**) xerxes_md_alloc(nchan * sizeof(unsigned short*));
 
-        working_board->dsp = (Dsp_Info**) xerxes_md_alloc(nchan * sizeof(Dsp_Info*));
+        xs->working_board->dsp = (Dsp_Info**) xerxes_md_alloc(nchan * sizeof(Dsp_Info*));
 
-        working_board->fippi =
+        xs->working_board->fippi =
             (Fippi_Info**) xerxes_md_alloc(nchan * sizeof(Fippi_Info*));
 
         /* Fill in some default information */
-        for (j = 0; j < working_board->nchan; j++) {
-            working_board->dsp[j] = NULL;
-            working_board->params[j] = NULL;
-            working_board->fippi[j] = NULL;
+        for (j = 0; j < xs->working_board->nchan; j++) {
+            xs->working_board->dsp[j] = NULL;
+            xs->working_board->params[j] = NULL;
+            xs->working_board->fippi[j] = NULL;
         }
 
-        numDxpMod++;
+        xs->numDxpMod++;
     } else if (STREQ(ltoken, "dsp")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'dsp' unless a "
                           "board type has been defined",
@@ -644,16 +762,16 @@ int dxp_add_board_item(char* ltoken, char** values) {
 
         chanid = (int) strtol(values[0], NULL, 10);
 
-        if ((chanid < 0) || (chanid >= (int) working_board->nchan)) {
+        if ((chanid < 0) || (chanid >= (int) xs->working_board->nchan)) {
             sprintf(info_string,
                     "Selected channel (%d) for DSP code is not valid for "
                     "the current module, which has %d channels",
-                    chanid, (int) working_board->nchan);
+                    chanid, (int) xs->working_board->nchan);
             dxp_log_error("dxp_add_board_item", info_string, DXP_BADCHANNEL);
             return DXP_BADCHANNEL;
         }
 
-        status = dxp_add_dsp(values[1], working_btype, &(working_board->dsp[chanid]));
+        status = dxp_add_dsp(values[1], xs->working_btype, &(xs->working_board->dsp[chanid]));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add DSP code: '%s'",
@@ -662,25 +780,25 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
 
-        working_board->chanstate[chanid].dspdownloaded = 2;
+        xs->working_board->chanstate[chanid].dspdownloaded = 2;
 
-        if (working_board->params[chanid]) {
-            xerxes_md_free(working_board->params[chanid]);
-            working_board->params[chanid] = NULL;
+        if (xs->working_board->params[chanid]) {
+            xerxes_md_free(xs->working_board->params[chanid]);
+            xs->working_board->params[chanid] = NULL;
         }
 
         param_array_size =
-            working_board->dsp[chanid]->params->nsymbol * sizeof(unsigned short);
+            xs->working_board->dsp[chanid]->params->nsymbol * sizeof(unsigned short);
 
         if (param_array_size > 0) {
             /* Only allocate memory if there are parameters */
-            working_board->params[chanid] =
+            xs->working_board->params[chanid] =
                 (unsigned short*) xerxes_md_alloc(param_array_size);
 
-            memset(working_board->params[chanid], 0, param_array_size);
+            memset(xs->working_board->params[chanid], 0, param_array_size);
         }
     } else if (STREQ(ltoken, "fippi")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'fippi' "
                           "unless a board type has been defined",
@@ -690,17 +808,17 @@ int dxp_add_board_item(char* ltoken, char** values) {
 
         chanid = (int) strtol(values[0], NULL, 10);
 
-        if ((chanid < 0) || (chanid >= (int) working_board->nchan)) {
+        if ((chanid < 0) || (chanid >= (int) xs->working_board->nchan)) {
             sprintf(info_string,
                     "Selected channel (%d) for FiPPI code is not valid "
                     "for the current module, which has %d channels",
-                    chanid, (int) working_board->nchan);
+                    chanid, (int) xs->working_board->nchan);
             dxp_log_error("dxp_add_board_item", info_string, DXP_BADCHANNEL);
             return DXP_BADCHANNEL;
         }
 
         status =
-            dxp_add_fippi(values[1], working_btype, &(working_board->fippi[chanid]));
+            dxp_add_fippi(values[1], xs->working_btype, &(xs->working_board->fippi[chanid]));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add FiPPI: '%s'",
@@ -709,7 +827,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
     } else if (STREQ(ltoken, "system_fippi")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'system_fippi' "
                           "unless a board type has been defined",
@@ -718,7 +836,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
         }
 
         status =
-            dxp_add_fippi(values[0], working_btype, &(working_board->system_fippi));
+            dxp_add_fippi(values[0], xs->working_btype, &(xs->working_board->system_fippi));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add System FiPPI: '%s'",
@@ -727,7 +845,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
     } else if (STREQ(ltoken, "system_fpga")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'system_fpga' "
                           "unless a board type has been defined",
@@ -735,7 +853,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return DXP_UNKNOWN_BTYPE;
         }
 
-        status = dxp_add_fippi(values[0], working_btype, &(working_board->system_fpga));
+        status = dxp_add_fippi(values[0], xs->working_btype, &(xs->working_board->system_fpga));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add System FPGA: '%s'",
@@ -744,7 +862,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
     } else if (STREQ(ltoken, "fippi_a")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'fippi_a' "
                           "unless a board type has been defined",
@@ -752,7 +870,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return DXP_UNKNOWN_BTYPE;
         }
 
-        status = dxp_add_fippi(values[0], working_btype, &(working_board->fippi_a));
+        status = dxp_add_fippi(values[0], xs->working_btype, &(xs->working_board->fippi_a));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add FiPPI A: '%s'",
@@ -761,7 +879,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
     } else if (STREQ(ltoken, "system_dsp")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'system_dsp' "
                           "unless a board type has been defined",
@@ -769,7 +887,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return DXP_UNKNOWN_BTYPE;
         }
 
-        status = dxp_add_dsp(values[0], working_btype, &(working_board->system_dsp));
+        status = dxp_add_dsp(values[0], xs->working_btype, &(xs->working_board->system_dsp));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add System DSP: '%s'",
@@ -778,17 +896,17 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return status;
         }
 
-        total_syms = working_board->system_dsp->params->nsymbol +
-                     working_board->system_dsp->params->n_per_chan_symbols;
+        total_syms = xs->working_board->system_dsp->params->nsymbol +
+                     xs->working_board->system_dsp->params->n_per_chan_symbols;
 
-        for (j = 0; j < working_board->nchan; j++) {
+        for (j = 0; j < xs->working_board->nchan; j++) {
             param_array_size = total_syms * sizeof(unsigned short);
-            working_board->params[j] =
+            xs->working_board->params[j] =
                 (unsigned short*) xerxes_md_alloc(param_array_size);
-            memset(working_board->params[j], 0, param_array_size);
+            memset(xs->working_board->params[j], 0, param_array_size);
         }
     } else if (STREQ(ltoken, "mmu")) {
-        if (working_btype == NULL) {
+        if (xs->working_btype == NULL) {
             dxp_log_error("dxp_add_board_item",
                           "Unable to process 'mmu' unless a "
                           "board type has been defined",
@@ -796,7 +914,7 @@ int dxp_add_board_item(char* ltoken, char** values) {
             return DXP_UNKNOWN_BTYPE;
         }
 
-        status = dxp_add_fippi(values[0], working_btype, &(working_board->mmu));
+        status = dxp_add_fippi(values[0], xs->working_btype, &(xs->working_board->mmu));
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Unable to add MMU: '%s'", PRINT_NON_NULL(values[0]));
@@ -843,6 +961,8 @@ static int XERXES_API dxp_free_board(Board* board) {
         xerxes_md_free(board->params);
     }
 
+    dxp_dsp_shadow_free(board);
+
     /* Free the Chan_State Array*/
     if (board->chanstate != NULL)
         xerxes_md_free(board->chanstate);
@@ -1043,7 +1163,7 @@ int XERXES_API dxp_add_btype(char* name, char* pointer, char* dllname) {
     int status = DXP_SUCCESS;
 
     Board_Info* prev = NULL;
-    Board_Info* current = btypes_head;
+    Board_Info* current = xs->btypes_head;
 
     UNUSED(dllname);
 
@@ -1065,11 +1185,11 @@ int XERXES_API dxp_add_btype(char* name, char* pointer, char* dllname) {
     }
 
     /* No match in the existing list, add a new entry */
-    if (btypes_head == NULL) {
+    if (xs->btypes_head == NULL) {
         /* Initialize the Header entry in the btypes linked list */
-        btypes_head = (Board_Info*) xerxes_md_alloc(sizeof(Board_Info));
-        btypes_head->type = 0;
-        current = btypes_head;
+        xs->btypes_head = (Board_Info*) xerxes_md_alloc(sizeof(Board_Info));
+        xs->btypes_head->type = 0;
+        current = xs->btypes_head;
     } else {
         /* Not First time, allocate memory for next member of linked list */
         prev->next = (Board_Info*) xerxes_md_alloc(sizeof(Board_Info));
@@ -1203,7 +1323,7 @@ static int dxp_add_dsp(char* filename, Board_Info* board, Dsp_Info** passed) {
 
     Dsp_Info* new_dsp = NULL;
     Dsp_Info* prev = NULL;
-    Dsp_Info* current = dsp_head;
+    Dsp_Info* current = xs->dsp_head;
 
     ASSERT(filename != NULL);
     ASSERT(board != NULL);
@@ -1350,12 +1470,13 @@ static int dxp_add_dsp(char* filename, Board_Info* board, Dsp_Info** passed) {
 
     /* Initialize pointers not used by all devices */
     new_dsp->params->chan_offsets = NULL;
+    new_dsp->params->n_chan_offsets = 0;
     new_dsp->params->n_per_chan_symbols = 0;
 
     sprintf(info_string, "Preparing to get DSP configuration: %s", new_dsp->filename);
     dxp_log_debug("dxp_add_dsp", info_string);
 
-    status = board->funcs->dxp_get_dspconfig(new_dsp);
+    status = dxp_dsp_cache_load(board, new_dsp);
 
     if (status != DXP_SUCCESS) {
         dxp_free_dsp(new_dsp);
@@ -1366,8 +1487,8 @@ static int dxp_add_dsp(char* filename, Board_Info* board, Dsp_Info** passed) {
     }
 
     /* Add the new DSP code to the global list. */
-    if (!dsp_head) {
-        dsp_head = new_dsp;
+    if (!xs->dsp_head) {
+        xs->dsp_head = new_dsp;
     } else {
         prev->next = new_dsp;
     }
@@ -1396,7 +1517,7 @@ static int XERXES_API dxp_add_fippi(char* filename, Board_Info* board,
     int status;
 
     Fippi_Info* prev = NULL;
-    Fippi_Info* current = fippi_head;
+    Fippi_Info* current = xs->fippi_head;
 
     /* First search through the linked list and see if this configuration
      * already exists */
@@ -1469,8 +1590,8 @@ static int XERXES_API dxp_add_fippi(char* filename, Board_Info* board,
     }
 
     /* Update global linked list with the new FiPPI. */
-    if (fippi_head == NULL) {
-        fippi_head = *fippi;
+    if (xs->fippi_head == NULL) {
+        xs->fippi_head = *fippi;
     } else {
         prev->next = *fippi;
     }
@@ -1491,7 +1612,7 @@ static int XERXES_API dxp_add_iface(char* dllname, char* iolib, Interface** ifac
     unsigned int maxMod = MAXDXP;
 
     Interface* prev = NULL;
-    Interface* current = iface_head;
+    Interface* current = xs->iface_head;
 
     /* First search through the linked list and see if this configuration
      * already exists */
@@ -1506,10 +1627,10 @@ static int XERXES_API dxp_add_iface(char* dllname, char* iolib, Interface** ifac
     }
 
     /* No match in the existing list, add a new entry */
-    if (iface_head == NULL) {
+    if (xs->iface_head == NULL) {
         /* First time, allocate memory for head of linked list */
-        iface_head = (Interface*) xerxes_md_alloc(sizeof(Interface));
-        current = iface_head;
+        xs->iface_head = (Interface*) xerxes_md_alloc(sizeof(Interface));
+        current = xs->iface_head;
     } else {
         /* Not First time, allocate memory for next member of linked list */
         prev->next = (Interface*) xerxes_md_alloc(sizeof(Interface));
@@ -1552,7 +1673,7 @@ static int XERXES_API dxp_add_iface(char* dllname, char* iolib, Interface** ifac
 XERXES_EXPORT int XERXES_API dxp_user_setup(void) {
     int status;
 
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     while (current != NULL) {
         current->is_full_reboot = TRUE_;
@@ -1577,7 +1698,7 @@ XERXES_EXPORT int XERXES_API dxp_user_setup(void) {
         return status;
     }
 
-    current = system_head;
+    current = xs->system_head;
 
     /* The per-module configurations are done here. Only configurations that
      * are applicable to every module should be done here. Hardware specific
@@ -1607,7 +1728,7 @@ XERXES_EXPORT int XERXES_API dxp_user_setup(void) {
 static int dxp_fipconfig(void) {
     int status;
 
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     while (current != NULL) {
         status = current->btype->funcs->dxp_download_fpgaconfig(
@@ -1659,6 +1780,8 @@ int XERXES_API dxp_replace_fpgaconfig(int* detChan, char* name, char* filename)
      * XXX If the board has defined any of the FiPPIs used by the xMAP/STJ product,
      * then we need to pass in a different Fippi_Info structure.
      */
+    handel_md_mutex_lock(&xs->lock);
+
     if (chosen->fippi_a || chosen->system_fpga) {
         if (STRNEQ(name, "a_and_b") || STREQ(name, "a")) {
             status = dxp_add_fippi(filename, chosen->btype, &(chosen->fippi_a));
@@ -1671,6 +1794,8 @@ int XERXES_API dxp_replace_fpgaconfig(int* detChan, char* name, char* filename)
         status = dxp_add_fippi(filename, chosen->btype, &(chosen->fippi[modChan]));
     }
 
+    handel_md_mutex_unlock(&xs->lock);
+
     if (status != DXP_SUCCESS) {
         sprintf(info_string, "Error loading FPGA %s", PRINT_NON_NULL(filename));
         dxp_log_error("dxp_replace_fpgaconfig", info_string, status);
@@ -1706,7 +1831,7 @@ XERXES_EXPORT int XERXES_API dxp_dspconfig(void) {
     int status;
     int ioChan;
 
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     dxp_log_debug("dxp_dspconfig", "Preapring to call dxp_download_dspconfig");
 
@@ -1755,12 +1880,16 @@ int XERXES_API dxp_replace_dspconfig(int* detChan, char* filename) {
     /* If the board has a system DSP, then we want to update that instead of
      * the "normal" DSP.
      */
+    handel_md_mutex_lock(&xs->lock);
+
     if (chosen->system_dsp != NULL) {
         status = dxp_add_dsp(filename, chosen->btype, &(chosen->system_dsp));
     } else {
         status = dxp_add_dsp(filename, chosen->btype, &(chosen->dsp[modChan]));
     }
 
+    handel_md_mutex_unlock(&xs->lock);
+
     if (status != DXP_SUCCESS) {
         sprintf(info_string, "Error loading Dsp %s", PRINT_NON_NULL(filename));
         dxp_log_error("dxp_replace_dspconfig", info_string, status);
@@ -1830,6 +1959,42 @@ int XERXES_API dxp_upload_dspparams(int* detChan) {
     return DXP_SUCCESS;
 }
 
+/*
+ * Writes any DSP parameters that the device is holding back for the
+ * designated detector channel. Devices that write parameters through
+ * immediately have nothing to flush.
+ *
+ * int *detChan;					Input: detector channel to flush
+ */
+int XERXES_API dxp_flush_dspparams(int* detChan) {
+    int status;
+    int ioChan, modChan;
+
+    Board* chosen = NULL;
+
+    if ((status = dxp_det_to_elec(detChan, &chosen, &modChan)) != DXP_SUCCESS) {
+        sprintf(info_string, "Error finding detector number %d", *detChan);
+        dxp_log_error("dxp_flush_dspparams", info_string, status);
+        return status;
+    }
+
+    if (chosen->btype->funcs->dxp_flush_dspparams == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    ioChan = chosen->ioChan;
+
+    status = chosen->btype->funcs->dxp_flush_dspparams(&ioChan, &modChan, chosen);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error flushing DSP parameters for detector %d", *detChan);
+        dxp_log_error("dxp_flush_dspparams", info_string, status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Routine to return the length of the spectrum memory.
  *
@@ -1920,7 +2085,7 @@ int XERXES_API dxp_start_run(unsigned short* gate, unsigned short* resume) {
 
     int ioChan, detChan, runactive;
     /* Pointer to the current Board */
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     /* gate value, if NULL is passed, use the XerXes stored value */
     unsigned short my_gate;
@@ -2170,7 +2335,7 @@ int XERXES_API dxp_isrunning_any(int* detChan, int* ret) {
     int status = DXP_SUCCESS;
     int runactive, i;
     /* Pointer to the Chosen Channel */
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     /* Initialize */
     *detChan = -1;
@@ -2562,6 +2727,117 @@ int XERXES_API dxp_set_one_dspsymbol(int* detChan, char* name, unsigned short* v
     return status;
 }
 
+/*
+ * Writes n consecutive DSP parameters, starting with the one at index first,
+ * in the order of dxp_symbolname_by_index(). Devices that can write a block
+ * of parameter memory in one transfer do so. Every other device writes the
+ * parameters one at a time, where a device that defers writes still
+ * coalesces them when it flushes.
+ *
+ * int *detChan;				Input: Detector channel to write to
+ * unsigned short *first;		Input: index of the first parameter
+ * unsigned short *n;			Input: number of parameters to write
+ * unsigned short *values;		Input: n values to write
+ */
+int XERXES_API dxp_write_dspsymbols(int* detChan, unsigned short* first,
+                                    unsigned short* n, unsigned short* values) {
+    int status;
+    int ioChan, modChan;
+    int runstat = 0;
+
+    unsigned short i;
+    unsigned short nsymbol;
+
+    char name[MAX_DSP_PARAM_NAME_LEN];
+
+    Board* chosen = NULL;
+
+    if (!detChan || !first || !n || !values) {
+        dxp_log_error("dxp_write_dspsymbols", "Passed in reference is NULL", DXP_NULL);
+        return DXP_NULL;
+    }
+
+    if ((status = dxp_det_to_elec(detChan, &chosen, &modChan)) != DXP_SUCCESS) {
+        sprintf(info_string, "Failed to locate detector channel %d", *detChan);
+        dxp_log_error("dxp_write_dspsymbols", info_string, status);
+        return status;
+    }
+
+    ioChan = chosen->ioChan;
+
+    status = chosen->btype->funcs->dxp_get_num_params(modChan, chosen, &nsymbol);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error getting number of parameters for detChan = %d",
+                *detChan);
+        dxp_log_error("dxp_write_dspsymbols", info_string, status);
+        return status;
+    }
+
+    if (*first >= nsymbol || *n > nsymbol - *first) {
+        status = DXP_NOSYMBOL;
+        sprintf(info_string,
+                "Parameters %hu to %u are out of range for detChan %d, which has %hu",
+                *first, (unsigned int) (*first + *n), *detChan, nsymbol);
+        dxp_log_error("dxp_write_dspsymbols", info_string, status);
+        return status;
+    }
+
+    if ((status = dxp_isrunning(detChan, &runstat)) != DXP_SUCCESS) {
+        sprintf(info_string, "Failed to determine the run status of detChan %d",
+                *detChan);
+        dxp_log_error("dxp_write_dspsymbols", info_string, status);
+        return status;
+    }
+
+    if (runstat != 0) {
+        status = DXP_RUNACTIVE;
+        sprintf(info_string,
+                "You must stop the run before modifying DSP parameters for detChan %d"
+                ", runstat = %#x",
+                *detChan, runstat);
+        dxp_log_error("dxp_write_dspsymbols", info_string, status);
+        return status;
+    }
+
+    if (chosen->btype->funcs->dxp_write_dspsymbols != NULL) {
+        status = chosen->btype->funcs->dxp_write_dspsymbols(&ioChan, &modChan, chosen,
+                                                            *first, *n, values);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error writing %hu parameters starting at %hu",
+                    *n, *first);
+            dxp_log_error("dxp_write_dspsymbols", info_string, status);
+            return status;
+        }
+
+        return DXP_SUCCESS;
+    }
+
+    for (i = 0; i < *n; i++) {
+        status = chosen->btype->funcs->dxp_get_symbol_by_index(
+            modChan, (unsigned short) (*first + i), chosen, name);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error getting name of symbol located at index %u",
+                    (unsigned int) (*first + i));
+            dxp_log_error("dxp_write_dspsymbols", info_string, status);
+            return status;
+        }
+
+        status = chosen->btype->funcs->dxp_modify_dspsymbol(&ioChan, &modChan, name,
+                                                            &values[i], chosen);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error writing parameter %s", name);
+            dxp_log_error("dxp_write_dspsymbols", info_string, status);
+            return status;
+        }
+    }
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Returns the DSP parameter name located at the specified index.
  *
@@ -2637,8 +2913,11 @@ int XERXES_API dxp_symbolname_limits(int* detChan, unsigned short* access,
     int status = DXP_SUCCESS;
     int modChan;
     unsigned short i;
+    unsigned short nsymbol;
+    unsigned long addr;
     /* Pointer to the Chosen Channel */
     Board* chosen = NULL;
+    Parameter* param;
 
     /* Translate the detector channel number to IO and channel numbers for writing. */
 
@@ -2648,25 +2927,35 @@ int XERXES_API dxp_symbolname_limits(int* detChan, unsigned short* access,
         return status;
     }
 
-    /* Was Memory allocated for the access list? */
-    if (access != NULL) {
-        /* Copy the list of access information */
-        for (i = 0; i < chosen->dsp[modChan]->params->nsymbol; i++)
-            access[i] = chosen->dsp[modChan]->params->parameters[i].access;
-    }
+    status = chosen->btype->funcs->dxp_get_num_params(modChan, chosen, &nsymbol);
 
-    /* Was Memory allocated for the lower bounds list? */
-    if (lbound != NULL) {
-        /* Copy the list of lower bounds information */
-        for (i = 0; i < chosen->dsp[modChan]->params->nsymbol; i++)
-            lbound[i] = chosen->dsp[modChan]->params->parameters[i].lbound;
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error getting number of parameters for detChan = %d",
+                *detChan);
+        dxp_log_error("dxp_symbolname_limits", info_string, status);
+        return status;
     }
 
-    /* Was Memory allocated for the upper bounds list? */
-    if (ubound != NULL) {
-        /* Copy the list of upper bounds information */
-        for (i = 0; i < chosen->dsp[modChan]->params->nsymbol; i++)
-            ubound[i] = chosen->dsp[modChan]->params->parameters[i].ubound;
+    /* Copy the limits of every symbol, global and per-channel alike. */
+    for (i = 0; i < nsymbol; i++) {
+        param = dxp_dsp_symbol(chosen, modChan, i, &addr);
+
+        if (param == NULL) {
+            status = DXP_NOSYMBOL;
+            sprintf(info_string, "No DSP parameter at index %hu for detChan %d", i,
+                    *detChan);
+            dxp_log_error("dxp_symbolname_limits", info_string, status);
+            return status;
+        }
+
+        if (access != NULL)
+            access[i] = param->access;
+
+        if (lbound != NULL)
+            lbound[i] = param->lbound;
+
+        if (ubound != NULL)
+            ubound[i] = param->ubound;
     }
 
     return status;
@@ -2855,7 +3144,7 @@ int XERXES_API dxp_det_to_elec(int* detChan, Board** passed, int* dxpChan) {
     int status;
 
     /* Point the current Board to the first Board in the system */
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     /* Loop through the Boards to find which module we desire */
 
@@ -2888,7 +3177,7 @@ int XERXES_API dxp_det_to_elec(int* detChan, Board** passed, int* dxpChan) {
 int XERXES_API dxp_elec_to_det(int* ioChan, int* dxpChan, int* detChan) {
     int status;
     /* Pointer to current Board */
-    Board* current = system_head;
+    Board* current = xs->system_head;
 
     /* Only support up to 4 channels per module. */
 
@@ -3138,6 +3427,100 @@ XERXES_EXPORT int XERXES_API dxp_set_io_priority(int* priority) {
     return DXP_SUCCESS;
 }
 
+/*
+ * Sets the scheduling of the threads that perform I/O. params holds the
+ * priority, the CPU to pin the threads to or -1, and the MD_IO_SCHED_*
+ * flags.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_io_scheduling(int* policy, int* params) {
+    int status;
+
+    if (policy == NULL || params == NULL) {
+        dxp_log_error("dxp_set_io_scheduling", "'policy' and 'params' may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    status = xerxes_md_set_scheduling(*policy, params[0], params[1], params[2]);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_set_io_scheduling", "Error setting I/O scheduling", status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Sets how parsed DSP files are cached. See the DXP_DSP_CACHE_* constants.
+ * The in-memory cache outlives dxp_init_ds() so that repeated system
+ * initializations only parse each distinct DSP file once per process.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_dsp_cache(int* mode) {
+    int status;
+
+    if (mode == NULL) {
+        dxp_log_error("dxp_set_dsp_cache", "'mode' may not be NULL", DXP_NULL);
+        return DXP_NULL;
+    }
+
+    status = dxp_dsp_cache_set_mode(*mode);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_set_dsp_cache", "Error setting the DSP cache mode", status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Sets how the devices poll for an operation of the given DXP_WAIT_*
+ * type to complete. profile holds the spin time, the first sleep interval
+ * and the longest sleep interval, in seconds.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_wait_profile(int* type, double* profile) {
+    int status;
+
+    if (type == NULL || profile == NULL) {
+        dxp_log_error("dxp_set_wait_profile", "'type' and 'profile' may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    status = dxp_wait_set_profile(*type, profile[0], profile[1], profile[2]);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_set_wait_profile", "Error setting the wait profile", status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Returns the completion time histogram for the given DXP_WAIT_* type.
+ * histogram must hold DXP_WAIT_HISTOGRAM_BINS entries.
+ */
+XERXES_EXPORT int XERXES_API dxp_get_wait_stats(int* type, unsigned long* histogram) {
+    int status;
+
+    if (type == NULL || histogram == NULL) {
+        dxp_log_error("dxp_get_wait_stats", "'type' and 'histogram' may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    status = dxp_wait_get_stats(*type, histogram);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_wait_stats", "Error reading the wait statistics", status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Calls the appropriate exit handler for the specified
  * board type.
@@ -3191,6 +3574,7 @@ static int XERXES_API dxp_parse_memory_str(char* name, char* type, unsigned long
     char* mem_delim = ":";
     char* full_name = NULL;
     char* tok = NULL;
+    char* save = NULL;
 
     ASSERT(name != NULL);
     ASSERT(type != NULL);
@@ -3207,7 +3591,7 @@ static int XERXES_API dxp_parse_memory_str(char* name, char* type, unsigned long
 
     strncpy(full_name, name, name_len);
 
-    tok = strtok(full_name, mem_delim);
+    tok = XIA_STRTOK(full_name, mem_delim, &save);
 
     if (tok == NULL) {
         sprintf(info_string, "Memory string '%s' is improperly formatted", name);
@@ -3217,7 +3601,7 @@ static int XERXES_API dxp_parse_memory_str(char* name, char* type, unsigned long
 
     strncpy(type, tok, strlen(tok) + 1);
 
-    tok = strtok(NULL, mem_delim);
+    tok = XIA_STRTOK(NULL, mem_delim, &save);
 
     if (tok == NULL) {
         sprintf(info_string, "Memory string '%s' is improperly formatted", name);
@@ -3233,7 +3617,7 @@ static int XERXES_API dxp_parse_memory_str(char* name, char* type, unsigned long
         return DXP_INVALID_STRING;
     }
 
-    tok = strtok(NULL, mem_delim);
+    tok = XIA_STRTOK(NULL, mem_delim, &save);
 
     if (tok == NULL) {
         sprintf(info_string, "Memory string '%s' is improperly formatted", name);
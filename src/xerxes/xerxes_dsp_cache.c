@@ -0,0 +1,612 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xerxes_dsp_cache.c
+ * @brief Process lifetime cache of parsed DSP files with an optional disk tier.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "md_generic.h"
+#include "xerxes_errors.h"
+#include "xerxes_structures.h"
+#include "xia_xerxes.h"
+#include "xia_xerxes_structures.h"
+
+#include "xia_assert.h"
+#include "xia_common.h"
+#include "xia_file.h"
+
+#include "md_threads.h"
+#include "xerxes_dsp_cache.h"
+
+#include <util/xia_crc.h>
+
+#define DSP_CACHE_MAGIC 0x43535844 /* "DXSC" */
+#define DSP_CACHE_VERSION 1
+
+/*
+ * A single symbol table entry. Kept in fixed size records so that the
+ * whole table can be written and read back in one operation.
+ */
+typedef struct {
+    char pname[MAX_DSP_PARAM_NAME_LEN];
+    uint32_t address;
+    uint16_t access;
+    uint16_t lbound;
+    uint16_t ubound;
+} DspCacheSymbol;
+
+/*
+ * Header of an on-disk cache file. The data words, channel offsets and
+ * symbols follow in that order.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t crc;
+    uint32_t size;
+    uint32_t proglen;
+    uint16_t nsymbol;
+    uint16_t n_per_chan_symbols;
+    uint16_t n_chan_offsets;
+    uint16_t symbol_size;
+} DspCacheHeader;
+
+typedef struct DspCacheEntry {
+    char btype[MAXBOARDNAME_LEN];
+    DspCacheHeader hdr;
+    uint16_t* data;
+    uint32_t* chan_offsets;
+    /* nsymbol global symbols followed by n_per_chan_symbols per channel symbols. */
+    DspCacheSymbol* symbols;
+    struct DspCacheEntry* next;
+} DspCacheEntry;
+
+static int dxp_dsp_cache_load_locked(Board_Info* board, Dsp_Info* dsp);
+static void dxp_dsp_cache_clear_locked(void);
+static int dxp_dsp_cache_hash(char* filename, uint32_t* crc, uint32_t* size);
+static DspCacheEntry* dxp_dsp_cache_find(char* btype, uint32_t crc, uint32_t size);
+static DspCacheEntry* dxp_dsp_cache_new(char* btype, DspCacheHeader* hdr);
+static void dxp_dsp_cache_free_entry(DspCacheEntry* entry);
+static int dxp_dsp_cache_copy_out(DspCacheEntry* entry, Dsp_Info* dsp);
+static DspCacheEntry* dxp_dsp_cache_copy_in(char* btype, uint32_t crc, uint32_t size,
+                                            Dsp_Info* dsp);
+static void dxp_dsp_cache_disk_name(char* btype, uint32_t crc, uint32_t size,
+                                    char* name, size_t len);
+static DspCacheEntry* dxp_dsp_cache_disk_read(char* btype, uint32_t crc,
+                                              uint32_t size);
+static void dxp_dsp_cache_disk_write(DspCacheEntry* entry);
+
+static int cache_mode = DXP_DSP_CACHE_MEMORY;
+static DspCacheEntry* cache_head = NULL;
+
+/* Guards cache_mode and cache_head, which every context shares. */
+static handel_md_Mutex cacheLock = {NULL, "xerxes_dsp_cache"};
+
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
+
+/*
+ * Creates the cache lock. Called from dxp_init_library(), before any DSP
+ * can be loaded.
+ */
+int dxp_dsp_cache_init(void) {
+    if (handel_md_mutex_ready(&cacheLock)) {
+        return DXP_SUCCESS;
+    }
+
+    if (handel_md_mutex_create(&cacheLock) != THREADING_NO_ERROR) {
+        dxp_log_error("dxp_dsp_cache_init", "Error creating the DSP cache lock",
+                      DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Loads the DSP program and symbols for dsp, either from the cache or by
+ * asking the device to parse dsp->filename.
+ *
+ * Entries are keyed by the board type, since each device has its own file
+ * format, and by the CRC32 and size of the file contents. Renamed or copied
+ * files therefore still hit and edited files always miss.
+ *
+ * The cache lock is held for the whole load, so when two threads load the
+ * same file it is parsed once and the second thread copies it out.
+ */
+int dxp_dsp_cache_load(Board_Info* board, Dsp_Info* dsp) {
+    int status;
+
+    handel_md_mutex_lock(&cacheLock);
+    status = dxp_dsp_cache_load_locked(board, dsp);
+    handel_md_mutex_unlock(&cacheLock);
+
+    return status;
+}
+
+static int dxp_dsp_cache_load_locked(Board_Info* board, Dsp_Info* dsp) {
+    int status;
+
+    uint32_t crc = 0;
+    uint32_t size = 0;
+
+    DspCacheEntry* entry = NULL;
+
+    ASSERT(board != NULL);
+    ASSERT(dsp != NULL);
+
+    if (cache_mode == DXP_DSP_CACHE_OFF || dsp->maxproglen == 0) {
+        return board->funcs->dxp_get_dspconfig(dsp);
+    }
+
+    /* Let the device report the file error, if any, through its own parser. */
+    status = dxp_dsp_cache_hash(dsp->filename, &crc, &size);
+
+    if (status != DXP_SUCCESS) {
+        return board->funcs->dxp_get_dspconfig(dsp);
+    }
+
+    entry = dxp_dsp_cache_find(board->name, crc, size);
+
+    if (entry == NULL && cache_mode == DXP_DSP_CACHE_DISK) {
+        entry = dxp_dsp_cache_disk_read(board->name, crc, size);
+
+        if (entry != NULL) {
+            entry->next = cache_head;
+            cache_head = entry;
+        }
+    }
+
+    if (entry != NULL) {
+        status = dxp_dsp_cache_copy_out(entry, dsp);
+
+        if (status == DXP_SUCCESS) {
+            sprintf(info_string, "Loaded '%s' from the DSP cache (crc = %#08x)",
+                    dsp->filename, crc);
+            dxp_log_info("dxp_dsp_cache_load", info_string);
+            return DXP_SUCCESS;
+        }
+
+        sprintf(info_string, "Cached copy of '%s' does not fit, parsing the file",
+                dsp->filename);
+        dxp_log_warning("dxp_dsp_cache_load", info_string);
+    }
+
+    status = board->funcs->dxp_get_dspconfig(dsp);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    entry = dxp_dsp_cache_copy_in(board->name, crc, size, dsp);
+
+    if (entry == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    entry->next = cache_head;
+    cache_head = entry;
+
+    if (cache_mode == DXP_DSP_CACHE_DISK) {
+        dxp_dsp_cache_disk_write(entry);
+    }
+
+    sprintf(info_string, "Added '%s' to the DSP cache (crc = %#08x)", dsp->filename,
+            crc);
+    dxp_log_debug("dxp_dsp_cache_load", info_string);
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Sets the cache mode to one of the DXP_DSP_CACHE_* constants. Turning the
+ * cache off releases the in-memory entries. Files already written to the
+ * temporary directory are left alone.
+ */
+int dxp_dsp_cache_set_mode(int mode) {
+    if (mode != DXP_DSP_CACHE_OFF && mode != DXP_DSP_CACHE_MEMORY &&
+        mode != DXP_DSP_CACHE_DISK) {
+        sprintf(info_string, "Unknown DSP cache mode %d", mode);
+        dxp_log_error("dxp_dsp_cache_set_mode", info_string, DXP_BAD_PARAM);
+        return DXP_BAD_PARAM;
+    }
+
+    handel_md_mutex_lock(&cacheLock);
+
+    if (mode == DXP_DSP_CACHE_OFF) {
+        dxp_dsp_cache_clear_locked();
+    }
+
+    cache_mode = mode;
+
+    handel_md_mutex_unlock(&cacheLock);
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Frees all of the in-memory cache entries.
+ */
+void dxp_dsp_cache_clear(void) {
+    handel_md_mutex_lock(&cacheLock);
+    dxp_dsp_cache_clear_locked();
+    handel_md_mutex_unlock(&cacheLock);
+}
+
+static void dxp_dsp_cache_clear_locked(void) {
+    DspCacheEntry* current = cache_head;
+
+    while (current != NULL) {
+        DspCacheEntry* next = current->next;
+        dxp_dsp_cache_free_entry(current);
+        current = next;
+    }
+
+    cache_head = NULL;
+}
+
+/*
+ * Computes the CRC32 and size of the file contents.
+ */
+static int dxp_dsp_cache_hash(char* filename, uint32_t* crc, uint32_t* size) {
+    unsigned char buf[4096];
+    size_t n;
+    uint32_t total = 0;
+
+    FILE* fp = NULL;
+
+    ASSERT(filename != NULL);
+
+    fp = xia_find_file(filename, "rb");
+
+    if (fp == NULL) {
+        return DXP_OPEN_FILE;
+    }
+
+    *crc = 0;
+
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        *crc = xia_crc32(*crc, buf, (int) n);
+        total += (uint32_t) n;
+    }
+
+    xia_file_close(fp);
+
+    *size = total;
+
+    return DXP_SUCCESS;
+}
+
+static DspCacheEntry* dxp_dsp_cache_find(char* btype, uint32_t crc, uint32_t size) {
+    DspCacheEntry* current = cache_head;
+
+    while (current != NULL) {
+        if (current->hdr.crc == crc && current->hdr.size == size &&
+            STREQ(current->btype, btype)) {
+            return current;
+        }
+        current = current->next;
+    }
+
+    return NULL;
+}
+
+/*
+ * Allocates an entry sized for the counts in hdr.
+ */
+static DspCacheEntry* dxp_dsp_cache_new(char* btype, DspCacheHeader* hdr) {
+    size_t n_symbols = (size_t) hdr->nsymbol + hdr->n_per_chan_symbols;
+
+    DspCacheEntry* entry = (DspCacheEntry*) xerxes_md_alloc(sizeof(DspCacheEntry));
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    memset(entry, 0, sizeof(DspCacheEntry));
+    strncpy(entry->btype, btype, sizeof(entry->btype) - 1);
+    entry->hdr = *hdr;
+
+    entry->data = (uint16_t*) xerxes_md_alloc((hdr->proglen + 1) * sizeof(uint16_t));
+    entry->chan_offsets =
+        (uint32_t*) xerxes_md_alloc((hdr->n_chan_offsets + 1) * sizeof(uint32_t));
+    entry->symbols =
+        (DspCacheSymbol*) xerxes_md_alloc((n_symbols + 1) * sizeof(DspCacheSymbol));
+
+    if (entry->data == NULL || entry->chan_offsets == NULL || entry->symbols == NULL) {
+        sprintf(info_string, "Error allocating DSP cache entry with %u words",
+                hdr->proglen);
+        dxp_log_error("dxp_dsp_cache_new", info_string, DXP_NOMEM);
+        dxp_dsp_cache_free_entry(entry);
+        return NULL;
+    }
+
+    memset(entry->symbols, 0, (n_symbols + 1) * sizeof(DspCacheSymbol));
+
+    return entry;
+}
+
+static void dxp_dsp_cache_free_entry(DspCacheEntry* entry) {
+    if (entry == NULL) {
+        return;
+    }
+
+    if (entry->data != NULL) {
+        xerxes_md_free(entry->data);
+    }
+
+    if (entry->chan_offsets != NULL) {
+        xerxes_md_free(entry->chan_offsets);
+    }
+
+    if (entry->symbols != NULL) {
+        xerxes_md_free(entry->symbols);
+    }
+
+    xerxes_md_free(entry);
+}
+
+/*
+ * Fills in a freshly allocated Dsp_Info from the cache entry. Returns
+ * DXP_MALFORMED_FILE if the entry doesn't fit in the limits the device
+ * reported through dxp_get_dspinfo().
+ */
+static int dxp_dsp_cache_copy_out(DspCacheEntry* entry, Dsp_Info* dsp) {
+    unsigned int i;
+
+    Dsp_Params* params = dsp->params;
+    DspCacheSymbol* sym = entry->symbols;
+
+    if (entry->hdr.proglen > dsp->maxproglen || entry->hdr.nsymbol > params->maxsym ||
+        entry->hdr.n_per_chan_symbols > params->maxsym ||
+        params->maxsymlen > MAX_DSP_PARAM_NAME_LEN) {
+        return DXP_MALFORMED_FILE;
+    }
+
+    if (entry->hdr.n_chan_offsets > 0) {
+        params->chan_offsets = (unsigned long*) xerxes_md_alloc(
+            entry->hdr.n_chan_offsets * sizeof(unsigned long));
+
+        if (params->chan_offsets == NULL) {
+            sprintf(info_string, "Error allocating %zu bytes for 'chan_offsets'",
+                    entry->hdr.n_chan_offsets * sizeof(unsigned long));
+            dxp_log_error("dxp_dsp_cache_copy_out", info_string, DXP_NOMEM);
+            return DXP_NOMEM;
+        }
+
+        for (i = 0; i < entry->hdr.n_chan_offsets; i++) {
+            params->chan_offsets[i] = entry->chan_offsets[i];
+        }
+    }
+
+    params->n_chan_offsets = entry->hdr.n_chan_offsets;
+
+    memcpy(dsp->data, entry->data, entry->hdr.proglen * sizeof(unsigned short));
+    dsp->proglen = entry->hdr.proglen;
+
+    params->nsymbol = entry->hdr.nsymbol;
+    params->n_per_chan_symbols = entry->hdr.n_per_chan_symbols;
+
+    for (i = 0; i < entry->hdr.nsymbol; i++, sym++) {
+        strncpy(params->parameters[i].pname, sym->pname, params->maxsymlen - 1);
+        params->parameters[i].pname[params->maxsymlen - 1] = '\0';
+        params->parameters[i].address = sym->address;
+        params->parameters[i].access = sym->access;
+        params->parameters[i].lbound = sym->lbound;
+        params->parameters[i].ubound = sym->ubound;
+    }
+
+    for (i = 0; i < entry->hdr.n_per_chan_symbols; i++, sym++) {
+        strncpy(params->per_chan_parameters[i].pname, sym->pname,
+                params->maxsymlen - 1);
+        params->per_chan_parameters[i].pname[params->maxsymlen - 1] = '\0';
+        params->per_chan_parameters[i].address = sym->address;
+        params->per_chan_parameters[i].access = sym->access;
+        params->per_chan_parameters[i].lbound = sym->lbound;
+        params->per_chan_parameters[i].ubound = sym->ubound;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Builds a cache entry from a Dsp_Info that was just parsed by the device.
+ * Returns NULL if the DSP can't be cached, e.g. the device allocated channel
+ * offsets without recording how many there are.
+ */
+static DspCacheEntry* dxp_dsp_cache_copy_in(char* btype, uint32_t crc, uint32_t size,
+                                            Dsp_Info* dsp) {
+    unsigned int i;
+
+    DspCacheHeader hdr;
+    DspCacheEntry* entry = NULL;
+    DspCacheSymbol* sym = NULL;
+
+    Dsp_Params* params = dsp->params;
+
+    if (params->chan_offsets != NULL && params->n_chan_offsets == 0) {
+        sprintf(info_string, "Not caching '%s': unknown number of channel offsets",
+                dsp->filename);
+        dxp_log_debug("dxp_dsp_cache_copy_in", info_string);
+        return NULL;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = DSP_CACHE_MAGIC;
+    hdr.version = DSP_CACHE_VERSION;
+    hdr.crc = crc;
+    hdr.size = size;
+    hdr.proglen = (uint32_t) dsp->proglen;
+    hdr.nsymbol = params->nsymbol;
+    hdr.n_per_chan_symbols = params->n_per_chan_symbols;
+    hdr.n_chan_offsets = params->chan_offsets != NULL ? params->n_chan_offsets : 0;
+    hdr.symbol_size = (uint16_t) sizeof(DspCacheSymbol);
+
+    entry = dxp_dsp_cache_new(btype, &hdr);
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    memcpy(entry->data, dsp->data, dsp->proglen * sizeof(unsigned short));
+
+    for (i = 0; i < hdr.n_chan_offsets; i++) {
+        entry->chan_offsets[i] = (uint32_t) params->chan_offsets[i];
+    }
+
+    sym = entry->symbols;
+
+    for (i = 0; i < hdr.nsymbol; i++, sym++) {
+        strncpy(sym->pname, params->parameters[i].pname, sizeof(sym->pname) - 1);
+        sym->address = params->parameters[i].address;
+        sym->access = params->parameters[i].access;
+        sym->lbound = params->parameters[i].lbound;
+        sym->ubound = params->parameters[i].ubound;
+    }
+
+    for (i = 0; i < hdr.n_per_chan_symbols; i++, sym++) {
+        strncpy(sym->pname, params->per_chan_parameters[i].pname,
+                sizeof(sym->pname) - 1);
+        sym->address = params->per_chan_parameters[i].address;
+        sym->access = params->per_chan_parameters[i].access;
+        sym->lbound = params->per_chan_parameters[i].lbound;
+        sym->ubound = params->per_chan_parameters[i].ubound;
+    }
+
+    return entry;
+}
+
+/*
+ * Cache files live in the MD temporary path. The name carries the full key so
+ * that stale files are simply never looked up.
+ */
+static void dxp_dsp_cache_disk_name(char* btype, uint32_t crc, uint32_t size,
+                                    char* name, size_t len) {
+    char* tmp_path = xerxes_md_tmp_path();
+    char* sep = xerxes_md_path_separator();
+
+    size_t tmp_len = strlen(tmp_path);
+
+    if (tmp_len > 0 && (tmp_path[tmp_len - 1] == '/' || tmp_path[tmp_len - 1] == '\\')) {
+        sep = "";
+    }
+
+    snprintf(name, len, "%s%sxia_dsp_%s_%08x_%u.dsc", tmp_path, sep, btype, crc, size);
+}
+
+static DspCacheEntry* dxp_dsp_cache_disk_read(char* btype, uint32_t crc,
+                                              uint32_t size) {
+    char name[MAXFILENAME_LEN];
+    size_t n_symbols;
+
+    DspCacheHeader hdr;
+    DspCacheEntry* entry = NULL;
+
+    FILE* fp = NULL;
+
+    dxp_dsp_cache_disk_name(btype, crc, size, name, sizeof(name));
+
+    fp = xia_file_open(name, "rb");
+
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != DSP_CACHE_MAGIC ||
+        hdr.version != DSP_CACHE_VERSION || hdr.crc != crc || hdr.size != size ||
+        hdr.symbol_size != sizeof(DspCacheSymbol)) {
+        xia_file_close(fp);
+        sprintf(info_string, "Ignoring invalid DSP cache file '%s'", name);
+        dxp_log_warning("dxp_dsp_cache_disk_read", info_string);
+        return NULL;
+    }
+
+    entry = dxp_dsp_cache_new(btype, &hdr);
+
+    if (entry == NULL) {
+        xia_file_close(fp);
+        return NULL;
+    }
+
+    n_symbols = (size_t) hdr.nsymbol + hdr.n_per_chan_symbols;
+
+    if (fread(entry->data, sizeof(uint16_t), hdr.proglen, fp) != hdr.proglen ||
+        fread(entry->chan_offsets, sizeof(uint32_t), hdr.n_chan_offsets, fp) !=
+            hdr.n_chan_offsets ||
+        fread(entry->symbols, sizeof(DspCacheSymbol), n_symbols, fp) != n_symbols) {
+        xia_file_close(fp);
+        dxp_dsp_cache_free_entry(entry);
+        sprintf(info_string, "Ignoring truncated DSP cache file '%s'", name);
+        dxp_log_warning("dxp_dsp_cache_disk_read", info_string);
+        return NULL;
+    }
+
+    xia_file_close(fp);
+
+    sprintf(info_string, "Read DSP cache file '%s'", name);
+    dxp_log_debug("dxp_dsp_cache_disk_read", info_string);
+
+    return entry;
+}
+
+/*
+ * Writes the entry to a scratch file and renames it into place so that a
+ * reader in another process never sees a partial file. Failures only cost
+ * the next process a parse, so they are logged as warnings.
+ */
+static void dxp_dsp_cache_disk_write(DspCacheEntry* entry) {
+    char name[MAXFILENAME_LEN];
+    char scratch[MAXFILENAME_LEN + 4];
+    size_t n_symbols = (size_t) entry->hdr.nsymbol + entry->hdr.n_per_chan_symbols;
+    boolean_t ok;
+
+    FILE* fp = NULL;
+
+    dxp_dsp_cache_disk_name(entry->btype, entry->hdr.crc, entry->hdr.size, name,
+                            sizeof(name));
+    snprintf(scratch, sizeof(scratch), "%s.tmp", name);
+
+    fp = xia_file_open(scratch, "wb");
+
+    if (fp == NULL) {
+        sprintf(info_string, "Unable to open DSP cache file '%s'", scratch);
+        dxp_log_warning("dxp_dsp_cache_disk_write", info_string);
+        return;
+    }
+
+    ok = fwrite(&entry->hdr, sizeof(entry->hdr), 1, fp) == 1 &&
+         fwrite(entry->data, sizeof(uint16_t), entry->hdr.proglen, fp) ==
+             entry->hdr.proglen &&
+         fwrite(entry->chan_offsets, sizeof(uint32_t), entry->hdr.n_chan_offsets, fp) ==
+             entry->hdr.n_chan_offsets &&
+         fwrite(entry->symbols, sizeof(DspCacheSymbol), n_symbols, fp) == n_symbols;
+
+    xia_file_close(fp);
+
+    remove(name);
+
+    if (!ok || rename(scratch, name) != 0) {
+        remove(scratch);
+        sprintf(info_string, "Unable to write DSP cache file '%s'", name);
+        dxp_log_warning("dxp_dsp_cache_disk_write", info_string);
+    }
+}
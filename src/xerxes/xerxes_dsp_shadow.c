@@ -0,0 +1,456 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xerxes_dsp_shadow.c
+ * @brief Host shadow of DSP parameter memory with coalesced writes.
+ *
+ * Each channel of a board has a Dsp_Shadow holding the value most recently
+ * written to every parameter of its DSP code. A write that matches a valid
+ * shadow value is dropped. Any other write only updates the shadow and
+ * marks the parameter dirty. Dirty parameters reach the hardware in
+ * dxp_dsp_shadow_flush(), which the device calls before anything that lets
+ * the DSP act on its parameters, e.g. starting a run.
+ *
+ * Only values the host wrote are ever valid. A device must invalidate the
+ * shadow whenever the DSP may have changed its own parameters, which in
+ * practice means every run or control task, and whenever new DSP code is
+ * downloaded.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "md_generic.h"
+#include "xerxes_errors.h"
+#include "xerxes_structures.h"
+#include "xia_xerxes.h"
+#include "xia_xerxes_structures.h"
+
+#include "xia_assert.h"
+#include "xia_common.h"
+
+#include "xerxes_dsp_shadow.h"
+
+/* Per-parameter state bits */
+#define SHADOW_VALID 0x1
+#define SHADOW_DIRTY 0x2
+
+static Dsp_Shadow* dxp_dsp_shadow_get(Board* board, int modChan);
+static void dxp_dsp_shadow_release(Dsp_Shadow* shadow);
+
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
+
+/*
+ * Records value as the new value of the parameter at index. The hardware is
+ * not written until the next flush. Returns DXP_NOMEM if the shadow could not
+ * be allocated, in which case the caller should write through.
+ */
+int dxp_dsp_shadow_write(Board* board, int modChan, unsigned short index,
+                         unsigned short value) {
+    Dsp_Shadow* shadow = dxp_dsp_shadow_get(board, modChan);
+
+    if (shadow == NULL) {
+        return DXP_NOMEM;
+    }
+
+    ASSERT(index < shadow->nsymbol);
+
+    if ((shadow->state[index] & SHADOW_VALID) && shadow->values[index] == value) {
+        return DXP_SUCCESS;
+    }
+
+    shadow->values[index] = value;
+
+    if (!(shadow->state[index] & SHADOW_DIRTY)) {
+        shadow->ndirty++;
+    }
+
+    shadow->state[index] = SHADOW_VALID | SHADOW_DIRTY;
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Returns TRUE_ and sets value if the parameter at index was written by the
+ * host since the shadow was last invalidated.
+ */
+boolean_t dxp_dsp_shadow_read(Board* board, int modChan, unsigned short index,
+                              unsigned short* value) {
+    Dsp_Shadow* shadow;
+
+    ASSERT(board != NULL);
+    ASSERT(value != NULL);
+
+    if (board->shadow == NULL || modChan == ALLCHAN) {
+        return FALSE_;
+    }
+
+    shadow = &board->shadow[modChan];
+
+    if (shadow->dsp != board->dsp[modChan] || index >= shadow->nsymbol ||
+        !(shadow->state[index] & SHADOW_VALID)) {
+        return FALSE_;
+    }
+
+    *value = shadow->values[index];
+    return TRUE_;
+}
+
+/*
+ * Writes all dirty parameters of modChan, or of every channel for ALLCHAN,
+ * to the hardware.
+ *
+ * Dirty parameters at consecutive DSP addresses are written as one block.
+ * Runs are allowed to span clean parameters that hold a valid value, since
+ * rewriting a known value is cheaper than starting a new transfer.
+ */
+int dxp_dsp_shadow_flush(Board* board, int* ioChan, int* modChan,
+                         DXP_WRITE_PARAM_BLOCK write) {
+    int status;
+
+    unsigned short i;
+    unsigned short first;
+    unsigned short last;
+    unsigned short nwritten = 0;
+    unsigned short nblocks = 0;
+
+    Dsp_Shadow* shadow;
+    Parameter* params;
+
+    ASSERT(board != NULL);
+    ASSERT(modChan != NULL);
+    ASSERT(write != NULL);
+
+    if (board->shadow == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    if (*modChan == ALLCHAN) {
+        int chan;
+
+        for (chan = 0; chan < (int) board->nchan; chan++) {
+            status = dxp_dsp_shadow_flush(board, ioChan, &chan, write);
+
+            if (status != DXP_SUCCESS) {
+                return status;
+            }
+        }
+
+        return DXP_SUCCESS;
+    }
+
+    shadow = &board->shadow[*modChan];
+
+    if (shadow->ndirty == 0 || shadow->dsp != board->dsp[*modChan]) {
+        return DXP_SUCCESS;
+    }
+
+    params = shadow->dsp->params->parameters;
+
+    for (i = 0; i < shadow->nsymbol; i++) {
+        if (!(shadow->state[i] & SHADOW_DIRTY)) {
+            continue;
+        }
+
+        first = i;
+        last = i;
+
+        while ((unsigned short) (i + 1) < shadow->nsymbol &&
+               (shadow->state[i + 1] & SHADOW_VALID) &&
+               params[i + 1].address == params[i].address + 1) {
+            i++;
+
+            if (shadow->state[i] & SHADOW_DIRTY) {
+                last = i;
+            }
+        }
+
+        status = write(ioChan, modChan, params[first].address,
+                       (unsigned int) (last - first + 1), &shadow->values[first]);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string,
+                    "Error writing %hu DSP parameters starting at %#x for "
+                    "module %d channel %d",
+                    (unsigned short) (last - first + 1), params[first].address,
+                    board->mod, *modChan);
+            dxp_log_error("dxp_dsp_shadow_flush", info_string, status);
+            return status;
+        }
+
+        for (; first <= last; first++) {
+            if (shadow->state[first] & SHADOW_DIRTY) {
+                shadow->state[first] &= ~SHADOW_DIRTY;
+                shadow->ndirty--;
+                nwritten++;
+            }
+        }
+
+        nblocks++;
+        i = last;
+    }
+
+    sprintf(info_string, "Wrote %hu DSP parameters in %hu blocks for module %d channel %d",
+            nwritten, nblocks, board->mod, *modChan);
+    dxp_log_debug("dxp_dsp_shadow_flush", info_string);
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Forgets every shadowed value of modChan, including unflushed writes.
+ * Pass ALLCHAN to invalidate every channel of the board.
+ */
+void dxp_dsp_shadow_invalidate(Board* board, int modChan) {
+    unsigned int i;
+
+    ASSERT(board != NULL);
+
+    if (board->shadow == NULL) {
+        return;
+    }
+
+    for (i = 0; i < board->nchan; i++) {
+        if (modChan == ALLCHAN || (int) i == modChan) {
+            if (board->shadow[i].state != NULL) {
+                memset(board->shadow[i].state, 0, board->shadow[i].nsymbol);
+            }
+
+            board->shadow[i].ndirty = 0;
+        }
+    }
+}
+
+/*
+ * Releases every channel's shadow for board.
+ */
+void dxp_dsp_shadow_free(Board* board) {
+    unsigned int i;
+
+    ASSERT(board != NULL);
+
+    if (board->shadow == NULL) {
+        return;
+    }
+
+    for (i = 0; i < board->nchan; i++) {
+        dxp_dsp_shadow_release(&board->shadow[i]);
+    }
+
+    xerxes_md_free(board->shadow);
+    board->shadow = NULL;
+}
+
+/*
+ * Returns the symbol table entry of the parameter at index for modChan, or
+ * NULL if there is none, and sets addr to its address in parameter memory.
+ *
+ * Boards with a system DSP list its global parameters first, followed by
+ * the per-channel parameters, whose addresses are offset by the channel.
+ */
+Parameter* dxp_dsp_symbol(Board* board, int modChan, unsigned short index,
+                          unsigned long* addr) {
+    Dsp_Params* params;
+    Parameter* param;
+
+    ASSERT(board != NULL);
+    ASSERT(addr != NULL);
+
+    if (board->system_dsp == NULL) {
+        if (board->dsp == NULL || board->dsp[modChan] == NULL ||
+            board->dsp[modChan]->params == NULL ||
+            index >= board->dsp[modChan]->params->nsymbol) {
+            return NULL;
+        }
+
+        param = &board->dsp[modChan]->params->parameters[index];
+        *addr = param->address;
+        return param;
+    }
+
+    params = board->system_dsp->params;
+
+    if (params == NULL) {
+        return NULL;
+    }
+
+    if (index < params->nsymbol) {
+        param = &params->parameters[index];
+        *addr = param->address;
+        return param;
+    }
+
+    index = (unsigned short) (index - params->nsymbol);
+
+    if (index >= params->n_per_chan_symbols || modChan >= params->n_chan_offsets) {
+        return NULL;
+    }
+
+    param = &params->per_chan_parameters[index];
+    *addr = param->address + params->chan_offsets[modChan];
+    return param;
+}
+
+/*
+ * Writes n consecutive DSP parameters of modChan, starting at index first,
+ * with write. Each run of parameters at consecutive addresses costs one
+ * write, and so one Transfer Address Register write on devices that reach
+ * parameter memory through the TAR/TDR pair, instead of one per parameter.
+ */
+int dxp_dsp_symbols_write(Board* board, int* ioChan, int* modChan, unsigned short first,
+                          unsigned short n, unsigned short* values,
+                          DXP_WRITE_DATA_MEMORY write) {
+    int status;
+
+    unsigned short i;
+    unsigned short start;
+
+    unsigned long addr;
+    unsigned long next = 0;
+    unsigned long base = 0;
+
+    unsigned long* data;
+
+    ASSERT(board != NULL);
+    ASSERT(ioChan != NULL);
+    ASSERT(modChan != NULL);
+    ASSERT(values != NULL);
+    ASSERT(write != NULL);
+
+    if (n == 0) {
+        return DXP_SUCCESS;
+    }
+
+    data = (unsigned long*) xerxes_md_alloc(n * sizeof(unsigned long));
+
+    if (data == NULL) {
+        sprintf(info_string, "Unable to allocate %zu bytes for 'data'",
+                n * sizeof(unsigned long));
+        dxp_log_error("dxp_dsp_symbols_write", info_string, DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    for (i = 0; i < n; i++) {
+        data[i] = (unsigned long) values[i];
+    }
+
+    for (start = 0, i = 0; i <= n; i++) {
+        if (i < n) {
+            if (dxp_dsp_symbol(board, *modChan, (unsigned short) (first + i), &addr) ==
+                NULL) {
+                xerxes_md_free(data);
+                sprintf(info_string, "No DSP parameter at index %u",
+                        (unsigned int) (first + i));
+                dxp_log_error("dxp_dsp_symbols_write", info_string, DXP_NOSYMBOL);
+                return DXP_NOSYMBOL;
+            }
+
+            if (i == 0) {
+                base = addr;
+                next = addr + 1;
+                continue;
+            }
+
+            if (addr == next) {
+                next++;
+                continue;
+            }
+        }
+
+        status = write(*ioChan, base, (unsigned long) (i - start), data + start);
+
+        if (status != DXP_SUCCESS) {
+            xerxes_md_free(data);
+            sprintf(info_string, "Error writing %hu DSP parameters to %#lx",
+                    (unsigned short) (i - start), base);
+            dxp_log_error("dxp_dsp_symbols_write", info_string, status);
+            return status;
+        }
+
+        start = i;
+        base = addr;
+        next = addr + 1;
+    }
+
+    xerxes_md_free(data);
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Returns the shadow for modChan, (re)building it if the channel's DSP code
+ * has changed since it was last used.
+ */
+static Dsp_Shadow* dxp_dsp_shadow_get(Board* board, int modChan) {
+    Dsp_Shadow* shadow;
+    Dsp_Info* dsp;
+
+    ASSERT(board != NULL);
+    ASSERT(modChan >= 0 && (unsigned int) modChan < board->nchan);
+
+    dsp = board->dsp[modChan];
+
+    if (dsp == NULL || dsp->params == NULL || dsp->params->nsymbol == 0) {
+        return NULL;
+    }
+
+    if (board->shadow == NULL) {
+        board->shadow = (Dsp_Shadow*) xerxes_md_alloc(board->nchan * sizeof(Dsp_Shadow));
+
+        if (board->shadow == NULL) {
+            return NULL;
+        }
+
+        memset(board->shadow, 0, board->nchan * sizeof(Dsp_Shadow));
+    }
+
+    shadow = &board->shadow[modChan];
+
+    if (shadow->dsp == dsp && shadow->nsymbol == dsp->params->nsymbol) {
+        return shadow;
+    }
+
+    dxp_dsp_shadow_release(shadow);
+
+    shadow->values =
+        (unsigned short*) xerxes_md_alloc(dsp->params->nsymbol * sizeof(unsigned short));
+    shadow->state = (byte_t*) xerxes_md_alloc(dsp->params->nsymbol);
+
+    if (shadow->values == NULL || shadow->state == NULL) {
+        dxp_dsp_shadow_release(shadow);
+        return NULL;
+    }
+
+    memset(shadow->state, 0, dsp->params->nsymbol);
+    shadow->nsymbol = dsp->params->nsymbol;
+    shadow->dsp = dsp;
+
+    return shadow;
+}
+
+static void dxp_dsp_shadow_release(Dsp_Shadow* shadow) {
+    if (shadow->values != NULL) {
+        xerxes_md_free(shadow->values);
+    }
+
+    if (shadow->state != NULL) {
+        xerxes_md_free(shadow->state);
+    }
+
+    memset(shadow, 0, sizeof(Dsp_Shadow));
+}
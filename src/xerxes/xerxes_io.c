@@ -37,6 +37,7 @@
 #include <stdlib.h>
 
 #include "xia_assert.h"
+#include "xia_common.h"
 #include "xia_mddef.h"
 
 #include "md_generic.h"
@@ -51,7 +52,7 @@
 XIA_MD_IMPORT int XIA_MD_API dxp_md_init_util(Xia_Util_Functions* funcs, char* type);
 
 #ifdef XERXES_TRACE_IO
-static char INFO_STRING[INFO_LEN];
+static XIA_THREAD_LOCAL char INFO_STRING[INFO_LEN];
 #endif
 
 #define MD_IO_READ 0
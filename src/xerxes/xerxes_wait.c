@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file xerxes_wait.c
+ * @brief Spin-then-backoff polling with completion time statistics.
+ *
+ * Each operation type has a profile: a spin time during which the device
+ * polls without sleeping, the first sleep interval after that, and the
+ * longest interval the doubling may reach. The defaults return from an
+ * operation that completes in about 1 ms without sleeping, and fall back
+ * to the historical 10 ms polling for long ones.
+ *
+ * Waits run concurrently on different modules, so the statistics are
+ * updated under their own lock.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "md_generic.h"
+#include "xerxes_errors.h"
+#include "xerxes_structures.h"
+#include "xia_xerxes.h"
+#include "xia_xerxes_structures.h"
+
+#include "xia_assert.h"
+#include "xia_common.h"
+
+#include "md_threads.h"
+#include "xerxes_wait.h"
+
+typedef struct {
+    double spin;
+    double interval;
+    double maxInterval;
+} Dxp_Wait_Profile;
+
+static Dxp_Wait_Profile profiles[DXP_WAIT_NUM_TYPES] = {
+    {1.0e-3, 2.5e-4, 1.0e-2}, /* DXP_WAIT_BUSY */
+    {1.0e-3, 2.5e-4, 1.0e-2}, /* DXP_WAIT_ACTIVE */
+    {1.0e-3, 5.0e-4, 1.0e-2}, /* DXP_WAIT_RUN_ENABLE */
+    {1.0e-3, 2.5e-4, 1.0e-2}, /* DXP_WAIT_RUN_END */
+};
+
+static unsigned long histograms[DXP_WAIT_NUM_TYPES][DXP_WAIT_HISTOGRAM_BINS];
+
+static handel_md_Mutex statsLock = {NULL, "xerxes_wait"};
+
+static XIA_THREAD_LOCAL char info_string[INFO_LEN];
+
+/*
+ * Creates the statistics lock. Called from dxp_init_library(), before
+ * any waits can run.
+ */
+int dxp_wait_init(void) {
+    if (handel_md_mutex_ready(&statsLock)) {
+        return DXP_SUCCESS;
+    }
+
+    if (handel_md_mutex_create(&statsLock) != THREADING_NO_ERROR) {
+        dxp_log_error("dxp_wait_init", "Error creating the wait statistics lock",
+                      DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Starts timing a wait of the given type that gives up after timeout
+ * seconds.
+ */
+void dxp_wait_begin(Dxp_Wait* w, int type, double timeout) {
+    ASSERT(w != NULL);
+    ASSERT(type >= 0 && type < DXP_WAIT_NUM_TYPES);
+
+    w->type = type;
+    w->timeout = timeout;
+    w->start = handel_md_clock();
+    w->elapsed = 0.0;
+    w->interval = profiles[type].interval;
+    w->polls = 0;
+    w->cancelled = FALSE_;
+}
+
+/*
+ * Called after each poll that did not find the operation complete.
+ * Sleeps as the profile asks and returns FALSE_ once the timeout has
+ * passed. There is always one more poll after the last sleep. Also
+ * returns FALSE_, with cancelled set, if the work the calling thread
+ * is bound to has been cancelled.
+ */
+boolean_t dxp_wait_next(Dxp_Wait* w) {
+    float sleep;
+
+    Dxp_Wait_Profile* p = &profiles[w->type];
+
+    w->polls++;
+    w->elapsed = handel_md_clock() - w->start;
+
+    if (w->elapsed >= w->timeout) {
+        return FALSE_;
+    }
+
+    if (handel_md_cancelled()) {
+        w->cancelled = TRUE_;
+        sprintf(info_string, "Wait cancelled after %d polls", w->polls);
+        dxp_log_error("dxp_wait_next", info_string, DXP_CANCELLED);
+        return FALSE_;
+    }
+
+    if (w->elapsed < p->spin) {
+        return TRUE_;
+    }
+
+    sleep = (float) MIN(w->interval, w->timeout - w->elapsed);
+    xerxes_md_wait(&sleep);
+
+    w->interval = MIN(w->interval * 2.0, p->maxInterval);
+
+    return TRUE_;
+}
+
+/*
+ * Records the completion time of a successful wait.
+ */
+void dxp_wait_end(Dxp_Wait* w) {
+    int bin = 0;
+
+    double limit = DXP_WAIT_HISTOGRAM_BASE;
+
+    w->elapsed = handel_md_clock() - w->start;
+
+    while (w->elapsed > limit && bin < DXP_WAIT_HISTOGRAM_BINS - 1) {
+        limit *= 2.0;
+        bin++;
+    }
+
+    handel_md_mutex_lock(&statsLock);
+    histograms[w->type][bin]++;
+    handel_md_mutex_unlock(&statsLock);
+}
+
+/*
+ * Replaces the profile for an operation type. All times are in seconds.
+ */
+int dxp_wait_set_profile(int type, double spin, double interval, double maxInterval) {
+    if (type < 0 || type >= DXP_WAIT_NUM_TYPES) {
+        sprintf(info_string, "Unknown wait type %d", type);
+        dxp_log_error("dxp_wait_set_profile", info_string, DXP_BAD_PARAM);
+        return DXP_BAD_PARAM;
+    }
+
+    if (spin < 0.0 || interval <= 0.0 || maxInterval < interval) {
+        sprintf(info_string,
+                "Invalid wait profile: spin = %f, interval = %f, max. interval = %f",
+                spin, interval, maxInterval);
+        dxp_log_error("dxp_wait_set_profile", info_string, DXP_BAD_PARAM);
+        return DXP_BAD_PARAM;
+    }
+
+    profiles[type].spin = spin;
+    profiles[type].interval = interval;
+    profiles[type].maxInterval = maxInterval;
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Copies the completion time histogram of an operation type, see
+ * DXP_WAIT_HISTOGRAM_BINS, into histogram.
+ */
+int dxp_wait_get_stats(int type, unsigned long* histogram) {
+    if (type < 0 || type >= DXP_WAIT_NUM_TYPES) {
+        sprintf(info_string, "Unknown wait type %d", type);
+        dxp_log_error("dxp_wait_get_stats", info_string, DXP_BAD_PARAM);
+        return DXP_BAD_PARAM;
+    }
+
+    handel_md_mutex_lock(&statsLock);
+    memcpy(histogram, histograms[type], sizeof(histograms[type]));
+    handel_md_mutex_unlock(&statsLock);
+
+    return DXP_SUCCESS;
+}
@@ -44,6 +44,7 @@ int main(int argc, char* argv[]) {
     double* done_times;
 
     int n_iters;
+    int n_tune = 0;
     int i = 0;
     int n_chans = 0;
 
@@ -90,6 +91,16 @@ int main(int argc, char* argv[]) {
     sscanf(argv[2], "%d", &n_iters);
     fprintf(stdout, "Running for %d iters worth of buffer reads.\n", n_iters);
 
+    /* Measure the first buffers of the run to size num_map_pixels_per_buffer. */
+    if (argc > 3) {
+        sscanf(argv[3], "%d", &n_tune);
+        fprintf(stdout, "Tuning the buffer size over %d buffers.\n", n_tune);
+
+        for (i = 0; i < n_chans; i += 4) {
+            CHECK(xiaSetMapTune(i, (unsigned int) n_tune, 0.0, 0));
+        }
+    }
+
     read_times = malloc(n_iters * sizeof(double));
 
     if (!read_times) {
@@ -183,6 +194,30 @@ int main(int argc, char* argv[]) {
 
     CHECK(xiaStopRun(-1));
 
+    if (n_tune > 0) {
+        for (i = 0; i < n_chans; i += 4) {
+            XiaMapTune tune;
+
+            CHECK(xiaGetMapTune(i, &tune));
+
+            if (!tune.complete) {
+                fprintf(stdout, "detChan %d: measured %u of %d buffers\n", i,
+                        tune.nBuffers, n_tune);
+                continue;
+            }
+
+            fprintf(stdout,
+                    "detChan %d: %0.1f pixels/buffer, fill = %0.3f ms, "
+                    "read = %0.3f ms, done = %0.3f ms\n",
+                    i, tune.pixels, tune.fillTime * 1.0e3, tune.readTime * 1.0e3,
+                    tune.doneTime * 1.0e3);
+            fprintf(stdout,
+                    "detChan %d: headroom = %0.2f, recommended "
+                    "num_map_pixels_per_buffer = %lu (0 = maximum)\n",
+                    i, tune.headroom, tune.recommended);
+        }
+    }
+
     fp = fopen("read_times.txt", "w");
 
     if (!fp) {
@@ -313,6 +348,6 @@ static void config_austinai_mapping_mode_sca(int total_chans) {
 }
 
 static void print_usage(void) {
-    fprintf(stdout, "Arguments: [.ini file]]\n");
+    fprintf(stdout, "Arguments: [.ini file] [iterations] [tuning buffers]\n");
     return;
 }
@@ -1,17 +1,38 @@
+#include "windows.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "handel.h"
+#include "handel_constants.h"
 #include "handel_errors.h"
 
 #include "xia_assert.h"
 
+static double n_secs_elapsed(LARGE_INTEGER start, LARGE_INTEGER stop,
+                             LARGE_INTEGER freq);
+
+/*
+ * Times xiaInit() + xiaStartSystem() repeatedly. The first iteration starts
+ * with an empty DSP cache (cold) and the rest reuse the parsed DSP code
+ * (warm). Pass "disk" as the optional second argument to use the on-disk
+ * cache, in which case a second run of the benchmark is warm from the start.
+ */
 int main(int argc, char* argv[]) {
     int status;
     int n_iters;
     int i;
+    int mode = XIA_DSP_CACHE_MEMORY;
+
+    double elapsed;
+    double cold = 0.0;
+    double warm = 0.0;
+
+    LARGE_INTEGER freq;
+    LARGE_INTEGER start;
+    LARGE_INTEGER stop;
 
-    if (argc != 2) {
+    if (argc < 2) {
         fprintf(stderr, "The first argument should be the number of times to "
                         "start the system.\n");
         exit(1);
@@ -19,16 +40,57 @@ int main(int argc, char* argv[]) {
 
     sscanf(argv[1], "%d", &n_iters);
 
+    if (argc > 2 && strcmp(argv[2], "disk") == 0) {
+        mode = XIA_DSP_CACHE_DISK;
+    }
+
+    QueryPerformanceFrequency(&freq);
+
+    /* Start from an empty in-memory cache. */
+    status = xiaSetDSPCache(XIA_DSP_CACHE_OFF);
+    ASSERT(status == XIA_SUCCESS);
+
+    status = xiaSetDSPCache(mode);
+    ASSERT(status == XIA_SUCCESS);
+
     for (i = 0; i < n_iters; i++) {
+        QueryPerformanceCounter(&start);
+
         status = xiaInit("xmap.ini");
         ASSERT(status == XIA_SUCCESS);
 
         status = xiaStartSystem();
         ASSERT(status == XIA_SUCCESS);
 
+        QueryPerformanceCounter(&stop);
+
         status = xiaExit();
         ASSERT(status == XIA_SUCCESS);
+
+        elapsed = n_secs_elapsed(start, stop, freq);
+        fprintf(stdout, "Iter %d: %0.6f s\n", i, elapsed);
+
+        if (i == 0) {
+            cold = elapsed;
+        } else {
+            warm += elapsed;
+        }
+    }
+
+    fprintf(stdout, "Cold start: %0.6f s\n", cold);
+
+    if (n_iters > 1) {
+        fprintf(stdout, "Warm start: %0.6f s (mean of %d)\n", warm / (n_iters - 1),
+                n_iters - 1);
     }
 
     exit(0);
 }
+
+/*
+ * Converts two values returned by QueryPerformanceCounter() into seconds.
+ */
+static double n_secs_elapsed(LARGE_INTEGER start, LARGE_INTEGER stop,
+                             LARGE_INTEGER freq) {
+    return ((double) (stop.QuadPart - start.QuadPart) / (double) freq.QuadPart);
+}
@@ -20,6 +20,11 @@
  * @brief Tests for detector agnostic Handel API functionality.
  */
 
+#include <handel_constants.h>
+#include <xia_common.h>
+#include <md_threads.h>
+#include <xia_mapping.h>
+
 #include <util/xia_ary_manip.h>
 #include <util/xia_compare.h>
 #include <util/xia_crc.h>
@@ -36,6 +41,120 @@ static int shared_value = 4714;
 static double shared_values[3] = {4512, 4613, 4714};
 static double shared_info[2] = {0., 0.};
 
+void acquisition_batch(void) {
+    int retval;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad det-chan on begin");
+    {
+        retval = xiaBeginAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaBeginAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+    }
+
+    TEST_CASE("Bad det-chan on commit");
+    {
+        retval = xiaCommitAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaCommitAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+    }
+
+    TEST_CASE("Commit without begin");
+    {
+        retval = xiaInit("configs/udxp_usb2.ini");
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaInit | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaCommitAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_ILLEGAL_OPERATION);
+        TEST_MSG("xiaCommitAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_ILLEGAL_OPERATION));
+    }
+
+    TEST_CASE("Begin twice");
+    {
+        retval = xiaBeginAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaBeginAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaBeginAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_ILLEGAL_OPERATION);
+        TEST_MSG("xiaBeginAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_ILLEGAL_OPERATION));
+    }
+
+    TEST_CASE("Unknown value is rejected when set");
+    {
+        double value = 1.0;
+
+        retval = xiaSetAcquisitionValues(0, "not_an_acquisition_value", &value);
+        TEST_CHECK(retval == XIA_NOT_FOUND);
+        TEST_MSG("xiaSetAcquisitionValues | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NOT_FOUND));
+    }
+
+    TEST_CASE("Empty commit");
+    {
+        retval = xiaCommitAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaCommitAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Failed set begin is rolled back");
+    {
+        TEST_CHECK(xiaNewModule("module2") == XIA_SUCCESS);
+        TEST_CHECK(xiaAddModuleItem("module2", "module_type", "udxp") == XIA_SUCCESS);
+        TEST_CHECK(xiaAddModuleItem("module2", "interface", "usb2") == XIA_SUCCESS);
+        int device_number = 1;
+        TEST_CHECK(xiaAddModuleItem("module2", "device_number", &device_number) ==
+                   XIA_SUCCESS);
+        int number_of_channels = 1;
+        TEST_CHECK(xiaAddModuleItem("module2", "number_of_channels",
+                                    &number_of_channels) == XIA_SUCCESS);
+        /* Channel items are parsed in place, so they cannot be literals. */
+        char channel0_item[] = "channel0_alias";
+        int channel0_alias = 1;
+        TEST_CHECK(xiaAddModuleItem("module2", channel0_item, &channel0_alias) ==
+                   XIA_SUCCESS);
+
+        /* detChan 1 already has a batch, so the master set cannot start one. */
+        retval = xiaBeginAcquisitionBatch(1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaBeginAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaBeginAcquisitionBatch(-1);
+        TEST_CHECK(retval == XIA_ILLEGAL_OPERATION);
+        TEST_MSG("xiaBeginAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_ILLEGAL_OPERATION));
+
+        retval = xiaCommitAcquisitionBatch(0);
+        TEST_CHECK(retval == XIA_ILLEGAL_OPERATION);
+        TEST_MSG("detChan 0 left in a batch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_ILLEGAL_OPERATION));
+
+        retval = xiaCommitAcquisitionBatch(1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaCommitAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaBeginAcquisitionBatch(-1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaBeginAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaCommitAcquisitionBatch(-1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaCommitAcquisitionBatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+    cleanup();
+}
+
 void add_detector_item(void) {
     int retval;
     xiaSuppressLogOutput();
@@ -295,103 +414,1583 @@ void add_firmware_item(void) {
                  tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
     }
 
-    TEST_CASE("Bad item name");
-    {
-        retval = xiaAddFirmwareItem(shared_alias, shared_name, &shared_value);
-        TEST_CHECK(retval == XIA_BAD_VALUE);
-        TEST_MSG("xiaAddFirmwareItem | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    TEST_CASE("Bad item name");
+    {
+        retval = xiaAddFirmwareItem(shared_alias, shared_name, &shared_value);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaAddFirmwareItem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+    cleanup();
+}
+
+void add_module_item(void) {
+    int retval;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Null Alias");
+    {
+        retval = xiaAddModuleItem(NULL, NULL, NULL);
+        TEST_CHECK(retval == XIA_NULL_ALIAS);
+        TEST_MSG("xiaAddModuleItem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_ALIAS));
+    }
+
+    TEST_CASE("Null Name");
+    {
+        retval = xiaAddModuleItem(shared_alias, NULL, NULL);
+        TEST_CHECK(retval == XIA_NULL_NAME);
+        TEST_MSG("xiaAddModuleItem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
+    }
+
+    TEST_CASE("Null Value");
+    {
+        retval = xiaAddModuleItem(shared_alias, shared_name, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaAddModuleItem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
+    }
+
+    TEST_CASE("Unknown item");
+    {
+        create_mod(shared_alias, "udxp", "usb2");
+        retval = xiaAddModuleItem(shared_alias, shared_name, &shared_value);
+        TEST_CHECK(retval == XIA_UNKNOWN_ITEM);
+        TEST_MSG("xiaAddModuleItem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_UNKNOWN_ITEM));
+    }
+
+    TEST_CASE("Known item");
+    {
+        retval = xiaAddModuleItem(shared_alias, "device_number", &shared_value);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaAddModuleItem | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        int chk = 0;
+        TEST_CHECK(xiaGetModuleItem(shared_alias, "device_number", &chk) ==
+                   XIA_SUCCESS);
+        TEST_CHECK(chk == shared_value);
+        TEST_MSG("%i != %i", chk, shared_value);
+    }
+    cleanup();
+}
+
+/*
+ * Writes a 32-bit value to a pair of 16-bit mapping buffer words, low word
+ * first.
+ */
+static void set_map_word32(unsigned long* words, unsigned long value) {
+    words[0] = value & 0xFFFF;
+    words[1] = (value >> 16) & 0xFFFF;
+}
+
+/*
+ * Clears the total words of a mapping buffer and writes its header for the
+ * given mode and number of pixels or events. Returns the first word after
+ * the header.
+ */
+static unsigned long* make_buffer_header(unsigned long* buffer, unsigned long total,
+                                         unsigned long mode, unsigned long n) {
+    memset(buffer, 0, total * sizeof(unsigned long));
+
+    buffer[0] = MAP_BUFFER_TAG0;
+    buffer[1] = MAP_BUFFER_TAG1;
+    buffer[MAP_BH_HEADER_SIZE] = MAP_BUFFER_HEADER_SIZE;
+    buffer[MAP_BH_MAPPING_MODE] = mode;
+    buffer[MAP_BH_N_PIXELS] = n;
+
+    return buffer + MAP_BUFFER_HEADER_SIZE;
+}
+
+/*
+ * Writes the header of an MCA or SCA pixel block with the given per-channel
+ * sizes. Returns the first word of the pixel data.
+ */
+static unsigned long* make_pixel_header(unsigned long* pixel, unsigned long mode,
+                                        unsigned long number, unsigned long block,
+                                        const unsigned int* sizes) {
+    unsigned long c;
+    unsigned long size =
+        mode == MAP_MODE_MCA ? MAP_MCA_PIXEL_HEADER_SIZE : MAP_SCA_PIXEL_HEADER_SIZE;
+
+    pixel[0] = MAP_PIXEL_TAG0;
+    pixel[1] = MAP_PIXEL_TAG1;
+    pixel[MAP_PH_HEADER_SIZE] = size;
+    pixel[MAP_PH_MAPPING_MODE] = mode;
+    set_map_word32(pixel + MAP_PH_PIXEL, number);
+    set_map_word32(pixel + MAP_PH_BLOCK_SIZE, block);
+
+    for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+        pixel[MAP_PH_CHANNEL_SIZE + c] = sizes[c];
+    }
+
+    return pixel + size;
+}
+
+/*
+ * Writes the realtime, livetime, triggers and events of channel c to a
+ * pixel header.
+ */
+static void set_pixel_stats(unsigned long* pixel, unsigned long c,
+                            unsigned long realtime, unsigned long livetime,
+                            unsigned long triggers, unsigned long events) {
+    unsigned long* words = pixel + MAP_PH_STATS + c * MAP_PH_STATS_PER_CHANNEL;
+
+    set_map_word32(words, realtime);
+    set_map_word32(words + 2, livetime);
+    set_map_word32(words + 4, triggers);
+    set_map_word32(words + 6, events);
+}
+
+static unsigned long make_mca_buffer(unsigned long* buffer, const unsigned int* sizes);
+
+void archive(void) {
+    int retval;
+    unsigned int i;
+    unsigned int mismatches = 0;
+    unsigned int sizes[4] = {37, 37, 0, 37};
+    unsigned int record[64];
+    int detChans[2] = {0, -1};
+    unsigned long len;
+    unsigned long buffer[MAP_BUFFER_HEADER_SIZE +
+                         3 * (MAP_MCA_PIXEL_HEADER_SIZE + 3 * 37)];
+    const void* data;
+    size_t size;
+    double value;
+    XiaArchiveWriter* writer = NULL;
+    XiaArchive* reader = NULL;
+    const char* path = "test_archive.xar";
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Null arguments");
+    {
+        retval = xiaCreateArchive(NULL, 1, NULL, 0, &writer);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaCreateArchive | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+
+        retval = xiaOpenArchive(path, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaOpenArchive | %s", tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+
+        retval = xiaFinishArchive(NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaFinishArchive | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("No streams");
+    {
+        retval = xiaCreateArchive(path, 0, NULL, 0, &writer);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaCreateArchive | %s", tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Write buffers and pixels");
+    {
+        len = make_mca_buffer(buffer, sizes);
+
+        /* Small chunks so the records span several of them. */
+        retval = xiaCreateArchive(path, 2, NULL, 1024, &writer);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaWriteArchiveBuffer(writer, 0, buffer, len);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaWriteArchiveBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaWriteArchiveBuffer(writer, 2, buffer, len);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaWriteArchiveBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        buffer[MAP_BUFFER_HEADER_SIZE] = 0;
+        retval = xiaWriteArchiveBuffer(writer, 0, buffer, len);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("xiaWriteArchiveBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
+        buffer[MAP_BUFFER_HEADER_SIZE] = MAP_PIXEL_TAG0;
+
+        /* Out of order, to be sorted when the index is written. */
+        for (i = 200; i-- > 0;) {
+            unsigned int k;
+
+            for (k = 0; k < i % 64; k++) {
+                record[k] = i * 100 + k;
+            }
+
+            retval = xiaWriteArchivePixel(writer, 1, i, record, k * sizeof(unsigned int));
+            mismatches += retval != XIA_SUCCESS;
+        }
+
+        TEST_CHECK_(mismatches == 0, "xiaWriteArchivePixel | %u failures", mismatches);
+
+        retval = xiaFinishArchive(writer);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaFinishArchive | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Read pixels");
+    {
+        retval = xiaOpenArchive(path, &reader);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaGetArchivePixel(reader, 0, 101, &data, &size);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaGetArchivePixel | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        if (retval == XIA_SUCCESS) {
+            const unsigned short* words = (const unsigned short*) data;
+            const unsigned long* block =
+                buffer + MAP_BUFFER_HEADER_SIZE + (MAP_MCA_PIXEL_HEADER_SIZE + 3 * 37);
+
+            mismatches =
+                size != (MAP_MCA_PIXEL_HEADER_SIZE + 3 * 37) * sizeof(unsigned short);
+
+            for (i = 0; i < size / sizeof(unsigned short); i++) {
+                mismatches += words[i] != (unsigned short) block[i];
+            }
+
+            TEST_CHECK_(mismatches == 0, "Pixel 101 | %u mismatches", mismatches);
+        }
+
+        mismatches = 0;
+
+        for (i = 0; i < 200; i++) {
+            unsigned int k;
+
+            retval = xiaGetArchivePixel(reader, 1, i, &data, &size);
+
+            if (retval != XIA_SUCCESS || size != (i % 64) * sizeof(unsigned int)) {
+                mismatches++;
+                continue;
+            }
+
+            for (k = 0; k < i % 64; k++) {
+                mismatches += ((const unsigned int*) data)[k] != i * 100 + k;
+            }
+        }
+
+        TEST_CHECK_(mismatches == 0, "Stream 1 | %u mismatches", mismatches);
+
+        retval = xiaGetArchivePixel(reader, 0, 99, &data, &size);
+        TEST_CHECK(retval == XIA_NOT_FOUND);
+        TEST_MSG("xiaGetArchivePixel | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NOT_FOUND));
+
+        retval = xiaGetArchivePixel(reader, 2, 100, &data, &size);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetArchivePixel | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaCloseArchive(reader);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaCloseArchive | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Acquisition values");
+    {
+        retval = xiaInit("configs/udxp_defaults.ini");
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaCreateArchive(path, 2, detChans, 0, &writer);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaFinishArchive(writer);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaFinishArchive | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaOpenArchive(path, &reader);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaGetArchiveValue(reader, 0, "peaking_time", &value);
+        TEST_CHECK(retval == XIA_SUCCESS && value == 2.0);
+        TEST_MSG("xiaGetArchiveValue | %s, %f",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS), value);
+
+        retval = xiaGetArchiveValue(reader, 1, "peaking_time", &value);
+        TEST_CHECK(retval == XIA_NOT_FOUND);
+        TEST_MSG("xiaGetArchiveValue | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NOT_FOUND));
+
+        xiaCloseArchive(reader);
+    }
+
+    TEST_CASE("Not an archive");
+    {
+        retval = xiaOpenArchive("configs/udxp_usb2.ini", &reader);
+        TEST_CHECK(retval == XIA_FILE_TYPE);
+        TEST_MSG("xiaOpenArchive | %s", tst_msg(errmsg, MSGLEN, retval, XIA_FILE_TYPE));
+    }
+
+    TEST_CHECK(remove(path) == 0);
+    TEST_MSG("unable to remove %s", path);
+    cleanup();
+}
+
+#define ARCHIVE_BENCH_STREAMS 4
+#define ARCHIVE_BENCH_PIXELS 4096
+#define ARCHIVE_BENCH_WORDS 2048
+#define ARCHIVE_BENCH_LOOKUPS 1000000
+
+void archive_throughput(void) {
+    int retval = XIA_SUCCESS;
+    unsigned int i;
+    unsigned int s;
+    unsigned int missing = 0;
+    unsigned int seed = 12345;
+    unsigned short* record;
+    const void* data;
+    size_t size;
+    double start;
+    double rate;
+    double latency;
+    XiaArchiveWriter* writer = NULL;
+    XiaArchive* reader = NULL;
+    const char* path = "test_archive_bench.xar";
+    xiaSuppressLogOutput();
+
+    record = malloc(ARCHIVE_BENCH_WORDS * sizeof(unsigned short));
+    TEST_ASSERT(record != NULL);
+
+    for (i = 0; i < ARCHIVE_BENCH_WORDS; i++) {
+        record[i] = (unsigned short) i;
+    }
+
+    TEST_CASE("Write");
+    {
+        start = handel_md_clock();
+
+        retval = xiaCreateArchive(path, ARCHIVE_BENCH_STREAMS, NULL, 0, &writer);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        for (i = 0; i < ARCHIVE_BENCH_PIXELS && retval == XIA_SUCCESS; i++) {
+            for (s = 0; s < ARCHIVE_BENCH_STREAMS && retval == XIA_SUCCESS; s++) {
+                retval = xiaWriteArchivePixel(writer, s, i, record,
+                                              ARCHIVE_BENCH_WORDS * sizeof(unsigned short));
+            }
+        }
+
+        if (retval == XIA_SUCCESS) {
+            retval = xiaFinishArchive(writer);
+        }
+
+        rate = (double) ARCHIVE_BENCH_PIXELS * ARCHIVE_BENCH_STREAMS *
+               ARCHIVE_BENCH_WORDS * sizeof(unsigned short) /
+               (handel_md_clock() - start + 1e-9);
+
+        TEST_CHECK_(retval == XIA_SUCCESS, "Write | %.1f MB/s", rate / 1e6);
+        TEST_MSG("Write | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Random lookup");
+    {
+        retval = xiaOpenArchive(path, &reader);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        start = handel_md_clock();
+
+        for (i = 0; i < ARCHIVE_BENCH_LOOKUPS; i++) {
+            seed = seed * 1103515245 + 12345;
+
+            retval = xiaGetArchivePixel(reader, (seed >> 8) % ARCHIVE_BENCH_STREAMS,
+                                        (seed >> 12) % ARCHIVE_BENCH_PIXELS, &data,
+                                        &size);
+            missing += retval != XIA_SUCCESS ||
+                       ((const unsigned short*) data)[size / 2 - 1] !=
+                           ARCHIVE_BENCH_WORDS - 1;
+        }
+
+        latency = (handel_md_clock() - start) / ARCHIVE_BENCH_LOOKUPS;
+
+        TEST_CHECK_(missing == 0, "Lookup | %u missing, %.0f ns per pixel", missing,
+                    latency * 1e9);
+
+        xiaCloseArchive(reader);
+    }
+
+    free(record);
+    TEST_CHECK(remove(path) == 0);
+    TEST_MSG("unable to remove %s", path);
+    cleanup();
+}
+
+void board_operation(void) {
+    int retval;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Null Name");
+    {
+        retval = xiaBoardOperation(0, NULL, NULL);
+        TEST_CHECK(retval == XIA_NULL_NAME);
+        TEST_MSG("xiaBoardOperation | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
+    }
+
+    TEST_CASE("Null Value");
+    {
+        retval = xiaBoardOperation(0, shared_name, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaBoardOperation | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Bad det-chan");
+    {
+        retval = xiaBoardOperation(0, shared_name, &shared_value);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaBoardOperation | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+    }
+    cleanup();
+}
+
+struct cancel_worker {
+    handel_md_Thread thread;
+    handel_md_Event bound;
+    handel_md_Event done;
+    handel_md_Cancel* outer;
+    handel_md_Cancel* inner;
+    int cancelled;
+};
+
+/*
+ * Binds the outer and then the inner token, the way a module lock nests
+ * inside xiaStartSystem(), and polls until the thread is cancelled.
+ */
+static void cancel_worker_main(void* arg) {
+    int i;
+    struct cancel_worker* worker = (struct cancel_worker*) arg;
+    handel_md_CancelScope outerScope;
+    handel_md_CancelScope innerScope;
+
+    handel_md_cancel_enter(worker->outer, &outerScope);
+    handel_md_cancel_enter(worker->inner, &innerScope);
+    handel_md_event_signal(&worker->bound);
+
+    for (i = 0; i < 5000 && !handel_md_cancelled(); i++) {
+        handel_md_thread_sleep(1);
+    }
+
+    worker->cancelled = handel_md_cancelled();
+
+    handel_md_cancel_leave(&innerScope);
+    handel_md_cancel_leave(&outerScope);
+    handel_md_event_signal(&worker->done);
+}
+
+static int run_cancel_worker(boolean_t cancelOuter) {
+    struct cancel_worker worker;
+    handel_md_Cancel outer;
+    handel_md_Cancel inner;
+
+    handel_md_cancel_init(&outer);
+    handel_md_cancel_init(&inner);
+
+    memset(&worker, 0, sizeof(worker));
+    worker.bound.name = "cancel_bound";
+    worker.done.name = "cancel_done";
+    worker.thread.name = "cancel_worker";
+    worker.thread.state = handel_md_ThreadsDetached;
+    worker.thread.entryPoint = cancel_worker_main;
+    worker.thread.argument = &worker;
+    worker.outer = &outer;
+    worker.inner = &inner;
+
+    TEST_ASSERT(handel_md_event_create(&worker.bound) == THREADING_NO_ERROR);
+    TEST_ASSERT(handel_md_event_create(&worker.done) == THREADING_NO_ERROR);
+    TEST_ASSERT(handel_md_thread_create(&worker.thread) == THREADING_NO_ERROR);
+
+    handel_md_event_wait(&worker.bound, 0);
+    handel_md_cancel_request(cancelOuter ? &outer : &inner);
+    handel_md_event_wait(&worker.done, 0);
+
+    handel_md_event_destroy(&worker.bound);
+    handel_md_event_destroy(&worker.done);
+
+    return worker.cancelled;
+}
+
+void cancel(void) {
+    int retval;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad det-chan");
+    {
+        retval = xiaCancel(0);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaCancel | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+    }
+
+    TEST_CASE("Idle module");
+    {
+        retval = xiaInit("configs/udxp_usb2.ini");
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaInit | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaCancel(0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaCancel | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Error text");
+    {
+        TEST_CHECK(strcmp(xiaGetErrorText(DXP_CANCELLED), "Operation was cancelled") ==
+                   0);
+        TEST_MSG("xiaGetErrorText | %s", xiaGetErrorText(DXP_CANCELLED));
+
+        TEST_CHECK(strcmp(xiaGetErrorText(XIA_CANCELLED),
+                          "The operation was cancelled by xiaCancel()") == 0);
+        TEST_MSG("xiaGetErrorText | %s", xiaGetErrorText(XIA_CANCELLED));
+    }
+
+    TEST_CASE("Inner token of a running thread");
+    {
+        TEST_CHECK(run_cancel_worker(FALSE_));
+        TEST_MSG("The worker did not see the cancel of its inner token");
+    }
+
+    TEST_CASE("Outer token of a running thread");
+    {
+        TEST_CHECK(run_cancel_worker(TRUE_));
+        TEST_MSG("The inner token hid the cancel of the outer token");
+    }
+
+    TEST_CASE("Unbound thread");
+    {
+        TEST_CHECK(!handel_md_cancelled());
+        TEST_MSG("The test thread is not bound to any token");
+    }
+    cleanup();
+}
+
+void close_log(void) {
+    xiaSuppressLogOutput();
+    int retval = xiaCloseLog();
+    TEST_CHECK(retval == XIA_SUCCESS);
+    TEST_MSG("xiaCloseLog | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    cleanup();
+}
+
+void contexts(void) {
+    int retval;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Null context");
+    {
+        retval = xiaContextCreate(NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaContextCreate | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+
+        retval = xiaContextDestroy(NULL);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaContextDestroy | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Independent configuration");
+    {
+        HandelContext* ctx = NULL;
+        unsigned int num_dets = 12;
+
+        retval = xiaContextCreate(&ctx);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaContextCreate | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        xiaContextSelect(ctx);
+        create_det(shared_alias, "reset", "+", 1, shared_value, shared_value);
+        retval = xiaGetNumDetectors(&num_dets);
+        TEST_CHECK(retval == XIA_SUCCESS && num_dets == 1);
+        TEST_MSG("%i = %i", num_dets, 1);
+
+        xiaContextSelect(NULL);
+        retval = xiaGetNumDetectors(&num_dets);
+        TEST_CHECK(retval == XIA_SUCCESS && num_dets == 0);
+        TEST_MSG("%i = %i", num_dets, 0);
+
+        retval = xiaContextDestroy(ctx);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaContextDestroy | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+    cleanup();
+}
+
+#define LIST_TEST_EVENTS 101
+#define LIST_TEST_START 0xFFFFF000UL
+#define LIST_TEST_STEP 0x100UL
+
+/*
+ * Writes a list mode buffer of n events numbered from first, ending in
+ * three words of padding. Event e has energy e * 997, channel e % 4, flags
+ * e % 5, pixel e / 10 and a clock that starts just below the 32-bit
+ * rollover and advances by LIST_TEST_STEP.
+ */
+static unsigned long make_list_buffer(unsigned long* buffer, unsigned long variant,
+                                      unsigned long first, unsigned long n) {
+    unsigned long e;
+    unsigned long size = variant == 2 ? 4 : 6;
+    unsigned long total = MAP_BUFFER_HEADER_SIZE + n * size + 3;
+    unsigned long* record = make_buffer_header(buffer, total, MAP_MODE_LIST, n);
+
+    buffer[MAP_BH_RUN_NUMBER] = 1;
+    set_map_word32(buffer + MAP_BH_TOTAL_WORDS, total);
+    buffer[MAP_BH_LIST_VARIANT] = variant;
+    buffer[MAP_BH_WORDS_PER_EVENT] = size;
+
+    for (e = first; e < first + n; e++, record += size) {
+        unsigned long time = (LIST_TEST_START + e * LIST_TEST_STEP) & 0xFFFFFFFF;
+
+        record[0] = (e * 997) & 0xFFFF;
+        record[1] = ((e % 5) << 8) | (e % 4);
+        set_map_word32(record + 2, time);
+
+        if (size == 6) {
+            set_map_word32(record + 4, e / 10);
+        }
+    }
+
+    return total;
+}
+
+/*
+ * Counts the decoded events that differ from those written by
+ * make_list_buffer(), the first being event first.
+ */
+static unsigned int check_list_events(const XiaListEvents* events, unsigned long first,
+                                      boolean_t pixels) {
+    unsigned long i;
+    unsigned int mismatches = 0;
+
+    for (i = 0; i < events->nEvents; i++) {
+        unsigned long e = first + i;
+        uint64_t time = (uint64_t) LIST_TEST_START + (uint64_t) e * LIST_TEST_STEP;
+        unsigned short flags = (unsigned short) (e % 5);
+
+        /* The clock passes 2^32 at event 16. */
+        if (e == 16) {
+            flags |= XIA_LIST_EVENT_ROLLOVER;
+        }
+
+        mismatches += events->timestamp[i] != time;
+        mismatches += events->energy[i] != ((e * 997) & 0xFFFF);
+        mismatches += events->channel[i] != e % 4;
+        mismatches += events->flags[i] != flags;
+        mismatches += events->pixel[i] != (pixels ? e / 10 : 0);
+    }
+
+    return mismatches;
+}
+
+void cube(void) {
+    int retval;
+    unsigned int x;
+    unsigned int b;
+    unsigned int mismatches = 0;
+    unsigned int sizes[4] = {37, 37, 0, 37};
+    unsigned int spectrum[100];
+    unsigned long len;
+    unsigned long buffer[MAP_BUFFER_HEADER_SIZE +
+                         3 * (MAP_MCA_PIXEL_HEADER_SIZE + 3 * 37)];
+    uint64_t image[50 * 3];
+    XiaCube* c = NULL;
+    const char* path = "test_cube.xcb";
+    xiaSuppressLogOutput();
+
+    len = make_mca_buffer(buffer, sizes);
+
+    TEST_CASE("Null arguments");
+    {
+        retval = xiaCreateCube(NULL, 50, 3, 4, 100, &c);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaCreateCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+
+        retval = xiaWriteCubeBuffer(NULL, 0, buffer, len);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaWriteCubeBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+
+        retval = xiaCloseCube(NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaCloseCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Empty cube");
+    {
+        retval = xiaCreateCube(path, 0, 3, 4, 100, &c);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaCreateCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Write buffer");
+    {
+        /* Pixels 100 to 102 land at (0, 2) to (2, 2). */
+        retval = xiaCreateCube(path, 50, 3, 4, 100, &c);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaWriteCubeBuffer(c, 1, buffer, len);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaWriteCubeBuffer | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaWriteCubeBuffer(c, 2, buffer, len);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaWriteCubeBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        buffer[MAP_BUFFER_HEADER_SIZE] = 0;
+        retval = xiaWriteCubeBuffer(c, 1, buffer, len);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("xiaWriteCubeBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
+        buffer[MAP_BUFFER_HEADER_SIZE] = MAP_PIXEL_TAG0;
+
+        retval = xiaCloseCube(c);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaCloseCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Read spectra");
+    {
+        retval = xiaOpenCube(path, &c);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        /* Buffer channels 0, 1 and 3 are cube channels 1 to 3. */
+        for (x = 0; x < 3; x++) {
+            retval = xiaGetCubeSpectrum(c, x, 2, 3, spectrum);
+            mismatches += retval != XIA_SUCCESS;
+
+            for (b = 0; b < 100; b++) {
+                mismatches += spectrum[b] != (b < 37 ? (x * 4 + 3) * 1000 + b : 0);
+            }
+
+            retval = xiaGetCubeSpectrum(c, x, 2, 0, spectrum);
+            mismatches += retval != XIA_SUCCESS;
+
+            for (b = 0; b < 100; b++) {
+                mismatches += spectrum[b] != 0;
+            }
+        }
+
+        TEST_CHECK_(mismatches == 0, "Spectra | %u mismatches", mismatches);
+
+        retval = xiaGetCubeSpectrum(c, 50, 0, 0, spectrum);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetCubeSpectrum | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Read image");
+    {
+        mismatches = 0;
+
+        /* The range crosses a bin tile and runs past the 37 bins written. */
+        retval = xiaGetCubeImage(c, 2, 30, 70, image);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaGetCubeImage | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        for (x = 0; x < 50 * 3; x++) {
+            uint64_t expected = 0;
+
+            if (x >= 100 && x < 103) {
+                for (b = 30; b < 37; b++) {
+                    expected += ((x - 100) * 4 + 1) * 1000 + b;
+                }
+            }
+
+            mismatches += image[x] != expected;
+        }
+
+        TEST_CHECK_(mismatches == 0, "Image | %u mismatches", mismatches);
+
+        retval = xiaGetCubeImage(c, 2, 30, 71, image);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetCubeImage | %s", tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        xiaCloseCube(c);
+    }
+
+    TEST_CASE("Pixel past the end");
+    {
+        retval = xiaCreateCube(path, 10, 10, 4, 100, &c);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaWriteCubeBuffer(c, 0, buffer, len);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaWriteCubeBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        xiaCloseCube(c);
+    }
+
+    TEST_CASE("Not a cube");
+    {
+        retval = xiaOpenCube("configs/udxp_usb2.ini", &c);
+        TEST_CHECK(retval == XIA_FILE_TYPE);
+        TEST_MSG("xiaOpenCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_FILE_TYPE));
+    }
+
+    TEST_CHECK(remove(path) == 0);
+    TEST_MSG("unable to remove %s", path);
+    cleanup();
+}
+
+/*
+ * Writes an MCA mapping buffer of n pixels from start with one channel of
+ * bins bins. Bin b of pixel p holds (p * 7 + b + seed) % 50 and its
+ * realtime, livetime, triggers and events are p + seed, p, 2 * p and p.
+ */
+static unsigned long make_region_buffer(unsigned long* buffer, unsigned long start,
+                                        unsigned int n, unsigned int bins,
+                                        unsigned int seed) {
+    unsigned long p;
+    unsigned long b;
+    unsigned long block = MAP_MCA_PIXEL_HEADER_SIZE + bins;
+    unsigned long total = MAP_BUFFER_HEADER_SIZE + n * block;
+    unsigned long* pixel = make_buffer_header(buffer, total, MAP_MODE_MCA, n);
+    unsigned int sizes[MAP_MAX_CHANNELS] = {0};
+
+    sizes[0] = bins;
+    set_map_word32(buffer + MAP_BH_START_PIXEL, start);
+
+    for (p = start; p < start + n; p++, pixel += block) {
+        unsigned long* spectrum =
+            make_pixel_header(pixel, MAP_MODE_MCA, p, block, sizes);
+
+        set_pixel_stats(pixel, 0, p + seed, p, 2 * p, p);
+
+        for (b = 0; b < bins; b++) {
+            spectrum[b] = (p * 7 + b + seed) % 50;
+        }
+    }
+
+    return total;
+}
+
+#define REGION_WIDTH 40
+#define REGION_HEIGHT 30
+#define REGION_BINS 100
+
+/*
+ * Checks xiaGetCubeRegion() against sums taken pixel by pixel, where
+ * pixels below 100 or from 600 on were written with seed 2.
+ */
+static unsigned int check_cube_region(XiaCube* c, unsigned long x, unsigned long y,
+                                      unsigned long w, unsigned long h) {
+    int retval;
+    unsigned long px;
+    unsigned long py;
+    unsigned int b;
+    unsigned int mismatches = 0;
+    uint64_t spectrum[REGION_BINS];
+    uint64_t expected[REGION_BINS];
+    uint64_t counts = 0;
+    uint64_t realtime = 0;
+    uint64_t triggers = 0;
+    XiaRegionStats stats;
+
+    memset(expected, 0, sizeof(expected));
+
+    for (py = y; py < y + h; py++) {
+        for (px = x; px < x + w; px++) {
+            unsigned long p = py * REGION_WIDTH + px;
+            unsigned int seed = p < 100 || p >= 600 ? 2 : 1;
+
+            for (b = 0; b < REGION_BINS; b++) {
+                expected[b] += (p * 7 + b + seed) % 50;
+                counts += (p * 7 + b + seed) % 50;
+            }
+
+            realtime += p + seed;
+            triggers += 2 * p;
+        }
+    }
+
+    retval = xiaGetCubeRegion(c, 1, x, y, w, h, spectrum, &stats);
+
+    if (retval != XIA_SUCCESS) {
+        return 1;
+    }
+
+    for (b = 0; b < REGION_BINS; b++) {
+        mismatches += spectrum[b] != expected[b];
+    }
+
+    mismatches += stats.nPixels != w * h;
+    mismatches += stats.counts != counts;
+    mismatches += stats.realtime != realtime;
+    mismatches += stats.triggers != triggers;
+
+    return mismatches;
+}
+
+void cube_region(void) {
+    int retval;
+    unsigned int i;
+    unsigned int mismatches = 0;
+    unsigned long len;
+    unsigned long* buffer;
+    uint64_t spectrum[REGION_BINS];
+    XiaRegionStats stats;
+    XiaCube* c = NULL;
+    const char* path = "test_cube_region.xcb";
+    xiaSuppressLogOutput();
+
+    buffer = malloc((MAP_BUFFER_HEADER_SIZE +
+                     100 * (MAP_MCA_PIXEL_HEADER_SIZE + REGION_BINS)) *
+                    sizeof(unsigned long));
+    TEST_ASSERT(buffer != NULL);
+
+    retval = xiaCreateCube(path, REGION_WIDTH, REGION_HEIGHT, 2, REGION_BINS, &c);
+    TEST_ASSERT(retval == XIA_SUCCESS);
+
+    TEST_CASE("Without an index");
+    {
+        for (i = 0; i < 6; i++) {
+            len = make_region_buffer(buffer, i * 100, 100, REGION_BINS, 1);
+            retval = xiaWriteCubeBuffer(c, 1, buffer, len);
+            mismatches += retval != XIA_SUCCESS;
+        }
+
+        /* Pixels 100 to 599, before any are written again. */
+        mismatches += check_cube_region(c, 0, 3, REGION_WIDTH, 10);
+        mismatches += check_cube_region(c, 3, 4, 17, 11);
+
+        TEST_CHECK_(mismatches == 0, "xiaGetCubeRegion | %u mismatches", mismatches);
+    }
+
+    TEST_CASE("Index updates");
+    {
+        mismatches = 0;
+
+        /* Index half the map, then write the rest and overwrite some. */
+        retval = xiaIndexCube(c, 4);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaIndexCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        len = make_region_buffer(buffer, 0, 100, REGION_BINS, 2);
+        mismatches += xiaWriteCubeBuffer(c, 1, buffer, len) != XIA_SUCCESS;
+
+        for (i = 6; i < 12; i++) {
+            len = make_region_buffer(buffer, i * 100, 100, REGION_BINS, 2);
+            mismatches += xiaWriteCubeBuffer(c, 1, buffer, len) != XIA_SUCCESS;
+        }
+
+        mismatches += check_cube_region(c, 0, 0, REGION_WIDTH, REGION_HEIGHT);
+        mismatches += check_cube_region(c, 4, 8, 16, 12);
+        mismatches += check_cube_region(c, 3, 2, 17, 11);
+        mismatches += check_cube_region(c, 5, 5, 2, 2);
+        mismatches += check_cube_region(c, 39, 29, 1, 1);
+        mismatches += check_cube_region(c, 1, 13, 38, 3);
+
+        TEST_CHECK_(mismatches == 0, "xiaGetCubeRegion | %u mismatches", mismatches);
+    }
+
+    TEST_CASE("Reindex");
+    {
+        retval = xiaIndexCube(c, 0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaIndexCube | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        mismatches = check_cube_region(c, 0, 0, REGION_WIDTH, REGION_HEIGHT);
+        mismatches += check_cube_region(c, 7, 3, 30, 20);
+
+        TEST_CHECK_(mismatches == 0, "xiaGetCubeRegion | %u mismatches", mismatches);
+    }
+
+    TEST_CASE("Bad region");
+    {
+        retval = xiaGetCubeRegion(c, 1, 30, 0, 11, 1, spectrum, &stats);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetCubeRegion | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaGetCubeRegion(c, 2, 0, 0, 1, 1, spectrum, &stats);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetCubeRegion | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaGetCubeRegion(c, 1, 0, 0, 1, 1, NULL, &stats);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGetCubeRegion | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    xiaCloseCube(c);
+    free(buffer);
+    TEST_CHECK(remove(path) == 0);
+    TEST_MSG("unable to remove %s", path);
+    cleanup();
+}
+
+#define REGION_BENCH_SIDE 256
+#define REGION_BENCH_BINS 1024
+#define REGION_BENCH_QUERIES 20
+
+void cube_region_throughput(void) {
+    int retval = XIA_SUCCESS;
+    unsigned int i;
+    unsigned int b;
+    unsigned int mismatches = 0;
+    unsigned long len;
+    unsigned long* buffer;
+    uint64_t* indexed;
+    uint64_t* scanned;
+    double start;
+    double indexTime;
+    double scanTime;
+    XiaRegionStats stats;
+    XiaCube* c = NULL;
+    const char* path = "test_cube_bench.xcb";
+    xiaSuppressLogOutput();
+
+    buffer = malloc((MAP_BUFFER_HEADER_SIZE +
+                     256 * (MAP_MCA_PIXEL_HEADER_SIZE + REGION_BENCH_BINS)) *
+                    sizeof(unsigned long));
+    indexed = malloc(REGION_BENCH_BINS * sizeof(uint64_t));
+    scanned = malloc(REGION_BENCH_BINS * sizeof(uint64_t));
+    TEST_ASSERT(buffer != NULL && indexed != NULL && scanned != NULL);
+
+    retval = xiaCreateCube(path, REGION_BENCH_SIDE, REGION_BENCH_SIDE, 1,
+                           REGION_BENCH_BINS, &c);
+    TEST_ASSERT(retval == XIA_SUCCESS);
+
+    retval = xiaIndexCube(c, 8);
+    TEST_ASSERT(retval == XIA_SUCCESS);
+
+    for (i = 0; i < REGION_BENCH_SIDE * REGION_BENCH_SIDE / 256 && retval == XIA_SUCCESS;
+         i++) {
+        len = make_region_buffer(buffer, i * 256, 256, REGION_BENCH_BINS, 1);
+        retval = xiaWriteCubeBuffer(c, 0, buffer, len);
+    }
+
+    TEST_CHECK(retval == XIA_SUCCESS);
+    TEST_MSG("xiaWriteCubeBuffer | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+    TEST_CASE("Indexed");
+    {
+        start = handel_md_clock();
+
+        for (i = 0; i < REGION_BENCH_QUERIES; i++) {
+            retval = xiaGetCubeRegion(c, 0, 3 + i, 5, 240 - i, 245, indexed, &stats);
+        }
+
+        indexTime = (handel_md_clock() - start) / REGION_BENCH_QUERIES;
+
+        TEST_CHECK_(retval == XIA_SUCCESS, "Indexed | %.1f us per region",
+                    indexTime * 1e6);
+        TEST_MSG("xiaGetCubeRegion | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+
+    TEST_CASE("Scanned");
+    {
+        xiaCloseCube(c);
+
+        retval = xiaOpenCube(path, &c);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        start = handel_md_clock();
+
+        for (i = 0; i < REGION_BENCH_QUERIES; i++) {
+            retval = xiaGetCubeRegion(c, 0, 3 + i, 5, 240 - i, 245, scanned, &stats);
+        }
+
+        scanTime = (handel_md_clock() - start) / REGION_BENCH_QUERIES;
+
+        for (b = 0; b < REGION_BENCH_BINS; b++) {
+            mismatches += indexed[b] != scanned[b];
+        }
+
+        TEST_CHECK_(mismatches == 0,
+                    "Scanned | %u mismatches, %.1f us per region, %.1fx slower",
+                    mismatches, scanTime * 1e6, scanTime / (indexTime + 1e-12));
+    }
+
+    xiaCloseCube(c);
+    free(buffer);
+    free(indexed);
+    free(scanned);
+    TEST_CHECK(remove(path) == 0);
+    TEST_MSG("unable to remove %s", path);
+    cleanup();
+}
+
+void decode_list_buffer(void) {
+    int retval;
+    unsigned int mismatches = 0;
+    unsigned long i;
+    unsigned long n;
+    unsigned long len;
+    unsigned long decoded = 0;
+    unsigned long buffer[2 * (MAP_BUFFER_HEADER_SIZE + LIST_TEST_EVENTS * 6 + 3)];
+    XiaListDecoder decoder;
+    XiaListEvents events;
+    xiaSuppressLogOutput();
+
+    memset(&decoder, 0, sizeof(decoder));
+    memset(&events, 0, sizeof(events));
+
+    TEST_CASE("Null arguments");
+    {
+        retval = xiaDecodeListBuffer(NULL, buffer, 0, &events);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaDecodeListBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Clock variant");
+    {
+        len = make_list_buffer(buffer, 2, 0, LIST_TEST_EVENTS);
+
+        retval = xiaDecodeListBuffer(&decoder, buffer, len, &events);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDecodeListBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        TEST_CHECK(events.nEvents == LIST_TEST_EVENTS && decoder.variant == 2 &&
+                   decoder.runNumber == 1);
+        TEST_MSG("Shape | %zu events, variant %u, run %u", events.nEvents,
+                 decoder.variant, decoder.runNumber);
+
+        mismatches = check_list_events(&events, 0, FALSE_);
+        TEST_CHECK(mismatches == 0);
+        TEST_MSG("Decoded values | %u mismatches", mismatches);
+    }
+
+    TEST_CASE("Resume across calls");
+    {
+        xiaResetListDecoder(&decoder);
+
+        len = make_list_buffer(buffer, 0, 0, LIST_TEST_EVENTS);
+        len += make_list_buffer(buffer + len, 0, LIST_TEST_EVENTS, LIST_TEST_EVENTS);
+        mismatches = 0;
+
+        /* Seven words at a time splits headers and records alike. */
+        for (i = 0; i < len; i += n) {
+            n = MIN(7, len - i);
+
+            retval = xiaDecodeListBuffer(&decoder, buffer + i, n, &events);
+
+            if (retval != XIA_SUCCESS) {
+                break;
+            }
+
+            mismatches += check_list_events(&events, decoded, TRUE_);
+            decoded += events.nEvents;
+        }
+
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDecodeListBuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        TEST_CHECK(decoded == 2 * LIST_TEST_EVENTS && mismatches == 0);
+        TEST_MSG("Decoded values | %lu events, %u mismatches", decoded, mismatches);
+    }
+
+    TEST_CASE("Malformed buffers");
+    {
+        len = make_list_buffer(buffer, 2, 0, LIST_TEST_EVENTS);
+
+        buffer[65] = 3;
+        xiaResetListDecoder(&decoder);
+        retval = xiaDecodeListBuffer(&decoder, buffer, len, &events);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("Short records | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
+
+        buffer[64] = 16;
+        xiaResetListDecoder(&decoder);
+        retval = xiaDecodeListBuffer(&decoder, buffer, len, &events);
+        TEST_CHECK(retval == XIA_UNKNOWN_LIST_MODE_VARIANT);
+        TEST_MSG("PMT variant | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_UNKNOWN_LIST_MODE_VARIANT));
+
+        buffer[3] = 1;
+        xiaResetListDecoder(&decoder);
+        retval = xiaDecodeListBuffer(&decoder, buffer, len, &events);
+        TEST_CHECK(retval == XIA_UNKNOWN_MAPPING);
+        TEST_MSG("MCA buffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_UNKNOWN_MAPPING));
+    }
+
+    retval = xiaFreeListEvents(&events);
+    TEST_CHECK(retval == XIA_SUCCESS && events.timestamp == NULL);
+    TEST_MSG("xiaFreeListEvents | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    cleanup();
+}
+
+#define LIST_BENCH_EVENTS 65535
+#define LIST_BENCH_PASSES 20
+
+/*
+ * Times decoding a full clock-variant buffer, whole and in 4096-word
+ * chunks. Run with -v to see the throughput.
+ */
+void decode_list_throughput(void) {
+    int retval = XIA_SUCCESS;
+    int pass;
+    unsigned long i;
+    unsigned long len;
+    unsigned long decoded;
+    unsigned long* buffer;
+    double start;
+    double rate;
+    XiaListDecoder decoder;
+    XiaListEvents events;
+    xiaSuppressLogOutput();
+
+    memset(&events, 0, sizeof(events));
+
+    buffer = malloc((MAP_BUFFER_HEADER_SIZE + LIST_BENCH_EVENTS * 4 + 3) *
+                    sizeof(unsigned long));
+    TEST_ASSERT(buffer != NULL);
+
+    len = make_list_buffer(buffer, 2, 0, LIST_BENCH_EVENTS);
+
+    TEST_CASE("Whole buffer");
+    {
+        decoded = 0;
+        start = handel_md_clock();
+
+        for (pass = 0; pass < LIST_BENCH_PASSES && retval == XIA_SUCCESS; pass++) {
+            xiaResetListDecoder(&decoder);
+            retval = xiaDecodeListBuffer(&decoder, buffer, len, &events);
+            decoded += events.nEvents;
+        }
+
+        rate = decoded / (handel_md_clock() - start + 1e-9);
+
+        TEST_CHECK_(retval == XIA_SUCCESS &&
+                        decoded == LIST_BENCH_PASSES * LIST_BENCH_EVENTS,
+                    "Whole buffer | %lu events, %.1f Mevents/s", decoded, rate / 1e6);
+    }
+
+    TEST_CASE("4096-word chunks");
+    {
+        decoded = 0;
+        start = handel_md_clock();
+
+        for (pass = 0; pass < LIST_BENCH_PASSES && retval == XIA_SUCCESS; pass++) {
+            xiaResetListDecoder(&decoder);
+
+            for (i = 0; i < len && retval == XIA_SUCCESS; i += 4096) {
+                retval = xiaDecodeListBuffer(&decoder, buffer + i, MIN(4096, len - i),
+                                             &events);
+                decoded += events.nEvents;
+            }
+        }
+
+        rate = decoded / (handel_md_clock() - start + 1e-9);
+
+        TEST_CHECK_(retval == XIA_SUCCESS &&
+                        decoded == LIST_BENCH_PASSES * LIST_BENCH_EVENTS,
+                    "Chunks | %lu events, %.1f Mevents/s", decoded, rate / 1e6);
+    }
+
+    free(buffer);
+    xiaFreeListEvents(&events);
+    cleanup();
+}
+
+#define MCA_TEST_PIXELS 3
+#define MCA_TEST_BINS 37
+
+/*
+ * Writes an MCA mapping buffer with the given spectrum size per channel.
+ * Bin b of channel c of pixel p holds (p * 4 + c) * 1000 + b.
+ */
+static unsigned long make_mca_buffer(unsigned long* buffer, const unsigned int* sizes) {
+    unsigned long p;
+    unsigned long c;
+    unsigned long b;
+    unsigned long block = MAP_MCA_PIXEL_HEADER_SIZE;
+    unsigned long total;
+    unsigned long* pixel;
+
+    for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+        block += sizes[c];
+    }
+
+    total = MAP_BUFFER_HEADER_SIZE + MCA_TEST_PIXELS * block;
+    pixel = make_buffer_header(buffer, total, MAP_MODE_MCA, MCA_TEST_PIXELS);
+
+    set_map_word32(buffer + MAP_BH_BUFFER_NUMBER, 0x00010002);
+    buffer[MAP_BH_BUFFER_ID] = 1;
+    set_map_word32(buffer + MAP_BH_START_PIXEL, 100);
+
+    for (p = 0; p < MCA_TEST_PIXELS; p++, pixel += block) {
+        unsigned long* spectrum =
+            make_pixel_header(pixel, MAP_MODE_MCA, 100 + p, block, sizes);
+
+        for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+            set_pixel_stats(pixel, c, 0x10000 + 10 * p + c, 0, 7, 0);
+
+            for (b = 0; b < sizes[c]; b++) {
+                *spectrum++ = (p * 4 + c) * 1000 + b;
+            }
+        }
+    }
+
+    return total;
+}
+
+void decode_mca_buffer(void) {
+    int retval;
+    unsigned int p;
+    unsigned int c;
+    unsigned int b;
+    unsigned int mismatches = 0;
+    unsigned int sizes[4] = {MCA_TEST_BINS, MCA_TEST_BINS, MCA_TEST_BINS,
+                             MCA_TEST_BINS};
+    unsigned long len;
+    unsigned long buffer[MAP_BUFFER_HEADER_SIZE +
+                         MCA_TEST_PIXELS *
+                             (MAP_MCA_PIXEL_HEADER_SIZE + 4 * MCA_TEST_BINS)];
+    XiaMCAPixels pixels;
+    xiaSuppressLogOutput();
+
+    memset(&pixels, 0, sizeof(pixels));
+
+    TEST_CASE("Null arguments");
+    {
+        retval = xiaDecodeMCABuffer(NULL, 0, &pixels);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaDecodeMCABuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Four channels");
+    {
+        len = make_mca_buffer(buffer, sizes);
+
+        retval = xiaDecodeMCABuffer(buffer, len, &pixels);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDecodeMCABuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        TEST_CHECK(pixels.nPixels == MCA_TEST_PIXELS && pixels.nChannels == 4 &&
+                   pixels.mcaLength == MCA_TEST_BINS);
+        TEST_MSG("Shape | %u pixels, %u channels, %u bins", pixels.nPixels,
+                 pixels.nChannels, pixels.mcaLength);
+
+        TEST_CHECK(pixels.bufferId == 1 && pixels.bufferNumber == 0x10002 &&
+                   pixels.startPixel == 100);
+        TEST_MSG("Header | buffer %u, number %lu, start %lu", pixels.bufferId,
+                 pixels.bufferNumber, pixels.startPixel);
+
+        for (p = 0; p < pixels.nPixels; p++) {
+            mismatches += pixels.pixel[p] != 100 + p;
+
+            for (c = 0; c < 4; c++) {
+                unsigned int k = p * 4 + c;
+
+                mismatches += pixels.realtime[k] != 10 * p + c + 0x10000;
+                mismatches += pixels.triggers[k] != 7;
+
+                for (b = 0; b < MCA_TEST_BINS; b++) {
+                    mismatches += pixels.spectra[k * MCA_TEST_BINS + b] != k * 1000 + b;
+                }
+            }
+        }
+
+        TEST_CHECK(mismatches == 0);
+        TEST_MSG("Decoded values | %u mismatches", mismatches);
+    }
+
+    TEST_CASE("One channel");
+    {
+        sizes[1] = sizes[2] = sizes[3] = 0;
+        len = make_mca_buffer(buffer, sizes);
+
+        retval = xiaDecodeMCABuffer(buffer, len, &pixels);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDecodeMCABuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        TEST_CHECK(pixels.nChannels == 1 && pixels.spectra[MCA_TEST_BINS] == 4000);
+        TEST_MSG("Shape | %u channels, pixel 1 starts with %u", pixels.nChannels,
+                 pixels.spectra[MCA_TEST_BINS]);
+    }
+
+    TEST_CASE("Malformed buffers");
+    {
+        retval = xiaDecodeMCABuffer(buffer, len - 1, &pixels);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("Short buffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
+
+        buffer[MAP_BUFFER_HEADER_SIZE + MAP_MCA_PIXEL_HEADER_SIZE + MCA_TEST_BINS] =
+            0x1234;
+        retval = xiaDecodeMCABuffer(buffer, len, &pixels);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("Bad pixel tag | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
+
+        buffer[3] = 2;
+        retval = xiaDecodeMCABuffer(buffer, len, &pixels);
+        TEST_CHECK(retval == XIA_UNKNOWN_MAPPING);
+        TEST_MSG("SCA buffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_UNKNOWN_MAPPING));
+
+        buffer[0] = 0;
+        retval = xiaDecodeMCABuffer(buffer, len, &pixels);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("Bad buffer tag | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
+    }
+
+    retval = xiaFreeMCAPixels(&pixels);
+    TEST_CHECK(retval == XIA_SUCCESS && pixels.spectra == NULL);
+    TEST_MSG("xiaFreeMCAPixels | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    cleanup();
+}
+
+#define SCA_TEST_PIXELS 3
+
+/*
+ * Writes an SCA mapping buffer with the given number of SCAs per channel.
+ * SCA r of channel c of pixel p counts (p << 24) + (c << 16) + r, except
+ * that the last SCA of channel 0 has the top bit set.
+ */
+static unsigned long make_sca_buffer(unsigned long* buffer,
+                                     const unsigned int* counts) {
+    unsigned long p;
+    unsigned long c;
+    unsigned long r;
+    unsigned long block = MAP_SCA_PIXEL_HEADER_SIZE;
+    unsigned long total;
+    unsigned long* pixel;
+
+    for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+        block += 2 * counts[c];
+    }
+
+    total = MAP_BUFFER_HEADER_SIZE + SCA_TEST_PIXELS * block;
+    pixel = make_buffer_header(buffer, total, MAP_MODE_SCA, SCA_TEST_PIXELS);
+
+    for (p = 0; p < SCA_TEST_PIXELS; p++, pixel += block) {
+        unsigned long* counter =
+            make_pixel_header(pixel, MAP_MODE_SCA, p, block, counts);
+
+        for (c = 0; c < MAP_MAX_CHANNELS; c++) {
+            set_pixel_stats(pixel, c, 100, 50, 300, 200);
+
+            for (r = 0; r < counts[c]; r++, counter += 2) {
+                unsigned long value = (p << 24) + (c << 16) + r;
+
+                if (c == 0 && r == counts[c] - 1) {
+                    value |= 0x80000000;
+                }
+
+                set_map_word32(counter, value);
+            }
+        }
     }
-    cleanup();
+
+    return total;
 }
 
-void add_module_item(void) {
+void decode_sca_buffer(void) {
     int retval;
+    unsigned int p;
+    unsigned int c;
+    unsigned int r;
+    unsigned int mismatches = 0;
+    unsigned int counts[4] = {5, 3, 0, 9};
+    unsigned int channels[3] = {0, 1, 3};
+    unsigned long len;
+    unsigned long buffer[MAP_BUFFER_HEADER_SIZE +
+                         SCA_TEST_PIXELS * (MAP_SCA_PIXEL_HEADER_SIZE + 2 * 17)];
+    XiaSCAPixels pixels;
     xiaSuppressLogOutput();
 
-    TEST_CASE("Null Alias");
-    {
-        retval = xiaAddModuleItem(NULL, NULL, NULL);
-        TEST_CHECK(retval == XIA_NULL_ALIAS);
-        TEST_MSG("xiaAddModuleItem | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_ALIAS));
-    }
+    memset(&pixels, 0, sizeof(pixels));
+    len = make_sca_buffer(buffer, counts);
 
-    TEST_CASE("Null Name");
+    TEST_CASE("Bad flags");
     {
-        retval = xiaAddModuleItem(shared_alias, NULL, NULL);
-        TEST_CHECK(retval == XIA_NULL_NAME);
-        TEST_MSG("xiaAddModuleItem | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
+        retval = xiaDecodeSCABuffer(buffer, len, 0x80, &pixels);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaDecodeSCABuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
     }
 
-    TEST_CASE("Null Value");
+    TEST_CASE("Counters");
     {
-        retval = xiaAddModuleItem(shared_alias, shared_name, NULL);
-        TEST_CHECK(retval == XIA_NULL_VALUE);
-        TEST_MSG("xiaAddModuleItem | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
-    }
+        retval = xiaDecodeSCABuffer(buffer, len, 0, &pixels);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDecodeSCABuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
 
-    TEST_CASE("Unknown item");
-    {
-        create_mod(shared_alias, "udxp", "usb2");
-        retval = xiaAddModuleItem(shared_alias, shared_name, &shared_value);
-        TEST_CHECK(retval == XIA_UNKNOWN_ITEM);
-        TEST_MSG("xiaAddModuleItem | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_UNKNOWN_ITEM));
+        TEST_CHECK(pixels.nPixels == SCA_TEST_PIXELS && pixels.nChannels == 3 &&
+                   pixels.nSCAs == 9);
+        TEST_MSG("Shape | %u pixels, %u channels, %u SCAs", pixels.nPixels,
+                 pixels.nChannels, pixels.nSCAs);
+
+        for (p = 0; p < pixels.nPixels; p++) {
+            for (c = 0; c < 3; c++) {
+                const unsigned int* sca = pixels.sca + (p * 3 + c) * 9;
+
+                for (r = 0; r < 9; r++) {
+                    unsigned int expected = 0;
+
+                    if (r < counts[channels[c]]) {
+                        expected = (p << 24) + (channels[c] << 16) + r;
+                    }
+
+                    if (c == 0 && r == counts[0] - 1) {
+                        expected |= 0x80000000;
+                    }
+
+                    mismatches += sca[r] != expected;
+                }
+
+                mismatches += pixels.livetime[p * 3 + c] != 50;
+            }
+        }
+
+        TEST_CHECK(mismatches == 0);
+        TEST_MSG("Decoded values | %u mismatches", mismatches);
     }
 
-    TEST_CASE("Known item");
+    TEST_CASE("Dead-time correction");
     {
-        retval = xiaAddModuleItem(shared_alias, "device_number", &shared_value);
+        retval = xiaDecodeSCABuffer(buffer, len, XIA_SCA_DEADTIME_CORRECT, &pixels);
         TEST_CHECK(retval == XIA_SUCCESS);
-        TEST_MSG("xiaAddModuleItem | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+        TEST_MSG("xiaDecodeSCABuffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
 
-        int chk = 0;
-        TEST_CHECK(xiaGetModuleItem(shared_alias, "device_number", &chk) ==
-                   XIA_SUCCESS);
-        TEST_CHECK(chk == shared_value);
-        TEST_MSG("%i != %i", chk, shared_value);
-    }
-    cleanup();
-}
+        mismatches = 0;
 
-void board_operation(void) {
-    int retval;
-    xiaSuppressLogOutput();
+        for (r = 0; r < SCA_TEST_PIXELS * 3 * 9; r++) {
+            double expected = 3.0 * pixels.sca[r];
+            mismatches += fabs(pixels.corrected[r] - expected) > 1e-6 * expected;
+        }
 
-    TEST_CASE("Null Name");
-    {
-        retval = xiaBoardOperation(0, NULL, NULL);
-        TEST_CHECK(retval == XIA_NULL_NAME);
-        TEST_MSG("xiaBoardOperation | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
+        TEST_CHECK(mismatches == 0);
+        TEST_MSG("Corrected values | %u not three times the counter", mismatches);
     }
 
-    TEST_CASE("Null Value");
+    TEST_CASE("Malformed buffers");
     {
-        retval = xiaBoardOperation(0, shared_name, NULL);
-        TEST_CHECK(retval == XIA_NULL_VALUE);
-        TEST_MSG("xiaBoardOperation | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
-    }
+        retval = xiaDecodeSCABuffer(buffer, len - 1, 0, &pixels);
+        TEST_CHECK(retval == XIA_MALFORMED_BUFFER);
+        TEST_MSG("Short buffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_MALFORMED_BUFFER));
 
-    TEST_CASE("Bad det-chan");
-    {
-        retval = xiaBoardOperation(0, shared_name, &shared_value);
-        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
-        TEST_MSG("xiaBoardOperation | %s",
-                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+        buffer[3] = 1;
+        retval = xiaDecodeSCABuffer(buffer, len, 0, &pixels);
+        TEST_CHECK(retval == XIA_UNKNOWN_MAPPING);
+        TEST_MSG("MCA buffer | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_UNKNOWN_MAPPING));
     }
-    cleanup();
-}
 
-void close_log(void) {
-    xiaSuppressLogOutput();
-    int retval = xiaCloseLog();
-    TEST_CHECK(retval == XIA_SUCCESS);
-    TEST_MSG("xiaCloseLog | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    retval = xiaFreeSCAPixels(&pixels);
+    TEST_CHECK(retval == XIA_SUCCESS && pixels.sca == NULL);
+    TEST_MSG("xiaFreeSCAPixels | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
     cleanup();
 }
 
@@ -1276,6 +2875,66 @@ void init_handel(void) {
     cleanup();
 }
 
+void io_scheduling(void) {
+    int retval;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad policy");
+    {
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_RR + 1, 0, -1, 0);
+        TEST_CHECK(retval == DXP_MDINVALIDPRIORITY);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_MDINVALIDPRIORITY));
+    }
+
+    TEST_CASE("Bad priority");
+    {
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_OTHER, 20, -1, 0);
+        TEST_CHECK(retval == DXP_MDINVALIDPRIORITY);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_MDINVALIDPRIORITY));
+
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_FIFO, 0, -1, 0);
+        TEST_CHECK(retval == DXP_MDINVALIDPRIORITY);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_MDINVALIDPRIORITY));
+    }
+
+    TEST_CASE("Bad CPU");
+    {
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_OTHER, 0, 1 << 20, 0);
+        TEST_CHECK(retval == DXP_MDINVALIDPRIORITY);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_MDINVALIDPRIORITY));
+    }
+
+    TEST_CASE("Bad flags");
+    {
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_OTHER, 0, -1, 0x80);
+        TEST_CHECK(retval == DXP_MDINVALIDPRIORITY);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_MDINVALIDPRIORITY));
+    }
+
+    TEST_CASE("Success");
+    {
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_OTHER, 0, 0, 0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaSetIOScheduling(XIA_IO_SCHED_OTHER, 0, -1, 0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetIOScheduling | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaSetIOPriority(0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetIOPriority | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+    cleanup();
+}
+
 void load_system(void) {
     int retval;
     xiaSuppressLogOutput();
@@ -1314,6 +2973,364 @@ void load_system(void) {
     cleanup();
 }
 
+void map_tune(void) {
+    int retval;
+    XiaMapTune tune;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad det-chan");
+    {
+        retval = xiaSetMapTune(0, 4, 0.0, 0);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaSetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+
+        retval = xiaGetMapTune(0, &tune);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaGetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+    }
+
+    TEST_CASE("Null result");
+    {
+        retval = xiaGetMapTune(0, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Bad settings");
+    {
+        retval = xiaInit("configs/udxp_usb2.ini");
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaInit | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaSetMapTune(0, 4, 0.5, 0);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaSetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaSetMapTune(0, 4, 0.0, 0x80);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaSetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaGetMapTune(0, &tune);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Enable and disable");
+    {
+        retval = xiaSetMapTune(0, 4, 0.0, XIA_MAP_TUNE_APPLY);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetMapTune | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaGetMapTune(0, &tune);
+        TEST_CHECK(retval == XIA_SUCCESS && tune.nBuffers == 0 && !tune.complete);
+        TEST_MSG("xiaGetMapTune | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaSetMapTune(0, 0, 0.0, 0);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetMapTune | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaGetMapTune(0, &tune);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetMapTune | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+    cleanup();
+}
+
+#define MERGE_TEST_EVENTS 10
+
+struct merge_events {
+    XiaListEvents events;
+    uint64_t timestamp[MERGE_TEST_EVENTS];
+    unsigned short energy[MERGE_TEST_EVENTS];
+    unsigned char channel[MERGE_TEST_EVENTS];
+    unsigned short flags[MERGE_TEST_EVENTS];
+    unsigned long pixel[MERGE_TEST_EVENTS];
+};
+
+/*
+ * Fills n events timed first, first + step, ... with the energy set to the
+ * stream number.
+ */
+static XiaListEvents* make_merge_events(struct merge_events* m, size_t n,
+                                        uint64_t first, uint64_t step,
+                                        unsigned short stream) {
+    size_t i;
+
+    memset(m, 0, sizeof(*m));
+
+    m->events.nEvents = n;
+    m->events.timestamp = m->timestamp;
+    m->events.energy = m->energy;
+    m->events.channel = m->channel;
+    m->events.flags = m->flags;
+    m->events.pixel = m->pixel;
+
+    for (i = 0; i < n; i++) {
+        m->timestamp[i] = first + i * step;
+        m->energy[i] = stream;
+    }
+
+    return &m->events;
+}
+
+void merge_list_events(void) {
+    int retval;
+    unsigned int i;
+    unsigned int s;
+    unsigned int mismatches = 0;
+    unsigned int streams[100];
+    struct merge_events m;
+    XiaListMerger* merger = NULL;
+    XiaListMerger* small = NULL;
+    XiaListEvents events;
+    xiaSuppressLogOutput();
+
+    memset(&events, 0, sizeof(events));
+
+    TEST_CASE("Bad arguments");
+    {
+        retval = xiaCreateListMerger(0, 16, &merger);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaCreateListMerger | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaCreateListMerger(3, 16, &merger);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaPushListEvents(merger, 3, make_merge_events(&m, 1, 0, 1, 3));
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaPushListEvents | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaPopListEvents(merger, 10, NULL, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaPopListEvents | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Watermark");
+    {
+        /* Streams 0, 1 and 2 take turns: stream 2 is two ticks ahead. */
+        xiaSetListMergerOffset(merger, 2, 2);
+        xiaPushListEvents(merger, 0, make_merge_events(&m, MERGE_TEST_EVENTS, 0, 3, 0));
+        xiaPushListEvents(merger, 1, make_merge_events(&m, MERGE_TEST_EVENTS, 1, 3, 1));
+
+        retval = xiaPopListEvents(merger, 100, &events, streams);
+        TEST_CHECK(retval == XIA_SUCCESS && events.nEvents == 0);
+        TEST_MSG("Stream 2 not started | %zu events", events.nEvents);
+
+        xiaPushListEvents(merger, 2, make_merge_events(&m, MERGE_TEST_EVENTS, 0, 3, 2));
+
+        retval = xiaPopListEvents(merger, 10, &events, streams);
+        TEST_CHECK(retval == XIA_SUCCESS && events.nEvents == 10);
+        TEST_MSG("First pop | %zu events", events.nEvents);
+
+        for (i = 0; i < events.nEvents; i++) {
+            mismatches += events.timestamp[i] != i || streams[i] != i % 3 ||
+                          events.energy[i] != i % 3;
+        }
+
+        /* Stream 0 ends at 27, so the rest wait for the streams to finish. */
+        retval = xiaPopListEvents(merger, 100, &events, streams);
+        TEST_CHECK(retval == XIA_SUCCESS && events.nEvents == 18);
+        TEST_MSG("Second pop | %zu events", events.nEvents);
+
+        for (i = 0; i < events.nEvents; i++) {
+            mismatches += events.timestamp[i] != i + 10 || streams[i] != (i + 10) % 3;
+        }
+
+        for (s = 0; s < 3; s++) {
+            xiaFinishListStream(merger, s);
+        }
+
+        retval = xiaPopListEvents(merger, 100, &events, streams);
+        TEST_CHECK(retval == XIA_SUCCESS && events.nEvents == 2);
+        TEST_MSG("After finishing | %zu events", events.nEvents);
+
+        for (i = 0; i < events.nEvents; i++) {
+            mismatches += events.timestamp[i] != i + 28 || streams[i] != (i + 28) % 3;
+        }
+
+        TEST_CHECK(mismatches == 0);
+        TEST_MSG("Merged order | %u mismatches", mismatches);
+
+        retval = xiaPushListEvents(merger, 0, make_merge_events(&m, 1, 100, 1, 0));
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("Finished stream | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Bounded streams");
+    {
+        retval = xiaCreateListMerger(1, 4, &small);
+        TEST_ASSERT(retval == XIA_SUCCESS);
+
+        retval = xiaPushListEvents(small, 0, make_merge_events(&m, 5, 0, 1, 0));
+        TEST_CHECK(retval == XIA_STREAM_FULL);
+        TEST_MSG("Too many events | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_STREAM_FULL));
+
+        retval = xiaPushListEvents(small, 0, make_merge_events(&m, 4, 0, 1, 0));
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("Full stream | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        xiaPopListEvents(small, 2, &events, NULL);
+
+        retval = xiaPushListEvents(small, 0, make_merge_events(&m, 2, 4, 1, 0));
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("After popping | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaPushListEvents(small, 0, make_merge_events(&m, 1, 0, 1, 0));
+        TEST_CHECK(retval == XIA_STREAM_FULL);
+        TEST_MSG("Full stream | %s", tst_msg(errmsg, MSGLEN, retval, XIA_STREAM_FULL));
+
+        xiaPopListEvents(small, 2, &events, NULL);
+
+        retval = xiaPushListEvents(small, 0, make_merge_events(&m, 1, 0, 1, 0));
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("Earlier event | %s", tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    xiaDestroyListMerger(small);
+    xiaDestroyListMerger(merger);
+    xiaFreeListEvents(&events);
+    cleanup();
+}
+
+#define MERGE_BENCH_STREAMS 20
+#define MERGE_BENCH_CHUNK 1024
+#define MERGE_BENCH_CHUNKS 50
+
+struct merge_producer {
+    handel_md_Thread thread;
+    handel_md_Event done;
+    XiaListMerger* merger;
+    int status;
+};
+
+/*
+ * Pushes MERGE_BENCH_CHUNKS chunks to each stream in turn, event i of
+ * stream s being timed i * MERGE_BENCH_STREAMS + s, waiting while a
+ * stream is full.
+ */
+static void merge_producer_main(void* arg) {
+    int status = XIA_SUCCESS;
+    unsigned int c;
+    unsigned int s;
+    unsigned int i;
+    struct merge_producer* producer = (struct merge_producer*) arg;
+    XiaListEvents events;
+
+    memset(&events, 0, sizeof(events));
+    events.nEvents = MERGE_BENCH_CHUNK;
+    events.timestamp = malloc(MERGE_BENCH_CHUNK * sizeof(uint64_t));
+    events.energy = calloc(MERGE_BENCH_CHUNK, sizeof(unsigned short));
+    events.channel = calloc(MERGE_BENCH_CHUNK, sizeof(unsigned char));
+    events.flags = calloc(MERGE_BENCH_CHUNK, sizeof(unsigned short));
+    events.pixel = calloc(MERGE_BENCH_CHUNK, sizeof(unsigned long));
+
+    for (c = 0; c < MERGE_BENCH_CHUNKS && status == XIA_SUCCESS; c++) {
+        for (s = 0; s < MERGE_BENCH_STREAMS && status == XIA_SUCCESS; s++) {
+            for (i = 0; i < MERGE_BENCH_CHUNK; i++) {
+                events.timestamp[i] =
+                    (uint64_t) (c * MERGE_BENCH_CHUNK + i) * MERGE_BENCH_STREAMS + s;
+            }
+
+            while ((status = xiaPushListEvents(producer->merger, s, &events)) ==
+                   XIA_STREAM_FULL) {
+                handel_md_thread_sleep(0);
+            }
+        }
+    }
+
+    for (s = 0; s < MERGE_BENCH_STREAMS; s++) {
+        xiaFinishListStream(producer->merger, s);
+    }
+
+    free(events.timestamp);
+    free(events.energy);
+    free(events.channel);
+    free(events.flags);
+    free(events.pixel);
+
+    producer->status = status;
+    handel_md_event_signal(&producer->done);
+}
+
+/*
+ * Merges the streams of a 20-module crate pushed by another thread. Run
+ * with -v to see the throughput.
+ */
+void merge_list_throughput(void) {
+    int retval = XIA_SUCCESS;
+    size_t i;
+    size_t merged = 0;
+    size_t total =
+        (size_t) MERGE_BENCH_STREAMS * MERGE_BENCH_CHUNKS * MERGE_BENCH_CHUNK;
+    unsigned int unordered = 0;
+    uint64_t last = 0;
+    double start;
+    double rate;
+    struct merge_producer producer;
+    XiaListEvents events;
+    xiaSuppressLogOutput();
+
+    memset(&events, 0, sizeof(events));
+    memset(&producer, 0, sizeof(producer));
+
+    retval = xiaCreateListMerger(MERGE_BENCH_STREAMS, 4 * MERGE_BENCH_CHUNK,
+                                 &producer.merger);
+    TEST_ASSERT(retval == XIA_SUCCESS);
+
+    producer.done.name = "producer";
+    producer.thread.name = "producer";
+    producer.thread.state = handel_md_ThreadsDetached;
+    producer.thread.entryPoint = merge_producer_main;
+    producer.thread.argument = &producer;
+
+    TEST_ASSERT(handel_md_event_create(&producer.done) == THREADING_NO_ERROR);
+
+    start = handel_md_clock();
+
+    TEST_ASSERT(handel_md_thread_create(&producer.thread) == THREADING_NO_ERROR);
+
+    while (merged < total && retval == XIA_SUCCESS) {
+        retval = xiaPopListEvents(producer.merger, 4096, &events, NULL);
+
+        for (i = 0; i < events.nEvents; i++) {
+            unordered += events.timestamp[i] != last + (merged + i > 0);
+            last = events.timestamp[i];
+        }
+
+        merged += events.nEvents;
+
+        if (events.nEvents == 0) {
+            handel_md_thread_sleep(0);
+        }
+    }
+
+    rate = merged / (handel_md_clock() - start + 1e-9);
+
+    handel_md_event_wait(&producer.done, 0);
+    handel_md_event_destroy(&producer.done);
+
+    TEST_CHECK_(retval == XIA_SUCCESS && producer.status == XIA_SUCCESS &&
+                    merged == total && unordered == 0,
+                "Merge | %zu of %zu events, %u out of order, %.1f Mevents/s", merged,
+                total, unordered, rate / 1e6);
+
+    xiaDestroyListMerger(producer.merger);
+    xiaFreeListEvents(&events);
+    cleanup();
+}
+
 void modify_detector_item(void) {
     int retval;
     xiaSuppressLogOutput();
@@ -1891,6 +3908,203 @@ void remove_module(void) {
     cleanup();
 }
 
+static int request_callback_status;
+
+static void request_callback(XiaRequest* request, int status, void* arg) {
+    (void) request;
+    request_callback_status = status;
+    *((int*) arg) += 1;
+}
+
+static handel_md_Event request_started = {NULL, "request_started"};
+static handel_md_Event request_gate = {NULL, "request_gate"};
+
+/* Holds the pool worker that runs the request until request_gate is signalled. */
+static void blocking_callback(XiaRequest* request, int status, void* arg) {
+    (void) request;
+    (void) status;
+    (void) arg;
+    handel_md_event_signal(&request_started);
+    handel_md_event_wait(&request_gate, 0);
+}
+
+void requests(void) {
+    int retval;
+    int status;
+    int calls = 0;
+    int info = 0;
+    XiaRequest* request = NULL;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Null name");
+    {
+        retval =
+            xiaDoSpecialRunAsync(0, NULL, &info, request_callback, &calls, &request);
+        TEST_CHECK(retval == XIA_NULL_NAME);
+        TEST_MSG("xiaDoSpecialRunAsync | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_NAME));
+    }
+
+    TEST_CASE("No handle or callback");
+    {
+        retval = xiaGainOperationAsync(0, "calibrate", &info, NULL, NULL, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGainOperationAsync | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Null request");
+    {
+        retval = xiaWaitRequest(NULL, 0, &status);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaWaitRequest | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Bad det-chan");
+    {
+        retval = xiaDoSpecialRunAsync(0, "adc_trace", &info, request_callback, &calls,
+                                      &request);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDoSpecialRunAsync | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaWaitRequest(request, 0, &status);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaWaitRequest | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+        TEST_CHECK(status == XIA_INVALID_DETCHAN);
+        TEST_MSG("Request status | %s",
+                 tst_msg(errmsg, MSGLEN, status, XIA_INVALID_DETCHAN));
+        TEST_CHECK(calls == 1 && request_callback_status == XIA_INVALID_DETCHAN);
+        TEST_MSG("Callback | called %d times with %d", calls, request_callback_status);
+    }
+
+    TEST_CASE("Exit with a queued request");
+    {
+        HandelContext* ctx = NULL;
+        XiaRequest* blocker = NULL;
+        unsigned int n = 0;
+
+        calls = 0;
+
+        retval = xiaSetPoolConfig(1, -1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetPoolConfig | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        TEST_ASSERT(handel_md_event_create(&request_started) == THREADING_NO_ERROR);
+        TEST_ASSERT(handel_md_event_create(&request_gate) == THREADING_NO_ERROR);
+
+        /* Keep the only worker busy with a request of the default context. */
+        retval = xiaDoSpecialRunAsync(0, "adc_trace", &info, blocking_callback, NULL,
+                                      &blocker);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaDoSpecialRunAsync | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+        handel_md_event_wait(&request_started, 0);
+
+        retval = xiaContextCreate(&ctx);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaContextCreate | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        xiaContextSelect(ctx);
+        retval = xiaGainOperationAsync(0, "calibrate", &info, request_callback, &calls,
+                                       &request);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaGainOperationAsync | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaExitCtx(ctx);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaExitCtx | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+        TEST_CHECK(calls == 1 && request_callback_status == XIA_INVALID_DETCHAN);
+        TEST_MSG("Queued request | called %d times with %d before the exit returned",
+                 calls, request_callback_status);
+
+        retval = xiaWaitRequest(request, 0, &status);
+        TEST_CHECK(retval == XIA_SUCCESS && status == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaWaitRequest | %s",
+                 tst_msg(errmsg, MSGLEN, status, XIA_INVALID_DETCHAN));
+
+        xiaContextSelect(NULL);
+        retval = xiaContextDestroy(ctx);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaContextDestroy | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        /* The default context's request still holds the pool. */
+        retval = xiaGetPoolSize(&n);
+        TEST_CHECK(retval == XIA_SUCCESS && n == 1);
+        TEST_MSG("xiaGetPoolSize | %u workers after the context exit", n);
+
+        handel_md_event_signal(&request_gate);
+        retval = xiaWaitRequest(blocker, 0, &status);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaWaitRequest | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        handel_md_event_destroy(&request_gate);
+        handel_md_event_destroy(&request_started);
+
+        retval = xiaSetPoolConfig(0, -1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetPoolConfig | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+    cleanup();
+}
+
+static void snapshot_put_string(FILE* fp, const char* str) {
+    uint32_t len = (uint32_t) strlen(str);
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(str, 1, len, fp);
+}
+
+/*
+ * Appends a DSP image object for modChan of alias to a binary snapshot. The
+ * image names the given FiPPI and holds nParams of the declared numParams
+ * parameters.
+ */
+static int append_snapshot_image(const char* file, const char* alias,
+                                  unsigned int modChan, unsigned short numParams,
+                                  unsigned short nParams, const char* fippi) {
+    char name[16];
+    unsigned short i;
+    unsigned char end = 0;
+    FILE* fp = fopen(file, "r+b");
+
+    if (fp == NULL) {
+        return -1;
+    }
+
+    /* Overwrite the end marker. */
+    fseek(fp, -1, SEEK_END);
+    fputc('I', fp);
+    snapshot_put_string(fp, alias);
+
+    snapshot_put_string(fp, "channel");
+    fputc('u', fp);
+    fwrite(&modChan, sizeof(modChan), 1, fp);
+
+    snapshot_put_string(fp, "num_params");
+    fputc('h', fp);
+    fwrite(&numParams, sizeof(numParams), 1, fp);
+
+    snapshot_put_string(fp, "fippi");
+    fputc('s', fp);
+    snapshot_put_string(fp, fippi);
+
+    for (i = 0; i < nParams; i++) {
+        snprintf(name, sizeof(name), "PARAM%hu", i);
+        snapshot_put_string(fp, name);
+        fputc('h', fp);
+        fwrite(&i, sizeof(i), 1, fp);
+    }
+
+    snapshot_put_string(fp, "");
+    fwrite(&end, 1, 1, fp);
+
+    return fclose(fp);
+}
+
 void save_system(void) {
     int retval;
     xiaSuppressLogOutput();
@@ -1990,6 +4204,107 @@ void save_system(void) {
         TEST_CHECK(remove(twodets_ini) == 0);
         TEST_MSG("unable to remove %s", twodets_ini);
     }
+
+    TEST_CASE("Binary snapshot");
+    {
+        char before_ini[] = "test_api-snapshot-before.ini";
+        char after_ini[] = "test_api-snapshot-after.ini";
+        char snapshot[] = "test_api-snapshot.bin";
+
+        retval = xiaSaveSystem("handel_binary_dsp", snapshot);
+        TEST_CHECK(retval == XIA_ILLEGAL_OPERATION);
+        TEST_MSG("xiaSaveSystem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_ILLEGAL_OPERATION));
+
+        retval = xiaSaveSystem("handel_ini", before_ini);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSaveSystem | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaSaveSystem("handel_binary", snapshot);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSaveSystem | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaLoadSystem("handel_binary", snapshot);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaLoadSystem | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        unsigned int num_mods = 0;
+        TEST_CHECK(xiaGetNumModules(&num_mods) == XIA_SUCCESS);
+        TEST_CHECK(num_mods == 2);
+
+        retval = xiaSaveSystem("handel_ini", after_ini);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSaveSystem | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        uint32_t before = xia_crc32_file(before_ini);
+        uint32_t after = xia_crc32_file(after_ini);
+        TEST_CHECK(before == after);
+        TEST_MSG("snapshot round trip changed the system: %u != %u", before, after);
+
+        retval = xiaLoadSystem("handel_binary", before_ini);
+        TEST_CHECK(retval == XIA_FORMAT_ERROR);
+        TEST_MSG("xiaLoadSystem | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_FORMAT_ERROR));
+
+        TEST_CHECK(remove(before_ini) == 0);
+        TEST_MSG("unable to remove %s", before_ini);
+        TEST_CHECK(remove(after_ini) == 0);
+        TEST_MSG("unable to remove %s", after_ini);
+        TEST_CHECK(remove(snapshot) == 0);
+        TEST_MSG("unable to remove %s", snapshot);
+    }
+
+    TEST_CASE("Binary snapshot DSP image");
+    {
+        /*
+         * Capturing and restoring an image needs hardware, so hand-build the
+         * image objects and check that they load and are validated.
+         */
+        char config[] = "configs/udxp_usb2.ini";
+        char snapshot[] = "test_api-snapshot-image.bin";
+
+        char long_name[MAXFILENAME_LEN + 1];
+        memset(long_name, 'f', MAXFILENAME_LEN);
+        long_name[MAXFILENAME_LEN] = '\0';
+
+        struct {
+            unsigned int mod_chan;
+            unsigned short num_params;
+            unsigned short n_params;
+            const char* fippi;
+            int expected;
+        } images[] = {
+            {0, 3, 3, "fippi0.fdd", XIA_SUCCESS},
+            {1, 3, 3, "fippi0.fdd", XIA_FORMAT_ERROR},
+            {0, 3, 2, "fippi0.fdd", XIA_FORMAT_ERROR},
+            {0, 3, 3, long_name, XIA_FORMAT_ERROR},
+        };
+
+        for (size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+            /* Every failed load leaves an empty or partial system behind. */
+            retval = xiaLoadSystem("handel_ini", config);
+            TEST_CHECK(retval == XIA_SUCCESS);
+            TEST_MSG("xiaLoadSystem | %s",
+                     tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+            retval = xiaSaveSystem("handel_binary", snapshot);
+            TEST_CHECK(retval == XIA_SUCCESS);
+            TEST_MSG("xiaSaveSystem | %s",
+                     tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+            TEST_CHECK(append_snapshot_image(snapshot, "module1", images[i].mod_chan,
+                                             images[i].num_params, images[i].n_params,
+                                             images[i].fippi) == 0);
+
+            retval = xiaLoadSystem("handel_binary", snapshot);
+            TEST_CHECK(retval == images[i].expected);
+            TEST_MSG("image %zu: xiaLoadSystem | %s", i,
+                     tst_msg(errmsg, MSGLEN, retval, images[i].expected));
+        }
+
+        TEST_CHECK(remove(snapshot) == 0);
+        TEST_MSG("unable to remove %s", snapshot);
+    }
     cleanup();
 }
 
@@ -2090,6 +4405,49 @@ void set_parameter(void) {
     cleanup();
 }
 
+void set_run_dispatch(void) {
+    int retval;
+    double skew;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad mode");
+    {
+        retval = xiaSetRunDispatch(7);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaSetRunDispatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Null skew");
+    {
+        retval = xiaGetRunStartSkew(NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGetRunStartSkew | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Parallel bad det-chan");
+    {
+        retval = xiaSetRunDispatch(XIA_RUN_DISPATCH_PARALLEL);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetRunDispatch | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaStartRun(0, 0);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaStartRun | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+
+        retval = xiaGetRunStartSkew(&skew);
+        TEST_CHECK(retval == XIA_SUCCESS && skew == 0.0);
+        TEST_MSG("xiaGetRunStartSkew | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        xiaSetRunDispatch(XIA_RUN_DISPATCH_SERIAL);
+    }
+    cleanup();
+}
+
 void start_run(void) {
     int retval;
     xiaSuppressLogOutput();
@@ -2152,6 +4510,256 @@ void update_user_params(void) {
     }
 }
 
+void wait_profile(void) {
+    int retval;
+    unsigned long histogram[XIA_WAIT_HISTOGRAM_BINS];
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad type");
+    {
+        retval = xiaSetWaitProfile(XIA_WAIT_RUN_END + 1, 0.001, 0.00025, 0.01);
+        TEST_CHECK(retval == DXP_BAD_PARAM);
+        TEST_MSG("xiaSetWaitProfile | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_BAD_PARAM));
+
+        retval = xiaGetWaitStats(-1, histogram);
+        TEST_CHECK(retval == DXP_BAD_PARAM);
+        TEST_MSG("xiaGetWaitStats | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_BAD_PARAM));
+    }
+
+    TEST_CASE("Bad intervals");
+    {
+        retval = xiaSetWaitProfile(XIA_WAIT_BUSY, 0.001, 0.01, 0.001);
+        TEST_CHECK(retval == DXP_BAD_PARAM);
+        TEST_MSG("xiaSetWaitProfile | %s",
+                 tst_msg(errmsg, MSGLEN, retval, DXP_BAD_PARAM));
+    }
+
+    TEST_CASE("Null histogram");
+    {
+        retval = xiaGetWaitStats(XIA_WAIT_BUSY, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGetWaitStats | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Success");
+    {
+        retval = xiaSetWaitProfile(XIA_WAIT_BUSY, 0.001, 0.00025, 0.01);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetWaitProfile | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaGetWaitStats(XIA_WAIT_BUSY, histogram);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaGetWaitStats | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+    }
+    cleanup();
+}
+
+void wait_run_complete(void) {
+    int retval;
+    int status;
+    int calls = 0;
+    XiaRequest* request = NULL;
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad timeout");
+    {
+        retval = xiaWaitRunComplete(0, 0.0);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaWaitRunComplete | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Bad det-chan");
+    {
+        retval = xiaWaitRunComplete(0, 1.0);
+        TEST_CHECK(retval == XIA_INVALID_DETCHAN);
+        TEST_MSG("xiaWaitRunComplete | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_INVALID_DETCHAN));
+    }
+
+    TEST_CASE("Bad det-chan callback");
+    {
+        retval = xiaWaitRunCompleteAsync(0, 1.0, request_callback, &calls, &request);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaWaitRunCompleteAsync | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaWaitRequest(request, 0, &status);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaWaitRequest | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+        TEST_CHECK(status == XIA_INVALID_DETCHAN);
+        TEST_MSG("Request status | %s",
+                 tst_msg(errmsg, MSGLEN, status, XIA_INVALID_DETCHAN));
+        TEST_CHECK(calls == 1 && request_callback_status == XIA_INVALID_DETCHAN);
+        TEST_MSG("Callback | called %d times with %d", calls, request_callback_status);
+    }
+    cleanup();
+}
+
+#define POOL_SUBMITTERS 4
+#define POOL_REQUESTS 250
+
+static handel_md_Mutex pool_lock = {NULL, "test_pool"};
+static int pool_calls;
+static int pool_failures;
+static int pool_info;
+
+struct pool_submitter {
+    handel_md_Thread thread;
+    handel_md_Event done;
+    int failures;
+};
+
+static void pool_callback(XiaRequest* request, int status, void* arg) {
+    (void) request;
+    (void) arg;
+    handel_md_mutex_lock(&pool_lock);
+    pool_calls++;
+    if (status != XIA_INVALID_DETCHAN) {
+        pool_failures++;
+    }
+    handel_md_mutex_unlock(&pool_lock);
+}
+
+static void pool_submitter_main(void* arg) {
+    int i;
+    struct pool_submitter* submitter = (struct pool_submitter*) arg;
+
+    for (i = 0; i < POOL_REQUESTS; i++) {
+        if (xiaDoSpecialRunAsync(0, "adc_trace", &pool_info, pool_callback, NULL,
+                                 NULL) != XIA_SUCCESS) {
+            submitter->failures++;
+        }
+    }
+
+    handel_md_event_signal(&submitter->done);
+}
+
+void worker_pool(void) {
+    int retval;
+    int i;
+    int calls = 0;
+    unsigned int n = 0;
+    unsigned int w;
+    unsigned long stats[XIA_POOL_STATS_LEN];
+    unsigned long submitted = 0;
+    unsigned long executed = 0;
+    struct pool_submitter submitters[POOL_SUBMITTERS];
+    xiaSuppressLogOutput();
+
+    TEST_CASE("Bad arguments");
+    {
+        retval = xiaSetPoolConfig(2, 1 << 20);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaSetPoolConfig | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+
+        retval = xiaGetPoolStats(0, NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGetPoolStats | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+
+        retval = xiaGetPoolSize(NULL);
+        TEST_CHECK(retval == XIA_NULL_VALUE);
+        TEST_MSG("xiaGetPoolSize | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_NULL_VALUE));
+    }
+
+    TEST_CASE("Contention");
+    {
+        retval = xiaSetPoolConfig(POOL_SUBMITTERS, -1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetPoolConfig | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        TEST_ASSERT(handel_md_mutex_create(&pool_lock) == THREADING_NO_ERROR);
+        pool_calls = 0;
+        pool_failures = 0;
+
+        for (i = 0; i < POOL_SUBMITTERS; i++) {
+            struct pool_submitter* submitter = &submitters[i];
+
+            memset(submitter, 0, sizeof(*submitter));
+            submitter->done.name = "submitter";
+            submitter->thread.name = "submitter";
+            submitter->thread.state = handel_md_ThreadsDetached;
+            submitter->thread.entryPoint = pool_submitter_main;
+            submitter->thread.argument = submitter;
+
+            TEST_ASSERT(handel_md_event_create(&submitter->done) == THREADING_NO_ERROR);
+            TEST_ASSERT(handel_md_thread_create(&submitter->thread) ==
+                        THREADING_NO_ERROR);
+        }
+
+        for (i = 0; i < POOL_SUBMITTERS; i++) {
+            handel_md_event_wait(&submitters[i].done, 0);
+            handel_md_event_destroy(&submitters[i].done);
+            TEST_CHECK(submitters[i].failures == 0);
+            TEST_MSG("Submitter %d | %d requests not queued", i,
+                     submitters[i].failures);
+        }
+
+        for (i = 0; i < 10000 && calls < POOL_SUBMITTERS * POOL_REQUESTS; i++) {
+            handel_md_thread_sleep(1);
+            handel_md_mutex_lock(&pool_lock);
+            calls = pool_calls;
+            handel_md_mutex_unlock(&pool_lock);
+        }
+
+        TEST_CHECK(calls == POOL_SUBMITTERS * POOL_REQUESTS && pool_failures == 0);
+        TEST_MSG("Callbacks | %d of %d, %d with the wrong status", calls,
+                 POOL_SUBMITTERS * POOL_REQUESTS, pool_failures);
+
+        retval = xiaGetPoolSize(&n);
+        TEST_CHECK(retval == XIA_SUCCESS && n == POOL_SUBMITTERS);
+        TEST_MSG("xiaGetPoolSize | %u workers", n);
+
+        for (w = 0; w < n; w++) {
+            retval = xiaGetPoolStats(w, stats);
+            TEST_CHECK(retval == XIA_SUCCESS);
+            TEST_MSG("xiaGetPoolStats | %s",
+                     tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+            submitted += stats[XIA_POOL_STAT_SUBMITTED];
+            executed += stats[XIA_POOL_STAT_EXECUTED];
+        }
+
+        TEST_CHECK(submitted == POOL_SUBMITTERS * POOL_REQUESTS &&
+                   executed == submitted);
+        TEST_MSG("Pool stats | %lu submitted, %lu executed", submitted, executed);
+
+        retval = xiaGetPoolStats(n, stats);
+        TEST_CHECK(retval == XIA_BAD_VALUE);
+        TEST_MSG("xiaGetPoolStats | %s",
+                 tst_msg(errmsg, MSGLEN, retval, XIA_BAD_VALUE));
+    }
+
+    TEST_CASE("Shutdown");
+    {
+        retval = xiaExit();
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaExit | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        /* Other contexts may still be using the pool. */
+        retval = xiaGetPoolSize(&n);
+        TEST_CHECK(retval == XIA_SUCCESS && n == POOL_SUBMITTERS);
+        TEST_MSG("xiaGetPoolSize | %u workers after xiaExit", n);
+
+        retval = xiaSetPoolConfig(0, -1);
+        TEST_CHECK(retval == XIA_SUCCESS);
+        TEST_MSG("xiaSetPoolConfig | %s", tst_msg(errmsg, MSGLEN, retval, XIA_SUCCESS));
+
+        retval = xiaGetPoolSize(&n);
+        TEST_CHECK(retval == XIA_SUCCESS && n == 0);
+        TEST_MSG("xiaGetPoolSize | %u workers after xiaSetPoolConfig", n);
+
+        handel_md_mutex_destroy(&pool_lock);
+    }
+    cleanup();
+}
+
 void xia_init(void) {
     int retval;
     xiaSuppressLogOutput();
@@ -2194,11 +4802,23 @@ void xia_init(void) {
 }
 
 TEST_LIST = {
+    {"Acquisition Batch", acquisition_batch},
     {"Add Detector Item", add_detector_item},
     {"Add Firmware Item", add_firmware_item},
     {"Add Module Item", add_module_item},
+    {"Archive", archive},
+    {"Archive Throughput", archive_throughput},
     {"Board Operation", board_operation},
+    {"Cancel", cancel},
     {"Close Log", close_log},
+    {"Contexts", contexts},
+    {"Cube", cube},
+    {"Cube Region", cube_region},
+    {"Cube Region Throughput", cube_region_throughput},
+    {"Decode List Buffer", decode_list_buffer},
+    {"Decode List Throughput", decode_list_throughput},
+    {"Decode MCA Buffer", decode_mca_buffer},
+    {"Decode SCA Buffer", decode_sca_buffer},
     {"Do Special Run", do_special_run},
     {"Download Firmware", download_firmware},
     {"Enable Log Output", enable_log_output},
@@ -2224,7 +4844,11 @@ TEST_LIST = {
     {"Get Special Run Data", get_special_run_data},
     {"Get Version Info", get_version_info},
     {"Init Handel", init_handel},
+    {"IO Scheduling", io_scheduling},
     {"Load System", load_system},
+    {"Map Tune", map_tune},
+    {"Merge List Events", merge_list_events},
+    {"Merge List Throughput", merge_list_throughput},
     {"Modify Detector Item", modify_detector_item},
     {"Modify Firmware Item", modify_firmware_item},
     {"Modify Module Item", modify_module_item},
@@ -2235,15 +4859,20 @@ TEST_LIST = {
     {"Remove Detector", remove_detector},
     {"Remove Firmware", remove_firmware},
     {"Remove Module", remove_module},
+    {"Requests", requests},
     {"Save System", save_system},
     {"Set Acquisition Values", set_acquisition_values},
     {"Set Log Level", set_log_level},
     {"Set Log Output", set_log_output},
     {"Set Parameter", set_parameter},
+    {"Set Run Dispatch", set_run_dispatch},
     {"Start Run", start_run},
     {"Stop Run", stop_run},
     {"Suppress Log Output", suppress_log_output},
     {"Update User Params", update_user_params},
+    {"Wait Profile", wait_profile},
+    {"Wait Run Complete", wait_run_complete},
+    {"Worker Pool", worker_pool},
     {"XIA Init", xia_init},
     {NULL, NULL} /* zeroed record marking the end of the list */
 };
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 
 #if _WIN32
@@ -26,6 +27,7 @@
 #include "handel_errors.h"
 #include "handel_constants.h"
 #include "md_generic.h"
+#include "md_threads.h"
 
 /* generic helper functions */
 static void CHECK_ERROR(int status);
@@ -44,6 +46,8 @@ static void test_preamp_gain();
 static void test_rc_decay_and_calibration();
 static void test_adc_settings();
 static void test_baseline_factor();
+static void test_acquisition_batch();
+static void test_cancel_run();
 
 boolean_t stop = FALSE_;
 
@@ -68,6 +72,8 @@ int main(int argc, char* argv[]) {
     test_preamp_gain();
     test_adc_settings();
     test_rc_decay_and_calibration();
+    test_acquisition_batch();
+    test_cancel_run();
 
     clean_up();
     return 0;
@@ -508,3 +514,169 @@ static void test_adc_settings() {
         traceinfo[1] /= 1.0e-9;
     }
 }
+
+/*
+ * Acquisition value batch: setting several values in a batch must leave the
+ * same DSP parameters as setting them one at a time.
+ */
+static void test_acquisition_batch() {
+    int status;
+    int ignored = 0;
+    int i;
+
+    char* names[5] = {"peaking_time", "preamp_gain", "dynamic_range", "mca_bin_width",
+                      "trigger_threshold"};
+    double values[5] = {2.0, 2.5, 20000., 15., 500.};
+    double value;
+    double readout;
+
+    char* params[6] = {"SLOWLEN", "SLOWGAP", "PEAKINT",
+                       "SWGAIN",  "MCAGAIN", "THRESHOLD"};
+    parameter_t expected[6];
+    parameter_t actual;
+
+    printf("\nAcquisition value batch\n");
+
+    for (i = 0; i < 5; i++) {
+        value = values[i];
+        status = xiaSetAcquisitionValues(0, names[i], &value);
+        CHECK_ERROR(status);
+    }
+
+    status = xiaBoardOperation(0, "apply", &ignored);
+    CHECK_ERROR(status);
+
+    for (i = 0; i < 6; i++) {
+        status = xiaGetParameter(0, params[i], &expected[i]);
+        CHECK_ERROR(status);
+    }
+
+    /* Move away from the expected settings before running the batch. */
+    value = 8.0;
+    status = xiaSetAcquisitionValues(0, "peaking_time", &value);
+    CHECK_ERROR(status);
+
+    value = 5.0;
+    status = xiaSetAcquisitionValues(0, "preamp_gain", &value);
+    CHECK_ERROR(status);
+
+    status = xiaBoardOperation(0, "apply", &ignored);
+    CHECK_ERROR(status);
+
+    status = xiaBeginAcquisitionBatch(0);
+    CHECK_ERROR(status);
+
+    for (i = 0; i < 5; i++) {
+        value = values[i];
+        status = xiaSetAcquisitionValues(0, names[i], &value);
+        CHECK_ERROR(status);
+    }
+
+    status = xiaCommitAcquisitionBatch(0);
+    CHECK_ERROR(status);
+
+    for (i = 0; i < 6; i++) {
+        status = xiaGetParameter(0, params[i], &actual);
+        CHECK_ERROR(status);
+
+        printf("%10s, %6hu, %6hu\n", params[i], expected[i], actual);
+
+        if (actual != expected[i]) {
+            printf("Batch left %s = %hu, expected %hu\n", params[i], actual,
+                   expected[i]);
+            CHECK_ERROR(XIA_BAD_VALUE);
+        }
+    }
+
+    for (i = 1; i < 5; i++) {
+        status = xiaGetAcquisitionValues(0, names[i], &readout);
+        CHECK_ERROR(status);
+
+        if (readout != values[i]) {
+            printf("Batch left %s = %0.3f, expected %0.3f\n", names[i], readout,
+                   values[i]);
+            CHECK_ERROR(XIA_BAD_VALUE);
+        }
+    }
+}
+
+struct run_waiter {
+    handel_md_Thread thread;
+    handel_md_Event done;
+    int status;
+};
+
+static void run_waiter_main(void* arg) {
+    struct run_waiter* waiter = (struct run_waiter*) arg;
+
+    waiter->status = xiaWaitRunComplete(0, 30.0);
+    handel_md_event_signal(&waiter->done);
+}
+
+static void test_cancel_run() {
+    int status;
+    int i;
+
+    double value;
+
+    struct run_waiter waiter;
+
+    printf("\nCancel while waiting for a run\n");
+
+    value = XIA_PRESET_FIXED_REAL;
+    status = xiaSetAcquisitionValues(0, "preset_type", &value);
+    CHECK_ERROR(status);
+
+    value = 60.0;
+    status = xiaSetAcquisitionValues(0, "preset_value", &value);
+    CHECK_ERROR(status);
+
+    status = xiaStartRun(0, 0);
+    CHECK_ERROR(status);
+
+    memset(&waiter, 0, sizeof(waiter));
+    waiter.done.name = "run_waiter";
+    waiter.thread.name = "run_waiter";
+    waiter.thread.state = handel_md_ThreadsDetached;
+    waiter.thread.entryPoint = run_waiter_main;
+    waiter.thread.argument = &waiter;
+
+    if (handel_md_event_create(&waiter.done) != THREADING_NO_ERROR ||
+        handel_md_thread_create(&waiter.thread) != THREADING_NO_ERROR) {
+        printf("Unable to start the waiting thread\n");
+        CHECK_ERROR(XIA_UNKNOWN);
+    }
+
+    /*
+     * The waiter only sees the cancels issued after it starts waiting, so
+     * keep cancelling until it returns. The run lasts much longer.
+     */
+    for (i = 0; i < 100; i++) {
+        status = xiaCancel(0);
+        CHECK_ERROR(status);
+
+        if (handel_md_event_wait(&waiter.done, 100) == THREADING_NO_ERROR) {
+            break;
+        }
+    }
+
+    status = xiaStopRun(0);
+    CHECK_ERROR(status);
+
+    /* Stopping the run ends the wait if the cancel was missed. */
+    if (i == 100) {
+        handel_md_event_wait(&waiter.done, 0);
+    }
+
+    handel_md_event_destroy(&waiter.done);
+
+    if (i == 100 || waiter.status != XIA_CANCELLED) {
+        printf("xiaWaitRunComplete returned %d, expected XIA_CANCELLED\n",
+               i == 100 ? XIA_TIMEOUT : waiter.status);
+        CHECK_ERROR(XIA_BAD_VALUE);
+    }
+
+    value = XIA_PRESET_NONE;
+    status = xiaSetAcquisitionValues(0, "preset_type", &value);
+    CHECK_ERROR(status);
+}
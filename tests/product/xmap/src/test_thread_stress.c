@@ -0,0 +1,285 @@
+/*
+ * Drives every module in the system from its own thread. Each thread
+ * alternates between MCA runs and mapping runs on its module, reading
+ * out the spectra and buffers, while the other threads do the same.
+ *
+ * Usage: test_thread_stress <ini file> [iterations]
+ *
+ * $Id$
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "xia_common.h"
+
+#include "handel.h"
+#include "handel_errors.h"
+#include "handel_generic.h"
+#include "md_threads.h"
+
+#define MAX_WORKERS 32
+
+struct worker {
+    char* alias;
+    int detChan;
+    int iterations;
+    int status;
+    handel_md_Thread thread;
+    handel_md_Event done;
+};
+
+static void worker_main(void* arg);
+static int do_mca_run(int detChan);
+static int do_mapping_run(int detChan);
+static int set_mapping_mode(int detChan, double mode);
+
+int main(int argc, char* argv[]) {
+    int status;
+    int failed = 0;
+    int iterations = 100;
+
+    unsigned int i;
+    unsigned int n_modules = 0;
+
+    char* aliases[MAX_WORKERS];
+
+    struct worker workers[MAX_WORKERS];
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <ini file> [iterations]\n", argv[0]);
+        exit(1);
+    }
+
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    xiaSetLogLevel(4);
+    xiaSetLogOutput("handel.log");
+
+    status = xiaInit(argv[1]);
+
+    if (status != XIA_SUCCESS) {
+        exit(1);
+    }
+
+    status = xiaStartSystem();
+
+    if (status != XIA_SUCCESS) {
+        exit(1);
+    }
+
+    status = xiaGetNumModules(&n_modules);
+
+    if (status != XIA_SUCCESS || n_modules > MAX_WORKERS) {
+        xiaExit();
+        exit(1);
+    }
+
+    for (i = 0; i < n_modules; i++) {
+        aliases[i] = malloc(MAXALIAS_LEN);
+        assert(aliases[i]);
+    }
+
+    status = xiaGetModules(aliases);
+
+    if (status != XIA_SUCCESS) {
+        xiaExit();
+        exit(1);
+    }
+
+    for (i = 0; i < n_modules; i++) {
+        struct worker* w = &workers[i];
+
+        w->alias = aliases[i];
+        w->iterations = iterations;
+        w->status = XIA_SUCCESS;
+
+        status = xiaGetModuleItem(w->alias, "channel0_alias", &w->detChan);
+
+        if (status != XIA_SUCCESS) {
+            xiaExit();
+            exit(1);
+        }
+
+        w->done.handle = NULL;
+        w->done.name = w->alias;
+
+        status = handel_md_event_create(&w->done);
+        assert(status == THREADING_NO_ERROR);
+
+        w->thread.handle = NULL;
+        w->thread.state = handel_md_ThreadsDetached;
+        w->thread.name = w->alias;
+        w->thread.priority = 0;
+        w->thread.stackSize = 0;
+        w->thread.attributes = 0;
+        w->thread.realtime = FALSE_;
+        w->thread.entryPoint = worker_main;
+        w->thread.argument = w;
+    }
+
+    for (i = 0; i < n_modules; i++) {
+        status = handel_md_thread_create(&workers[i].thread);
+        assert(status == THREADING_NO_ERROR);
+    }
+
+    for (i = 0; i < n_modules; i++) {
+        handel_md_event_wait(&workers[i].done, 0);
+        handel_md_event_destroy(&workers[i].done);
+
+        if (workers[i].status != XIA_SUCCESS) {
+            fprintf(stderr, "Module '%s' failed with status %d.\n", workers[i].alias,
+                    workers[i].status);
+            failed = 1;
+        }
+
+        free(aliases[i]);
+    }
+
+    xiaExit();
+
+    if (failed) {
+        return 1;
+    }
+
+    printf("%u modules completed %d iterations each.\n", n_modules, iterations);
+
+    return 0;
+}
+
+static void worker_main(void* arg) {
+    int i;
+
+    struct worker* w = (struct worker*) arg;
+
+    for (i = 0; i < w->iterations && w->status == XIA_SUCCESS; i++) {
+        w->status = do_mca_run(w->detChan);
+
+        if (w->status == XIA_SUCCESS) {
+            w->status = do_mapping_run(w->detChan);
+        }
+    }
+
+    handel_md_event_signal(&w->done);
+}
+
+static int do_mca_run(int detChan) {
+    int status;
+
+    unsigned long len;
+
+    unsigned long* buffer;
+
+    status = set_mapping_mode(detChan, 0.0);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    status = xiaStartRun(detChan, 0);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    handel_md_thread_sleep(10);
+
+    status = xiaGetRunData(detChan, "mca_length", &len);
+
+    if (status != XIA_SUCCESS) {
+        xiaStopRun(detChan);
+        return status;
+    }
+
+    buffer = malloc(len * sizeof(unsigned long));
+    assert(buffer);
+
+    status = xiaGetRunData(detChan, "mca", buffer);
+
+    free(buffer);
+
+    if (status != XIA_SUCCESS) {
+        xiaStopRun(detChan);
+        return status;
+    }
+
+    return xiaStopRun(detChan);
+}
+
+static int do_mapping_run(int detChan) {
+    int status;
+
+    unsigned short full = 0;
+
+    unsigned long len;
+
+    unsigned long* buffer;
+
+    char buffer_done = 'a';
+
+    status = set_mapping_mode(detChan, 1.0);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    status = xiaStartRun(detChan, 0);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    do {
+        status = xiaGetRunData(detChan, "buffer_full_a", &full);
+
+        if (status != XIA_SUCCESS) {
+            xiaStopRun(detChan);
+            return status;
+        }
+    } while (!full);
+
+    status = xiaGetRunData(detChan, "buffer_len", &len);
+
+    if (status != XIA_SUCCESS) {
+        xiaStopRun(detChan);
+        return status;
+    }
+
+    buffer = malloc(len * sizeof(unsigned long));
+    assert(buffer);
+
+    status = xiaGetRunData(detChan, "buffer_a", buffer);
+
+    free(buffer);
+
+    if (status != XIA_SUCCESS) {
+        xiaStopRun(detChan);
+        return status;
+    }
+
+    status = xiaBoardOperation(detChan, "buffer_done", &buffer_done);
+
+    if (status != XIA_SUCCESS) {
+        xiaStopRun(detChan);
+        return status;
+    }
+
+    return xiaStopRun(detChan);
+}
+
+static int set_mapping_mode(int detChan, double mode) {
+    int status;
+    int ignore = 0;
+
+    status = xiaSetAcquisitionValues(detChan, "mapping_mode", &mode);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    return xiaBoardOperation(detChan, "apply", &ignore);
+}
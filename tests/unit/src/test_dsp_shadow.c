@@ -0,0 +1,449 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Copyright 2025 XIA LLC, All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file test_dsp_shadow.c
+ * @brief Tests the DSP parameter shadow against a fake board.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "xerxes_errors.h"
+#include "xia_common.h"
+#include "xia_xerxes.h"
+#include "xia_xerxes_structures.h"
+
+#include "xerxes_dsp_shadow.h"
+
+#include <acutest.h>
+
+#define NUM_CHANS 2
+#define NUM_PARAMS 6
+#define MAX_BLOCKS 8
+
+/* Parameters 0-2 and 3-4 sit at consecutive addresses, 5 stands alone. */
+static Parameter PARAMS[NUM_PARAMS] = {
+    {"A", 10, 1, 0, 0}, {"B", 11, 1, 0, 0}, {"C", 12, 1, 0, 0},
+    {"D", 20, 1, 0, 0}, {"E", 21, 1, 0, 0}, {"F", 30, 1, 0, 0},
+};
+
+typedef struct {
+    int modChan;
+    unsigned int addr;
+    unsigned int len;
+    unsigned short data[NUM_PARAMS];
+} block_t;
+
+static block_t blocks[MAX_BLOCKS];
+static int nblocks;
+static int write_status;
+
+static Dsp_Params dsp_params;
+static Dsp_Info dsp_a;
+static Dsp_Info dsp_b;
+static Dsp_Info* dsps[NUM_CHANS];
+static Board board;
+
+static void stub_log(int level, const char* routine, const char* message, int error,
+                     const char* file, int line) {
+    UNUSED(level);
+    UNUSED(routine);
+    UNUSED(message);
+    UNUSED(error);
+    UNUSED(file);
+    UNUSED(line);
+}
+
+static int record_block(int* ioChan, int* modChan, unsigned int addr, unsigned int len,
+                        unsigned short* data) {
+    UNUSED(ioChan);
+
+    if (write_status != DXP_SUCCESS) {
+        return write_status;
+    }
+
+    TEST_ASSERT(nblocks < MAX_BLOCKS);
+    TEST_ASSERT(len <= NUM_PARAMS);
+
+    blocks[nblocks].modChan = *modChan;
+    blocks[nblocks].addr = addr;
+    blocks[nblocks].len = len;
+    memcpy(blocks[nblocks].data, data, len * sizeof(unsigned short));
+    nblocks++;
+
+    return DXP_SUCCESS;
+}
+
+static int record_memory(int ioChan, unsigned long base, unsigned long len,
+                         unsigned long* data) {
+    unsigned long i;
+
+    UNUSED(ioChan);
+
+    if (write_status != DXP_SUCCESS) {
+        return write_status;
+    }
+
+    TEST_ASSERT(nblocks < MAX_BLOCKS);
+    TEST_ASSERT(len <= NUM_PARAMS);
+
+    blocks[nblocks].modChan = -1;
+    blocks[nblocks].addr = (unsigned int) base;
+    blocks[nblocks].len = (unsigned int) len;
+
+    for (i = 0; i < len; i++) {
+        blocks[nblocks].data[i] = (unsigned short) data[i];
+    }
+
+    nblocks++;
+
+    return DXP_SUCCESS;
+}
+
+static int flush(int modChan) {
+    int ioChan = 0;
+
+    nblocks = 0;
+    return dxp_dsp_shadow_flush(&board, &ioChan, &modChan, record_block);
+}
+
+static void setup(void) {
+    xerxes_md_alloc = malloc;
+    xerxes_md_free = free;
+    xerxes_md_log = stub_log;
+
+    memset(&dsp_params, 0, sizeof(dsp_params));
+    dsp_params.parameters = PARAMS;
+    dsp_params.nsymbol = NUM_PARAMS;
+
+    memset(&dsp_a, 0, sizeof(dsp_a));
+    memset(&dsp_b, 0, sizeof(dsp_b));
+    dsp_a.params = &dsp_params;
+    dsp_b.params = &dsp_params;
+
+    dsps[0] = &dsp_a;
+    dsps[1] = &dsp_a;
+
+    memset(&board, 0, sizeof(board));
+    board.nchan = NUM_CHANS;
+    board.dsp = dsps;
+
+    nblocks = 0;
+    write_status = DXP_SUCCESS;
+}
+
+static void teardown(void) {
+    dxp_dsp_shadow_free(&board);
+}
+
+void diff(void) {
+    setup();
+
+    TEST_CASE("Changed write is deferred until flush");
+    {
+        TEST_CHECK(dxp_dsp_shadow_write(&board, 0, 0, 5) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 0);
+        TEST_CHECK(board.shadow[0].ndirty == 1);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 10 && blocks[0].len == 1);
+        TEST_CHECK(blocks[0].data[0] == 5);
+        TEST_CHECK(board.shadow[0].ndirty == 0);
+    }
+
+    TEST_CASE("Unchanged write is dropped");
+    {
+        TEST_CHECK(dxp_dsp_shadow_write(&board, 0, 0, 5) == DXP_SUCCESS);
+        TEST_CHECK(board.shadow[0].ndirty == 0);
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 0);
+    }
+
+    TEST_CASE("Rewriting a dirty parameter counts it once");
+    {
+        TEST_CHECK(dxp_dsp_shadow_write(&board, 0, 0, 6) == DXP_SUCCESS);
+        TEST_CHECK(dxp_dsp_shadow_write(&board, 0, 0, 7) == DXP_SUCCESS);
+        TEST_CHECK(board.shadow[0].ndirty == 1);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].data[0] == 7);
+    }
+
+    TEST_CASE("Reads return host written values only");
+    {
+        unsigned short value = 0;
+
+        TEST_CHECK(dxp_dsp_shadow_read(&board, 0, 0, &value));
+        TEST_CHECK(value == 7);
+        TEST_CHECK(!dxp_dsp_shadow_read(&board, 0, 1, &value));
+        TEST_CHECK(!dxp_dsp_shadow_read(&board, 1, 0, &value));
+        TEST_CHECK(!dxp_dsp_shadow_read(&board, ALLCHAN, 0, &value));
+    }
+
+    teardown();
+}
+
+void coalesce(void) {
+    setup();
+
+    TEST_CASE("Consecutive addresses are written as one block");
+    {
+        dxp_dsp_shadow_write(&board, 0, 0, 1);
+        dxp_dsp_shadow_write(&board, 0, 1, 2);
+        dxp_dsp_shadow_write(&board, 0, 2, 3);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 10 && blocks[0].len == 3);
+        TEST_CHECK(blocks[0].data[0] == 1 && blocks[0].data[1] == 2 &&
+                   blocks[0].data[2] == 3);
+    }
+
+    TEST_CASE("Blocks span valid clean parameters");
+    {
+        dxp_dsp_shadow_write(&board, 0, 0, 4);
+        dxp_dsp_shadow_write(&board, 0, 2, 6);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 10 && blocks[0].len == 3);
+        TEST_CHECK(blocks[0].data[0] == 4 && blocks[0].data[1] == 2 &&
+                   blocks[0].data[2] == 6);
+    }
+
+    TEST_CASE("Blocks stop at trailing clean parameters");
+    {
+        dxp_dsp_shadow_write(&board, 0, 0, 8);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 10 && blocks[0].len == 1);
+    }
+
+    TEST_CASE("Address gaps split blocks");
+    {
+        dxp_dsp_shadow_write(&board, 0, 2, 9);
+        dxp_dsp_shadow_write(&board, 0, 3, 10);
+        dxp_dsp_shadow_write(&board, 0, 4, 11);
+        dxp_dsp_shadow_write(&board, 0, 5, 12);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 3);
+        TEST_CHECK(blocks[0].addr == 12 && blocks[0].len == 1);
+        TEST_CHECK(blocks[1].addr == 20 && blocks[1].len == 2);
+        TEST_CHECK(blocks[1].data[0] == 10 && blocks[1].data[1] == 11);
+        TEST_CHECK(blocks[2].addr == 30 && blocks[2].len == 1);
+    }
+
+    teardown();
+    setup();
+
+    TEST_CASE("Parameters never written break a block");
+    {
+        dxp_dsp_shadow_write(&board, 0, 0, 1);
+        dxp_dsp_shadow_write(&board, 0, 2, 3);
+
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 2);
+        TEST_CHECK(blocks[0].addr == 10 && blocks[0].len == 1);
+        TEST_CHECK(blocks[1].addr == 12 && blocks[1].len == 1);
+    }
+
+    TEST_CASE("All channels are flushed");
+    {
+        dxp_dsp_shadow_write(&board, 0, 5, 1);
+        dxp_dsp_shadow_write(&board, 1, 5, 2);
+
+        TEST_CHECK(flush(ALLCHAN) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 2);
+        TEST_CHECK(blocks[0].modChan == 0 && blocks[0].data[0] == 1);
+        TEST_CHECK(blocks[1].modChan == 1 && blocks[1].data[0] == 2);
+    }
+
+    TEST_CASE("Failed writes stay dirty");
+    {
+        dxp_dsp_shadow_write(&board, 0, 5, 3);
+
+        write_status = DXP_WRITE_TSAR;
+        TEST_CHECK(flush(0) == DXP_WRITE_TSAR);
+        TEST_CHECK(board.shadow[0].ndirty == 1);
+
+        write_status = DXP_SUCCESS;
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 30 && blocks[0].data[0] == 3);
+    }
+
+    teardown();
+}
+
+void invalidate(void) {
+    unsigned short value;
+
+    setup();
+
+    TEST_CASE("Invalidate drops values and pending writes");
+    {
+        dxp_dsp_shadow_write(&board, 0, 0, 1);
+        dxp_dsp_shadow_write(&board, 1, 0, 1);
+        dxp_dsp_shadow_invalidate(&board, 0);
+
+        TEST_CHECK(!dxp_dsp_shadow_read(&board, 0, 0, &value));
+        TEST_CHECK(dxp_dsp_shadow_read(&board, 1, 0, &value));
+        TEST_CHECK(flush(ALLCHAN) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].modChan == 1);
+    }
+
+    TEST_CASE("Writes after invalidate reach the hardware");
+    {
+        dxp_dsp_shadow_write(&board, 1, 0, 1);
+        TEST_CHECK(flush(1) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 0);
+
+        dxp_dsp_shadow_invalidate(&board, ALLCHAN);
+        dxp_dsp_shadow_write(&board, 1, 0, 1);
+        TEST_CHECK(flush(1) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+    }
+
+    TEST_CASE("New DSP code discards the shadow");
+    {
+        dxp_dsp_shadow_write(&board, 0, 1, 2);
+        dsps[0] = &dsp_b;
+
+        TEST_CHECK(!dxp_dsp_shadow_read(&board, 0, 1, &value));
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 0);
+
+        dxp_dsp_shadow_write(&board, 0, 1, 2);
+        TEST_CHECK(board.shadow[0].dsp == &dsp_b);
+        TEST_CHECK(flush(0) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 11 && blocks[0].data[0] == 2);
+    }
+
+    teardown();
+    TEST_CHECK(board.shadow == NULL);
+}
+
+void symbols(void) {
+    unsigned long addr = 0;
+    unsigned long offsets[2] = {0x100, 0x200};
+
+    Dsp_Params system_params;
+    Dsp_Info system_dsp;
+
+    setup();
+
+    TEST_CASE("Per-channel DSP");
+    {
+        TEST_CHECK(dxp_dsp_symbol(&board, 1, 4, &addr) == &PARAMS[4]);
+        TEST_CHECK(addr == 21);
+        TEST_CHECK(dxp_dsp_symbol(&board, 1, NUM_PARAMS, &addr) == NULL);
+    }
+
+    TEST_CASE("System DSP");
+    {
+        memset(&system_params, 0, sizeof(system_params));
+        system_params.parameters = PARAMS;
+        system_params.nsymbol = 2;
+        system_params.per_chan_parameters = &PARAMS[2];
+        system_params.n_per_chan_symbols = 3;
+        system_params.chan_offsets = offsets;
+        system_params.n_chan_offsets = 2;
+
+        memset(&system_dsp, 0, sizeof(system_dsp));
+        system_dsp.params = &system_params;
+        board.system_dsp = &system_dsp;
+
+        TEST_CHECK(dxp_dsp_symbol(&board, 1, 1, &addr) == &PARAMS[1]);
+        TEST_CHECK(addr == 11);
+
+        TEST_CHECK(dxp_dsp_symbol(&board, 0, 2, &addr) == &PARAMS[2]);
+        TEST_CHECK(addr == 0x100 + 12);
+
+        TEST_CHECK(dxp_dsp_symbol(&board, 1, 4, &addr) == &PARAMS[4]);
+        TEST_CHECK(addr == 0x200 + 21);
+
+        TEST_CHECK(dxp_dsp_symbol(&board, 0, 5, &addr) == NULL);
+        TEST_CHECK(dxp_dsp_symbol(&board, 2, 2, &addr) == NULL);
+    }
+
+    teardown();
+}
+
+void symbol_blocks(void) {
+    int ioChan = 0;
+    int modChan = 0;
+    unsigned short values[NUM_PARAMS] = {1, 2, 3, 4, 5, 6};
+
+    setup();
+
+    TEST_CASE("Runs of consecutive addresses are written as one block");
+    {
+        TEST_CHECK(dxp_dsp_symbols_write(&board, &ioChan, &modChan, 0, NUM_PARAMS,
+                                         values, record_memory) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 3);
+        TEST_CHECK(blocks[0].addr == 10 && blocks[0].len == 3);
+        TEST_CHECK(blocks[0].data[0] == 1 && blocks[0].data[2] == 3);
+        TEST_CHECK(blocks[1].addr == 20 && blocks[1].len == 2);
+        TEST_CHECK(blocks[1].data[0] == 4 && blocks[1].data[1] == 5);
+        TEST_CHECK(blocks[2].addr == 30 && blocks[2].len == 1);
+        TEST_CHECK(blocks[2].data[0] == 6);
+    }
+
+    TEST_CASE("A run may start mid-block");
+    {
+        nblocks = 0;
+        TEST_CHECK(dxp_dsp_symbols_write(&board, &ioChan, &modChan, 1, 3, values,
+                                         record_memory) == DXP_SUCCESS);
+        TEST_CHECK(nblocks == 2);
+        TEST_CHECK(blocks[0].addr == 11 && blocks[0].len == 2);
+        TEST_CHECK(blocks[1].addr == 20 && blocks[1].len == 1);
+        TEST_CHECK(blocks[1].data[0] == 3);
+    }
+
+    TEST_CASE("An unknown parameter stops the write");
+    {
+        nblocks = 0;
+        TEST_CHECK(dxp_dsp_symbols_write(&board, &ioChan, &modChan, 4, 3, values,
+                                         record_memory) == DXP_NOSYMBOL);
+        TEST_CHECK(nblocks == 1);
+        TEST_CHECK(blocks[0].addr == 21 && blocks[0].len == 1);
+    }
+
+    TEST_CASE("Failed writes are reported");
+    {
+        write_status = DXP_WRITE_TSAR;
+        TEST_CHECK(dxp_dsp_symbols_write(&board, &ioChan, &modChan, 0, 2, values,
+                                         record_memory) == DXP_WRITE_TSAR);
+    }
+
+    teardown();
+}
+
+TEST_LIST = {
+    {"Diff", diff},
+    {"Coalesce", coalesce},
+    {"Invalidate", invalidate},
+    {"Symbols", symbols},
+    {"Symbol Blocks", symbol_blocks},
+    {NULL, NULL} /* zeroed record marking the end of the list */
+};
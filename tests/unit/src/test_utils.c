@@ -20,11 +20,18 @@
  * @brief Tests all the utility headers.
  */
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <util/xia_ary_manip.h>
 #include <util/xia_compare.h>
 #include <util/xia_crc.h>
+#include <util/xia_map_tune.h>
+#include <util/xia_ring.h>
 #include <util/xia_str_manip.h>
+#include <util/xia_unpack.h>
+
+#include <xia_common.h>
+#include <md_threads.h>
 
 #include <acutest.h>
 
@@ -204,6 +211,254 @@ void lower(void) {
     }
 }
 
+void map_tune(void) {
+    unsigned long n;
+
+    TEST_CASE("Known inputs");
+    {
+        /* 32 * 0.5 / 64 fills in 0.25 s; 2 * (32 * 0.125 / 64 + 0.0625) = 0.25 s. */
+        n = xia_map_tune_size(0.5, 0.125, 0.0625, 64.0, 2.0);
+        TEST_CHECK(n == 32);
+        TEST_MSG("Recommended %lu pixels, expected 32", n);
+
+        n = xia_map_tune_size(0.1, 0.01, 0.005, 100.0, 2.0);
+        TEST_CHECK(n == 13);
+        TEST_MSG("Recommended %lu pixels, expected 13 for 12.5 rounded up", n);
+
+        n = xia_map_tune_size(0.5, 0.125, 0.0, 64.0, 2.0);
+        TEST_CHECK(n == 1);
+        TEST_MSG("Recommended %lu pixels, expected 1 with no buffer_done time", n);
+    }
+
+    TEST_CASE("Reaches the target");
+    {
+        double fill = 0.2;
+        double read = 0.03;
+        double done = 0.004;
+        double pixels = 150.0;
+        double target = 3.0;
+
+        n = xia_map_tune_size(fill, read, done, pixels, target);
+        TEST_CHECK(n * fill / pixels >= target * (n * read / pixels + done));
+        TEST_MSG("%lu pixels miss a headroom of %0.1f", n, target);
+        TEST_CHECK((n - 1) * fill / pixels < target * ((n - 1) * read / pixels + done));
+        TEST_MSG("%lu pixels already reach a headroom of %0.1f", n - 1, target);
+    }
+
+    TEST_CASE("No size fits");
+    {
+        n = xia_map_tune_size(0.1, 0.05, 0.005, 100.0, 2.0);
+        TEST_CHECK(n == 0);
+        TEST_MSG("Recommended %lu pixels when reading takes half the fill", n);
+
+        n = xia_map_tune_size(0.1, 0.08, 0.005, 100.0, 2.0);
+        TEST_CHECK(n == 0);
+        TEST_MSG("Recommended %lu pixels when reading is slower than filling", n);
+
+        n = xia_map_tune_size(1.0, 0.499999, 1.0e6, 1.0e6, 2.0);
+        TEST_CHECK(n == 0);
+        TEST_MSG("Recommended %lu pixels past the largest buffer", n);
+    }
+
+    TEST_CASE("Nothing measured");
+    {
+        n = xia_map_tune_size(0.1, 0.01, 0.005, 0.0, 2.0);
+        TEST_CHECK(n == 0);
+        TEST_MSG("Recommended %lu pixels without pixels", n);
+
+        n = xia_map_tune_size(0.0, 0.0, 0.0, 100.0, 2.0);
+        TEST_CHECK(n == 0);
+        TEST_MSG("Recommended %lu pixels without a fill time", n);
+    }
+}
+
+void ring(void) {
+    struct xia_ring r;
+    uint32_t i;
+    size_t len = 0;
+    unsigned long* slot;
+    const unsigned long* out;
+
+    TEST_CASE("Ring init");
+    {
+        TEST_CHECK(!xia_ring_init(&r, 0, 16));
+        TEST_MSG("A ring needs at least one slot");
+
+        TEST_CHECK(!xia_ring_init(&r, 4, 0));
+        TEST_MSG("A ring needs a non-zero slot size");
+
+        TEST_ASSERT(xia_ring_init(&r, 5, 100));
+        TEST_CHECK(r.capacity == 8);
+        TEST_MSG("Capacity 5 rounds up to 8, got %u", r.capacity);
+
+        TEST_CHECK(r.slot_size == 128);
+        TEST_MSG("Slot size 100 rounds up to 128, got %zu", r.slot_size);
+
+        TEST_CHECK(((uintptr_t) r.slots % XIA_RING_CACHE_LINE) == 0);
+        TEST_MSG("Slots are cache-line aligned");
+
+        TEST_CHECK(xia_ring_peek(&r, NULL) == NULL);
+        TEST_MSG("A new ring is empty");
+    }
+
+    TEST_CASE("Ring fill and drain");
+    {
+        for (i = 0; i < r.capacity; i++) {
+            slot = (unsigned long*) xia_ring_acquire(&r);
+            TEST_ASSERT(slot != NULL);
+            slot[0] = i;
+            xia_ring_commit(&r, sizeof(unsigned long));
+        }
+
+        TEST_CHECK(xia_ring_acquire(&r) == NULL);
+        TEST_MSG("A full ring has no free slot");
+
+        TEST_CHECK(xia_ring_occupancy(&r) == 8 && xia_ring_high_water(&r) == 8);
+        TEST_MSG("Occupancy %u, high water %u", xia_ring_occupancy(&r),
+                 xia_ring_high_water(&r));
+
+        for (i = 0; i < 3; i++) {
+            out = (const unsigned long*) xia_ring_peek(&r, &len);
+            TEST_ASSERT(out != NULL);
+            TEST_CHECK(out[0] == i && len == sizeof(unsigned long));
+            TEST_MSG("Slot %u holds %lu with length %zu", i, out[0], len);
+            xia_ring_release(&r);
+        }
+
+        xia_ring_reset_high_water(&r);
+        TEST_CHECK(xia_ring_occupancy(&r) == 5 && xia_ring_high_water(&r) == 5);
+        TEST_MSG("Occupancy %u, high water %u", xia_ring_occupancy(&r),
+                 xia_ring_high_water(&r));
+    }
+
+    TEST_CASE("Ring wrap around");
+    {
+        for (i = 0; i < 1000; i++) {
+            slot = (unsigned long*) xia_ring_acquire(&r);
+            TEST_ASSERT(slot != NULL);
+            slot[0] = 100 + i;
+            xia_ring_commit(&r, i);
+
+            out = (const unsigned long*) xia_ring_peek(&r, &len);
+            TEST_ASSERT(out != NULL);
+            xia_ring_release(&r);
+        }
+
+        for (i = 0; i < 5; i++) {
+            out = (const unsigned long*) xia_ring_peek(&r, &len);
+            TEST_ASSERT(out != NULL);
+            xia_ring_release(&r);
+        }
+
+        TEST_CHECK(out[0] == 1099 && len == 999);
+        TEST_MSG("The last slot holds %lu with length %zu", out[0], len);
+
+        TEST_CHECK(xia_ring_peek(&r, NULL) == NULL && xia_ring_occupancy(&r) == 0);
+        TEST_MSG("The ring drains empty");
+
+        TEST_CHECK(xia_ring_high_water(&r) == 6);
+        TEST_MSG("High water %u", xia_ring_high_water(&r));
+    }
+
+    xia_ring_free(&r);
+}
+
+#define RING_THREAD_ITEMS 200000
+
+struct ring_producer {
+    handel_md_Thread thread;
+    handel_md_Event done;
+    struct xia_ring* ring;
+};
+
+/*
+ * Spins on a full or empty ring, yielding now and then so the other side
+ * runs on a single CPU too.
+ */
+static void ring_wait(unsigned int* spins) {
+    if (++*spins % 64 == 0) {
+        handel_md_thread_sleep(0);
+    }
+}
+
+/*
+ * Pushes RING_THREAD_ITEMS numbered slots, waiting whenever the ring is
+ * full. Item i holds i and its complement and has a length of i % 7 + 1.
+ */
+static void ring_producer_main(void* arg) {
+    struct ring_producer* producer = (struct ring_producer*) arg;
+    uint32_t i;
+    uint32_t* slot;
+    unsigned int spins = 0;
+
+    for (i = 0; i < RING_THREAD_ITEMS; i++) {
+        while ((slot = (uint32_t*) xia_ring_acquire(producer->ring)) == NULL) {
+            ring_wait(&spins);
+        }
+
+        slot[0] = i;
+        slot[1] = ~i;
+        xia_ring_commit(producer->ring, i % 7 + 1);
+    }
+
+    handel_md_event_signal(&producer->done);
+}
+
+void ring_threads(void) {
+    struct xia_ring r;
+    struct ring_producer producer;
+    uint32_t i;
+    uint32_t mismatches = 0;
+    uint32_t first = 0;
+    unsigned int spins = 0;
+    size_t len = 0;
+    const uint32_t* out;
+
+    TEST_ASSERT(xia_ring_init(&r, 64, 2 * sizeof(uint32_t)));
+
+    /* Start the indices just short of the 32-bit rollover. */
+    r.head = r.tail = 0xFFFFFFFFu - 1000;
+
+    producer.ring = &r;
+    producer.thread.name = "ring producer";
+    producer.thread.state = handel_md_ThreadsDetached;
+    producer.thread.entryPoint = ring_producer_main;
+    producer.thread.argument = &producer;
+
+    TEST_ASSERT(handel_md_event_create(&producer.done) == THREADING_NO_ERROR);
+    TEST_ASSERT(handel_md_thread_create(&producer.thread) == THREADING_NO_ERROR);
+
+    TEST_CASE("One producer, one consumer");
+    {
+        for (i = 0; i < RING_THREAD_ITEMS; i++) {
+            while ((out = (const uint32_t*) xia_ring_peek(&r, &len)) == NULL) {
+                ring_wait(&spins);
+            }
+
+            if (out[0] != i || out[1] != ~i || len != i % 7 + 1) {
+                if (mismatches++ == 0) {
+                    first = i;
+                }
+            }
+
+            xia_ring_release(&r);
+        }
+
+        handel_md_event_wait(&producer.done, 0);
+
+        TEST_CHECK_(mismatches == 0,
+                    "%u of %u items out of order or changed, the first at %u",
+                    mismatches, RING_THREAD_ITEMS, first);
+        TEST_CHECK(xia_ring_peek(&r, NULL) == NULL && xia_ring_occupancy(&r) == 0);
+        TEST_MSG("The ring drains empty");
+        TEST_CHECK(xia_ring_high_water(&r) <= r.capacity);
+        TEST_MSG("High water %u", xia_ring_high_water(&r));
+    }
+
+    handel_md_event_destroy(&producer.done);
+    xia_ring_free(&r);
+}
+
 void rounding(void) {
     TEST_CASE("Positive");
     {
@@ -223,6 +478,84 @@ void rounding(void) {
     }
 }
 
+/*
+ * Packs n words, two to an element, into the back half of data the way the
+ * hardware delivers them and fills the front half with junk.
+ */
+static void pack_words(unsigned long* data, const unsigned long* words, size_t n) {
+    size_t i;
+    size_t offset = n / 2;
+
+    for (i = 0; i < offset; i++) {
+        data[i] = 0xDEADBEEF;
+    }
+
+    for (i = 0; i < n - offset; i++) {
+        unsigned long hi = 2 * i + 1 < n ? words[2 * i + 1] : 0xBEEF;
+
+        data[offset + i] = words[2 * i] | (hi << 16);
+    }
+}
+
+static size_t check_unpacked(size_t n) {
+    size_t i;
+    size_t bad = 0;
+
+    unsigned long* words = malloc((n + 1) * sizeof(unsigned long));
+    unsigned long* data = malloc((n + 1) * sizeof(unsigned long));
+
+    for (i = 0; i < n; i++) {
+        words[i] = (0x8001 + 37 * i) & 0xFFFF;
+    }
+
+    pack_words(data, words, n);
+    xia_unpack_packed_words(data, n);
+
+    for (i = 0; i < n; i++) {
+        if (data[i] != words[i]) {
+            bad++;
+        }
+    }
+
+    free(words);
+    free(data);
+
+    return bad;
+}
+
+void unpack(void) {
+    size_t n;
+    size_t bad;
+
+    TEST_CASE("Short buffers");
+    {
+        /* Covers odd and even n and every remainder after the vector loops. */
+        for (n = 0; n <= 33; n++) {
+            bad = check_unpacked(n);
+            TEST_CHECK_(bad == 0, "n = %zu", n);
+            TEST_MSG("%zu of %zu words unpacked wrong", bad, n);
+        }
+    }
+
+    TEST_CASE("Long buffers");
+    {
+        for (n = 4093; n <= 4099; n++) {
+            bad = check_unpacked(n);
+            TEST_CHECK_(bad == 0, "n = %zu", n);
+            TEST_MSG("%zu of %zu words unpacked wrong", bad, n);
+        }
+    }
+
+    TEST_CASE("High bits");
+    {
+        unsigned long data[3] = {0, 0xFFFF1234, 0xFFFF5678};
+
+        xia_unpack_packed_words(data, 3);
+        TEST_CHECK(data[0] == 0x1234 && data[1] == 0xFFFF && data[2] == 0x5678);
+        TEST_MSG("Unpacked %#lx %#lx %#lx", data[0], data[1], data[2]);
+    }
+}
+
 TEST_LIST = {
     {"Approx", approx},
     {"Compare Arrays", compare_arrays},
@@ -230,6 +563,10 @@ TEST_LIST = {
     {"CRC32", crc32},
     {"Fill Arrays", fill_array},
     {"Lower", lower},
+    {"Map Tune", map_tune},
+    {"Ring", ring},
+    {"Ring Threads", ring_threads},
     {"Rounding", rounding},
+    {"Unpack", unpack},
     {NULL, NULL} /* zeroed record marking the end of the list */
 };